@@ -1,16 +1,45 @@
 VERSE_VS_IN vec4 osg_Tangent;
+#ifndef VERSE_GLES2
+VERSE_VS_IN vec4 osg_InstanceRow0, osg_InstanceRow1, osg_InstanceRow2;
+#endif
+uniform int InstancingMode;
 VERSE_VS_OUT vec4 texCoord0, texCoord1, color, eyeVertex;
 VERSE_VS_OUT vec3 eyeNormal, eyeTangent, eyeBinormal;
 
+vec3 instanceVector(vec3 v)
+{
+#ifndef VERSE_GLES2
+    return vec3(dot(osg_InstanceRow0.xyz, v), dot(osg_InstanceRow1.xyz, v), dot(osg_InstanceRow2.xyz, v));
+#else
+    return v;
+#endif
+}
+
+vec4 instanceVertex(vec4 v)
+{
+#ifndef VERSE_GLES2
+    return vec4(dot(osg_InstanceRow0, v), dot(osg_InstanceRow1, v), dot(osg_InstanceRow2, v), v.w);
+#else
+    return v;
+#endif
+}
+
 void main()
 {
-    eyeNormal = normalize(VERSE_MATRIX_N * osg_Normal);
-    eyeTangent = normalize(VERSE_MATRIX_N * osg_Tangent.xyz);
-    eyeBinormal = normalize(VERSE_MATRIX_N * (cross(osg_Normal, osg_Tangent.xyz) * osg_Tangent.w));
-    eyeVertex = VERSE_MATRIX_MV * osg_Vertex;
+    vec4 vertex = osg_Vertex; vec3 normal = osg_Normal, tangent = osg_Tangent.xyz;
+    if (InstancingMode > 0)
+    {
+        vertex = instanceVertex(vertex);
+        normal = instanceVector(normal); tangent = instanceVector(tangent);
+    }
+
+    eyeNormal = normalize(VERSE_MATRIX_N * normal);
+    eyeTangent = normalize(VERSE_MATRIX_N * tangent);
+    eyeBinormal = normalize(VERSE_MATRIX_N * (cross(normal, tangent) * osg_Tangent.w));
+    eyeVertex = VERSE_MATRIX_MV * vertex;
 
     texCoord0 = osg_MultiTexCoord0;
     texCoord1 = osg_MultiTexCoord1;
     color = osg_Color;
-    gl_Position = VERSE_MATRIX_MVP * osg_Vertex;
+    gl_Position = VERSE_MATRIX_MVP * vertex;
 }
@@ -1,8 +1,22 @@
+#ifndef VERSE_GLES2
+VERSE_VS_IN vec4 osg_InstanceRow0, osg_InstanceRow1, osg_InstanceRow2;
+#endif
+uniform int InstancingMode;
 VERSE_VS_OUT vec4 texCoord0, lightProjVec;
 
+vec4 instanceVertex(vec4 v)
+{
+#ifndef VERSE_GLES2
+    return vec4(dot(osg_InstanceRow0, v), dot(osg_InstanceRow1, v), dot(osg_InstanceRow2, v), v.w);
+#else
+    return v;
+#endif
+}
+
 void main()
 {
-    lightProjVec = VERSE_MATRIX_MVP * osg_Vertex;
+    vec4 vertex = (InstancingMode > 0) ? instanceVertex(osg_Vertex) : osg_Vertex;
+    lightProjVec = VERSE_MATRIX_MVP * vertex;
     texCoord0 = osg_MultiTexCoord0;
     gl_Position = lightProjVec;
 }
@@ -139,12 +139,20 @@ BSplineVolume::BSplineVolume(int numUCtrl, int numVCtrl, int numWCtrl, int uDeg,
     _basis[0].create(numUCtrl, uDeg, false);
     _basis[1].create(numVCtrl, vDeg, false);
     _basis[2].create(numWCtrl, wDeg, false);
+    _ctrlPointArray.resize(numUCtrl * numVCtrl * numWCtrl);
 }
 
 BSplineVolume::~BSplineVolume()
 {
 }
 
+void BSplineVolume::setControlPoint(const VolumeIndex& index, const osg::Vec3& cp)
+{
+    _ctrlPoints[index] = cp;
+    unsigned int flatIndex = getControlPointIndex(index);
+    if (flatIndex < _ctrlPointArray.size()) _ctrlPointArray[flatIndex] = cp;
+}
+
 osg::Vec3 BSplineVolume::getControlPoint(const VolumeIndex& index) const
 {
     std::map<VolumeIndex, osg::Vec3>::const_iterator itr = _ctrlPoints.find(index);
@@ -177,6 +185,44 @@ osg::Vec3 BSplineVolume::getPosition(float u, float v, float w)
     return pos;
 }
 
+unsigned int BSplineVolume::getNumWeights() const
+{
+    return (getDegree(0) + 1) * (getDegree(1) + 1) * (getDegree(2) + 1);
+}
+
+void BSplineVolume::getWeightOffsets(std::vector<unsigned int>& offsets) const
+{
+    offsets.clear(); offsets.reserve(getNumWeights());
+    for (int iu = 0; iu <= getDegree(0); ++iu)
+    {
+        for (int iv = 0; iv <= getDegree(1); ++iv)
+        {
+            for (int iw = 0; iw <= getDegree(2); ++iw)
+                offsets.push_back(getControlPointIndex(VolumeIndex(iu, iv, iw)));
+        }
+    }
+}
+
+unsigned int BSplineVolume::computeWeights(UniformBSpline* basis, float u, float v, float w,
+                                           float* weights) const
+{
+    int umin, umax, vmin, vmax, wmin, wmax, k = 0;
+    basis[0].compute(u, 0, umin, umax);
+    basis[1].compute(v, 0, vmin, vmax);
+    basis[2].compute(w, 0, wmin, wmax);
+    for (int iu = umin; iu <= umax; ++iu)
+    {
+        double tmp0 = basis[0].getD0(iu);
+        for (int iv = vmin; iv <= vmax; ++iv)
+        {
+            double tmp1 = basis[1].getD0(iv);
+            for (int iw = wmin; iw <= wmax; ++iw)
+                weights[k++] = (float)(tmp0 * tmp1 * basis[2].getD0(iw));
+        }
+    }
+    return getControlPointIndex(VolumeIndex(umin, vmin, wmin));
+}
+
 osg::Vec3 BSplineVolume::getDerivativeU(float u, float v, float w)
 {
     int umin, umax, vmin, vmax, wmin, wmax;
@@ -288,7 +334,7 @@ void ApplyUserNodeVisitor::applyDrawable(osg::Drawable* drawable)
 void ApplyUserNodeVisitor::reset(bool resetBB, bool resetVM)
 {
     if (resetBB) _bb.init();
-    if (resetVM) _normVertexMap.clear();
+    if (resetVM) { _normVertexMap.clear(); _weightMap.clear(); }
     _matrixStack.clear();
     _matrixStack.push_back(osg::Matrix::identity());
 }
@@ -337,7 +383,7 @@ void ApplyUserNodeVisitor::computeNormalizedVertex(osg::Geometry* geometry)
 
     osg::Matrix matrix = _matrixStack.back();
     VertexList& list = _normVertexMap[geometry];
-    list.resize(va->size());
+    list.resize(va->size()); _weightMap.erase(geometry);
     for (unsigned int i = 0; i < va->size(); ++i)
     {
         osg::Vec3 pt = (*va)[i] * matrix;
@@ -352,13 +398,16 @@ void ApplyUserNodeVisitor::computeNewVertex(osg::Geometry* geometry)
     if (!va || !_volume) return;
 
     osg::Matrix invMatrix = osg::Matrix::inverse(_upperMatrix * _matrixStack.back());
-    VertexList& list = _normVertexMap[geometry];
-
-    unsigned int minSize = osg::minimum(va->size(), list.size());
-    for (unsigned int i = 0; i < minSize; ++i)
+    if (_useCachedWeights) computeNewVertexCached(geometry, invMatrix);
+    else
     {
-        const osg::Vec3& param = list[i];
-        (*va)[i] = _volume->getPosition(param[0], param[1], param[2]) * invMatrix;
+        VertexList& list = _normVertexMap[geometry];
+        unsigned int minSize = osg::minimum(va->size(), list.size());
+        for (unsigned int i = 0; i < minSize; ++i)
+        {
+            const osg::Vec3& param = list[i];
+            (*va)[i] = _volume->getPosition(param[0], param[1], param[2]) * invMatrix;
+        }
     }
 
     if (geometry->getUseVertexBufferObjects()) { va->dirty(); }
@@ -368,6 +417,54 @@ void ApplyUserNodeVisitor::computeNewVertex(osg::Geometry* geometry)
     geometry->dirtyBound();
 }
 
+void ApplyUserNodeVisitor::computeNewVertexCached(osg::Geometry* geometry, const osg::Matrix& invMatrix)
+{
+    osg::Vec3Array* va = static_cast<osg::Vec3Array*>(geometry->getVertexArray());
+    const VertexList& list = _normVertexMap[geometry];
+    int numWeights = (int)_volume->getNumWeights();
+    int minSize = (int)osg::minimum(va->size(), list.size());
+    if (minSize < 1) return;
+
+    WeightData& data = _weightMap[geometry];
+    if (data.firstIndices.size() != (size_t)minSize ||
+        data.weights.size() != (size_t)(minSize * numWeights))
+    {
+        // Basis weights never change unless the volume or vertex parameters are reset
+        const BSplineVolume* volume = _volume.get();
+        volume->getWeightOffsets(_weightOffsets);
+        data.firstIndices.resize(minSize);
+        data.weights.resize(minSize * numWeights);
+#pragma omp parallel
+        {
+            UniformBSpline basis[3] = { volume->getBasis(0), volume->getBasis(1), volume->getBasis(2) };
+#pragma omp for schedule(dynamic, 256)
+            for (int i = 0; i < minSize; ++i)
+            {
+                const osg::Vec3& param = list[i];
+                data.firstIndices[i] = volume->computeWeights(
+                    basis, param[0], param[1], param[2], &data.weights[i * numWeights]);
+            }
+        }
+    }
+
+    // Sparse product of cached weights and flat control points
+    const osg::Vec3* ctrlPoints = &(_volume->getControlPointArray()[0]);
+    const unsigned int* offsets = &_weightOffsets[0];
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < minSize; ++i)
+    {
+        const osg::Vec3* first = ctrlPoints + data.firstIndices[i];
+        const float* weights = &data.weights[i * numWeights];
+        float x = 0.0f, y = 0.0f, z = 0.0f;
+        for (int k = 0; k < numWeights; ++k)
+        {
+            const float* pt = first[offsets[k]].ptr(); float wt = weights[k];
+            x += pt[0] * wt; y += pt[1] * wt; z += pt[2] * wt;
+        }
+        (*va)[i] = osg::Vec3(x, y, z) * invMatrix;
+    }
+}
+
 /* FFDModeler */
 
 FFDModeler::FFDModeler()
@@ -68,12 +68,29 @@ namespace osgVerse
                       int uDeg = 1, int vDeg = 1, int wDeg = 1);
         int getNumCtrlPoints(int dim) const { return _basis[dim].getNumCtrlPoints(); }
         int getDegree(int dim) const { return _basis[dim].getDegree(); }
+        const UniformBSpline& getBasis(int dim) const { return _basis[dim]; }
 
         /** Set the control points at specific index */
-        void setControlPoint(const VolumeIndex& index, const osg::Vec3& cp) { _ctrlPoints[index] = cp; }
+        void setControlPoint(const VolumeIndex& index, const osg::Vec3& cp);
         osg::Vec3 getControlPoint(const VolumeIndex& index) const;
         const std::map<VolumeIndex, osg::Vec3>& getAllControlPoints() const { return _ctrlPoints; }
 
+        /** Control points in a flat array, indexed by getControlPointIndex() */
+        const std::vector<osg::Vec3>& getControlPointArray() const { return _ctrlPointArray; }
+        unsigned int getControlPointIndex(const VolumeIndex& index) const
+        { return (index.u * getNumCtrlPoints(1) + index.v) * getNumCtrlPoints(2) + index.w; }
+
+        /** Number of non-zero basis weights of each domain position: (uDeg+1)*(vDeg+1)*(wDeg+1) */
+        unsigned int getNumWeights() const;
+
+        /** Offsets of weighted control points relative to the first one, in getNumWeights() order */
+        void getWeightOffsets(std::vector<unsigned int>& offsets) const;
+
+        /** Compute basis weights at specific domain and return flat index of the first control point,
+            so that position = sum(weights[k] * array[first + offsets[k]]). Basis functions are given
+            as copies of getBasis(0/1/2) so that it can be called from multiple threads */
+        unsigned int computeWeights(UniformBSpline* basis, float u, float v, float w, float* weights) const;
+
         /** Get position at specific domain (0<=u<=1, etc.) */
         osg::Vec3 getPosition(float u, float v, float w);
         osg::Vec3 getDerivativeU(float u, float v, float w);
@@ -84,6 +101,7 @@ namespace osgVerse
         virtual ~BSplineVolume();
 
         std::map<VolumeIndex, osg::Vec3> _ctrlPoints;
+        std::vector<osg::Vec3> _ctrlPointArray;
         UniformBSpline _basis[3];
     };
 
@@ -92,9 +110,9 @@ namespace osgVerse
     {
     public:
         ApplyUserNodeVisitor(TraversalMode mode = TRAVERSE_ALL_CHILDREN)
-            : osg::NodeVisitor(mode), _mode(REQ_BOUND) { reset(true, true); }
+            : osg::NodeVisitor(mode), _mode(REQ_BOUND), _useCachedWeights(false) { reset(true, true); }
 
-        void setBSplineVolume(BSplineVolume* bv) { _volume = bv; }
+        void setBSplineVolume(BSplineVolume* bv) { _volume = bv; _weightMap.clear(); }
         BSplineVolume* getBSplineVolume() { return _volume.get(); }
         const BSplineVolume* getBSplineVolume() const { return _volume.get(); }
 
@@ -105,6 +123,12 @@ namespace osgVerse
         osg::BoundingBox& getBoundingBox() { return _bb; }
         const osg::BoundingBox& getBoundingBox() const { return _bb; }
 
+        /** Cache basis weights of each vertex at first REQ_SETV, then compute new vertices as a sparse
+            product of weights and flat control points in parallel. Much faster for interactive editing
+            of large meshes, but takes (uDeg+1)*(vDeg+1)*(wDeg+1) floats more memory per vertex */
+        void setUseCachedWeights(bool b) { _useCachedWeights = b; if (!b) _weightMap.clear(); }
+        bool getUseCachedWeights() const { return _useCachedWeights; }
+
         virtual void apply(osg::Transform& node);
         virtual void apply(osg::Geode& node);
 
@@ -116,6 +140,7 @@ namespace osgVerse
         void computeBoundBox(osg::Geometry* geometry);
         void computeNormalizedVertex(osg::Geometry* geometry);
         void computeNewVertex(osg::Geometry* geometry);
+        void computeNewVertexCached(osg::Geometry* geometry, const osg::Matrix& invMatrix);
 
         osg::observer_ptr<BSplineVolume> _volume;
 
@@ -126,8 +151,19 @@ namespace osgVerse
         typedef std::vector<osg::Vec3> VertexList;
         typedef std::map<osg::Geometry*, VertexList> VertexMap;
         VertexMap _normVertexMap;
+
+        struct WeightData
+        {
+            std::vector<unsigned int> firstIndices;  // per vertex
+            std::vector<float> weights;  // per vertex * numWeights
+        };
+        typedef std::map<osg::Geometry*, WeightData> WeightMap;
+        WeightMap _weightMap;
+        std::vector<unsigned int> _weightOffsets;
+
         osg::BoundingBox _bb;
         ApplyMode _mode;
+        bool _useCachedWeights;
     };
 
     /** The FFD modeler to control an input node */
@@ -161,6 +197,10 @@ namespace osgVerse
         /** FFD grid geometry to be outputted. Don't add it to other transform nodes */
         osg::Geometry* getFFDGridResult() { return _ffdGeom.get(); }
 
+        /** Use cached basis weights to deform the node, see ApplyUserNodeVisitor::setUseCachedWeights() */
+        void setUseCachedWeights(bool b) { _userNodeVisitor.setUseCachedWeights(b); }
+        bool getUseCachedWeights() const { return _userNodeVisitor.getUseCachedWeights(); }
+
     protected:
         virtual ~FFDModeler();
         void comupteFFDBox(const osg::BoundingBox& bb);
@@ -1,5 +1,6 @@
 #include <osg/Version>
 #include <algorithm>
+#include <climits>
 #include "Math.h"
 #include "Utilities.h"
 #include "GeometryMapper.h"
@@ -25,13 +26,16 @@ public:
         if (_matrixStack.size() > 0) matrix = _matrixStack.back();
 
         osg::Vec3Array* va = static_cast<osg::Vec3Array*>(geom.getVertexArray());
+        std::vector<osg::Vec3> points(va->size());
+        for (size_t i = 0; i < va->size(); ++i) points[i] = (*va)[i] * matrix;
+
+        std::vector<uint32_t> resultIndices;
         std::map<osg::StateSet*, unsigned int> stateSetCounts;
+        _query->findNearest(points, 1, resultIndices);
         for (size_t i = 0; i < va->size(); ++i)
         {
-            std::vector<uint32_t> resultIndices(1);
-            _query->findNearest((*va)[i] * matrix, resultIndices, 1);
-
-            unsigned int index = resultIndices[0];
+            unsigned int index = resultIndices[i];
+            if (index == UINT_MAX) continue;
             if (_verticesOfStateSets)
             {
                 for (std::map<osg::StateSet*, std::vector<size_t>>::iterator itr =
@@ -117,11 +121,13 @@ float GeometryMapper::computeSimilarity(osg::Node* source, osg::Node* target)
         query.addPoint(vertices0[i], new VertexIndex(i));
     query.buildIndex();
 
+    std::vector<uint32_t> resultIndices; std::vector<float> resultDistances2;
+    query.findNearest(vertices1, 1, resultIndices, &resultDistances2);
+
     std::vector<float> lengthList; float maxD = 0.0f, minD = FLT_MAX;
     for (size_t i = 0; i < vertices1.size(); ++i)
     {
-        std::vector<uint32_t> resultIndices(1);
-        float d = sqrt(query.findNearest(vertices1[i], resultIndices, 1));
+        float d = sqrt(resultDistances2[i]);
         if (maxD < d) maxD = d; if (minD > d) minD = d;
         lengthList.push_back(d);
     }
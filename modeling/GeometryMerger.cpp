@@ -3,82 +3,191 @@
 #include <osg/Texture2D>
 #include <osgDB/FileNameUtils>
 #include <osgDB/WriteFile>
+#include <numeric>
 #include "GeometryMerger.h"
 #include "Utilities.h"
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 using namespace osgVerse;
 
 struct ResetTrianglesOperator
 {
-    ResetTrianglesOperator() : _start(0) {}
-    osg::observer_ptr<osg::DrawElementsUInt> _de;
+    ResetTrianglesOperator() : _indices(NULL), _start(0) {}
+    std::vector<unsigned int>* _indices;
     unsigned int _start;
 
     void operator()(unsigned int i1, unsigned int i2, unsigned int i3)
     {
         if (i1 == i2 || i2 == i3 || i1 == i3) return;
-        _de->push_back(i1 + _start); _de->push_back(i2 + _start); _de->push_back(i3 + _start);
+        _indices->push_back(i1 + _start); _indices->push_back(i2 + _start);
+        _indices->push_back(i3 + _start);
     }
 };
 
+static void transformVertices(const osg::Vec3* src, osg::Vec3* dst, size_t num, const osg::Matrix& m)
+{
+    if (m(0, 3) != 0.0 || m(1, 3) != 0.0 || m(2, 3) != 0.0 || m(3, 3) != 1.0)
+    { for (size_t i = 0; i < num; ++i) dst[i] = src[i] * m; return; }
+
+    // Affine matrix: skip the projective division, but still use doubles to keep precision
+    // of large (e.g. geocentric) offsets
+    const double m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2);
+    const double m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2);
+    const double m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2);
+    const double m30 = m(3, 0), m31 = m(3, 1), m32 = m(3, 2);
+    const float* in = (const float*)src; float* out = (float*)dst; size_t i = 0;
+#if defined(__SSE2__)
+    // Blocks of two vertices: x/y of each vertex in one register, and z of both in another
+    const __m128d c0 = _mm_set_pd(m01, m00), c1 = _mm_set_pd(m11, m10);
+    const __m128d c2 = _mm_set_pd(m21, m20), c3 = _mm_set_pd(m31, m30);
+    const __m128d z0 = _mm_set1_pd(m02), z1 = _mm_set1_pd(m12);
+    const __m128d z2 = _mm_set1_pd(m22), z3 = _mm_set1_pd(m32);
+    for (; i + 6 <= num * 3; i += 6)
+    {
+        const float* v = in + i; float* r = out + i; double z[2];
+        __m128d xy0 = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(v[0]), c0),
+            _mm_mul_pd(_mm_set1_pd(v[1]), c1)), _mm_mul_pd(_mm_set1_pd(v[2]), c2)), c3);
+        __m128d xy1 = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(v[3]), c0),
+            _mm_mul_pd(_mm_set1_pd(v[4]), c1)), _mm_mul_pd(_mm_set1_pd(v[5]), c2)), c3);
+        __m128d zz = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set_pd(v[3], v[0]), z0),
+            _mm_mul_pd(_mm_set_pd(v[4], v[1]), z1)), _mm_mul_pd(_mm_set_pd(v[5], v[2]), z2)), z3);
+        _mm_storel_pi((__m64*)r, _mm_cvtpd_ps(xy0));
+        _mm_storel_pi((__m64*)(r + 3), _mm_cvtpd_ps(xy1));
+        _mm_storeu_pd(z, zz); r[2] = (float)z[0]; r[5] = (float)z[1];
+    }
+#endif
+    for (; i < num * 3; i += 3)
+    {
+        const double x = in[i], y = in[i + 1], z = in[i + 2];
+        out[i + 0] = (float)(x * m00 + y * m10 + z * m20 + m30);
+        out[i + 1] = (float)(x * m01 + y * m11 + z * m21 + m31);
+        out[i + 2] = (float)(x * m02 + y * m12 + z * m22 + m32);
+    }
+}
+
+static bool isSameImage(const osg::Image& img0, const osg::Image& img1)
+{
+    if (img0.s() != img1.s() || img0.t() != img1.t() || img0.r() != img1.r()) return false;
+    if (img0.getPixelFormat() != img1.getPixelFormat() ||
+        img0.getDataType() != img1.getDataType()) return false;
+    if (img0.getTotalSizeInBytes() != img1.getTotalSizeInBytes()) return false;
+    return memcmp(img0.data(), img1.data(), img0.getTotalSizeInBytes()) == 0;
+}
+
+static void collectUniqueImages(const std::vector<GeometryMerger::GeometryPair>& geomList,
+                                const std::vector<size_t>& indices, std::vector<osg::Image*>& images,
+                                std::vector<int>& imageOfGeometry)
+{
+    std::vector<osg::Image*> allImages(indices.size(), NULL);
+    for (size_t k = 0; k < indices.size(); ++k)
+    {
+        osg::StateSet* ss = geomList[indices[k]].first->getStateSet();
+        if (!ss) continue; else if (ss->getNumTextureAttributeLists() == 0) continue;
+
+        osg::Texture2D* tex = dynamic_cast<osg::Texture2D*>(
+            ss->getTextureAttribute(0, osg::StateAttribute::TEXTURE));
+        if (tex && tex->getImage()) allImages[k] = tex->getImage();
+    }
+
+    // Hash image data in parallel, so that identical images can share one atlas place
+    std::vector<unsigned long long> hashes(indices.size(), 0);
+    int numGeometries = (int)indices.size();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < numGeometries; ++k)
+    {
+        osg::Image* img = allImages[k];
+        if (img && img->data())
+            hashes[k] = XXH64(img->data(), img->getTotalSizeInBytes(), img->s() * 65536 + img->t());
+    }
+
+    std::map<osg::Image*, int> pointerMap;
+    std::multimap<unsigned long long, int> hashMap;
+    imageOfGeometry.assign(indices.size(), -1);
+    for (size_t k = 0; k < indices.size(); ++k)
+    {
+        osg::Image* img = allImages[k]; if (!img) continue;
+        std::map<osg::Image*, int>::iterator p = pointerMap.find(img);
+        if (p != pointerMap.end()) { imageOfGeometry[k] = p->second; continue; }
+
+        int index = -1;
+        if (img->data())
+        {
+            std::pair<std::multimap<unsigned long long, int>::iterator,
+                      std::multimap<unsigned long long, int>::iterator> range =
+                hashMap.equal_range(hashes[k]);
+            for (std::multimap<unsigned long long, int>::iterator itr = range.first;
+                 itr != range.second; ++itr)
+            { if (isSameImage(*images[itr->second], *img)) { index = itr->second; break; } }
+        }
+
+        if (index < 0)
+        {
+            index = (int)images.size(); images.push_back(img);
+            if (img->data()) hashMap.insert(std::pair<unsigned long long, int>(hashes[k], index));
+        }
+        pointerMap[img] = index; imageOfGeometry[k] = index;
+    }
+}
+
+static osg::Texture2D* createAtlasTexture(osg::Image* atlas)
+{
+    osg::ref_ptr<osg::Texture2D> tex2D = new osg::Texture2D;
+    tex2D->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR_MIPMAP_LINEAR);
+    tex2D->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
+    tex2D->setResizeNonPowerOfTwoHint(true); tex2D->setImage(atlas);
+    return tex2D.release();
+}
+
 GeometryMerger::GeometryMerger()
 {}
 
 GeometryMerger::~GeometryMerger()
 {}
 
-osg::Geometry* GeometryMerger::process(const std::vector<std::pair<osg::Geometry*, osg::Matrix>>& geomList,
+osg::Geometry* GeometryMerger::process(const std::vector<GeometryPair>& geomList,
                                        size_t offset, size_t size, int maxTextureSize)
 {
     if (size == 0) size = geomList.size() - offset;
     if (geomList.empty()) return NULL;
 
-    // Collect textures and make atlas
-    osg::ref_ptr<TexturePacker> packer = new TexturePacker(4096, 4096);
-    std::vector<osg::ref_ptr<osg::Image>> images;
-    std::vector<size_t> gIndices;
-
-    std::map<size_t, size_t> geometryIdMap;
-    std::string imageName; size_t numImages = 0;
+    std::vector<size_t> indices;
     size_t end = osg::minimum(offset + size, geomList.size());
-    for (size_t i = offset; i < end; ++i)
-    {
-        osg::StateSet* ss = geomList[i].first->getStateSet();
-        if (!ss) continue; else if (ss->getNumTextureAttributeLists() == 0) continue;
+    for (size_t i = offset; i < end; ++i) indices.push_back(i);
 
-        osg::Texture2D* tex = dynamic_cast<osg::Texture2D*>(
-            ss->getTextureAttribute(0, osg::StateAttribute::TEXTURE));
-        if (tex && tex->getImage()) { images.push_back(tex->getImage()); gIndices.push_back(i); }
-    }
+    // Collect textures and make atlas
+    std::vector<osg::Image*> images; std::vector<int> imageOfGeometry;
+    collectUniqueImages(geomList, indices, images, imageOfGeometry);
 
-    std::string ext = images.empty() ? "" : osgDB::getFileExtension(images[0]->getFileName());
+    osg::ref_ptr<TexturePacker> packer = new TexturePacker(4096, 4096);
+    std::vector<size_t> packingIds(images.size());
+    std::string imageName; size_t numImages = 0;
     for (size_t i = 0; i < images.size(); ++i)
     {
-        size_t id = gIndices[i]; geometryIdMap[id] = packer->addElement(images[i].get());
+        packingIds[i] = packer->addElement(images[i]);
         imageName += osgDB::getStrippedName(images[i]->getFileName()) + ",";
     }
 
     // Recompute texture coords
-    osg::ref_ptr<osg::Image> atlas = packer->pack(numImages, true);
-    if (!atlas) { packer->setMaxSize(8192, 8192); atlas = packer->pack(numImages, true); }
+    osg::ref_ptr<osg::Image> atlas;
+    std::vector<osg::Vec4> uvTransforms(indices.size(), osg::Vec4(0.0f, 0.0f, 1.0f, 1.0f));
+    if (!images.empty())
+    {
+        atlas = packer->pack(numImages, true);
+        if (!atlas) { packer->setMaxSize(8192, 8192); atlas = packer->pack(numImages, true); }
+    }
+
     if (atlas.valid())
     {
         float totalW = atlas->s(), totalH = atlas->t();
-        for (size_t i = offset; i < end; ++i)
+        for (size_t k = 0; k < indices.size(); ++k)
         {
-            osg::Geometry* geom = geomList[i].first;
-            osg::Vec2Array* ta = static_cast<osg::Vec2Array*>(geom->getTexCoordArray(0));
-            if (!ta || geometryIdMap.find(i) == geometryIdMap.end()) continue;
-
-            int x = 0, y = 0, w = 0, h = 0;
-            if (!packer->getPackingData(geometryIdMap[i], x, y, w, h)) continue;
-
-            float tx0 = (float)x / totalW, tw = (float)w / totalW;
-            float ty0 = (float)y / totalH, th = (float)h / totalH;
-            for (size_t j = 0; j < ta->size(); ++j)
-            {
-                const osg::Vec2& t = (*ta)[j];
-                (*ta)[j] = osg::Vec2(t[0] * tw + tx0, t[1] * th + ty0);
-            }
+            int x = 0, y = 0, w = 0, h = 0, imageIndex = imageOfGeometry[k];
+            if (imageIndex < 0 || !packer->getPackingData(packingIds[imageIndex], x, y, w, h)) continue;
+            uvTransforms[k] = osg::Vec4((float)x / totalW, (float)y / totalH,
+                                        (float)w / totalW, (float)h / totalH);
         }
 
         int totalW1 = osg::Image::computeNearestPowerOfTwo(totalW);
@@ -89,60 +198,199 @@ osg::Geometry* GeometryMerger::process(const std::vector<std::pair<osg::Geometry
         if (totalH1 > maxTextureSize) totalH1 = maxTextureSize;
         if (totalW1 != totalW || totalH1 != totalH) atlas->scaleImage(totalW1, totalH1, 1);
 
-        ext = ".jpg";  // packed image should always be saved to JPG at current time...
+        std::string ext = ".jpg";  // packed image should always be saved to JPG at current time...
         atlas->setFileName(imageName + "_all." + ext);
     }
 
     // Concatenate arrays and primitive-sets
-    osg::ref_ptr<osg::Vec3Array> vaAll = new osg::Vec3Array;
-    osg::ref_ptr<osg::Vec3Array> naAll = new osg::Vec3Array;
-    osg::ref_ptr<osg::Vec2Array> taAll = new osg::Vec2Array;
-    osg::ref_ptr<osg::DrawElementsUInt> de = new osg::DrawElementsUInt(GL_TRIANGLES);
+    osg::ref_ptr<osg::Geometry> resultGeom = mergeGeometries(geomList, indices, uvTransforms);
+    if (resultGeom.valid() && atlas.valid())
+        resultGeom->getOrCreateStateSet()->setTextureAttributeAndModes(0, createAtlasTexture(atlas.get()));
+    return resultGeom.release();
+}
+
+std::vector<osg::ref_ptr<osg::Geometry>> GeometryMerger::processAsPages(
+        const std::vector<GeometryPair>& geomList, size_t offset, size_t size, int maxPageSize)
+{
+    std::vector<osg::ref_ptr<osg::Geometry>> results;
+    if (geomList.empty() || offset >= geomList.size()) return results;
+    if (size == 0) size = geomList.size() - offset;
+
+    std::vector<size_t> indices;
+    size_t end = osg::minimum(offset + size, geomList.size());
+    for (size_t i = offset; i < end; ++i) indices.push_back(i);
+
+    std::vector<osg::Image*> images; std::vector<int> imageOfGeometry;
+    collectUniqueImages(geomList, indices, images, imageOfGeometry);
+
+    // Split images into pages: each page packs as many of the remaining images as possible
+    struct AtlasPage
+    {
+        osg::ref_ptr<TexturePacker> packer;
+        osg::ref_ptr<osg::Image> atlas;
+        std::vector<int> images;
+    };
+    std::vector<AtlasPage> pages;
+    std::vector<size_t> packingIds(images.size()), pageOfImage(images.size());
+    std::vector<int> remaining(images.size());
+    std::iota(remaining.begin(), remaining.end(), 0);
+    while (!remaining.empty())
+    {
+        AtlasPage page; size_t numPacked = 0;
+        page.packer = new TexturePacker(maxPageSize, maxPageSize);
+        for (size_t r = 0; r < remaining.size(); ++r)
+            packingIds[remaining[r]] = page.packer->addElement(images[remaining[r]]);
+        page.packer->pack(numPacked, false);
+
+        std::vector<int> unpacked; int x = 0, y = 0, w = 0, h = 0;
+        for (size_t r = 0; r < remaining.size(); ++r)
+        {
+            int imageIndex = remaining[r];
+            if (page.packer->getPackingData(packingIds[imageIndex], x, y, w, h))
+            { page.images.push_back(imageIndex); pageOfImage[imageIndex] = pages.size(); }
+            else unpacked.push_back(imageIndex);
+        }
 
+        if (page.images.empty())
+        {
+            // The image is larger than page size, so make it a page of its own
+            int imageIndex = remaining[0]; osg::Image* img = images[imageIndex];
+            page.packer->clear();
+            page.packer->setMaxSize(osg::maximum(img->s(), 1), osg::maximum(img->t(), 1));
+            packingIds[imageIndex] = page.packer->addElement(img);
+            page.packer->pack(numPacked, false);
+            page.images.push_back(imageIndex); pageOfImage[imageIndex] = pages.size();
+            unpacked.erase(unpacked.begin());
+        }
+        pages.push_back(page); remaining.swap(unpacked);
+    }
+
+    // Build page images in native resolution
+    int numPages = (int)pages.size();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int p = 0; p < numPages; ++p) pages[p].atlas = pages[p].packer->createResult();
+
+    // Merge geometries of each page, and untextured ones as the last
+    std::vector<std::vector<size_t>> pageIndices(pages.size() + 1);
+    std::vector<std::vector<osg::Vec4>> pageTransforms(pages.size() + 1);
+    for (size_t k = 0; k < indices.size(); ++k)
+    {
+        int imageIndex = imageOfGeometry[k], x = 0, y = 0, w = 0, h = 0;
+        size_t p = (imageIndex < 0) ? pages.size() : pageOfImage[imageIndex];
+        osg::Vec4 uvTransform(0.0f, 0.0f, 1.0f, 1.0f);
+        if (p < pages.size() && pages[p].atlas.valid() &&
+            pages[p].packer->getPackingData(packingIds[imageIndex], x, y, w, h))
+        {
+            float totalW = pages[p].atlas->s(), totalH = pages[p].atlas->t();
+            uvTransform.set((float)x / totalW, (float)y / totalH, (float)w / totalW, (float)h / totalH);
+        }
+        pageIndices[p].push_back(indices[k]);
+        pageTransforms[p].push_back(uvTransform);
+    }
+
+    for (size_t p = 0; p < pageIndices.size(); ++p)
+    {
+        if (pageIndices[p].empty()) continue;
+        osg::ref_ptr<osg::Geometry> resultGeom =
+            mergeGeometries(geomList, pageIndices[p], pageTransforms[p]);
+        if (!resultGeom) continue;
+
+        if (p < pages.size() && pages[p].atlas.valid())
+        {
+            std::string imageName;
+            for (size_t i = 0; i < pages[p].images.size(); ++i)
+                imageName += osgDB::getStrippedName(images[pages[p].images[i]]->getFileName()) + ",";
+            pages[p].atlas->setFileName(imageName + "_page" + std::to_string(p) + ".jpg");
+            resultGeom->getOrCreateStateSet()->setTextureAttributeAndModes(
+                0, createAtlasTexture(pages[p].atlas.get()));
+        }
+        results.push_back(resultGeom);
+    }
+    return results;
+}
+
+osg::Geometry* GeometryMerger::mergeGeometries(const std::vector<GeometryPair>& geomList,
+                                               const std::vector<size_t>& indices,
+                                               const std::vector<osg::Vec4>& uvTransforms)
+{
+    // Find valid geometries and their vertex offsets in the merged one
     osg::ref_ptr<osg::Geometry> resultGeom = new osg::Geometry;
-    for (size_t i = offset; i < end; ++i)
+    std::vector<size_t> validList, offsets(1, 0);
+    bool withNormals = true, withTexCoords = true;
+    for (size_t k = 0; k < indices.size(); ++k)
     {
-        osg::Geometry* geom = geomList[i].first;
-        osg::Vec3Array* va = static_cast<osg::Vec3Array*>(geom->getVertexArray());
-        osg::Vec3Array* na = static_cast<osg::Vec3Array*>(geom->getNormalArray());
-        osg::Vec2Array* ta = static_cast<osg::Vec2Array*>(geom->getTexCoordArray(0));
-        if (!va || geom->getNumPrimitiveSets() == 0) continue;
+        osg::Geometry* geom = geomList[indices[k]].first;
+        osg::Vec3Array* va = dynamic_cast<osg::Vec3Array*>(geom->getVertexArray());
+        osg::Vec3Array* na = dynamic_cast<osg::Vec3Array*>(geom->getNormalArray());
+        osg::Vec2Array* ta = dynamic_cast<osg::Vec2Array*>(geom->getTexCoordArray(0));
+        if (!va || va->empty() || geom->getNumPrimitiveSets() == 0) continue;
 
         if (!resultGeom->getStateSet() && geom->getStateSet() != NULL)
         {
             resultGeom->setStateSet(static_cast<osg::StateSet*>(
                 geom->getStateSet()->clone(osg::CopyOp::DEEP_COPY_ALL)));
         }
+        if (!na || na->size() != va->size()) withNormals = false;
+        if (!ta || ta->size() != va->size()) withTexCoords = false;
+        validList.push_back(k); offsets.push_back(offsets.back() + va->size());
+    }
+    if (validList.empty()) return NULL;
+
+    // Transform and copy vertex data of each geometry to its own range
+    size_t numVertices = offsets.back();
+    osg::ref_ptr<osg::Vec3Array> vaAll = new osg::Vec3Array(numVertices);
+    osg::ref_ptr<osg::Vec3Array> naAll = withNormals ? new osg::Vec3Array(numVertices) : NULL;
+    osg::ref_ptr<osg::Vec2Array> taAll = withTexCoords ? new osg::Vec2Array(numVertices) : NULL;
+    std::vector<std::vector<unsigned int>> triangles(validList.size());
+
+    int numValid = (int)validList.size();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int n = 0; n < numValid; ++n)
+    {
+        size_t k = validList[n], start = offsets[n];
+        const GeometryPair& pair = geomList[indices[k]];
+        osg::Geometry* geom = pair.first;
+
+        osg::Vec3Array* va = static_cast<osg::Vec3Array*>(geom->getVertexArray());
+        transformVertices(&(*va)[0], &(*vaAll)[start], va->size(), pair.second);
+        if (naAll.valid())
+        {
+            osg::Vec3Array* na = static_cast<osg::Vec3Array*>(geom->getNormalArray());
+            std::copy(na->begin(), na->end(), naAll->begin() + start);
+        }
+
+        if (taAll.valid())
+        {
+            osg::Vec2Array* ta = static_cast<osg::Vec2Array*>(geom->getTexCoordArray(0));
+            osg::Vec4 uvT = uvTransforms.empty() ? osg::Vec4(0.0f, 0.0f, 1.0f, 1.0f) : uvTransforms[k];
+            for (size_t j = 0; j < ta->size(); ++j)
+            {
+                const osg::Vec2& t = (*ta)[j];
+                (*taAll)[start + j] = osg::Vec2(t[0] * uvT[2] + uvT[0], t[1] * uvT[3] + uvT[1]);
+            }
+        }
 
         osg::TriangleIndexFunctor<ResetTrianglesOperator> functor;
-        functor._de = de.get(); functor._start = vaAll->size();
+        functor._indices = &triangles[n]; functor._start = start;
         geom->accept(functor);
-
-        osg::Matrix matrix = geomList[i].second;
-        for (size_t v = 0; v < va->size(); ++v) vaAll->push_back((*va)[v] * matrix);
-        if (na) naAll->insert(naAll->end(), na->begin(), na->end());
-        if (ta) taAll->insert(taAll->end(), ta->begin(), ta->end());
     }
 
+    osg::ref_ptr<osg::DrawElementsUInt> de = new osg::DrawElementsUInt(GL_TRIANGLES);
+    size_t numIndices = 0;
+    for (size_t n = 0; n < triangles.size(); ++n) numIndices += triangles[n].size();
+    de->reserve(numIndices);
+    for (size_t n = 0; n < triangles.size(); ++n)
+        de->insert(de->end(), triangles[n].begin(), triangles[n].end());
+
     resultGeom->setUseDisplayList(false);
     resultGeom->setUseVertexBufferObjects(true);
     resultGeom->setVertexArray(vaAll.get());
-    if (naAll->size() == vaAll->size())
+    if (naAll.valid())
     {
         resultGeom->setNormalArray(naAll.get());
         resultGeom->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
     }
-    if (taAll->size() == vaAll->size())
-        resultGeom->setTexCoordArray(0, taAll.get());
+    if (taAll.valid()) resultGeom->setTexCoordArray(0, taAll.get());
     resultGeom->addPrimitiveSet(de.get());
-
-    if (atlas.valid())
-    {
-        osg::ref_ptr<osg::Texture2D> tex2D = new osg::Texture2D;
-        tex2D->setFilter(osg::Texture2D::MIN_FILTER, osg::Texture2D::LINEAR_MIPMAP_LINEAR);
-        tex2D->setFilter(osg::Texture2D::MAG_FILTER, osg::Texture2D::LINEAR);
-        tex2D->setResizeNonPowerOfTwoHint(true); tex2D->setImage(atlas.get());
-        resultGeom->getOrCreateStateSet()->setTextureAttributeAndModes(0, tex2D.get());
-    }
     return resultGeom.release();
 }
@@ -15,10 +15,23 @@ namespace osgVerse
         GeometryMerger();
         ~GeometryMerger();
 
-        osg::Geometry* process(const std::vector<std::pair<osg::Geometry*, osg::Matrix>>& geomList, size_t offset,
+        typedef std::pair<osg::Geometry*, osg::Matrix> GeometryPair;
+
+        /** Merge geometries into one, with a single atlas scaled down to maxTextureSize if needed */
+        osg::Geometry* process(const std::vector<GeometryPair>& geomList, size_t offset,
                                size_t size = 0, int maxTextureSize = 4096);
 
+        /** Merge geometries into one geometry per atlas page. Images keep their native resolution
+            and are split into as many pages (not larger than maxPageSize) as needed. Geometries
+            without textures are merged into an extra geometry without atlas */
+        std::vector<osg::ref_ptr<osg::Geometry>> processAsPages(
+                const std::vector<GeometryPair>& geomList, size_t offset,
+                size_t size = 0, int maxPageSize = 4096);
+
     protected:
+        osg::Geometry* mergeGeometries(const std::vector<GeometryPair>& geomList,
+                                       const std::vector<size_t>& indices,
+                                       const std::vector<osg::Vec4>& uvTransforms);
     };
 }
 
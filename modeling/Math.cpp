@@ -451,6 +451,182 @@ osg::Matrix Coordinate::convertLLAtoNED(const osg::Vec3d& lla, const WGS84& wgs8
     m.setTrans(convertLLAtoECEF(lla, wgs84)); return m;
 }
 
+/* Batch conversions: each block of points is handled by one thread, and every kernel is a
+   straight loop over strided component arrays so that both AoS and SoA inputs can share it */
+#define COORDINATE_BLOCK_SIZE 4096
+#define COORDINATE_PARALLEL_MIN 65536
+
+typedef void (*CoordinateKernel)(double* c0, double* c1, double* c2, size_t stride, size_t count,
+                                 const Coordinate::UTM* utm, const Coordinate::WGS84& wgs84);
+
+static void runCoordinateKernel(CoordinateKernel kernel, double* c0, double* c1, double* c2,
+                                size_t stride, size_t count, const Coordinate::UTM* utm,
+                                const Coordinate::WGS84& wgs84)
+{
+    int numBlocks = (int)((count + COORDINATE_BLOCK_SIZE - 1) / COORDINATE_BLOCK_SIZE);
+#pragma omp parallel for schedule(dynamic, 1) if (count > COORDINATE_PARALLEL_MIN)
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        size_t start = (size_t)b * COORDINATE_BLOCK_SIZE, offset = start * stride;
+        size_t num = osg::minimum((size_t)COORDINATE_BLOCK_SIZE, count - start);
+        kernel(c0 + offset, c1 + offset, c2 + offset, stride, num, utm, wgs84);
+    }
+}
+
+static void kernelLLAtoECEF(double* c0, double* c1, double* c2, size_t stride, size_t count,
+                            const Coordinate::UTM*, const Coordinate::WGS84& wgs84)
+{
+    const double radiusE = wgs84.radiusEquator, e2 = wgs84.eccentricitySq, e2Inv = 1.0 - e2;
+    for (size_t i = 0, j = 0; i < count; ++i, j += stride)
+    {
+        const double latitude = c0[j], longitude = c1[j], height = c2[j];
+        const double sin_latitude = sin(latitude), cos_latitude = cos(latitude);
+        const double N = radiusE / sqrt(1.0 - e2 * sin_latitude * sin_latitude);
+        c0[j] = (N + height) * cos_latitude * cos(longitude);
+        c1[j] = (N + height) * cos_latitude * sin(longitude);
+        c2[j] = (N * e2Inv + height) * sin_latitude;
+    }
+}
+
+static void kernelECEFtoLLA(double* c0, double* c1, double* c2, size_t stride, size_t count,
+                            const Coordinate::UTM*, const Coordinate::WGS84& wgs84)
+{
+    // Same Bowring method as the scalar version, but sin/cos of theta and latitude are
+    // derived algebraically from their tangents, saving four trigonometric calls per point
+    const double re = wgs84.radiusEquator, rp = wgs84.radiusPolar, e2 = wgs84.eccentricitySq;
+    const double eDashSquared = (re * re - rp * rp) / (rp * rp);
+    for (size_t i = 0, j = 0; i < count; ++i, j += stride)
+    {
+        const double x = c0[j], y = c1[j], z = c2[j];
+        if (x == 0.0)
+        {   // on the polar axis or on the prime meridian plane: use the scalar special cases
+            osg::Vec3d lla = Coordinate::convertECEFtoLLA(osg::Vec3d(x, y, z), wgs84);
+            c0[j] = lla[0]; c1[j] = lla[1]; c2[j] = lla[2]; continue;
+        }
+
+        const double p = sqrt(x * x + y * y), tx = p * rp, ty = z * re;
+        const double rt = sqrt(tx * tx + ty * ty), sin_theta = ty / rt, cos_theta = tx / rt;
+        const double t = (z + eDashSquared * rp * sin_theta * sin_theta * sin_theta) /
+                         (p - e2 * re * cos_theta * cos_theta * cos_theta);
+        const double cos_latitude = 1.0 / sqrt(1.0 + t * t), sin_latitude = t * cos_latitude;
+        const double N = re / sqrt(1.0 - e2 * sin_latitude * sin_latitude);
+        c0[j] = atan(t); c1[j] = atan2(y, x); c2[j] = p / cos_latitude - N;
+    }
+}
+
+// Clenshaw summations of UTM::clenshaw() / clenshaw2() for the fixed 6 coefficients, taking
+// trigonometric values of the arguments once instead of recomputing them for every term
+static inline double clenshawUTM(const double* a, double sinR, double cosR)
+{
+    double hr = 0.0, hr1 = a[5], hr2 = 0.0;
+    for (int k = 4; k >= 0; --k)
+    { hr = -hr2 + (2. * hr1 * cosR) + a[k]; hr2 = hr1; hr1 = hr; }
+    return sinR * hr;
+}
+
+static inline void clenshaw2UTM(const double* a, double sinR, double cosR, double sinhI, double coshI,
+                                double& R, double& I)
+{
+    const double cc = cosR * coshI, ss = sinR * sinhI;
+    double hr = 0.0, hr1 = a[5], hr2 = 0.0, hi = 0.0, hi1 = 0.0, hi2 = 0.0;
+    for (int k = 4; k >= 0; --k)
+    {
+        hr = -hr2 + (2. * hr1 * cc) - (-2. * hi1 * ss) + a[k];
+        hi = -hi2 + (-2. * hr1 * ss) + (2. * hi1 * cc);
+        hr2 = hr1; hi2 = hi1; hr1 = hr; hi1 = hi;
+    }
+    R = (sinR * coshI * hr) - (cosR * sinhI * hi);
+    I = (sinR * coshI * hi) + (cosR * sinhI * hr);
+}
+
+static void kernelLLAtoUTM(double* c0, double* c1, double* c2, size_t stride, size_t count,
+                           const Coordinate::UTM* utm, const Coordinate::WGS84& wgs84)
+{
+    const double lon0 = utm->lon0, scale = utm->Qn * wgs84.radiusEquator;
+    const double northing = utm->Zb * wgs84.radiusEquator + (utm->isNorth ? 0. : 10000000.);
+    double cbg[6], gtu[6];
+    for (int k = 0; k < 6; ++k) { cbg[k] = utm->cbg[k]; gtu[k] = utm->gtu[k]; }
+
+    for (size_t i = 0, j = 0; i < count; ++i, j += stride)
+    {
+        const double lat = c1[j], lam = c0[j] - lon0;
+        const double gauss = clenshawUTM(cbg, sin(2. * lat), cos(2. * lat)) + lat;
+        const double sinG = sin(gauss), cosG = cos(gauss), sinL = sin(lam), cosL = cos(lam);
+        double Cn = atan2(sinG, cosL * cosG);
+        double Ce = asinh(tan(atan2(sinL * cosG, std::hypot(sinG, cosG * cosL))));
+
+        double dCn = 0.0, dCe = 0.0;
+        clenshaw2UTM(gtu, sin(2. * Cn), cos(2. * Cn), sinh(2. * Ce), cosh(2. * Ce), dCn, dCe);
+        Cn += dCn; Ce += dCe;
+        if (std::fabs(Ce) <= 2.623395162778)
+        { c0[j] = scale * Ce + 500000.0; c1[j] = scale * Cn + northing; }
+        else
+        { c0[j] = 0.0; c1[j] = 0.0; c2[j] = 0.0; }
+    }
+}
+
+static void kernelUTMtoLLA(double* c0, double* c1, double* c2, size_t stride, size_t count,
+                           const Coordinate::UTM* utm, const Coordinate::WGS84& wgs84)
+{
+    const double lon0 = utm->lon0, Zb = utm->Zb, invScale = 1.0 / (utm->Qn * wgs84.radiusEquator);
+    const double northing = utm->isNorth ? 0. : 10000000.0, invQn = 1.0 / utm->Qn;
+    double cgb[6], utg[6];
+    for (int k = 0; k < 6; ++k) { cgb[k] = utm->cgb[k]; utg[k] = utm->utg[k]; }
+
+    for (size_t i = 0, j = 0; i < count; ++i, j += stride)
+    {
+        double Cn = ((c1[j] - northing) / wgs84.radiusEquator - Zb) * invQn;
+        double Ce = (c0[j] - 500000.0) * invScale;
+        if (std::fabs(Ce) > 2.623395162778)
+        { c0[j] = 0.0; c1[j] = 0.0; c2[j] = 0.0; continue; }
+
+        double dCn = 0.0, dCe = 0.0;
+        clenshaw2UTM(utg, sin(2. * Cn), cos(2. * Cn), sinh(2. * Ce), cosh(2. * Ce), dCn, dCe);
+        Cn += dCn; Ce = atan(sinh(Ce + dCe));
+
+        const double sinCe = sin(Ce), cosCe = cos(Ce), sinCn = sin(Cn), cosCn = cos(Cn);
+        const double lon = atan2(sinCe, cosCe * cosCn) + lon0;
+        const double lat = atan2(sinCn * cosCe, std::hypot(sinCe, cosCe * cosCn));
+        c0[j] = lon; c1[j] = clenshawUTM(cgb, sin(2. * lat), cos(2. * lat)) + lat;
+    }
+}
+
+void Coordinate::convertLLAtoECEF(osg::Vec3d* values, size_t count, const WGS84& wgs84)
+{
+    if (!values || !count) return; double* ptr = values->ptr();
+    runCoordinateKernel(kernelLLAtoECEF, ptr, ptr + 1, ptr + 2, 3, count, NULL, wgs84);
+}
+
+void Coordinate::convertECEFtoLLA(osg::Vec3d* values, size_t count, const WGS84& wgs84)
+{
+    if (!values || !count) return; double* ptr = values->ptr();
+    runCoordinateKernel(kernelECEFtoLLA, ptr, ptr + 1, ptr + 2, 3, count, NULL, wgs84);
+}
+
+void Coordinate::convertLLAtoUTM(osg::Vec3d* values, size_t count, const UTM& utm, const WGS84& wgs84)
+{
+    if (!values || !count) return; double* ptr = values->ptr();
+    runCoordinateKernel(kernelLLAtoUTM, ptr, ptr + 1, ptr + 2, 3, count, &utm, wgs84);
+}
+
+void Coordinate::convertUTMtoLLA(osg::Vec3d* values, size_t count, const UTM& utm, const WGS84& wgs84)
+{
+    if (!values || !count) return; double* ptr = values->ptr();
+    runCoordinateKernel(kernelUTMtoLLA, ptr, ptr + 1, ptr + 2, 3, count, &utm, wgs84);
+}
+
+void Coordinate::convertLLAtoECEF(double* x, double* y, double* z, size_t count, const WGS84& wgs84)
+{
+    if (!x || !y || !z || !count) return;
+    runCoordinateKernel(kernelLLAtoECEF, x, y, z, 1, count, NULL, wgs84);
+}
+
+void Coordinate::convertECEFtoLLA(double* x, double* y, double* z, size_t count, const WGS84& wgs84)
+{
+    if (!x || !y || !z || !count) return;
+    runCoordinateKernel(kernelECEFtoLLA, x, y, z, 1, count, NULL, wgs84);
+}
+
 /* MathExpression */
 
 MathExpression::MathExpression(const std::string& exp)
@@ -502,30 +678,120 @@ double MathExpression::evaluate(bool* ok)
 struct PointCloudData
 {
     std::vector<PointCloudQuery::PointData> points;
+    std::vector<float> coords[3];  // SoA copy of point coordinates used by the KD-trees
     inline size_t kdtree_get_point_count() const { return points.size(); }
 
     // Returns the distance between the vector "p1[0:size-1]" and
     // the data point with index "idx_p2" stored in the class
     inline float kdtree_distance(const float* p1, const size_t idx_p2, size_t size) const
     {
-        const osg::Vec3& p = points[idx_p2].first;
-        const float d0 = p1[0] - p[0], d1 = p1[1] - p[1], d2 = p1[2] - p[2];
+        const float d0 = p1[0] - coords[0][idx_p2], d1 = p1[1] - coords[1][idx_p2],
+                    d2 = p1[2] - coords[2][idx_p2];
         return d0 * d0 + d1 * d1 + d2 * d2;
     }
 
     // Returns the dim'th component of the idx'th point in the class
-    inline float kdtree_get_pt(const size_t idx, int dim) const
-    {
-        if (dim == 0) return points[idx].first.x();
-        else if (dim == 1) return points[idx].first.y();
-        else return points[idx].first.z();
-    }
+    inline float kdtree_get_pt(const size_t idx, int dim) const { return coords[dim][idx]; }
 
     // Optional bounding-box computation: return false to default to a standard bbox computation loop
     template <class BBOX> bool kdtree_get_bbox(BBOX& bb) const { return false; }
+
+    void push(const osg::Vec3& pt)
+    { coords[0].push_back(pt[0]); coords[1].push_back(pt[1]); coords[2].push_back(pt[2]); }
 };
+
+/* Points appended after buildIndex(), indexed from 0 as the dynamic KD-tree requires */
+struct PointCloudTailData
+{
+    const PointCloudData* data; size_t offset, count;
+    PointCloudTailData(const PointCloudData* d) : data(d), offset(0), count(0) {}
+
+    inline size_t kdtree_get_point_count() const { return count; }
+    inline float kdtree_get_pt(const size_t idx, int dim) const
+    { return data->coords[dim][offset + idx]; }
+    template <class BBOX> bool kdtree_get_bbox(BBOX& bb) const { return false; }
+};
+
 typedef nanoflann::L2_Simple_Adaptor<float, PointCloudData> AdaptorType;
 typedef nanoflann::KDTreeSingleIndexAdaptor<AdaptorType, PointCloudData, 3> KdTreeType;
+typedef nanoflann::L2_Simple_Adaptor<float, PointCloudTailData> TailAdaptorType;
+typedef nanoflann::KDTreeSingleIndexDynamicAdaptor<TailAdaptorType, PointCloudTailData, 3> DynamicKdTreeType;
+
+struct PointCloudIndex
+{
+    PointCloudIndex(const PointCloudData* d, int leafSize)
+        : mainTree(NULL), tailTree(NULL), tail(d), maxLeafSize(leafSize) {}
+    ~PointCloudIndex() { delete mainTree; delete tailTree; }
+
+    KdTreeType* mainTree;
+    DynamicKdTreeType* tailTree;
+    PointCloudTailData tail;
+    int maxLeafSize;
+};
+
+/* Collect k-nearest results from main and tail trees, with tail indices mapped to global ones */
+struct PointCloudKnnResultSet
+{
+    typedef float DistanceType; typedef uint32_t IndexType;
+    PointCloudKnnResultSet(unsigned int k, uint32_t* indices, float* distances2)
+        : _indices(indices), _dists(distances2), _capacity(k), _count(0), _offset(0) {}
+
+    void setOffset(size_t offset) { _offset = offset; }
+    size_t size() const { return _count; }
+    bool full() const { return _count == _capacity; }
+    float worstDist() const { return full() ? _dists[_capacity - 1] : FLT_MAX; }
+
+    bool addPoint(float dist, uint32_t index)
+    {
+        size_t i = _count;
+        for (; i > 0 && _dists[i - 1] > dist; --i)
+        {
+            if (i < _capacity) { _dists[i] = _dists[i - 1]; _indices[i] = _indices[i - 1]; }
+        }
+        if (i < _capacity) { _dists[i] = dist; _indices[i] = index + (uint32_t)_offset; }
+        if (_count < _capacity) _count++;
+        return true;
+    }
+
+protected:
+    uint32_t* _indices; float* _dists;
+    size_t _capacity, _count, _offset;
+};
+
+/* Same as nanoflann::RadiusResultSet, but mapping tail indices to global ones */
+struct PointCloudRadiusResultSet
+{
+    typedef float DistanceType; typedef uint32_t IndexType;
+    PointCloudRadiusResultSet(float radius, std::vector<PointCloudQuery::IndexAndDistancePair>& r)
+        : _results(r), _radius(radius), _offset(0) {}
+
+    void setOffset(size_t offset) { _offset = offset; }
+    size_t size() const { return _results.size(); }
+    bool full() const { return true; }
+    float worstDist() const { return _radius; }
+
+    bool addPoint(float dist, uint32_t index)
+    {
+        if (dist < _radius) _results.push_back(
+            PointCloudQuery::IndexAndDistancePair(index + (uint32_t)_offset, dist));
+        return true;
+    }
+
+protected:
+    std::vector<PointCloudQuery::IndexAndDistancePair>& _results;
+    float _radius; size_t _offset;
+};
+
+template<typename RESULTSET>
+static void findPointCloudNeighbors(const PointCloudIndex* index, RESULTSET& result, const osg::Vec3& pt,
+                                    const nanoflann::SearchParams& params)
+{
+    float queryPt[3] = { pt[0], pt[1], pt[2] };
+    if (index->mainTree)
+    { result.setOffset(0); index->mainTree->findNeighbors(result, queryPt, params); }
+    if (index->tailTree && index->tail.count > 0)
+    { result.setOffset(index->tail.offset); index->tailTree->findNeighbors(result, queryPt, params); }
+}
 
 PointCloudQuery::PointCloudQuery()
 { _queryData = new PointCloudData; _index = NULL; }
@@ -533,20 +799,43 @@ PointCloudQuery::PointCloudQuery()
 PointCloudQuery::~PointCloudQuery()
 {
     PointCloudData* pcd = (PointCloudData*)_queryData;
-    pcd->points.clear(); delete _queryData; _queryData = NULL;
-    delete _index; _index = NULL;
+    delete pcd; _queryData = NULL;
+    delete (PointCloudIndex*)_index; _index = NULL;
 }
 
 void PointCloudQuery::addPoint(const osg::Vec3& pt, osg::Referenced* userData)
 {
     PointCloudData* pcd = (PointCloudData*)_queryData;
-    pcd->points.push_back(PointData(pt, userData));
+    pcd->points.push_back(PointData(pt, userData)); pcd->push(pt);
+
+    PointCloudIndex* index = (PointCloudIndex*)_index;
+    if (index == NULL) return;
+    if (index->tail.count + 1 > index->tail.offset)
+    {
+        // Merge into the main tree when tail grows as large as it, so that the
+        // amortized cost of appending keeps logarithmic and queries stay fast
+        buildIndex(index->maxLeafSize); return;
+    }
+
+    if (!index->tailTree)
+    {
+        index->tailTree = new DynamicKdTreeType(
+            3, index->tail, nanoflann::KDTreeSingleIndexAdaptorParams(index->maxLeafSize));
+    }
+    uint32_t local = (uint32_t)index->tail.count++;
+    index->tailTree->addPoints(local, local);
 }
 
 void PointCloudQuery::setPoints(const std::vector<PointData>& data)
 {
     PointCloudData* pcd = (PointCloudData*)_queryData;
     pcd->points = data;
+    for (int d = 0; d < 3; ++d)
+    {
+        pcd->coords[d].resize(data.size());
+        for (size_t i = 0; i < data.size(); ++i) pcd->coords[d][i] = data[i].first[d];
+    }
+    delete (PointCloudIndex*)_index; _index = NULL;
 }
 
 unsigned int PointCloudQuery::getNumPoints() const
@@ -564,32 +853,77 @@ const std::vector<PointCloudQuery::PointData>& PointCloudQuery::getPoints() cons
 void PointCloudQuery::buildIndex(int maxLeafSize)
 {
     PointCloudData* pcd = (PointCloudData*)_queryData;
-    if (_index != NULL) delete _index;
-    KdTreeType* kdtree = new KdTreeType(3, *pcd, nanoflann::KDTreeSingleIndexAdaptorParams(maxLeafSize));
-    kdtree->buildIndex(); _index = kdtree;
+    if (_index != NULL) delete (PointCloudIndex*)_index;
+
+    PointCloudIndex* index = new PointCloudIndex(pcd, maxLeafSize);
+    index->mainTree = new KdTreeType(3, *pcd, nanoflann::KDTreeSingleIndexAdaptorParams(maxLeafSize));
+    index->mainTree->buildIndex(); index->tail.offset = pcd->points.size(); _index = index;
 }
 
 float PointCloudQuery::findNearest(const osg::Vec3& pt, std::vector<uint32_t>& resultIndices,
                                    unsigned int maxResults)
 {
-    KdTreeType* kdtree = (KdTreeType*)_index;
+    PointCloudIndex* index = (PointCloudIndex*)_index;
+    if (!index || maxResults == 0) { resultIndices.clear(); return FLT_MAX; }
+
     std::vector<float> resultDistance2(maxResults);
     resultIndices.resize(maxResults);
 
-    float queryPt[3] = { pt[0], pt[1], pt[2] };
-    kdtree->knnSearch(&queryPt[0], maxResults, &(resultIndices[0]), &(resultDistance2[0]));
-    std::sort(resultDistance2.begin(), resultDistance2.end(), std::less<float>());
-    return resultDistance2[0];
+    PointCloudKnnResultSet resultSet(maxResults, &(resultIndices[0]), &(resultDistance2[0]));
+    findPointCloudNeighbors(index, resultSet, pt, nanoflann::SearchParams());
+    resultIndices.resize(resultSet.size());
+    return resultSet.size() > 0 ? resultDistance2[0] : FLT_MAX;
 }
 
 int PointCloudQuery::findInRadius(const osg::Vec3& pt, float radius,
                                   std::vector<IndexAndDistancePair>& resultIndices)
 {
-    KdTreeType* kdtree = (KdTreeType*)_index;
+    PointCloudIndex* index = (PointCloudIndex*)_index;
+    resultIndices.clear(); if (!index) return 0;
+
     nanoflann::SearchParams params; params.sorted = false;
+    PointCloudRadiusResultSet resultSet(radius, resultIndices);
+    findPointCloudNeighbors(index, resultSet, pt, params);
+    return (int)resultIndices.size();
+}
 
-    float queryPt[3] = { pt[0], pt[1], pt[2] };
-    return kdtree->radiusSearch(&queryPt[0], radius, resultIndices, params);
+void PointCloudQuery::findNearest(const std::vector<osg::Vec3>& points, unsigned int k,
+                                  std::vector<uint32_t>& resultIndices, std::vector<float>* resultDistances2) const
+{
+    PointCloudIndex* index = (PointCloudIndex*)_index;
+    resultIndices.assign(points.size() * k, UINT_MAX);
+    if (resultDistances2) resultDistances2->assign(points.size() * k, FLT_MAX);
+    if (!index || k == 0) return;
+
+    int numPoints = (int)points.size();
+#pragma omp parallel
+    {
+        std::vector<float> localDistances2(resultDistances2 ? 0 : k);
+#pragma omp for schedule(dynamic, 256)
+        for (int i = 0; i < numPoints; ++i)
+        {
+            float* dist2 = resultDistances2 ? &(*resultDistances2)[i * k] : &localDistances2[0];
+            PointCloudKnnResultSet resultSet(k, &resultIndices[i * k], dist2);
+            findPointCloudNeighbors(index, resultSet, points[i], nanoflann::SearchParams());
+        }
+    }
+}
+
+void PointCloudQuery::findInRadius(const std::vector<osg::Vec3>& points, float radius,
+                                   std::vector<std::vector<IndexAndDistancePair>>& results) const
+{
+    PointCloudIndex* index = (PointCloudIndex*)_index;
+    results.clear(); results.resize(points.size());
+    if (!index) return;
+
+    nanoflann::SearchParams params; params.sorted = false;
+    int numPoints = (int)points.size();
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numPoints; ++i)
+    {
+        PointCloudRadiusResultSet resultSet(radius, results[i]);
+        findPointCloudNeighbors(index, resultSet, points[i], params);
+    }
 }
 
 /* GeometryAlgorithm */
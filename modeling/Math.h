@@ -95,7 +95,9 @@ namespace osgVerse
         bool _compiled;
     };
 
-    /** Point cloud querying manager, used for finding closest points */
+    /** Point cloud querying manager, used for finding closest points.
+        Points added after buildIndex() go to a dynamic tail index that is merged into the
+        main KDTree when it grows as large, so appending never needs an explicit rebuild */
     class PointCloudQuery
     {
     public:
@@ -114,13 +116,23 @@ namespace osgVerse
         /** Build the KDTree index for point cloud */
         void buildIndex(int maxLeafSize = 10);
 
-        /** Find nearest neighbors of specific point */
+        /** Find nearest neighbors of specific point, returning the smallest squared distance */
         float findNearest(const osg::Vec3& pt, std::vector<uint32_t>& resultIndices,
                           unsigned int maxResults = 1000);
 
         /** Find points inside the radius of specific point */
         int findInRadius(const osg::Vec3& pt, float radius, std::vector<IndexAndDistancePair>& resultIndices);
 
+        /** Find k nearest neighbors of all points in parallel. Results of i-th point are stored
+            in [i * k, (i + 1) * k) of resultIndices, sorted by distance and padded with UINT_MAX */
+        void findNearest(const std::vector<osg::Vec3>& points, unsigned int k,
+                         std::vector<uint32_t>& resultIndices,
+                         std::vector<float>* resultDistances2 = NULL) const;
+
+        /** Find points inside the radius of all points in parallel */
+        void findInRadius(const std::vector<osg::Vec3>& points, float radius,
+                          std::vector<std::vector<IndexAndDistancePair>>& results) const;
+
     protected:
         void* _queryData;
         void* _index;
@@ -182,6 +194,20 @@ namespace osgVerse
 
         /// Geodetic: latitude and longitude in radius, altitude in metres; NED: north-east-down
         static osg::Matrix convertLLAtoNED(const osg::Vec3d& lla, const WGS84& wgs84 = WGS84());
+
+        /// Batch versions converting an array of points in place, split to threads for large inputs
+        static void convertLLAtoECEF(osg::Vec3d* values, size_t count, const WGS84& wgs84 = WGS84());
+        static void convertECEFtoLLA(osg::Vec3d* values, size_t count, const WGS84& wgs84 = WGS84());
+        static void convertLLAtoUTM(osg::Vec3d* values, size_t count,
+                                    const UTM& utm, const WGS84& wgs84 = WGS84());
+        static void convertUTMtoLLA(osg::Vec3d* values, size_t count,
+                                    const UTM& utm, const WGS84& wgs84 = WGS84());
+
+        /// Batch versions converting separated component arrays (x/lat, y/lon, z/alt) in place
+        static void convertLLAtoECEF(double* x, double* y, double* z, size_t count,
+                                     const WGS84& wgs84 = WGS84());
+        static void convertECEFtoLLA(double* x, double* y, double* z, size_t count,
+                                     const WGS84& wgs84 = WGS84());
     };
 
     /** Computational geometry helpers struct */
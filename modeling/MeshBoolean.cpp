@@ -0,0 +1,583 @@
+#include <osg/io_utils>
+#include <algorithm>
+#include <climits>
+#include <cfloat>
+#include <map>
+#include <unordered_map>
+#include <iostream>
+#include "3rdparty/cdt/CDT.h"
+#include "3rdparty/cdt/predicates.h"
+#include "MeshBoolean.h"
+#include "Utilities.h"
+using namespace osgVerse;
+
+#define EXTRA_POINT_FLAG 0x80000000u
+static inline uint64_t makeEdgeKey(unsigned int a, unsigned int b)
+{ return (a < b) ? (((uint64_t)a << 32) | b) : (((uint64_t)b << 32) | a); }
+
+/* Orientation tests using adaptive exact predicates. A zero result is always treated as positive,
+   and arguments are ordered canonically, so degenerate cases are decided the same way every time
+   they are met (a simple form of symbolic perturbation) */
+static inline double orient(const std::vector<osg::Vec3d>& pts, unsigned int a, unsigned int b,
+                            unsigned int c, unsigned int d)
+{ return predicates::adaptive::orient3d(pts[a].ptr(), pts[b].ptr(), pts[c].ptr(), pts[d].ptr()); }
+
+static inline int signOf(double v) { return v < 0.0 ? -1 : 1; }
+
+static inline int edgeSide(const std::vector<osg::Vec3d>& pts, unsigned int p, unsigned int q,
+                           unsigned int u, unsigned int v)
+{ return (u < v) ? signOf(orient(pts, p, q, u, v)) : -signOf(orient(pts, p, q, v, u)); }
+
+/* Bounding volume hierarchy of triangles, for candidate pairs and ray casting */
+struct TriangleTree
+{
+    struct Node
+    {
+        osg::BoundingBoxd box;
+        int left, right; unsigned int start, count;
+    };
+    std::vector<Node> nodes;
+    std::vector<unsigned int> order;
+    const std::vector<osg::Vec3d>* points;
+    const unsigned int* indices;
+    unsigned int faceOffset;
+
+    void build(const std::vector<osg::Vec3d>& pts, const unsigned int* ids, size_t numFaces,
+               unsigned int offset)
+    {
+        points = &pts; indices = ids; faceOffset = offset; nodes.clear();
+        order.resize(numFaces); if (!numFaces) return;
+
+        std::vector<osg::Vec3d> centers(numFaces);
+        for (size_t i = 0; i < numFaces; ++i)
+        {
+            const unsigned int* v = ids + i * 3; order[i] = (unsigned int)i;
+            centers[i] = (pts[v[0]] + pts[v[1]] + pts[v[2]]) / 3.0;
+        }
+        nodes.reserve(numFaces / 2 + 1);
+        buildNode(0, (unsigned int)numFaces, centers);
+    }
+
+    int buildNode(unsigned int start, unsigned int count, const std::vector<osg::Vec3d>& centers)
+    {
+        Node node; node.left = node.right = -1; node.start = start; node.count = count;
+        osg::BoundingBoxd centerBox;
+        for (unsigned int i = start; i < start + count; ++i)
+        {
+            const unsigned int* v = indices + order[i] * 3;
+            for (int k = 0; k < 3; ++k) node.box.expandBy((*points)[v[k]]);
+            centerBox.expandBy(centers[order[i]]);
+        }
+
+        int index = (int)nodes.size(); nodes.push_back(node);
+        if (count <= 4) return index;
+
+        osg::Vec3d extent = centerBox._max - centerBox._min;
+        int axis = (extent[0] > extent[1]) ? (extent[0] > extent[2] ? 0 : 2) : (extent[1] > extent[2] ? 1 : 2);
+        unsigned int half = count / 2;
+        std::nth_element(order.begin() + start, order.begin() + start + half, order.begin() + start + count,
+                         [&centers, axis](unsigned int a, unsigned int b) { return centers[a][axis] < centers[b][axis]; });
+
+        int left = buildNode(start, half, centers);
+        int right = buildNode(start + half, count - half, centers);
+        nodes[index].left = left; nodes[index].right = right; nodes[index].count = 0;
+        return index;
+    }
+
+    template<typename Func> void query(const osg::BoundingBoxd& bb, Func func) const
+    {
+        if (nodes.empty()) return;
+        std::vector<int> stack(1, 0); stack.reserve(64);
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.back()]; stack.pop_back();
+            if (!node.box.intersects(bb)) continue;
+            if (node.count > 0)
+            { for (unsigned int i = 0; i < node.count; ++i) func(order[node.start + i] + faceOffset); }
+            else { stack.push_back(node.left); stack.push_back(node.right); }
+        }
+    }
+
+    unsigned int countRayHits(const osg::Vec3d& origin, const osg::Vec3d& dir) const
+    {
+        if (nodes.empty()) return 0;
+        osg::Vec3d invDir(1.0 / dir[0], 1.0 / dir[1], 1.0 / dir[2]);
+        std::vector<int> stack(1, 0); stack.reserve(64);
+        unsigned int hits = 0;
+        while (!stack.empty())
+        {
+            const Node& node = nodes[stack.back()]; stack.pop_back();
+            double tMin = 0.0, tMax = DBL_MAX;
+            for (int k = 0; k < 3; ++k)
+            {
+                double t0 = (node.box._min[k] - origin[k]) * invDir[k];
+                double t1 = (node.box._max[k] - origin[k]) * invDir[k];
+                if (t0 > t1) std::swap(t0, t1);
+                tMin = osg::maximum(tMin, t0); tMax = osg::minimum(tMax, t1);
+            }
+            if (tMin > tMax) continue;
+            if (node.count == 0) { stack.push_back(node.left); stack.push_back(node.right); continue; }
+
+            for (unsigned int i = 0; i < node.count; ++i)
+            {
+                // Moller-Trumbore ray-triangle test
+                const unsigned int* v = indices + order[node.start + i] * 3;
+                const osg::Vec3d &p0 = (*points)[v[0]], &p1 = (*points)[v[1]], &p2 = (*points)[v[2]];
+                osg::Vec3d e1 = p1 - p0, e2 = p2 - p0, pv = dir ^ e2;
+                double det = e1 * pv; if (det == 0.0) continue;
+
+                double invDet = 1.0 / det; osg::Vec3d tv = origin - p0;
+                double u = (tv * pv) * invDet; if (u < 0.0 || u > 1.0) continue;
+                osg::Vec3d qv = tv ^ e1; double w = (dir * qv) * invDet;
+                if (w < 0.0 || u + w > 1.0) continue;
+                if ((e2 * qv) * invDet > 0.0) hits++;
+            }
+        }
+        return hits;
+    }
+};
+
+/* An intersection point is identified by the edge of one mesh and the face of the other that
+   it lies on, so the same point computed from different triangle pairs is always shared */
+struct PointKey
+{
+    unsigned int v0, v1, face;
+    bool operator<(const PointKey& k) const
+    {
+        if (v0 != k.v0) return v0 < k.v0;
+        return (v1 != k.v1) ? (v1 < k.v1) : (face < k.face);
+    }
+};
+
+struct IntersectedPair
+{
+    unsigned int faceA, faceB;
+    PointKey keys[2]; osg::Vec3d positions[2];
+};
+
+struct FaceCuts
+{
+    std::vector<unsigned int> interiorPoints;
+    std::vector<std::pair<unsigned int, unsigned int>> segments;
+};
+
+struct FaceTriangulation
+{
+    std::vector<unsigned int> triangles;
+    std::vector<osg::Vec3d> extraPoints;
+};
+
+struct BooleanContext
+{
+    std::vector<osg::Vec3d> points;
+    std::vector<unsigned int> faces;
+    std::unordered_map<uint64_t, std::vector<unsigned int>> edgePoints;
+    std::unordered_map<unsigned int, FaceCuts> faceCuts;
+    TriangleTree trees[2];
+    unsigned int numFaces[2];
+
+    /// Test if edge (p, q) with p < q crosses face f, when its end points are on different sides
+    bool edgeCrossesFace(unsigned int p, unsigned int q, unsigned int f) const
+    {
+        const unsigned int* v = &faces[f * 3];
+        int s0 = edgeSide(points, p, q, v[0], v[1]);
+        return s0 == edgeSide(points, p, q, v[1], v[2]) && s0 == edgeSide(points, p, q, v[2], v[0]);
+    }
+
+    /// Find edges of f0 crossing f1, and append intersection points to pair result
+    int collectEdgePoints(unsigned int f0, unsigned int f1, const double* dist, const int* sides,
+                          IntersectedPair& pair, int numPoints) const
+    {
+        const unsigned int* v = &faces[f0 * 3];
+        for (int e = 0; e < 3 && numPoints < 3; ++e)
+        {
+            int i = e, j = (e + 1) % 3; if (sides[i] == sides[j]) continue;
+            unsigned int p = v[i], q = v[j]; double dp = dist[i], dq = dist[j];
+            if (p > q) { std::swap(p, q); std::swap(dp, dq); }
+            if (!edgeCrossesFace(p, q, f1)) continue;
+            if (numPoints == 2) return 3;  // degenerated case, ignore this pair
+
+            double t = (dp == dq) ? 0.0 : dp / (dp - dq);
+            pair.keys[numPoints].v0 = p; pair.keys[numPoints].v1 = q; pair.keys[numPoints].face = f1;
+            pair.positions[numPoints] = points[p] + (points[q] - points[p]) * t; numPoints++;
+        }
+        return numPoints;
+    }
+
+    bool intersect(unsigned int fa, unsigned int fb, IntersectedPair& pair) const
+    {
+        const unsigned int *va = &faces[fa * 3], *vb = &faces[fb * 3];
+        double da[3], db[3]; int sa[3], sb[3];
+        for (int i = 0; i < 3; ++i)
+        { da[i] = orient(points, vb[0], vb[1], vb[2], va[i]); sa[i] = signOf(da[i]); }
+        if (sa[0] == sa[1] && sa[1] == sa[2]) return false;
+
+        for (int i = 0; i < 3; ++i)
+        { db[i] = orient(points, va[0], va[1], va[2], vb[i]); sb[i] = signOf(db[i]); }
+        if (sb[0] == sb[1] && sb[1] == sb[2]) return false;
+
+        int numPoints = collectEdgePoints(fa, fb, da, sa, pair, 0);
+        if (numPoints < 3) numPoints = collectEdgePoints(fb, fa, db, sb, pair, numPoints);
+        pair.faceA = fa; pair.faceB = fb; return numPoints == 2;
+    }
+
+    void triangulate(unsigned int f, FaceTriangulation& result) const
+    {
+        const unsigned int* v = &faces[f * 3];
+        const osg::Vec3d& p0 = points[v[0]];
+        osg::Vec3d normal = (points[v[1]] - p0) ^ (points[v[2]] - p0);
+        int axis = (fabs(normal[0]) > fabs(normal[1])) ? (fabs(normal[0]) > fabs(normal[2]) ? 0 : 2)
+                 : (fabs(normal[1]) > fabs(normal[2]) ? 1 : 2);
+        int ax = (axis + 1) % 3, ay = (axis + 2) % 3;
+        if (normal[axis] == 0.0) { result.triangles.assign(v, v + 3); return; }
+
+        std::vector<unsigned int> globals; std::map<unsigned int, unsigned int> localMap;
+        std::vector<CDT::V2d<double>> vertices; std::vector<CDT::Edge> edges;
+        auto addVertex = [&](unsigned int id) -> unsigned int
+        {
+            std::map<unsigned int, unsigned int>::iterator itr = localMap.find(id);
+            if (itr != localMap.end()) return itr->second;
+
+            unsigned int local = (unsigned int)globals.size(); localMap[id] = local; globals.push_back(id);
+            vertices.push_back(CDT::V2d<double>::make(points[id][ax], points[id][ay])); return local;
+        };
+
+        // Boundary chains, with intersection points on each edge sorted
+        for (int e = 0; e < 3; ++e)
+        {
+            unsigned int a = v[e], b = v[(e + 1) % 3];
+            std::vector<std::pair<double, unsigned int>> chain;
+            std::unordered_map<uint64_t, std::vector<unsigned int>>::const_iterator itr =
+                edgePoints.find(makeEdgeKey(a, b));
+            if (itr != edgePoints.end())
+            {
+                osg::Vec3d dir = points[b] - points[a];
+                for (size_t i = 0; i < itr->second.size(); ++i)
+                {
+                    unsigned int id = itr->second[i];
+                    chain.push_back(std::pair<double, unsigned int>((points[id] - points[a]) * dir, id));
+                }
+                std::sort(chain.begin(), chain.end());
+            }
+
+            unsigned int last = addVertex(a);
+            for (size_t i = 0; i < chain.size(); ++i)
+            {
+                unsigned int curr = addVertex(chain[i].second);
+                if (curr != last) edges.push_back(CDT::Edge(last, curr)); last = curr;
+            }
+            unsigned int end = addVertex(b); if (end != last) edges.push_back(CDT::Edge(last, end));
+        }
+
+        // Interior points and intersection segments
+        std::unordered_map<unsigned int, FaceCuts>::const_iterator cutItr = faceCuts.find(f);
+        if (cutItr != faceCuts.end())
+        {
+            const FaceCuts& cuts = cutItr->second;
+            for (size_t i = 0; i < cuts.interiorPoints.size(); ++i) addVertex(cuts.interiorPoints[i]);
+            for (size_t i = 0; i < cuts.segments.size(); ++i)
+            {
+                unsigned int s0 = addVertex(cuts.segments[i].first), s1 = addVertex(cuts.segments[i].second);
+                if (s0 != s1) edges.push_back(CDT::Edge(s0, s1));
+            }
+        }
+
+        // Points merged to the same 2D location keep the first global index
+        CDT::DuplicatesInfo dup = CDT::RemoveDuplicatesAndRemapEdges(vertices, edges);
+        std::vector<unsigned int> cdtGlobals(vertices.size(), UINT_MAX);
+        for (size_t i = 0; i < dup.mapping.size(); ++i)
+        { if (cdtGlobals[dup.mapping[i]] == UINT_MAX) cdtGlobals[dup.mapping[i]] = globals[i]; }
+        edges.erase(std::remove_if(edges.begin(), edges.end(),
+                    [](const CDT::Edge& e) { return e.v1() == e.v2(); }), edges.end());
+
+        CDT::Triangulation<double> cdt(CDT::VertexInsertionOrder::Auto,
+                                       CDT::IntersectingConstraintEdges::TryResolve, 0.0);
+        try
+        {
+            cdt.insertVertices(vertices); cdt.insertEdges(edges);
+            cdt.eraseOuterTriangles();
+        }
+        catch (std::exception& err)
+        {
+            OSG_INFO << "[MeshBoolean] Failed to triangulate face " << f << ": "
+                     << err.what() << std::endl;
+            result.triangles.assign(v, v + 3); return;
+        }
+
+        // New vertices from resolved constraint intersections are lifted back to the face plane
+        size_t numInput = cdtGlobals.size();
+        for (size_t i = numInput; i < cdt.vertices.size(); ++i)
+        {
+            osg::Vec3d pt; pt[ax] = cdt.vertices[i].x; pt[ay] = cdt.vertices[i].y;
+            pt[axis] = p0[axis] - (normal[ax] * (pt[ax] - p0[ax]) + normal[ay] * (pt[ay] - p0[ay])) / normal[axis];
+            result.extraPoints.push_back(pt);
+        }
+
+        for (size_t i = 0; i < cdt.triangles.size(); ++i)
+        {
+            unsigned int ids[3]; osg::Vec3d pt[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                size_t index = cdt.triangles[i].vertices[k];
+                if (index < numInput) { ids[k] = cdtGlobals[index]; pt[k] = points[ids[k]]; }
+                else
+                {
+                    ids[k] = EXTRA_POINT_FLAG | (unsigned int)(index - numInput);
+                    pt[k] = result.extraPoints[index - numInput];
+                }
+            }
+
+            osg::Vec3d n = (pt[1] - pt[0]) ^ (pt[2] - pt[0]);
+            if (n.length2() == 0.0) continue; else if (n * normal < 0.0) std::swap(ids[1], ids[2]);
+            result.triangles.insert(result.triangles.end(), ids, ids + 3);
+        }
+    }
+};
+
+static void computePatches(const std::vector<unsigned int>& triangles,
+                           const std::vector<uint64_t>& constraints, std::vector<unsigned int>& patches)
+{
+    size_t numTriangles = triangles.size() / 3;
+    std::vector<unsigned int> parents(numTriangles);
+    for (size_t i = 0; i < numTriangles; ++i) parents[i] = (unsigned int)i;
+    auto findRoot = [&parents](unsigned int i)
+    {
+        while (parents[i] != i) { parents[i] = parents[parents[i]]; i = parents[i]; }
+        return i;
+    };
+
+    // Triangles sharing an edge belong to the same patch, unless the edge is an intersection one
+    std::vector<std::pair<uint64_t, unsigned int>> edges(numTriangles * 3);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        for (int e = 0; e < 3; ++e)
+            edges[i * 3 + e] = std::pair<uint64_t, unsigned int>(
+                makeEdgeKey(triangles[i * 3 + e], triangles[i * 3 + (e + 1) % 3]), (unsigned int)i);
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i + 1; while (j < edges.size() && edges[j].first == edges[i].first) ++j;
+        if (!std::binary_search(constraints.begin(), constraints.end(), edges[i].first))
+        {
+            unsigned int r0 = findRoot(edges[i].second);
+            for (size_t k = i + 1; k < j; ++k)
+            { unsigned int r1 = findRoot(edges[k].second); if (r0 != r1) parents[r1] = r0; }
+        }
+        i = j;
+    }
+
+    std::vector<unsigned int> patchOfRoot(numTriangles, UINT_MAX); unsigned int numPatches = 0;
+    patches.resize(numTriangles);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        unsigned int r = findRoot((unsigned int)i);
+        if (patchOfRoot[r] == UINT_MAX) patchOfRoot[r] = numPatches++;
+        patches[i] = patchOfRoot[r];
+    }
+}
+
+static void classifyPatches(const std::vector<osg::Vec3d>& points, const std::vector<unsigned int>& triangles,
+                            const std::vector<unsigned int>& patches, const TriangleTree& otherTree,
+                            std::vector<bool>& insideOther)
+{
+    // Choose the largest triangle of each patch, and test its center against the other mesh
+    size_t numTriangles = triangles.size() / 3; unsigned int numPatches = 0;
+    for (size_t i = 0; i < numTriangles; ++i) numPatches = osg::maximum(numPatches, patches[i] + 1);
+
+    std::vector<double> bestArea(numPatches, -1.0);
+    std::vector<unsigned int> bestTriangle(numPatches, 0);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+        const unsigned int* v = &triangles[i * 3];
+        double area = ((points[v[1]] - points[v[0]]) ^ (points[v[2]] - points[v[0]])).length2();
+        if (area > bestArea[patches[i]]) { bestArea[patches[i]] = area; bestTriangle[patches[i]] = i; }
+    }
+
+    osg::BoundingBoxd otherBox = otherTree.nodes.empty() ? osg::BoundingBoxd() : otherTree.nodes[0].box;
+    osg::Vec3d rayDir(0.0123, 0.0271, 1.0); rayDir.normalize();
+    std::vector<char> results(numPatches, 0);
+
+    int numPatchesI = (int)numPatches;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int p = 0; p < numPatchesI; ++p)
+    {
+        const unsigned int* v = &triangles[bestTriangle[p] * 3];
+        osg::Vec3d center = (points[v[0]] + points[v[1]] + points[v[2]]) / 3.0;
+        if (!otherBox.valid() || !otherBox.contains(center)) continue;
+        results[p] = (otherTree.countRayHits(center, rayDir) % 2) ? 1 : 0;
+    }
+    insideOther.assign(results.begin(), results.end());
+}
+
+MeshBoolean::MeshBoolean()
+:   _numIntersectedPairs(0) {}
+
+void MeshBoolean::setMesh(Operand op, const std::vector<osg::Vec3>& vertices,
+                          const std::vector<unsigned int>& indices)
+{
+    _vertices[op].assign(vertices.begin(), vertices.end());
+    _indices[op].clear(); _indices[op].reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a == b || b == c || a == c) continue;
+        if (a >= vertices.size() || b >= vertices.size() || c >= vertices.size()) continue;
+        _indices[op].push_back(a); _indices[op].push_back(b); _indices[op].push_back(c);
+    }
+}
+
+void MeshBoolean::setMesh(Operand op, const MeshCollector& collector)
+{ setMesh(op, collector.getVertices(), collector.getTriangles()); }
+
+void MeshBoolean::setMesh(Operand op, osg::Node* node)
+{
+    if (!node) { _vertices[op].clear(); _indices[op].clear(); return; }
+    MeshCollector collector; collector.setWeldingVertices(true);
+    collector.setUseGlobalVertices(true); collector.setOnlyVertexAndIndices(true);
+    node->accept(collector); setMesh(op, collector);
+}
+
+osg::Geometry* MeshBoolean::process(Operation op)
+{
+    BooleanContext ctx; _numIntersectedPairs = 0;
+    unsigned int numVertexA = (unsigned int)_vertices[MESH_A].size();
+    ctx.numFaces[0] = (unsigned int)_indices[MESH_A].size() / 3;
+    ctx.numFaces[1] = (unsigned int)_indices[MESH_B].size() / 3;
+    if (ctx.numFaces[0] == 0 && ctx.numFaces[1] == 0) return NULL;
+
+    // Put both meshes in one point and face list, B after A
+    ctx.points = _vertices[MESH_A];
+    ctx.points.insert(ctx.points.end(), _vertices[MESH_B].begin(), _vertices[MESH_B].end());
+    ctx.faces = _indices[MESH_A];
+    for (size_t i = 0; i < _indices[MESH_B].size(); ++i)
+        ctx.faces.push_back(_indices[MESH_B][i] + numVertexA);
+
+    unsigned int totalFaces = ctx.numFaces[0] + ctx.numFaces[1];
+    ctx.trees[0].build(ctx.points, ctx.faces.data(), ctx.numFaces[0], 0);
+    ctx.trees[1].build(ctx.points, ctx.faces.data() + ctx.numFaces[0] * 3,
+                       ctx.numFaces[1], ctx.numFaces[0]);
+
+    // Find intersecting triangle pairs in parallel
+    const unsigned int chunkSize = 256;
+    int numChunks = (int)((ctx.numFaces[0] + chunkSize - 1) / chunkSize);
+    std::vector<std::vector<IntersectedPair>> pairsOfChunks(numChunks);
+    osg::BoundingBoxd boxB = ctx.trees[1].nodes.empty() ? osg::BoundingBoxd() : ctx.trees[1].nodes[0].box;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < numChunks; ++c)
+    {
+        std::vector<IntersectedPair>& pairs = pairsOfChunks[c];
+        unsigned int end = osg::minimum((c + 1) * chunkSize, ctx.numFaces[0]);
+        for (unsigned int fa = c * chunkSize; fa < end; ++fa)
+        {
+            osg::BoundingBoxd bb; const unsigned int* v = &ctx.faces[fa * 3];
+            for (int k = 0; k < 3; ++k) bb.expandBy(ctx.points[v[k]]);
+            if (!boxB.valid() || !boxB.intersects(bb)) continue;
+
+            ctx.trees[1].query(bb, [&](unsigned int fb)
+            { IntersectedPair pair; if (ctx.intersect(fa, fb, pair)) pairs.push_back(pair); });
+        }
+    }
+
+    // Share intersection points by their keys, and record cuts of each face
+    std::map<PointKey, unsigned int> pointIds; std::vector<uint64_t> constraints;
+    for (size_t c = 0; c < pairsOfChunks.size(); ++c)
+    {
+        const std::vector<IntersectedPair>& pairs = pairsOfChunks[c];
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            const IntersectedPair& pair = pairs[i]; unsigned int ids[2];
+            for (int k = 0; k < 2; ++k)
+            {
+                const PointKey& key = pair.keys[k];
+                std::map<PointKey, unsigned int>::iterator itr = pointIds.find(key);
+                if (itr != pointIds.end()) { ids[k] = itr->second; continue; }
+
+                ids[k] = (unsigned int)ctx.points.size(); pointIds[key] = ids[k];
+                ctx.points.push_back(pair.positions[k]);
+                ctx.edgePoints[makeEdgeKey(key.v0, key.v1)].push_back(ids[k]);
+                ctx.faceCuts[key.face].interiorPoints.push_back(ids[k]);
+            }
+
+            if (ids[0] == ids[1]) continue;
+            std::pair<unsigned int, unsigned int> segment(ids[0], ids[1]);
+            ctx.faceCuts[pair.faceA].segments.push_back(segment);
+            ctx.faceCuts[pair.faceB].segments.push_back(segment);
+            constraints.push_back(makeEdgeKey(ids[0], ids[1]));
+        }
+        _numIntersectedPairs += pairs.size();
+    }
+    std::sort(constraints.begin(), constraints.end());
+
+    // Re-triangulate all faces with cuts or split edges in parallel
+    std::vector<int> affectedIndex(totalFaces, -1); std::vector<unsigned int> affectedFaces;
+    for (unsigned int f = 0; f < totalFaces; ++f)
+    {
+        const unsigned int* v = &ctx.faces[f * 3]; bool affected = ctx.faceCuts.find(f) != ctx.faceCuts.end();
+        for (int e = 0; e < 3 && !affected; ++e)
+            affected = ctx.edgePoints.find(makeEdgeKey(v[e], v[(e + 1) % 3])) != ctx.edgePoints.end();
+        if (affected) { affectedIndex[f] = (int)affectedFaces.size(); affectedFaces.push_back(f); }
+    }
+
+    std::vector<FaceTriangulation> triangulations(affectedFaces.size());
+    int numAffected = (int)affectedFaces.size();
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < numAffected; ++i) ctx.triangulate(affectedFaces[i], triangulations[i]);
+
+    for (size_t i = 0; i < triangulations.size(); ++i)
+    {
+        FaceTriangulation& ft = triangulations[i];
+        unsigned int base = (unsigned int)ctx.points.size();
+        ctx.points.insert(ctx.points.end(), ft.extraPoints.begin(), ft.extraPoints.end());
+        for (size_t j = 0; j < ft.triangles.size(); ++j)
+        { if (ft.triangles[j] & EXTRA_POINT_FLAG) ft.triangles[j] = base + (ft.triangles[j] & ~EXTRA_POINT_FLAG); }
+    }
+
+    // Collect result triangles of both meshes, then split them into patches and classify
+    std::vector<unsigned int> triangles[2], patches[2]; std::vector<bool> inside[2];
+    for (unsigned int f = 0; f < totalFaces; ++f)
+    {
+        std::vector<unsigned int>& target = triangles[f < ctx.numFaces[0] ? 0 : 1];
+        if (affectedIndex[f] < 0) target.insert(target.end(), &ctx.faces[f * 3], &ctx.faces[f * 3] + 3);
+        else
+        {
+            const std::vector<unsigned int>& sub = triangulations[affectedIndex[f]].triangles;
+            target.insert(target.end(), sub.begin(), sub.end());
+        }
+    }
+
+    for (int m = 0; m < 2; ++m)
+    {
+        computePatches(triangles[m], constraints, patches[m]);
+        classifyPatches(ctx.points, triangles[m], patches[m], ctx.trees[1 - m], inside[m]);
+    }
+
+    // Keep patches by operation: B parts are flipped for difference
+    bool keepInside[2] = { op == INTERSECTION, op != UNION }, flipped[2] = { false, op == DIFFERENCE };
+    std::vector<unsigned int> vertexMap(ctx.points.size(), UINT_MAX);
+    osg::ref_ptr<osg::Vec3Array> va = new osg::Vec3Array;
+    osg::ref_ptr<osg::DrawElementsUInt> de = new osg::DrawElementsUInt(GL_TRIANGLES);
+    for (int m = 0; m < 2; ++m)
+    {
+        size_t numTriangles = triangles[m].size() / 3;
+        for (size_t i = 0; i < numTriangles; ++i)
+        {
+            if (inside[m][patches[m][i]] != keepInside[m]) continue;
+            unsigned int ids[3] = { triangles[m][i * 3], triangles[m][i * 3 + 1], triangles[m][i * 3 + 2] };
+            if (flipped[m]) std::swap(ids[1], ids[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                unsigned int& mapped = vertexMap[ids[k]];
+                if (mapped == UINT_MAX) { mapped = va->size(); va->push_back(ctx.points[ids[k]]); }
+                de->push_back(mapped);
+            }
+        }
+    }
+
+    OSG_INFO << "[MeshBoolean] " << _numIntersectedPairs << " intersecting pairs, "
+             << affectedFaces.size() << " faces re-triangulated, " << de->size() / 3
+             << " triangles in result" << std::endl;
+    if (de->empty()) return NULL;
+    return createGeometry(va.get(), NULL, osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f), de.get());
+}
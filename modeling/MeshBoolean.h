@@ -0,0 +1,48 @@
+#ifndef MANA_MODELING_MESH_BOOLEAN_HPP
+#define MANA_MODELING_MESH_BOOLEAN_HPP
+
+#include <vector>
+#include <osg/Geometry>
+
+namespace osgVerse
+{
+    class MeshCollector;
+
+    /** Boolean operations between two triangle meshes. Intersecting triangle pairs are found with
+        bounding volume hierarchies in parallel, and tested with adaptive exact orientation predicates.
+        Cut triangles are re-triangulated with constrained Delaunay, and each connected patch is then
+        kept or dropped by casting a ray (nearly +Z) against the other mesh. So mesh B should be closed,
+        while mesh A may also be an open height-field surface like a photogrammetry terrain.
+        Overlapping coplanar faces of A and B are not specially handled at present */
+    class MeshBoolean : public osg::Referenced
+    {
+    public:
+        MeshBoolean();
+
+        enum Operation { UNION, INTERSECTION, DIFFERENCE };
+        enum Operand { MESH_A = 0, MESH_B = 1 };
+
+        /** Set operand from vertices and triangle indices. Shared vertices must be welded */
+        void setMesh(Operand op, const std::vector<osg::Vec3>& vertices,
+                     const std::vector<unsigned int>& indices);
+
+        /** Set operand from MeshCollector result, which should have welded global vertices */
+        void setMesh(Operand op, const MeshCollector& collector);
+
+        /** Set operand from a node; its triangles are collected and welded in world space */
+        void setMesh(Operand op, osg::Node* node);
+
+        /** Compute the boolean result (A op B) as a new triangle geometry, or NULL if it is empty */
+        osg::Geometry* process(Operation op);
+
+        /// Number of intersecting triangle pairs found in last process()
+        unsigned int getNumIntersectedPairs() const { return _numIntersectedPairs; }
+
+    protected:
+        std::vector<osg::Vec3d> _vertices[2];
+        std::vector<unsigned int> _indices[2];
+        unsigned int _numIntersectedPairs;
+    };
+}
+
+#endif
@@ -1,8 +1,321 @@
+#include <Eigen/Sparse>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <tuple>
 #include "MeshDeformer.h"
-#include "3rdparty/laplacian_deformation.hpp"
 using namespace osgVerse;
 using namespace osgVerse::helper;
 
+namespace osgVerse
+{
+    /** Factorized Laplacian system of a region, whose first numConstrained vertices are constrained.
+        Equation numbers refer to Sorkine et al., "Laplacian Surface Editing", 2004 */
+    struct LaplacianSystem
+    {
+        typedef Eigen::SparseMatrix<double> SpMat;
+        typedef Eigen::Triplet<double> Triplet;
+
+        SpMat laplacian;  // N x N uniform Laplacian
+        Eigen::SimplicialLDLT<SpMat> solver;  // L^T L + C^T C, shared by x/y/z
+        Eigen::SimplicialLDLT<SpMat> rsiSolver;  // A^T A + C^T C of energy (5), 3N x 3N
+        Eigen::MatrixXd positions, deltaTerm;  // N x 3 rest positions and L^T * delta
+        std::vector<double> deltaLengths;
+        int numConstrained; bool rotationInvariant;
+
+        bool prepare(const std::vector<vec3>& pos, const std::vector<std::vector<int>>& adj,
+                     int numC, bool rsi)
+        {
+            int n = (int)pos.size(); numConstrained = numC; rotationInvariant = rsi;
+            std::vector<Triplet> coeffs;
+            for (int i = 0; i < n; ++i)
+            {
+                const std::vector<int>& ring = adj[i]; coeffs.push_back(Triplet(i, i, 1.0));
+                double w = ring.empty() ? 0.0 : (-1.0 / (double)ring.size());
+                for (size_t j = 0; j < ring.size(); ++j) coeffs.push_back(Triplet(i, ring[j], w));
+            }
+            laplacian.resize(n, n);
+            laplacian.setFromTriplets(coeffs.begin(), coeffs.end());
+
+            positions.resize(n, 3);
+            for (int i = 0; i < n; ++i) positions.row(i) << pos[i].x, pos[i].y, pos[i].z;
+            Eigen::MatrixXd delta = laplacian * positions;
+            deltaTerm = laplacian.transpose() * delta;
+            deltaLengths.resize(n);
+            for (int i = 0; i < n; ++i) deltaLengths[i] = delta.row(i).norm();
+
+            // Energy (4) is separable, so x/y/z share one N x N factorization
+            SpMat constraints(n, n); coeffs.clear();
+            for (int i = 0; i < numC; ++i) coeffs.push_back(Triplet(i, i, 1.0));
+            constraints.setFromTriplets(coeffs.begin(), coeffs.end());
+            solver.compute(SpMat(laplacian.transpose() * laplacian) + constraints);
+            if (solver.info() != Eigen::Success) return false;
+            if (!rsi) return true;
+
+            // Energy (5): delta of each vertex is transformed by T_i = (A_i A_i^T)^-1 A_i (equation 12)
+            std::vector<std::vector<Triplet>> rowCoeffs(n);
+#pragma omp parallel for schedule(dynamic, 64)
+            for (int i = 0; i < n; ++i)
+            {
+                const std::vector<int>& ring = adj[i];
+                std::vector<Triplet>& rc = rowCoeffs[i];
+                double w = ring.empty() ? 0.0 : (-1.0 / (double)ring.size());
+                for (int d = 0; d < 3; ++d)
+                {
+                    rc.push_back(Triplet(3 * i + d, 3 * i + d, 1.0));
+                    for (size_t j = 0; j < ring.size(); ++j)
+                        rc.push_back(Triplet(3 * i + d, 3 * ring[j] + d, w));
+                }
+                if (ring.size() < 2) continue;  // too few neighbors to fit a transformation
+
+                std::vector<int> ids(1, i); ids.insert(ids.end(), ring.begin(), ring.end());
+                int k = (int)ids.size();
+                Eigen::MatrixXd At = Eigen::MatrixXd::Zero(7, 3 * k);
+                for (int j = 0; j < k; ++j)
+                {
+                    double vx = positions(ids[j], 0), vy = positions(ids[j], 1), vz = positions(ids[j], 2);
+                    At(0, j * 3 + 0) = vx; At(2, j * 3 + 0) = vz; At(3, j * 3 + 0) = -vy; At(4, j * 3 + 0) = 1.0;
+                    At(0, j * 3 + 1) = vy; At(1, j * 3 + 1) = -vz; At(3, j * 3 + 1) = vx; At(5, j * 3 + 1) = 1.0;
+                    At(0, j * 3 + 2) = vz; At(1, j * 3 + 2) = vy; At(2, j * 3 + 2) = -vx; At(6, j * 3 + 2) = 1.0;
+                }
+
+                Eigen::Matrix<double, 7, 7> AAt = At * At.transpose();
+                Eigen::MatrixXd T = AAt.ldlt().solve(At);
+                double dx = delta(i, 0), dy = delta(i, 1), dz = delta(i, 2);
+                for (int j = 0; j < 3 * k; ++j)
+                {
+                    int col = 3 * ids[j / 3] + (j % 3);
+                    double s = T(0, j), h1 = T(1, j), h2 = T(2, j), h3 = T(3, j);
+                    rc.push_back(Triplet(3 * i + 0, col, -(dx * s - dy * h3 + dz * h2)));
+                    rc.push_back(Triplet(3 * i + 1, col, -(dx * h3 + dy * s - dz * h1)));
+                    rc.push_back(Triplet(3 * i + 2, col, -(-dx * h2 + dy * h1 + dz * s)));
+                }
+            }
+
+            coeffs.clear();
+            for (int i = 0; i < n; ++i)
+            {
+                coeffs.insert(coeffs.end(), rowCoeffs[i].begin(), rowCoeffs[i].end());
+                std::vector<Triplet>().swap(rowCoeffs[i]);
+            }
+
+            SpMat energy(3 * n, 3 * n), constraints3(3 * n, 3 * n);
+            energy.setFromTriplets(coeffs.begin(), coeffs.end()); coeffs.clear();
+            for (int i = 0; i < 3 * numC; ++i) coeffs.push_back(Triplet(i, i, 1.0));
+            constraints3.setFromTriplets(coeffs.begin(), coeffs.end());
+            rsiSolver.compute(SpMat(energy.transpose() * energy) + constraints3);
+            return rsiSolver.info() == Eigen::Success;
+        }
+
+        void solve(const Eigen::MatrixXd& targets, Eigen::MatrixXd& result) const
+        {
+            int n = (int)positions.rows();
+            Eigen::MatrixXd rhs;
+            if (rotationInvariant)
+            {
+                // Right-hand side of energy (5) is zero except for constraints
+                Eigen::VectorXd b = Eigen::VectorXd::Zero(3 * n);
+                for (int i = 0; i < numConstrained; ++i)
+                { for (int d = 0; d < 3; ++d) b[3 * i + d] = targets(i, d); }
+                Eigen::VectorXd x = rsiSolver.solve(b);
+
+                // Solver introduces local scaling, so normalize delta of the result to original lengths
+                Eigen::MatrixXd solution = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, 3, Eigen::RowMajor>>(
+                    x.data(), n, 3);
+                Eigen::MatrixXd solutionDelta = laplacian * solution;
+                for (int i = 0; i < n; ++i)
+                {
+                    double len = solutionDelta.row(i).norm();
+                    solutionDelta.row(i) *= (len > 0.0) ? (deltaLengths[i] / len) : 0.0;
+                }
+                rhs = laplacian.transpose() * solutionDelta;
+            }
+            else
+                rhs = deltaTerm;
+            rhs.topRows(numConstrained) += targets;
+
+            result.resize(n, 3);
+#pragma omp parallel for
+            for (int d = 0; d < 3; ++d) result.col(d) = solver.solve(rhs.col(d));
+        }
+    };
+}
+
+/* MeshDeformSession */
+
+MeshDeformSession::MeshDeformSession()
+    : _system(NULL), _coarseSystem(NULL), _coarseRatio(0), _rotationInvariant(true)
+{
+}
+
+MeshDeformSession::~MeshDeformSession()
+{ clear(); }
+
+void MeshDeformSession::clear()
+{
+    delete _system; _system = NULL;
+    delete _coarseSystem; _coarseSystem = NULL;
+    _roiIndices.clear(); _clusters.clear();
+    _coarseRingOffsets.clear(); _coarseRings.clear();
+}
+
+bool MeshDeformSession::prepare(const std::vector<vec3>& positions, const std::vector<int>& cells,
+                                const std::vector<int>& constrained, const std::vector<int>& freeVertices)
+{
+    clear(); if (constrained.empty()) return false;
+    _roiIndices.insert(_roiIndices.end(), constrained.begin(), constrained.end());
+    _roiIndices.insert(_roiIndices.end(), freeVertices.begin(), freeVertices.end());
+
+    int numRoi = (int)_roiIndices.size(), numPositions = (int)positions.size();
+    std::vector<int> roiMap(numPositions, -1);
+    std::vector<vec3> roiPositions(numRoi);
+    for (int i = 0; i < numRoi; ++i)
+    {
+        int index = _roiIndices[i];
+        if (index < 0 || index >= numPositions || roiMap[index] >= 0)
+        { clear(); return false; }  // out of range or duplicated
+        roiMap[index] = i; roiPositions[i] = positions[index];
+    }
+
+    std::vector<std::vector<int>> adjacency(numRoi);
+    for (size_t i = 0; i + 2 < cells.size(); i += 3)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            int a = cells[i + j], b = cells[i + (j + 1) % 3];
+            if (a < 0 || b < 0 || a >= numPositions || b >= numPositions) continue;
+            int ra = roiMap[a], rb = roiMap[b];
+            if (ra >= 0 && rb >= 0 && ra != rb)
+            { adjacency[ra].push_back(rb); adjacency[rb].push_back(ra); }
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < numRoi; ++i)
+    {
+        std::vector<int>& ring = adjacency[i]; std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    }
+
+    _system = new LaplacianSystem;
+    if (!_system->prepare(roiPositions, adjacency, (int)constrained.size(), _rotationInvariant))
+    { clear(); return false; }
+    if (_coarseRatio > 1) prepareCoarseLevel(roiPositions, adjacency, (int)constrained.size());
+    return true;
+}
+
+void MeshDeformSession::prepareCoarseLevel(const std::vector<vec3>& roiPositions,
+                                           const std::vector<std::vector<int>>& adjacency, int numConstrained)
+{
+    // Constrained vertices are kept as coarse nodes, and free vertices are clustered by a grid
+    // whose cell size makes each cluster cover about 'ratio' vertices
+    int numRoi = (int)roiPositions.size(); double edgeLength = 0.0; size_t numEdges = 0;
+    for (int i = 0; i < numRoi; ++i)
+    {
+        const std::vector<int>& ring = adjacency[i];
+        for (size_t j = 0; j < ring.size(); ++j)
+        { edgeLength += vec3::distance(roiPositions[i], roiPositions[ring[j]]); numEdges++; }
+    }
+    if (numEdges == 0 || numRoi <= numConstrained) return;
+
+    double cellSize = (edgeLength / (double)numEdges) * sqrt((double)_coarseRatio);
+    std::map<std::tuple<int, int, int>, int> cellMap;
+    std::vector<vec3> coarsePositions(roiPositions.begin(), roiPositions.begin() + numConstrained);
+    std::vector<int> clusterSizes(numConstrained, 1);
+    _clusters.resize(numRoi);
+    for (int i = 0; i < numRoi; ++i)
+    {
+        if (i < numConstrained) { _clusters[i] = i; continue; }
+        const vec3& v = roiPositions[i];
+        std::tuple<int, int, int> key((int)floor(v.x / cellSize), (int)floor(v.y / cellSize),
+                                      (int)floor(v.z / cellSize));
+        std::map<std::tuple<int, int, int>, int>::iterator itr = cellMap.find(key);
+        if (itr == cellMap.end())
+        {
+            int c = (int)coarsePositions.size(); cellMap[key] = c; _clusters[i] = c;
+            coarsePositions.push_back(v); clusterSizes.push_back(1);
+        }
+        else
+        {
+            int c = itr->second; _clusters[i] = c;
+            coarsePositions[c] += v; clusterSizes[c]++;
+        }
+    }
+
+    int numCoarse = (int)coarsePositions.size();
+    std::vector<std::vector<int>> coarseAdjacency(numCoarse);
+    for (int c = numConstrained; c < numCoarse; ++c)
+        coarsePositions[c] = coarsePositions[c] * (1.0 / (double)clusterSizes[c]);
+    for (int i = 0; i < numRoi; ++i)
+    {
+        const std::vector<int>& ring = adjacency[i]; int c0 = _clusters[i];
+        for (size_t j = 0; j < ring.size(); ++j)
+        { int c1 = _clusters[ring[j]]; if (c0 != c1) coarseAdjacency[c0].push_back(c1); }
+    }
+
+    for (int c = 0; c < numCoarse; ++c)
+    {
+        std::vector<int>& ring = coarseAdjacency[c]; std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    }
+
+    // Free vertices interpolate displacements of nearby clusters, to avoid blocky previews
+    _coarseRingOffsets.assign(1, 0);
+    for (int i = numConstrained; i < numRoi; ++i)
+    {
+        const std::vector<int>& ring = adjacency[i];
+        std::vector<int> clusters(1, _clusters[i]);
+        for (size_t j = 0; j < ring.size(); ++j) clusters.push_back(_clusters[ring[j]]);
+        std::sort(clusters.begin(), clusters.end());
+        clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+        _coarseRings.insert(_coarseRings.end(), clusters.begin(), clusters.end());
+        _coarseRingOffsets.push_back((int)_coarseRings.size());
+    }
+
+    _coarseSystem = new LaplacianSystem;
+    if (!_coarseSystem->prepare(coarsePositions, coarseAdjacency, numConstrained, _rotationInvariant))
+    {
+        delete _coarseSystem; _coarseSystem = NULL;
+        _clusters.clear(); _coarseRingOffsets.clear(); _coarseRings.clear();
+    }
+}
+
+bool MeshDeformSession::solve(const std::vector<vec3>& targets, std::vector<vec3>& positions,
+                              bool coarse) const
+{
+    if (!_system || (int)targets.size() != _system->numConstrained) return false;
+    int numConstrained = _system->numConstrained, numRoi = (int)_roiIndices.size();
+    for (int i = 0; i < numRoi; ++i)
+    { if (_roiIndices[i] >= (int)positions.size()) return false; }
+
+    Eigen::MatrixXd targetMatrix(numConstrained, 3), result;
+    for (int i = 0; i < numConstrained; ++i)
+        targetMatrix.row(i) << targets[i].x, targets[i].y, targets[i].z;
+    if (coarse && _coarseSystem)
+    {
+        _coarseSystem->solve(targetMatrix, result);
+        Eigen::MatrixXd displacements = result - _coarseSystem->positions;
+        for (int i = 0; i < numConstrained; ++i) positions[_roiIndices[i]] = targets[i];
+
+#pragma omp parallel for schedule(dynamic, 256)
+        for (int i = numConstrained; i < numRoi; ++i)
+        {
+            int r = i - numConstrained, begin = _coarseRingOffsets[r], end = _coarseRingOffsets[r + 1];
+            Eigen::RowVector3d disp = Eigen::RowVector3d::Zero();
+            for (int j = begin; j < end; ++j) disp += displacements.row(_coarseRings[j]);
+            disp = _system->positions.row(i) + disp / (double)(end - begin);
+            positions[_roiIndices[i]] = vec3(disp[0], disp[1], disp[2]);
+        }
+        return true;
+    }
+
+    _system->solve(targetMatrix, result);
+    for (int i = 0; i < numRoi; ++i)
+        positions[_roiIndices[i]] = vec3(result(i, 0), result(i, 1), result(i, 2));
+    return true;
+}
+
+/* MeshDeformer */
+
 MeshDeformer::MeshDeformer()
     : _boundaryBegin(-1), _updatingCount(-1)
 {
@@ -10,7 +323,6 @@ MeshDeformer::MeshDeformer()
 
 MeshDeformer::~MeshDeformer()
 {
-    if (_updatingCount >= 0) freeDeform();
 }
 
 void MeshDeformer::initialize(const std::vector<vec3>& pos, const std::vector<int>& cells)
@@ -35,15 +347,14 @@ void MeshDeformer::initialize(const std::vector<vec3>& pos, const std::vector<in
         newCells.push_back(_sharedIndexMap[cells[i]]);
 
     // Set variables
-    if (_updatingCount >= 0) freeDeform();
+    _session.clear();
     _positions = newPos; _cells = newCells; _updatingCount = -1;
     _adjacancies = computeAdjacancy((int)_positions.size(), _cells);
 }
 
 bool MeshDeformer::setHandle(int mainHandle, int handleSize, int unconstrainedSize)
 {
-    if (_updatingCount >= 0)
-    { _handles.clear(); _unconstrained.clear(); freeDeform(); }
+    _handles.clear(); _unconstrained.clear(); _session.clear();
     
     int numVertices = (int)_positions.size();
     if (numVertices == 0) return false; else _updatingCount = 0;
@@ -91,38 +402,24 @@ bool MeshDeformer::setHandle(int mainHandle, int handleSize, int unconstrainedSi
         _handles.push_back(e); visited[e] = true;
     }
 
-    // Prepare deformation
-    int unconstrainedBegin = (int)_handles.size(); _combined.clear();
-    _combined.insert(_combined.end(), _handles.begin(), _handles.end());
-    _combined.insert(_combined.end(), _unconstrained.begin(), _unconstrained.end());
-    prepareDeform(_cells.data(), (int)_cells.size(),
-                  (double*)_positions.data(), numVertices * 3,
-                  _combined.data(), (int)_combined.size(), unconstrainedBegin, true);
-    return true;
+    // Prepare deformation: factorize once for this handle set
+    return _session.prepare(_positions, _cells, _handles, _unconstrained);
 }
 
-bool MeshDeformer::updateDeformation(double dx, double dy, double dz)
+bool MeshDeformer::updateDeformation(double dx, double dy, double dz, bool coarse)
 {
-    std::vector<double> inputData(_handles.size() * 3);
-    if (_boundaryBegin < 0 || _handles.empty()) return false;
+    if (_boundaryBegin < 0 || _handles.empty() || !_session.isPrepared()) return false;
+    std::vector<vec3> targets(_handles.size());
 
-    int j = 0, handleSize = (int)_handles.size();
-    for (int i = 0; i < _boundaryBegin; ++i)
+    int handleSize = (int)_handles.size();
+    for (int i = 0; i < handleSize; ++i)
     {
-        inputData[j * 3 + 0] = _positions[_handles[i]].x + dx;
-        inputData[j * 3 + 1] = _positions[_handles[i]].y + dy;
-        inputData[j * 3 + 2] = _positions[_handles[i]].z + dz; ++j;
+        targets[i] = _positions[_handles[i]];
+        if (i < _boundaryBegin) targets[i] += vec3(dx, dy, dz);
     }
 
-    for (int i = _boundaryBegin; i < handleSize; ++i)
-    {
-        inputData[j * 3 + 0] = _positions[_handles[i]].x;
-        inputData[j * 3 + 1] = _positions[_handles[i]].y;
-        inputData[j * 3 + 2] = _positions[_handles[i]].z; ++j;
-    }
-    
-    // Compute deformation
-    doDeform(&inputData[0], handleSize, (double*)_positions.data());
+    // Compute deformation with back-substitutions only
+    if (!_session.solve(targets, _positions, coarse)) return false;
 
     // Reconstruct original vertex list
     for (std::map<int, int>::iterator itr = _sharedIndexMap.begin();
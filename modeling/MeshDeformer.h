@@ -56,6 +56,54 @@ namespace osgVerse
         };
     }
 
+    struct LaplacianSystem;
+
+    /** Laplacian deformation session of a mesh region. The sparse system is factorized once in
+        prepare(), so moving constrained vertices only costs back-substitutions in solve().
+        An optional coarse level (vertex clusters of the region) can be solved for fast previewing */
+    class MeshDeformSession
+    {
+    public:
+        MeshDeformSession();
+        ~MeshDeformSession();
+
+        /// Owns the factorized systems, so it can't be copied
+        MeshDeformSession(const MeshDeformSession&) = delete;
+        MeshDeformSession& operator=(const MeshDeformSession&) = delete;
+
+        /// Use rotation-scale-invariant energy, slower but keeps details better (default: true)
+        void setRotationInvariant(bool b) { _rotationInvariant = b; }
+        bool getRotationInvariant() const { return _rotationInvariant; }
+
+        /// Prepare a coarse level with about 1/ratio of region vertices, 0 to disable (default: 0)
+        void setCoarseRatio(int r) { _coarseRatio = r; }
+        int getCoarseRatio() const { return _coarseRatio; }
+
+        /** Factorize the system of a mesh region, which is slow and should be done only when the mesh
+            or constrained set changes. Constrained vertices follow targets given to solve(), and free
+            vertices are computed. Vertices not in the region are kept unchanged */
+        bool prepare(const std::vector<helper::vec3>& positions, const std::vector<int>& cells,
+                     const std::vector<int>& constrained, const std::vector<int>& freeVertices);
+
+        /** Compute new region positions using back-substitutions only. Targets are of constrained
+            vertices in prepare() order, and positions is the whole mesh to update in place */
+        bool solve(const std::vector<helper::vec3>& targets, std::vector<helper::vec3>& positions,
+                   bool coarse = false) const;
+
+        bool isPrepared() const { return _system != NULL; }
+        bool hasCoarseLevel() const { return _coarseSystem != NULL; }
+        void clear();
+
+    protected:
+        void prepareCoarseLevel(const std::vector<helper::vec3>& roiPositions,
+                                const std::vector<std::vector<int>>& adjacency, int numConstrained);
+
+        LaplacianSystem *_system, *_coarseSystem;
+        std::vector<int> _roiIndices, _clusters;
+        std::vector<int> _coarseRingOffsets, _coarseRings;
+        int _coarseRatio; bool _rotationInvariant;
+    };
+
     class MeshDeformer
     {
     public:
@@ -64,7 +112,13 @@ namespace osgVerse
 
         void initialize(const std::vector<helper::vec3>& pos, const std::vector<int>& cells);
         bool setHandle(int mainHandle, int handleSize, int unconstrainedSize);
-        bool updateDeformation(double dx, double dy, double dz);
+
+        /** Move handles by given offset. Set coarse to solve on the coarse level for previewing,
+            which requires getSession().setCoarseRatio() before setHandle() */
+        bool updateDeformation(double dx, double dy, double dz, bool coarse = false);
+
+        MeshDeformSession& getSession() { return _session; }
+        const MeshDeformSession& getSession() const { return _session; }
 
         void getHandles(std::vector<int>& handles, std::vector<int>& unconstrained);
         const std::vector<helper::vec3>& getPositions(bool original = true) const;
@@ -76,11 +130,12 @@ namespace osgVerse
         std::map<int, std::vector<int>> _sharedToOriginIndexMap;
         std::map<int, int> _sharedIndexMap;
         std::vector<helper::vec3> _positions, _positions0;
-        std::vector<int> _cells, _combined;
+        std::vector<int> _cells;
         AdjacancyList _adjacancies;
 
         std::vector<int> _handles;
         std::vector<int> _unconstrained;
+        MeshDeformSession _session;
         int _boundaryBegin, _updatingCount;
     };
 }
@@ -0,0 +1,333 @@
+#include <osg/Version>
+#include <osg/io_utils>
+#include <osg/Geode>
+#include <osg/TriangleIndexFunctor>
+#include <osg/ValueObject>
+#include <osgDB/FileNameUtils>
+#include <osgDB/WriteFile>
+#include <meshoptimizer/meshoptimizer.h>
+#include "MeshLodGenerator.h"
+using namespace osgVerse;
+
+struct CollectTriangleOperator
+{
+    void operator()(unsigned int i1, unsigned int i2, unsigned int i3)
+    {
+        if (i1 == i2 || i2 == i3 || i1 == i3) return;
+        indices.push_back(i1); indices.push_back(i2); indices.push_back(i3);
+    }
+    std::vector<unsigned int> indices;
+};
+
+struct LodSourceData
+{
+    osg::Vec3Array* vertices;
+    std::vector<unsigned int> indices;
+    std::vector<float> attributes, weights;
+    size_t numAttributes; float scale;
+    LodSourceData() : vertices(NULL), numAttributes(0), scale(1.0f) {}
+};
+
+static bool prepareSourceData(osg::Geometry& geom, LodSourceData& data,
+                              float normalWeight, float uvWeight, float colorWeight)
+{
+    data.vertices = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
+    if (!data.vertices || data.vertices->empty()) return false;
+
+    osg::TriangleIndexFunctor<CollectTriangleOperator> functor; geom.accept(functor);
+    data.indices.swap(functor.indices); if (data.indices.empty()) return false;
+
+    size_t numVertices = data.vertices->size();
+    data.scale = meshopt_simplifyScale(
+        (const float*)&(*data.vertices)[0], numVertices, sizeof(osg::Vec3));
+
+    // Interleave per-vertex attributes for the attribute-aware error metric
+    osg::Vec3Array* na = dynamic_cast<osg::Vec3Array*>(geom.getNormalArray());
+    osg::Vec2Array* ta = dynamic_cast<osg::Vec2Array*>(geom.getTexCoordArray(0));
+    osg::Vec4Array* ca = dynamic_cast<osg::Vec4Array*>(geom.getColorArray());
+    if (!na || na->size() != numVertices || normalWeight <= 0.0f ||
+        geom.getNormalBinding() != osg::Geometry::BIND_PER_VERTEX) na = NULL;
+    if (!ta || ta->size() != numVertices || uvWeight <= 0.0f) ta = NULL;
+    if (!ca || ca->size() != numVertices || colorWeight <= 0.0f ||
+        geom.getColorBinding() != osg::Geometry::BIND_PER_VERTEX) ca = NULL;
+
+    size_t stride = (na ? 3 : 0) + (ta ? 2 : 0) + (ca ? 4 : 0);
+    if (stride == 0) return true;
+    for (size_t k = 0; k < 3 && na; ++k) data.weights.push_back(normalWeight);
+    for (size_t k = 0; k < 2 && ta; ++k) data.weights.push_back(uvWeight);
+    for (size_t k = 0; k < 4 && ca; ++k) data.weights.push_back(colorWeight);
+
+    data.numAttributes = stride; data.attributes.resize(numVertices * stride);
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        float* ptr = &data.attributes[i * stride];
+        if (na) { const osg::Vec3& n = (*na)[i]; *(ptr++) = n[0]; *(ptr++) = n[1]; *(ptr++) = n[2]; }
+        if (ta) { const osg::Vec2& t = (*ta)[i]; *(ptr++) = t[0]; *(ptr++) = t[1]; }
+        if (ca) { const osg::Vec4& c = (*ca)[i]; for (int k = 0; k < 4; ++k) *(ptr++) = c[k]; }
+    }
+    return true;
+}
+
+static size_t simplifyIndices(const LodSourceData& data, const std::vector<unsigned int>& input,
+                              std::vector<unsigned int>& output, size_t targetCount, float maxError,
+                              bool lockBorders, float& resultError)
+{
+    const float* positions = (const float*)&(*data.vertices)[0];
+    size_t numVertices = data.vertices->size();
+    unsigned int options = lockBorders ? meshopt_SimplifyLockBorder : 0;
+
+    output.resize(input.size()); resultError = 0.0f;
+    size_t count = 0;
+    if (data.numAttributes > 0)
+        count = meshopt_simplifyWithAttributes(
+            &output[0], &input[0], input.size(), positions, numVertices, sizeof(osg::Vec3),
+            &data.attributes[0], data.numAttributes * sizeof(float), &data.weights[0],
+            data.numAttributes, NULL, targetCount, maxError, options, &resultError);
+    else
+        count = meshopt_simplify(&output[0], &input[0], input.size(), positions, numVertices,
+                                 sizeof(osg::Vec3), targetCount, maxError, options, &resultError);
+    output.resize(count); return count;
+}
+
+template<typename T>
+static T* remapArrayData(const T* src, const std::vector<unsigned int>& remap, size_t count)
+{
+    T* dst = new T(count);
+    for (size_t i = 0; i < remap.size(); ++i)
+    { if (remap[i] != ~0u) (*dst)[remap[i]] = (*src)[i]; }
+    return dst;
+}
+
+static osg::Array* remapArray(osg::Array* src, const std::vector<unsigned int>& remap, size_t count)
+{
+    // Arrays not in per-vertex size (e.g. overall bindings) are shared as they are
+    if (!src || src->getNumElements() != remap.size()) return src;
+#define REMAP_ARRAY_TYPE(T) \
+    { T* arr = dynamic_cast<T*>(src); if (arr) return remapArrayData(arr, remap, count); }
+    REMAP_ARRAY_TYPE(osg::Vec3Array) REMAP_ARRAY_TYPE(osg::Vec2Array)
+    REMAP_ARRAY_TYPE(osg::Vec4Array) REMAP_ARRAY_TYPE(osg::Vec4ubArray)
+    REMAP_ARRAY_TYPE(osg::FloatArray) REMAP_ARRAY_TYPE(osg::Vec3dArray)
+#undef REMAP_ARRAY_TYPE
+    OSG_NOTICE << "[MeshLodGenerator] Unsupported vertex array type " << src->className()
+               << ", which will be removed from simplified geometry" << std::endl;
+    return NULL;
+}
+
+static osg::Geometry* createLevelGeometry(const osg::Geometry& src, std::vector<unsigned int>& indices,
+                                          bool optimizeForRendering)
+{
+    osg::Vec3Array* va = static_cast<osg::Vec3Array*>(const_cast<osg::Array*>(src.getVertexArray()));
+    size_t numVertices = va->size();
+    if (optimizeForRendering)
+    {
+        meshopt_optimizeVertexCache(&indices[0], &indices[0], indices.size(), numVertices);
+        meshopt_optimizeOverdraw(&indices[0], &indices[0], indices.size(),
+                                 (const float*)&(*va)[0], numVertices, sizeof(osg::Vec3), 1.05f);
+    }
+
+    // Always compact vertices so that unused ones are dropped
+    std::vector<unsigned int> remap(numVertices);
+    size_t newNumVertices = meshopt_optimizeVertexFetchRemap(
+        &remap[0], &indices[0], indices.size(), numVertices);
+    meshopt_remapIndexBuffer(&indices[0], &indices[0], indices.size(), &remap[0]);
+
+    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+    geom->setName(src.getName());
+    geom->setStateSet(const_cast<osg::StateSet*>(src.getStateSet()));
+    geom->setUseDisplayList(false); geom->setUseVertexBufferObjects(true);
+    geom->setVertexArray(remapArray(va, remap, newNumVertices));
+
+    osg::Geometry& s = const_cast<osg::Geometry&>(src);
+    if (s.getNormalArray())
+    {
+        geom->setNormalArray(remapArray(s.getNormalArray(), remap, newNumVertices));
+        geom->setNormalBinding(s.getNormalBinding());
+    }
+
+    if (s.getColorArray())
+    {
+        geom->setColorArray(remapArray(s.getColorArray(), remap, newNumVertices));
+        geom->setColorBinding(s.getColorBinding());
+    }
+
+    for (unsigned int u = 0; u < s.getNumTexCoordArrays(); ++u)
+    {
+        osg::Array* ta = s.getTexCoordArray(u);
+        if (ta) geom->setTexCoordArray(u, remapArray(ta, remap, newNumVertices));
+    }
+
+    for (unsigned int a = 0; a < s.getNumVertexAttribArrays(); ++a)
+    {
+        osg::Array* aa = s.getVertexAttribArray(a); if (!aa) continue;
+        geom->setVertexAttribArray(a, remapArray(aa, remap, newNumVertices));
+        geom->setVertexAttribBinding(a, s.getVertexAttribBinding(a));
+    }
+
+    if (newNumVertices < 65535)
+        geom->addPrimitiveSet(new osg::DrawElementsUShort(GL_TRIANGLES, indices.begin(), indices.end()));
+    else
+        geom->addPrimitiveSet(new osg::DrawElementsUInt(GL_TRIANGLES, indices.begin(), indices.end()));
+    return geom.release();
+}
+
+MeshLodGenerator::MeshLodGenerator()
+:   _reductionRatio(0.5f), _maxRelativeError(0.05f), _pixelErrorTolerance(1.0f),
+    _normalWeight(0.05f), _uvWeight(0.05f), _colorWeight(0.01f),
+    _maxLevels(4), _lockBorders(false), _optimizeForRendering(true) {}
+
+std::vector<MeshLodGenerator::Level> MeshLodGenerator::generate(osg::Geometry* geom)
+{
+    std::vector<Level> levels; LodSourceData data;
+    if (!geom || !prepareSourceData(*geom, data, _normalWeight, _uvWeight, _colorWeight))
+        return levels;
+
+    std::vector<unsigned int> current = data.indices, indices = current;
+    Level finest; finest.geometry = createLevelGeometry(*geom, indices, _optimizeForRendering);
+    finest.geometry->setUserValue("SimplifyError", 0.0f);
+    levels.push_back(finest);
+
+    // Each level is simplified from the previous one, and errors are accumulated
+    float accumulatedError = 0.0f;
+    for (int i = 1; i < _maxLevels; ++i)
+    {
+        size_t targetCount = (size_t)(current.size() / 3 * _reductionRatio) * 3;
+        float errorLimit = _maxRelativeError - accumulatedError, error = 0.0f;
+        if (targetCount < 3 || errorLimit <= 0.0f) break;
+
+        std::vector<unsigned int> result;
+        size_t count = simplifyIndices(data, current, result, targetCount,
+                                       errorLimit, _lockBorders, error);
+        if (count == 0 || count > current.size() * 0.95) break;  // not reduced under the error limit
+        accumulatedError += error; current.swap(result);
+
+        Level level; indices = current;
+        level.error = accumulatedError * data.scale;
+        level.ratio = (float)current.size() / (float)data.indices.size();
+        level.geometry = createLevelGeometry(*geom, indices, _optimizeForRendering);
+        level.geometry->setUserValue("SimplifyError", level.error);
+        levels.push_back(level);
+    }
+
+    for (size_t i = 0; i < levels.size(); ++i)
+        OSG_INFO << "[MeshLodGenerator] " << geom->getName() << ": Level " << i << ", Triangles = "
+                 << (size_t)(data.indices.size() * levels[i].ratio) / 3 << ", Error = "
+                 << levels[i].error << std::endl;
+    return levels;
+}
+
+float MeshLodGenerator::simplify(osg::Geometry& geom, float ratio)
+{
+    LodSourceData data;
+    if (!prepareSourceData(geom, data, _normalWeight, _uvWeight, _colorWeight)) return -1.0f;
+
+    std::vector<unsigned int> result; float error = 0.0f;
+    size_t targetCount = (size_t)(data.indices.size() / 3 * ratio) * 3;
+    if (simplifyIndices(data, data.indices, result, targetCount,
+                        _maxRelativeError, _lockBorders, error) == 0) return -1.0f;
+
+    osg::ref_ptr<osg::Geometry> simplified =
+        createLevelGeometry(geom, result, _optimizeForRendering);
+    geom.setVertexArray(simplified->getVertexArray());
+    geom.setNormalArray(simplified->getNormalArray());
+    geom.setNormalBinding(simplified->getNormalBinding());
+    geom.setColorArray(simplified->getColorArray());
+    geom.setColorBinding(simplified->getColorBinding());
+    for (unsigned int u = 0; u < geom.getNumTexCoordArrays(); ++u)
+        geom.setTexCoordArray(u, simplified->getTexCoordArray(u));
+    for (unsigned int a = 0; a < geom.getNumVertexAttribArrays(); ++a)
+    {
+        geom.setVertexAttribArray(a, simplified->getVertexAttribArray(a));
+        geom.setVertexAttribBinding(a, simplified->getVertexAttribBinding(a));
+    }
+    geom.removePrimitiveSet(0, geom.getNumPrimitiveSets());
+    geom.addPrimitiveSet(simplified->getPrimitiveSet(0));
+    geom.dirtyBound(); return error * data.scale;
+}
+
+void MeshLodGenerator::computeRanges(const std::vector<Level>& levels, float radius,
+                                     std::vector<std::pair<float, float>>& ranges) const
+{
+    // In PIXEL_SIZE_ON_SCREEN mode, LOD range value is roughly the projected radius in pixels,
+    // so error of a level is about (error * pixelSize / radius) pixels on screen
+    std::vector<float> maxPixelSizes(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        float error = levels[i].error;
+        maxPixelSizes[i] = (error > 0.0f) ? _pixelErrorTolerance * radius / error : FLT_MAX;
+        if (i > 0) maxPixelSizes[i] = osg::minimum(maxPixelSizes[i], maxPixelSizes[i - 1]);
+    }
+
+    ranges.resize(levels.size());
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        float minPixelSize = (i + 1 < levels.size()) ? maxPixelSizes[i + 1] : 0.0f;
+        ranges[i] = std::pair<float, float>(minPixelSize, maxPixelSizes[i]);
+    }
+}
+
+osg::LOD* MeshLodGenerator::createLOD(osg::Geometry* geom)
+{
+    std::vector<Level> levels = generate(geom);
+    if (levels.empty()) return NULL;
+
+#if OSG_VERSION_GREATER_THAN(3, 2, 3)
+    float radius = geom->getBoundingBox().radius();
+#else
+    float radius = geom->getBound().radius();
+#endif
+    std::vector<std::pair<float, float>> ranges;
+    computeRanges(levels, radius, ranges);
+
+    osg::ref_ptr<osg::LOD> lod = new osg::LOD;
+    lod->setRangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN);
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(levels[i].geometry.get());
+        lod->addChild(geode.get(), ranges[i].first, ranges[i].second);
+    }
+    return lod.release();
+}
+
+osg::PagedLOD* MeshLodGenerator::createPagedLOD(osg::Geometry* geom, const std::string& prefix,
+                                                const std::string& ext)
+{
+    std::vector<Level> levels = generate(geom);
+    if (levels.empty()) return NULL;
+
+#if OSG_VERSION_GREATER_THAN(3, 2, 3)
+    osg::BoundingBox bb = geom->getBoundingBox();
+#else
+    osg::BoundingBox bb = geom->getBound();
+#endif
+    std::vector<std::pair<float, float>> ranges;
+    computeRanges(levels, bb.radius(), ranges);
+
+    osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD;
+    plod->setRangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN);
+    plod->setCenterMode(osg::LOD::USER_DEFINED_CENTER);
+    plod->setCenter(bb.center()); plod->setRadius(bb.radius());
+    plod->setDatabasePath(osgDB::getFilePath(prefix));
+
+    // Coarsest level is kept in memory, and finer ones are paged in
+    size_t coarsest = levels.size() - 1;
+    osg::ref_ptr<osg::Geode> root = new osg::Geode;
+    root->addDrawable(levels[coarsest].geometry.get());
+    plod->addChild(root.get(), ranges[coarsest].first, ranges[coarsest].second);
+
+    unsigned int childIndex = 1;
+    for (int i = (int)coarsest - 1; i >= 0; --i, ++childIndex)
+    {
+        std::string fileName = prefix + "_L" + std::to_string(i) + "." + ext;
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(levels[i].geometry.get());
+        if (!osgDB::writeNodeFile(*geode, fileName))
+        {
+            OSG_WARN << "[MeshLodGenerator] Failed to write level file " << fileName << std::endl;
+            break;
+        }
+        plod->setFileName(childIndex, osgDB::getSimpleFileName(fileName));
+        plod->setRange(childIndex, ranges[i].first, ranges[i].second);
+    }
+    return plod.release();
+}
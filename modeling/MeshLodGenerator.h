@@ -0,0 +1,82 @@
+#ifndef MANA_MODELING_MESH_LOD_GENERATOR_HPP
+#define MANA_MODELING_MESH_LOD_GENERATOR_HPP
+
+#include <vector>
+#include <string>
+#include <osg/Geometry>
+#include <osg/PagedLOD>
+
+namespace osgVerse
+{
+    /** Generate a chain of simplified levels for each geometry with meshoptimizer, working on
+        index buffers directly so no halfedge structure is needed. Every level is reordered for
+        vertex cache, overdraw and vertex fetch, and carries the simplification error it has */
+    class MeshLodGenerator : public osg::Referenced
+    {
+    public:
+        MeshLodGenerator();
+
+        struct Level
+        {
+            osg::ref_ptr<osg::Geometry> geometry;
+            float error;   // absolute error in model units, accumulated from the finest level
+            float ratio;   // triangle count ratio compared with the finest level
+            Level() : error(0.0f), ratio(1.0f) {}
+        };
+
+        /// Max number of levels including the finest one (default: 4)
+        void setMaxLevels(int n) { _maxLevels = n; }
+        int getMaxLevels() const { return _maxLevels; }
+
+        /// Triangle ratio of each level compared with the previous one (default: 0.5)
+        void setReductionRatio(float r) { _reductionRatio = r; }
+        float getReductionRatio() const { return _reductionRatio; }
+
+        /// Max error relative to geometry extents; stop generating levels above it (default: 0.05)
+        void setMaxRelativeError(float e) { _maxRelativeError = e; }
+        float getMaxRelativeError() const { return _maxRelativeError; }
+
+        /// Weights of normal, texture coordinate and color in error metric, 0 to ignore one
+        void setAttributeWeights(float n, float uv, float c)
+        { _normalWeight = n; _uvWeight = uv; _colorWeight = c; }
+
+        /// Keep vertices on open borders, useful for tiles that must stay seamless (default: false)
+        void setLockBorders(bool b) { _lockBorders = b; }
+        bool getLockBorders() const { return _lockBorders; }
+
+        /// Reorder levels for vertex cache, overdraw and vertex fetch (default: true)
+        void setOptimizeForRendering(bool b) { _optimizeForRendering = b; }
+        bool getOptimizeForRendering() const { return _optimizeForRendering; }
+
+        /// Allowed screen-space error in pixels, used to compute LOD ranges (default: 1)
+        void setPixelErrorTolerance(float p) { _pixelErrorTolerance = p; }
+        float getPixelErrorTolerance() const { return _pixelErrorTolerance; }
+
+        /** Generate levels from finest to coarsest. Level 0 is an optimized copy of input.
+            Each geometry also has user value "SimplifyError" for its absolute error */
+        std::vector<Level> generate(osg::Geometry* geom);
+
+        /** Simplify a single geometry in place to given triangle ratio, returning absolute error,
+            or negative value if the geometry can't be handled */
+        float simplify(osg::Geometry& geom, float ratio);
+
+        /** Create an osg::LOD of all levels, using PIXEL_SIZE_ON_SCREEN ranges computed from
+            level errors and the pixel error tolerance */
+        osg::LOD* createLOD(osg::Geometry* geom);
+
+        /** Create an osg::PagedLOD whose coarsest level is kept inline and finer levels are written
+            to <prefix>_L<n>.<ext> files, using the same error-based ranges */
+        osg::PagedLOD* createPagedLOD(osg::Geometry* geom, const std::string& prefix,
+                                      const std::string& ext = "osgb");
+
+    protected:
+        void computeRanges(const std::vector<Level>& levels, float radius,
+                           std::vector<std::pair<float, float>>& ranges) const;
+
+        float _reductionRatio, _maxRelativeError, _pixelErrorTolerance;
+        float _normalWeight, _uvWeight, _colorWeight;
+        int _maxLevels; bool _lockBorders, _optimizeForRendering;
+    };
+}
+
+#endif
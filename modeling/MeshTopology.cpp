@@ -18,82 +18,237 @@ MeshTopology::~MeshTopology()
 
 pmp::SurfaceMesh* MeshTopology::generate(MeshCollector* collector)
 {
+    const std::vector<osg::Vec3>& vertices = collector->getVertices();
+    const std::vector<unsigned int>& indices = collector->getTriangles();
     if (_mesh != NULL) delete _mesh;
     _mesh = new pmp::SurfaceMesh;
 
-    pmp::VertexProperty<pmp::Normal> normals = _mesh->vertex_property<pmp::Normal>("v:normal");
-    pmp::VertexProperty<pmp::Color> colors = _mesh->vertex_property<pmp::Color>("v:color");
-    pmp::VertexProperty<pmp::TexCoord> texcoords = _mesh->vertex_property<pmp::TexCoord>("v:tex");
+    int numVertices = (int)vertices.size();
+    if (buildConnectivity(vertices.size(), indices))
+    {
+        std::vector<pmp::Point>& points = _mesh->positions();
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < numVertices; ++i)
+        { const osg::Vec3& v = vertices[i]; points[i] = pmp::Point(v[0], v[1], v[2]); }
+    }
+    else
+    {
+        // Non-manifold input: add faces one by one and skip those pmp can't accept
+        OSG_INFO << "[MeshTopology] Non-manifold input, adding faces one by one" << std::endl;
+        delete _mesh; _mesh = new pmp::SurfaceMesh;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const osg::Vec3& v = vertices[i];
+            _mesh->add_vertex(pmp::Point(v[0], v[1], v[2]));
+        }
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            std::vector<pmp::Vertex> face;
+            face.push_back(pmp::Vertex(indices[i + 0]));
+            face.push_back(pmp::Vertex(indices[i + 1]));
+            face.push_back(pmp::Vertex(indices[i + 2]));
+
+            try { _mesh->add_face(face); }
+            catch (pmp::TopologyException& e)
+            { OSG_WARN << "[MeshTopology] " << e.what() << std::endl; }
+        }
+    }
 
+    if (numVertices == 0) return _mesh;
     std::vector<osg::Vec4>& na = collector->getAttributes(MeshCollector::NormalAttr);
     std::vector<osg::Vec4>& ca = collector->getAttributes(MeshCollector::ColorAttr);
     std::vector<osg::Vec4>& ta = collector->getAttributes(MeshCollector::UvAttr);
-    if (na.empty()) _mesh->remove_vertex_property(normals);
-    if (ca.empty()) _mesh->remove_vertex_property(colors);
-    if (ta.empty()) _mesh->remove_vertex_property(texcoords);
-
-    const std::vector<osg::Vec3>& vertices = collector->getVertices();
     bool withNormals = (na.size() >= vertices.size());
     bool withColors = (ca.size() >= vertices.size());
     bool withUVs = (ta.size() >= vertices.size());
-    for (size_t i = 0; i < vertices.size(); ++i)
-    {
-        const osg::Vec3& v = vertices[i];
-        pmp::Vertex vec = _mesh->add_vertex(pmp::Point(v[0], v[1], v[2]));
-        if (withNormals) normals[vec] = pmp::Normal(na[i][0], na[i][1], na[i][2]);
-        if (withColors) colors[vec] = pmp::Color(ca[i][0], ca[i][1], ca[i][2]);
-        if (withUVs) texcoords[vec] = pmp::TexCoord(ta[i][0], ta[i][1]);
-    }
 
-    const std::vector<unsigned int>& indices = collector->getTriangles();
-    for (size_t i = 0; i < indices.size(); i += 3)
+    pmp::Normal* normals = NULL; pmp::Color* colors = NULL; pmp::TexCoord* texcoords = NULL;
+    if (!na.empty()) normals = &(_mesh->vertex_property<pmp::Normal>("v:normal").vector()[0]);
+    if (!ca.empty()) colors = &(_mesh->vertex_property<pmp::Color>("v:color").vector()[0]);
+    if (!ta.empty()) texcoords = &(_mesh->vertex_property<pmp::TexCoord>("v:tex").vector()[0]);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < numVertices; ++i)
     {
-        std::vector<pmp::Vertex> face;
-        face.push_back(pmp::Vertex(indices[i + 0]));
-        face.push_back(pmp::Vertex(indices[i + 1]));
-        face.push_back(pmp::Vertex(indices[i + 2]));
-
-        try { _mesh->add_face(face); }
-        catch (pmp::TopologyException& e)
-        { OSG_WARN << "[MeshTopology] " << e.what() << std::endl; }
+        if (withNormals && normals) normals[i] = pmp::Normal(na[i][0], na[i][1], na[i][2]);
+        if (withColors && colors) colors[i] = pmp::Color(ca[i][0], ca[i][1], ca[i][2]);
+        if (withUVs && texcoords) texcoords[i] = pmp::TexCoord(ta[i][0], ta[i][1]);
     }
     return _mesh;
 }
 
-osg::Geometry* MeshTopology::output(int eID)
+bool MeshTopology::buildConnectivity(size_t numVertices, const std::vector<unsigned int>& indices)
 {
-    if (!_mesh) return NULL;
-    pmp::VertexProperty<pmp::Point> points = _mesh->get_vertex_property<pmp::Point>("v:point");
-    pmp::VertexProperty<pmp::Normal> normals = _mesh->get_vertex_property<pmp::Normal>("v:normal");
-    pmp::VertexProperty<pmp::Color> colors = _mesh->get_vertex_property<pmp::Color>("v:color");
-    pmp::VertexProperty<pmp::TexCoord> texcoords = _mesh->get_vertex_property<pmp::TexCoord>("v:tex");
+    // Collect valid triangles and sort their corners by the smaller vertex of each corner's edge
+    std::vector<pmp::IndexType> triangles; triangles.reserve(indices.size());
+    size_t numSkipped = 0;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        pmp::IndexType a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        if (a >= numVertices || b >= numVertices || c >= numVertices ||
+            a == b || b == c || a == c) { numSkipped++; continue; }
+        triangles.push_back(a); triangles.push_back(b); triangles.push_back(c);
+    }
+    if (numSkipped > 0)
+        OSG_NOTICE << "[MeshTopology] " << numSkipped << " degenerated faces skipped" << std::endl;
 
-    osg::ref_ptr<osg::Vec3Array> va = (points) ? new osg::Vec3Array : NULL;
-    osg::ref_ptr<osg::Vec3Array> na = (normals) ? new osg::Vec3Array : NULL;
-    osg::ref_ptr<osg::Vec4Array> ca = (colors) ? new osg::Vec4Array : NULL;
-    osg::ref_ptr<osg::Vec2Array> ta = (texcoords) ? new osg::Vec2Array : NULL;
-    if (!va) return NULL;
+    int numCorners = (int)triangles.size(), numV = (int)numVertices;
+    if (triangles.empty())
+    {
+        for (size_t v = 0; v < numVertices; ++v) _mesh->new_vertex();
+        return true;
+    }
+#define CORNER_FROM(c) triangles[c]
+#define CORNER_TO(c) triangles[((c) % 3 == 2) ? (c) - 2 : (c) + 1]
+    std::vector<pmp::IndexType> offsets(numVertices + 1, 0), corners(numCorners);
+    for (int c = 0; c < numCorners; ++c)
+        offsets[osg::minimum(CORNER_FROM(c), CORNER_TO(c)) + 1]++;
+    for (size_t v = 0; v < numVertices; ++v) offsets[v + 1] += offsets[v];
+    {
+        std::vector<pmp::IndexType> cursors(offsets.begin(), offsets.end() - 1);
+        for (int c = 0; c < numCorners; ++c)
+            corners[cursors[osg::minimum(CORNER_FROM(c), CORNER_TO(c))]++] = c;
+    }
 
-    std::vector<pmp::Point>& pts = points.vector();
-    for (size_t i = 0; i < pts.size(); ++i)
+    // Pair corners of the same edge in each bucket: one corner is a boundary edge, two opposite
+    // corners share an interior edge, and others are non-manifold
+    std::vector<pmp::IndexType> edgeOffsets(numVertices + 1, 0);
+    int numFailed = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:numFailed)
+    for (int v = 0; v < numV; ++v)
     {
-        const pmp::Point& pt = pts[i]; pmp::Vertex v(i);
-        va->push_back(osg::Vec3(pt[0], pt[1], pt[2]));
-        if (normals)
+        pmp::IndexType* begin = corners.data() + offsets[v], *end = corners.data() + offsets[v + 1];
+        std::sort(begin, end, [&triangles](pmp::IndexType c0, pmp::IndexType c1)
+                  { return osg::maximum(CORNER_FROM(c0), CORNER_TO(c0)) <
+                           osg::maximum(CORNER_FROM(c1), CORNER_TO(c1)); });
+        for (pmp::IndexType* ptr = begin; ptr < end; ++edgeOffsets[v + 1])
         {
-            const pmp::Normal& n = normals[v];
-            na->push_back(osg::Vec3(n[0], n[1], n[2]));
+            pmp::IndexType c0 = *ptr, other = osg::maximum(CORNER_FROM(c0), CORNER_TO(c0));
+            if (ptr + 1 < end && osg::maximum(CORNER_FROM(*(ptr + 1)), CORNER_TO(*(ptr + 1))) == other)
+            {
+                pmp::IndexType c1 = *(ptr + 1);
+                if (CORNER_FROM(c0) == CORNER_FROM(c1)) numFailed++;  // inconsistent orientation
+                if (ptr + 2 < end && osg::maximum(CORNER_FROM(*(ptr + 2)), CORNER_TO(*(ptr + 2))) == other)
+                    numFailed++;  // more than 2 faces at one edge
+                ptr += 2;
+            }
+            else ptr++;
         }
-        if (colors)
+    }
+    if (numFailed > 0) return false;
+    for (size_t v = 0; v < numVertices; ++v) edgeOffsets[v + 1] += edgeOffsets[v];
+
+    // Assign halfedges to corners; the twin of a single corner is a boundary halfedge
+    std::vector<pmp::IndexType> cornerHalfedges(numCorners), boundaryCorners;
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int v = 0; v < numV; ++v)
+    {
+        pmp::IndexType* begin = corners.data() + offsets[v], *end = corners.data() + offsets[v + 1];
+        pmp::IndexType e = edgeOffsets[v];
+        for (pmp::IndexType* ptr = begin; ptr < end; ++e)
         {
-            const pmp::Color& c = colors[v];
-            ca->push_back(osg::Vec4(c[0], c[1], c[2], 1.0f));
+            pmp::IndexType c0 = *ptr, other = osg::maximum(CORNER_FROM(c0), CORNER_TO(c0));
+            cornerHalfedges[c0] = 2 * e;
+            if (ptr + 1 < end && osg::maximum(CORNER_FROM(*(ptr + 1)), CORNER_TO(*(ptr + 1))) == other)
+            { cornerHalfedges[*(ptr + 1)] = 2 * e + 1; ptr += 2; }
+            else ptr++;
         }
-        if (texcoords)
+    }
+
+    std::vector<pmp::IndexType> boundaryOut(numVertices, PMP_MAX_INDEX), valences(numVertices, 0);
+    std::vector<pmp::IndexType> edgeCorners(edgeOffsets.back(), PMP_MAX_INDEX);
+    for (int c = 0; c < numCorners; ++c)
+    {
+        pmp::IndexType e = cornerHalfedges[c] / 2; valences[CORNER_FROM(c)]++;
+        edgeCorners[e] = (edgeCorners[e] == PMP_MAX_INDEX) ? c : numCorners;
+    }
+    for (size_t e = 0; e < edgeCorners.size(); ++e)
+    {
+        pmp::IndexType c = edgeCorners[e]; if (c == (pmp::IndexType)numCorners) continue;
+        pmp::IndexType& out = boundaryOut[CORNER_TO(c)];
+        if (out != PMP_MAX_INDEX) return false;  // non-manifold vertex with 2 boundary loops
+        out = cornerHalfedges[c] ^ 1; boundaryCorners.push_back(c);
+    }
+
+    // Allocate and link all elements
+    int numFaces = numCorners / 3;
+    _mesh->reserve(numVertices, edgeCorners.size(), numFaces);
+    for (size_t v = 0; v < numVertices; ++v) _mesh->new_vertex();
+    for (size_t e = 0; e < edgeCorners.size(); ++e) _mesh->new_edge();
+    for (int f = 0; f < numFaces; ++f) _mesh->new_face();
+
+#pragma omp parallel for schedule(static)
+    for (int f = 0; f < numFaces; ++f)
+    {
+        pmp::Face face(f);
+        for (int k = 0; k < 3; ++k)
         {
-            const pmp::TexCoord& t = texcoords[v];
-            ta->push_back(osg::Vec2(t[0], t[1]));
+            int c = 3 * f + k, cNext = 3 * f + (k + 1) % 3;
+            pmp::Halfedge h(cornerHalfedges[c]);
+            _mesh->set_vertex(h, pmp::Vertex(CORNER_TO(c)));
+            _mesh->set_face(h, face);
+            _mesh->set_next_halfedge(h, pmp::Halfedge(cornerHalfedges[cNext]));
         }
+        _mesh->set_halfedge(face, pmp::Halfedge(cornerHalfedges[3 * f + 2]));  // same as add_face()
+    }
+
+    for (int c = 0; c < numCorners; ++c)
+        _mesh->set_halfedge(pmp::Vertex(CORNER_FROM(c)), pmp::Halfedge(cornerHalfedges[c]));
+    for (size_t i = 0; i < boundaryCorners.size(); ++i)
+    {
+        pmp::IndexType c = boundaryCorners[i];
+        pmp::Halfedge hb(cornerHalfedges[c] ^ 1);
+        _mesh->set_vertex(hb, pmp::Vertex(CORNER_FROM(c)));
+        _mesh->set_next_halfedge(hb, pmp::Halfedge(boundaryOut[CORNER_FROM(c)]));
+        _mesh->set_halfedge(pmp::Vertex(CORNER_TO(c)), hb);
+    }
+#undef CORNER_FROM
+#undef CORNER_TO
+
+    // Check that faces around each vertex form a single fan, as add_face() requires
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:numFailed)
+    for (int v = 0; v < numV; ++v)
+    {
+        if (valences[v] == 0) continue;
+        pmp::Halfedge h0 = _mesh->halfedge(pmp::Vertex(v)), h = h0;
+        pmp::IndexType numVisited = 0, numSteps = 0;
+        do
+        {
+            if (_mesh->face(h).is_valid()) numVisited++;
+            h = _mesh->cw_rotated_halfedge(h);
+        } while (h != h0 && ++numSteps <= valences[v]);
+        if (numVisited != valences[v]) numFailed++;
+    }
+    return numFailed == 0;
+}
+
+osg::Geometry* MeshTopology::output(int eID)
+{
+    if (!_mesh) return NULL;
+    pmp::VertexProperty<pmp::Point> points = _mesh->get_vertex_property<pmp::Point>("v:point");
+    pmp::VertexProperty<pmp::Normal> normals = _mesh->get_vertex_property<pmp::Normal>("v:normal");
+    pmp::VertexProperty<pmp::Color> colors = _mesh->get_vertex_property<pmp::Color>("v:color");
+    pmp::VertexProperty<pmp::TexCoord> texcoords = _mesh->get_vertex_property<pmp::TexCoord>("v:tex");
+    if (!points) return NULL;
+
+    // Write to preallocated arrays directly
+    int numVertices = (int)points.vector().size();
+    osg::ref_ptr<osg::Vec3Array> va = new osg::Vec3Array(numVertices);
+    osg::ref_ptr<osg::Vec3Array> na = (normals) ? new osg::Vec3Array(numVertices) : NULL;
+    osg::ref_ptr<osg::Vec4Array> ca = (colors) ? new osg::Vec4Array(numVertices) : NULL;
+    osg::ref_ptr<osg::Vec2Array> ta = (texcoords) ? new osg::Vec2Array(numVertices) : NULL;
+    const pmp::Point* pts = points.data();
+    const pmp::Normal* nPtr = normals ? normals.data() : NULL;
+    const pmp::Color* cPtr = colors ? colors.data() : NULL;
+    const pmp::TexCoord* tPtr = texcoords ? texcoords.data() : NULL;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < numVertices; ++i)
+    {
+        const pmp::Point& pt = pts[i];
+        (*va)[i] = osg::Vec3(pt[0], pt[1], pt[2]);
+        if (nPtr) (*na)[i] = osg::Vec3(nPtr[i][0], nPtr[i][1], nPtr[i][2]);
+        if (cPtr) (*ca)[i] = osg::Vec4(cPtr[i][0], cPtr[i][1], cPtr[i][2], 1.0f);
+        if (tPtr) (*ta)[i] = osg::Vec2(tPtr[i][0], tPtr[i][1]);
     }
 
     osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
@@ -133,7 +288,24 @@ void MeshTopology::processGeometryFaces(osg::Geometry* geom, const std::vector<u
             for (size_t t = 0; t < vList.size(); ++t) de->push_back(vList[t]);
         }
     }
-    else
+    else if (_mesh->n_faces() == _mesh->faces_size())
+    {
+        // No deleted faces: write triangles to the preallocated array in parallel,
+        // or fall back to the loop below if any polygon is found
+        int numFaces = (int)_mesh->faces_size(), numPolygons = 0;
+        de->resize(numFaces * 3);
+#pragma omp parallel for schedule(static) reduction(+:numPolygons)
+        for (int f = 0; f < numFaces; ++f)
+        {
+            pmp::Halfedge h0 = _mesh->halfedge(pmp::Face(f)), h = h0;
+            for (int k = 0; k < 3; ++k)
+            { (*de)[3 * f + k] = _mesh->to_vertex(h).idx(); h = _mesh->next_halfedge(h); }
+            if (h != h0) numPolygons++;
+        }
+        if (numPolygons > 0) de->clear();
+    }
+
+    if (faces.empty() && de->empty())
     {
         pmp::SurfaceMesh::FaceContainer faces2 = _mesh->faces();
         for (auto f : faces2)
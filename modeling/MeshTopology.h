@@ -85,6 +85,10 @@ namespace osgVerse
     protected:
         virtual ~MeshTopology();
 
+        /** Build halfedge connectivity of an empty mesh from indexed triangles in bulk.
+            Return false for non-manifold input, which should then be added face by face */
+        bool buildConnectivity(size_t numVertices, const std::vector<unsigned int>& indices);
+
         bool findConnectedEdges(
             uint32_t he, std::vector<uint32_t>& subEdges, std::set<uint32_t>& usedEdges) const;
         void addNeighborFaces(std::set<uint32_t>& faceSet, uint32_t f) const;
@@ -0,0 +1,293 @@
+#include <osg/io_utils>
+#include <osg/Vec3i>
+#include <osg/ValueObject>
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <marl/scheduler.h>
+#include <marl/waitgroup.h>
+#include "PhysicsProxyBuilder.h"
+#include "Utilities.h"
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+using namespace osgVerse;
+
+PhysicsProxyBuilder::PhysicsProxyBuilder()
+:   _numFinished(0), _numTotal(0), _running(false), _started(false), _cancelled(false),
+    _chunkMode(BY_CHILD_NODE), _cellSize(0.0f), _vhacdError(0.0f), _obbExtent(0.1f),
+    _proxyType(ALL_PROXIES), _numThreads(0), _vhacdResolution(10000), _vhacdMaxHulls(8),
+    _obbSamples(500), _vhacdBestPlane(false), _vhacdShrinkWrap(true) {}
+
+PhysicsProxyBuilder::~PhysicsProxyBuilder()
+{
+    cancel(); if (_thread.joinable()) _thread.join();
+}
+
+void PhysicsProxyBuilder::setVHACDParameters(bool findBestPlane, bool shrinkWrap, int resolution,
+                                             int maxConvexHulls, float maxError)
+{
+    _vhacdBestPlane = findBestPlane; _vhacdShrinkWrap = shrinkWrap;
+    _vhacdResolution = resolution; _vhacdMaxHulls = maxConvexHulls; _vhacdError = maxError;
+}
+
+bool PhysicsProxyBuilder::start(osg::Node* scene)
+{
+    if (_running || !scene) return false;
+    if (_thread.joinable()) _thread.join();
+    _collectors.clear(); _results.clear();
+    _numFinished = 0; _numTotal = 0;
+
+    // Children of a transform root still need its own matrix to be in root coordinates
+    osg::Matrix rootMatrix; osg::Group* root = scene->asGroup();
+    if (scene->asTransform()) scene->asTransform()->computeLocalToWorldMatrix(rootMatrix, NULL);
+
+    std::vector<osg::Node*> chunkNodes;
+    if (_chunkMode == BY_CHILD_NODE && root && root->getNumChildren() > 0)
+    {
+        for (unsigned int i = 0; i < root->getNumChildren(); ++i)
+            chunkNodes.push_back(root->getChild(i));
+    }
+    else
+        chunkNodes.push_back(scene);
+
+    // Traversing only records geometries; they are transformed and welded later in background
+    for (size_t i = 0; i < chunkNodes.size(); ++i)
+    {
+        osg::ref_ptr<BoundingVolumeVisitor> bvv = new BoundingVolumeVisitor;
+        bvv->setWeldingVertices(true); bvv->setOnlyVertexAndIndices(true);
+        if (chunkNodes[i] != scene) bvv->pushMatrix(rootMatrix);
+        chunkNodes[i]->accept(*bvv); _collectors.push_back(bvv);
+
+        Chunk chunk; if (_chunkMode == BY_CHILD_NODE) chunk.node = chunkNodes[i];
+        _results.push_back(chunk);
+    }
+
+    if (!_cacheDirectory.empty() && !osgDB::fileExists(_cacheDirectory))
+    {
+        if (!osgDB::makeDirectory(_cacheDirectory))
+            OSG_WARN << "[PhysicsProxyBuilder] Failed to create cache directory "
+                     << _cacheDirectory << std::endl;
+    }
+
+    _cancelled = false; _started = true; _running = true;
+    _thread = std::thread(&PhysicsProxyBuilder::run, this);
+    return true;
+}
+
+void PhysicsProxyBuilder::wait()
+{
+    if (_thread.joinable()) _thread.join();
+}
+
+float PhysicsProxyBuilder::getProgress() const
+{
+    size_t total = _numTotal;
+    if (total == 0) return _running ? 0.0f : 1.0f;
+    return (float)_numFinished / (float)total;
+}
+
+void PhysicsProxyBuilder::run()
+{
+    if (_chunkMode == BY_SPATIAL_CELL) splitIntoCells();
+    size_t numChunks = _collectors.size(); _numTotal = numChunks;
+
+    // Collecting uses OpenMP, which should not start its thread team inside marl fibers
+    for (size_t i = 0; i < numChunks && !_cancelled; ++i)
+        _collectors[i]->collectPendingGeometries();
+
+    marl::Scheduler::Config config = marl::Scheduler::Config::allCores();
+    if (_numThreads > 0) config.setWorkerThreadCount(_numThreads);
+    config.setFiberStackSize(4 * 1024 * 1024);  // VHACD recursion needs more than the default
+
+    marl::Scheduler scheduler(config); scheduler.bind();
+    {
+        marl::WaitGroup waitGroup((unsigned int)numChunks);
+        for (size_t i = 0; i < numChunks; ++i)
+        {
+            marl::schedule([this, i, waitGroup]()
+            {
+                if (!_cancelled) processChunk(i);
+                waitGroup.done();
+            });
+        }
+        waitGroup.wait();
+    }
+    marl::Scheduler::unbind();
+
+    // Remove chunks without any proxies, including cancelled ones
+    std::vector<Chunk> results;
+    for (size_t i = 0; i < _results.size(); ++i)
+    {
+        const Chunk& chunk = _results[i];
+        if (chunk.convexHulls.valid() || chunk.obb.valid()) results.push_back(chunk);
+    }
+    _results.swap(results); _collectors.clear();
+    if (_cancelled)
+        OSG_NOTICE << "[PhysicsProxyBuilder] Cancelled after " << _numFinished << " of "
+                   << numChunks << " chunks" << std::endl;
+    _running = false;
+}
+
+void PhysicsProxyBuilder::splitIntoCells()
+{
+    if (_collectors.empty()) return;
+    osg::ref_ptr<BoundingVolumeVisitor> source = _collectors[0];
+    const std::vector<osg::Vec3>& vertices = source->getVertices();
+    const std::vector<unsigned int>& indices = source->getTriangles();
+    _collectors.clear(); _results.clear();
+    if (vertices.empty() || indices.size() < 3) return;
+
+    osg::BoundingBox bound;
+    for (size_t i = 0; i < vertices.size(); ++i) bound.expandBy(vertices[i]);
+    float cellSize = _cellSize;
+    if (cellSize <= 0.0f)
+    {
+        osg::Vec3 extent = bound._max - bound._min;
+        cellSize = osg::maximum(extent[0], osg::maximum(extent[1], extent[2])) * 0.25f;
+        if (cellSize <= 0.0f) cellSize = 1.0f;
+    }
+
+    // Assign each triangle to the cell containing its centroid
+    typedef std::map<osg::Vec3i, std::vector<unsigned int>> CellMap; CellMap cells;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        osg::Vec3 center = (vertices[indices[i]] + vertices[indices[i + 1]]
+                         + vertices[indices[i + 2]]) / 3.0f - bound._min;
+        osg::Vec3i key((int)floor(center[0] / cellSize), (int)floor(center[1] / cellSize),
+                       (int)floor(center[2] / cellSize));
+        std::vector<unsigned int>& triangles = cells[key];
+        triangles.push_back(indices[i]); triangles.push_back(indices[i + 1]);
+        triangles.push_back(indices[i + 2]);
+    }
+
+    // Remap global indices to local ones of each cell
+    std::vector<int> localIndices(vertices.size(), -1);
+    for (CellMap::iterator itr = cells.begin(); itr != cells.end(); ++itr)
+    {
+        std::vector<osg::Vec3> cellVertices; std::vector<unsigned int> globalIndices;
+        std::vector<unsigned int>& cellIndices = itr->second;
+        for (size_t i = 0; i < cellIndices.size(); ++i)
+        {
+            unsigned int index = cellIndices[i];
+            if (localIndices[index] < 0)
+            {
+                localIndices[index] = (int)cellVertices.size(); globalIndices.push_back(index);
+                cellVertices.push_back(vertices[index]);
+            }
+            cellIndices[i] = (unsigned int)localIndices[index];
+        }
+
+        osg::ref_ptr<BoundingVolumeVisitor> bvv = new BoundingVolumeVisitor;
+        bvv->setMesh(cellVertices, cellIndices); _collectors.push_back(bvv);
+        _results.push_back(Chunk());
+        for (size_t i = 0; i < globalIndices.size(); ++i) localIndices[globalIndices[i]] = -1;
+    }
+    OSG_INFO << "[PhysicsProxyBuilder] Split " << indices.size() / 3 << " triangles into "
+             << cells.size() << " cells of size " << cellSize << std::endl;
+}
+
+void PhysicsProxyBuilder::processChunk(size_t index)
+{
+    BoundingVolumeVisitor* bvv = _collectors[index].get();
+    const std::vector<osg::Vec3>& vertices = bvv->getVertices();
+    const std::vector<unsigned int>& indices = bvv->getTriangles();
+
+    Chunk& chunk = _results[index];
+    if (!vertices.empty() && indices.size() > 2)
+    {
+        for (size_t i = 0; i < vertices.size(); ++i) chunk.bound.expandBy(vertices[i]);
+        chunk.hash = computeHash(vertices, indices);
+        chunk.fromCache = readCache(chunk);
+        if (!chunk.fromCache)
+        {
+            if (_proxyType & CONVEX_HULLS)
+                chunk.convexHulls = bvv->computeVHACD(_vhacdBestPlane, _vhacdShrinkWrap, _vhacdResolution,
+                                                      _vhacdMaxHulls, _vhacdError, false);
+            if (_proxyType & ORIENTED_BOX)
+                chunk.obb = bvv->computeOBB(chunk.obbRotation, _obbExtent, _obbSamples);
+            writeCache(chunk);
+        }
+    }
+
+    _collectors[index] = NULL;  // release collected mesh as early as possible
+    size_t numFinished = ++_numFinished;
+    if (_callback.valid()) _callback->chunkFinished(this, chunk, numFinished, _numTotal);
+}
+
+std::string PhysicsProxyBuilder::computeHash(const std::vector<osg::Vec3>& vertices,
+                                             const std::vector<unsigned int>& indices) const
+{
+    int params[5] = { _proxyType, _vhacdResolution, _vhacdMaxHulls, _obbSamples,
+                      (_vhacdBestPlane ? 1 : 0) + (_vhacdShrinkWrap ? 2 : 0) };
+    float paramsF[2] = { _vhacdError, _obbExtent };
+
+    XXH64_state_t* state = XXH64_createState(); XXH64_reset(state, 0);
+    XXH64_update(state, vertices.data(), vertices.size() * sizeof(osg::Vec3));
+    XXH64_update(state, indices.data(), indices.size() * sizeof(unsigned int));
+    XXH64_update(state, params, sizeof(params));
+    XXH64_update(state, paramsF, sizeof(paramsF));
+    unsigned long long hash = (unsigned long long)XXH64_digest(state);
+    XXH64_freeState(state);
+
+    char buffer[20]; snprintf(buffer, 20, "%016llx", hash);
+    return std::string(buffer);
+}
+
+bool PhysicsProxyBuilder::readCache(Chunk& chunk) const
+{
+    if (_cacheDirectory.empty() || chunk.hash.empty()) return false;
+    std::string file = _cacheDirectory + "/" + chunk.hash + ".osgb";
+    if (!osgDB::fileExists(file)) return false;
+
+    osg::ref_ptr<osg::Group> group = dynamic_cast<osg::Group*>(osgDB::readNodeFile(file));
+    if (!group) return false;
+
+    osg::Geometry* hulls = NULL;
+    osg::Geode* geode = group->getNumChildren() > 0 ? group->getChild(0)->asGeode() : NULL;
+    if (geode && geode->getNumDrawables() > 0) hulls = geode->getDrawable(0)->asGeometry();
+    if ((_proxyType & CONVEX_HULLS) && !hulls)
+    {
+        // VHACD may find no hulls for a chunk, which is recorded so as not to compute it again
+        bool noHulls = false;
+        if (!group->getUserValue("NoConvexHulls", noHulls) || !noHulls) return false;
+    }
+
+    osg::Vec3 obbMin, obbMax; osg::Vec4 obbRotation;
+    if (_proxyType & ORIENTED_BOX)
+    {
+        if (!group->getUserValue("ObbMin", obbMin) || !group->getUserValue("ObbMax", obbMax) ||
+            !group->getUserValue("ObbRotation", obbRotation)) return false;
+        chunk.obb.set(obbMin, obbMax); chunk.obbRotation.set(obbRotation);
+    }
+    if (hulls) { chunk.convexHulls = hulls; geode->removeDrawables(0, geode->getNumDrawables()); }
+    return true;
+}
+
+void PhysicsProxyBuilder::writeCache(const Chunk& chunk) const
+{
+    if (_cacheDirectory.empty() || chunk.hash.empty()) return;
+    osg::ref_ptr<osg::Group> group = new osg::Group;
+    if ((_proxyType & CONVEX_HULLS) && !chunk.convexHulls)
+        group->setUserValue("NoConvexHulls", true);
+    if (_proxyType & ORIENTED_BOX)
+    {
+        group->setUserValue("ObbMin", chunk.obb._min);
+        group->setUserValue("ObbMax", chunk.obb._max);
+        group->setUserValue("ObbRotation", chunk.obbRotation.asVec4());
+    }
+
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    if (chunk.convexHulls.valid()) geode->addDrawable(chunk.convexHulls.get());
+    group->addChild(geode.get());
+
+    std::string file = _cacheDirectory + "/" + chunk.hash + ".osgb";
+    if (!osgDB::writeNodeFile(*group, file))
+        OSG_WARN << "[PhysicsProxyBuilder] Failed to write cache " << file << std::endl;
+    geode->removeDrawables(0, geode->getNumDrawables());  // don't keep hulls parented to cache
+}
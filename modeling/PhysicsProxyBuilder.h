@@ -0,0 +1,122 @@
+#ifndef MANA_MODELING_PHYSICS_PROXY_BUILDER_HPP
+#define MANA_MODELING_PHYSICS_PROXY_BUILDER_HPP
+
+#include <osg/Geometry>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+
+namespace osgVerse
+{
+    class BoundingVolumeVisitor;
+
+    /** Compute physics proxies (VHACD convex hulls and approximate OBBs) of a scene in background.
+        The scene is split into chunks by child nodes or by spatial cells, which are processed on a
+        marl thread pool. Results can be cached on disk, keyed by a hash of chunk geometry and
+        parameters, so they are not recomputed next time. Typical use at load time:
+          - start() after the scene is loaded, and keep rendering
+          - check isFinished() every frame, then create PhysicsEngine shapes from getResults()
+        Geometries of the scene should not be modified before finished */
+    class PhysicsProxyBuilder : public osg::Referenced
+    {
+    public:
+        PhysicsProxyBuilder();
+
+        enum ChunkMode { BY_CHILD_NODE, BY_SPATIAL_CELL };
+        enum ProxyType { CONVEX_HULLS = 1, ORIENTED_BOX = 2, ALL_PROXIES = 3 };
+
+        struct Chunk
+        {
+            osg::ref_ptr<osg::Node> node;  // child node of BY_CHILD_NODE mode, NULL for cells
+            osg::ref_ptr<osg::Geometry> convexHulls;  // in coordinates of the scene root
+            osg::BoundingBox obb; osg::Quat obbRotation;  // same as BoundingVolumeVisitor::computeOBB()
+            osg::BoundingBox bound;
+            std::string hash; bool fromCache;
+            Chunk() : fromCache(false) {}
+        };
+
+        /** Called from worker threads when a chunk is done, so it must be thread-safe */
+        class Callback : public osg::Referenced
+        {
+        public:
+            virtual void chunkFinished(PhysicsProxyBuilder* builder, const Chunk& chunk,
+                                       size_t numFinished, size_t numTotal) {}
+        };
+
+        /// How to split the scene into chunks (default: BY_CHILD_NODE)
+        void setChunkMode(ChunkMode m) { _chunkMode = m; }
+        ChunkMode getChunkMode() const { return _chunkMode; }
+
+        /// Cell size of BY_SPATIAL_CELL mode, 0 to split scene bound into 4x4x4 cells (default: 0)
+        void setCellSize(float s) { _cellSize = s; }
+        float getCellSize() const { return _cellSize; }
+
+        /// Proxies to compute (default: ALL_PROXIES)
+        void setProxyType(int t) { _proxyType = t; }
+        int getProxyType() const { return _proxyType; }
+
+        /// Number of worker threads, 0 to use all cores (default: 0)
+        void setNumThreads(int n) { _numThreads = n; }
+        int getNumThreads() const { return _numThreads; }
+
+        /// Directory to cache results, empty to disable caching (default: empty)
+        void setCacheDirectory(const std::string& dir) { _cacheDirectory = dir; }
+        const std::string& getCacheDirectory() const { return _cacheDirectory; }
+
+        /// Parameters of BoundingVolumeVisitor::computeVHACD()
+        void setVHACDParameters(bool findBestPlane, bool shrinkWrap, int resolution,
+                                int maxConvexHulls, float maxError);
+
+        /// Parameters of BoundingVolumeVisitor::computeOBB()
+        void setOBBParameters(float relativeExtent, int numSamples)
+        { _obbExtent = relativeExtent; _obbSamples = numSamples; }
+
+        void setCallback(Callback* cb) { _callback = cb; }
+        Callback* getCallback() { return _callback.get(); }
+
+        /** Start computing proxies of the scene in background, returning false if still running.
+            Child nodes are traversed at once on caller thread; meshes are collected on the
+            background thread, and proxies of each chunk are computed by worker threads */
+        bool start(osg::Node* scene);
+
+        /** Stop scheduling remained chunks; chunks in progress will still be finished */
+        void cancel() { _cancelled = true; }
+
+        /** Block until all chunks are finished or cancelled */
+        void wait();
+
+        bool isRunning() const { return _running; }
+        bool isFinished() const { return !_running && _started; }
+        float getProgress() const;
+
+        /** Get results, only available when finished. Empty chunks are removed */
+        std::vector<Chunk>& getResults() { return _results; }
+
+    protected:
+        virtual ~PhysicsProxyBuilder();
+
+        void run();
+        void splitIntoCells();
+        void processChunk(size_t index);
+        std::string computeHash(const std::vector<osg::Vec3>& vertices,
+                                const std::vector<unsigned int>& indices) const;
+        bool readCache(Chunk& chunk) const;
+        void writeCache(const Chunk& chunk) const;
+
+        std::vector<osg::ref_ptr<BoundingVolumeVisitor>> _collectors;
+        std::vector<Chunk> _results;
+        osg::ref_ptr<Callback> _callback;
+        std::thread _thread;
+        std::atomic<size_t> _numFinished, _numTotal;
+        std::atomic<bool> _running, _started, _cancelled;
+
+        std::string _cacheDirectory;
+        ChunkMode _chunkMode; float _cellSize;
+        float _vhacdError, _obbExtent;
+        int _proxyType, _numThreads, _vhacdResolution, _vhacdMaxHulls, _obbSamples;
+        bool _vhacdBestPlane, _vhacdShrinkWrap;
+    };
+}
+
+#endif
@@ -86,81 +86,156 @@ static void createHexagonTriangles(unsigned int a, unsigned int b, unsigned int
     de.push_back(c); de.push_back(d); de.push_back(e);
 }
 
+struct CollectedGeometry
+{
+    std::vector<osg::Vec3> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<osg::Vec4> normals, colors, uvs;
+};
+
 struct CollectVertexOperator
 {
     void operator()(unsigned int i1, unsigned int i2, unsigned int i3)
     {
-        if (vertices && vertices->size() <= baseIndex)
-        {
-            std::vector<bool> vertexAddingList;
-            for (size_t i = 0; i < inputV->size(); ++i)
-            {
-                osg::Vec3 v = (*inputV)[i] * matrix;
-                if (vertexMap)
-                {
-                    if (vertexMap->find(v) == vertexMap->end())
-                    {
-                        (*vertexMap)[v] = vertices->size();
-                        vertexAddingList.push_back(true);
-                        vertices->push_back(v);
-                    }
-                    else
-                        vertexAddingList.push_back(false);
-                    indexMap[baseIndex + i] = (*vertexMap)[v] - baseIndex;
-                }
-                else vertices->push_back(v);
-            }
+        if (!prepared) prepare();
+        if (i1 >= indexMap.size() || i2 >= indexMap.size() || i3 >= indexMap.size()) return;
+
+        i1 = indexMap[i1]; i2 = indexMap[i2]; i3 = indexMap[i3];
+        if (i1 == i2 || i2 == i3 || i1 == i3) return;
+        output->indices.push_back(i1); output->indices.push_back(i2);
+        output->indices.push_back(i3);
+    }
 
-            if (attributes)
+    void prepare()
+    {
+        size_t numVertices = inputV->size(); prepared = true;
+        std::vector<bool> vertexAddingList(numVertices, true);
+        indexMap.resize(numVertices); output->vertices.reserve(numVertices);
+        if (weldingHash) weldingHash->reserve(numVertices);
+        for (size_t i = 0; i < numVertices; ++i)
+        {
+            osg::Vec3 v = (*inputV)[i] * matrix;
+            unsigned int index = output->vertices.size();
+            if (weldingHash)
             {
-                std::vector<osg::Vec4>& na = (*attributes)[MeshCollector::NormalAttr];
-                std::vector<osg::Vec4>& ca = (*attributes)[MeshCollector::ColorAttr];
-                std::vector<osg::Vec4>& ta = (*attributes)[MeshCollector::UvAttr];
-                for (size_t i = 0; i < inputV->size(); ++i)
-                {
-                    if (vertexMap && !vertexAddingList[i]) continue;
-                    if (inputN)
-                    {
-                        osg::Vec3 n = osg::Matrix::transform3x3(osg::Matrix::inverse(matrix), (*inputN)[i]);
-                        na.push_back(osg::Vec4(n, 0.0));
-                    }
-                    if (inputC) ca.push_back((*inputC)[i]);
-                    if (inputT) ta.push_back(osg::Vec4((*inputT)[i].x(),
-                                                       (*inputT)[i].y(), 0.0f, 1.0));
-                }
+                indexMap[i] = weldingHash->findOrInsert(v, index);
+                if (indexMap[i] != index) { vertexAddingList[i] = false; continue; }
             }
+            else indexMap[i] = index;
+            output->vertices.push_back(v);
         }
 
-        if (indices)
+        osg::Matrix invMatrix = osg::Matrix::inverse(matrix);
+        for (size_t i = 0; i < numVertices; ++i)
         {
-            if (vertexMap)
+            if (!vertexAddingList[i]) continue;
+            if (inputN)
             {
-                i1 = indexMap[baseIndex + i1]; i2 = indexMap[baseIndex + i2];
-                i3 = indexMap[baseIndex + i3];
+                osg::Vec3 n = osg::Matrix::transform3x3(invMatrix, (*inputN)[i]);
+                output->normals.push_back(osg::Vec4(n, 0.0));
             }
-
-            if (i1 == i2 || i2 == i3 || i1 == i3) return;
-            indices->push_back(baseIndex + i1); indices->push_back(baseIndex + i2);
-            indices->push_back(baseIndex + i3);
+            if (inputC) output->colors.push_back((*inputC)[i]);
+            if (inputT) output->uvs.push_back(osg::Vec4((*inputT)[i].x(),
+                                                        (*inputT)[i].y(), 0.0f, 1.0));
         }
     }
 
     CollectVertexOperator()
-    :   inputV(NULL), inputN(NULL), inputT(NULL), inputC(NULL), vertexMap(NULL),
-        vertices(NULL), indices(NULL), attributes(NULL), baseIndex(0) {}
+    :   inputV(NULL), inputN(NULL), inputT(NULL), inputC(NULL), weldingHash(NULL),
+        output(NULL), prepared(false) {}
     osg::Vec3Array *inputV, *inputN;
     osg::Vec2Array *inputT; osg::Vec4Array *inputC;
-    std::map<osg::Vec3, unsigned int, Vec3MapComparer>* vertexMap;
-    std::map<unsigned int, unsigned int> indexMap;
+    VertexWeldingHash* weldingHash;
+    std::vector<unsigned int> indexMap;
 
-    std::vector<osg::Vec3>* vertices; std::vector<unsigned int>* indices;
-    std::map<MeshCollector::VertexAttribute, std::vector<osg::Vec4>>* attributes;
-    osg::Matrix matrix; unsigned int baseIndex;
+    CollectedGeometry* output;
+    osg::Matrix matrix; bool prepared;
 };
 
+/// VertexWeldingHash ///
+
+static const unsigned int WELDING_EMPTY_SLOT = 0xffffffffu;
+
+static inline size_t hashWeldingKey(const long long* key)
+{
+    unsigned long long h = (unsigned long long)key[0] * 0x9E3779B97F4A7C15ull;
+    h ^= (unsigned long long)key[1] * 0xC2B2AE3D27D4EB4Full;
+    h ^= (unsigned long long)key[2] * 0x165667B19E3779F9ull;
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33; return (size_t)h;
+}
+
+void VertexWeldingHash::computeKey(const osg::Vec3& v, long long* key) const
+{
+    if (_epsilon > 0.0)
+    {
+        for (int i = 0; i < 3; ++i)
+            key[i] = (long long)floor((double)v[i] / _epsilon + 0.5);
+    }
+    else
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            float f = (v[i] == 0.0f) ? 0.0f : v[i];  // treat -0 and +0 as the same
+            unsigned int bits = 0; memcpy(&bits, &f, sizeof(float)); key[i] = bits;
+        }
+    }
+}
+
+void VertexWeldingHash::reserve(size_t numVertices)
+{
+    size_t required = (_size + numVertices) * 2;
+    if (required > _entries.size()) rehash(required);
+}
+
+void VertexWeldingHash::rehash(size_t capacity)
+{
+    size_t newCapacity = 64;
+    while (newCapacity < capacity) newCapacity <<= 1;
+
+    std::vector<Entry> oldEntries; oldEntries.swap(_entries);
+    Entry emptyEntry; memset(&emptyEntry, 0, sizeof(Entry));
+    emptyEntry.value = WELDING_EMPTY_SLOT;
+    _entries.resize(newCapacity, emptyEntry);
+
+    size_t mask = newCapacity - 1;
+    for (size_t i = 0; i < oldEntries.size(); ++i)
+    {
+        const Entry& e = oldEntries[i];
+        if (e.value == WELDING_EMPTY_SLOT) continue;
+
+        size_t pos = hashWeldingKey(e.key) & mask;
+        while (_entries[pos].value != WELDING_EMPTY_SLOT) pos = (pos + 1) & mask;
+        _entries[pos] = e;
+    }
+}
+
+unsigned int VertexWeldingHash::findOrInsert(const osg::Vec3& v, unsigned int index)
+{
+    if ((_size + 1) * 2 > _entries.size()) rehash(_entries.size() * 2);
+    long long key[3]; computeKey(v, key);
+
+    size_t mask = _entries.size() - 1, pos = hashWeldingKey(key) & mask;
+    while (true)
+    {
+        Entry& e = _entries[pos];
+        if (e.value == WELDING_EMPTY_SLOT)
+        {
+            e.key[0] = key[0]; e.key[1] = key[1]; e.key[2] = key[2];
+            e.value = index; _size++; return index;
+        }
+        else if (e.key[0] == key[0] && e.key[1] == key[1] && e.key[2] == key[2])
+            return e.value;
+        pos = (pos + 1) & mask;
+    }
+}
+
+/// MeshCollector ///
+
 MeshCollector::MeshCollector()
 :   osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), _weldVertices(false), _globalVertices(false),
-    _loadedFineLevels(false), _onlyVertexAndIndices(false) {}
+    _loadedFineLevels(false), _onlyVertexAndIndices(false), _hasPendingGeometries(false) {}
 
 MeshCollector::NonManifoldType MeshCollector::isManifold() const
 {
@@ -171,7 +246,8 @@ MeshCollector::NonManifoldType MeshCollector::isManifold() const
 void MeshCollector::reset()
 {
     _matrixStack.clear(); _boundingBox.init();
-    _vertexMap.clear(); _attributes.clear();
+    _vertexMap.clear(); _attributes.clear(); _pendingGeometries.clear();
+    _hasPendingGeometries = false;
     _vertices.clear(); _indices.clear();
 }
 
@@ -293,29 +369,12 @@ void MeshCollector::apply(osg::Geometry& geom)
     osg::StateSet* ss = geom.getStateSet();
     if (ss) apply(geom.getNumParents() > 0 ? geom.getParent(0) : NULL, &geom, *ss);
 
-    osg::TriangleIndexFunctor<CollectVertexOperator> functor;
-    functor.inputV = static_cast<osg::Vec3Array*>(geom.getVertexArray());
-    if (!_onlyVertexAndIndices)
-        functor.inputT = static_cast<osg::Vec2Array*>(geom.getTexCoordArray(0));
-    if (!_onlyVertexAndIndices && geom.getNormalBinding() == osg::Geometry::BIND_PER_VERTEX)
-        functor.inputN = static_cast<osg::Vec3Array*>(geom.getNormalArray());
-    if (!_onlyVertexAndIndices && geom.getColorBinding() == osg::Geometry::BIND_PER_VERTEX)
-        functor.inputC = static_cast<osg::Vec4Array*>(geom.getColorArray());
-
-    functor.vertices = &_vertices; functor.attributes = &_attributes;
-    functor.indices = &_indices; functor.matrix = matrix;
-    functor.baseIndex = _vertices.size();
-    if (_weldVertices)
-    {
-        if (!_globalVertices) _vertexMap.clear();
-        functor.vertexMap = &_vertexMap;
-    }
-
-    geom.accept(functor);
-    if (!_stateSetStack.empty())
+    // Only record the geometry here; they will be collected together in parallel later
+    if (dynamic_cast<osg::Vec3Array*>(geom.getVertexArray()) != NULL)
     {
-        std::vector<size_t>& vids = _vertexOfStateSetMap[_stateSetStack.back()];
-        for (size_t i = functor.baseIndex; i < _vertices.size(); ++i) vids.push_back(i);
+        PendingGeometry pg; pg.geometry = &geom; pg.matrix = matrix;
+        pg.stateSet = _stateSetStack.empty() ? NULL : _stateSetStack.back();
+        _pendingGeometries.push_back(pg); _hasPendingGeometries = true;
     }
 #if OSG_VERSION_GREATER_THAN(3, 4, 1)
     traverse(geom);
@@ -323,6 +382,108 @@ void MeshCollector::apply(osg::Geometry& geom)
     if (ss) popStateSet();
 }
 
+void MeshCollector::collectPendingGeometries()
+{
+    // Only the first caller merges; others wait for it and then see nothing pending
+    if (!_hasPendingGeometries) return;
+    std::lock_guard<std::mutex> lock(_collectMutex);
+    if (_pendingGeometries.empty()) return;
+    std::vector<CollectedGeometry> collected(_pendingGeometries.size());
+    double epsilon = _vertexMap.getEpsilon();
+
+    // Transform and weld each geometry independently
+    int numGeometries = (int)_pendingGeometries.size();
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < numGeometries; ++i)
+    {
+        osg::Geometry& geom = *_pendingGeometries[i].geometry;
+        osg::TriangleIndexFunctor<CollectVertexOperator> functor;
+        functor.inputV = static_cast<osg::Vec3Array*>(geom.getVertexArray());
+        if (!_onlyVertexAndIndices)
+        {
+            size_t numVertices = functor.inputV->size();
+            osg::Vec2Array* ta = dynamic_cast<osg::Vec2Array*>(geom.getTexCoordArray(0));
+            if (ta && ta->size() >= numVertices) functor.inputT = ta;
+            if (geom.getNormalBinding() == osg::Geometry::BIND_PER_VERTEX)
+            {
+                osg::Vec3Array* na = dynamic_cast<osg::Vec3Array*>(geom.getNormalArray());
+                if (na && na->size() >= numVertices) functor.inputN = na;
+            }
+            if (geom.getColorBinding() == osg::Geometry::BIND_PER_VERTEX)
+            {
+                osg::Vec4Array* ca = dynamic_cast<osg::Vec4Array*>(geom.getColorArray());
+                if (ca && ca->size() >= numVertices) functor.inputC = ca;
+            }
+        }
+
+        VertexWeldingHash localHash(epsilon);
+        if (_weldVertices) functor.weldingHash = &localHash;
+        functor.output = &collected[i]; functor.matrix = _pendingGeometries[i].matrix;
+        geom.accept(functor);
+    }
+
+    // Merge results in traversal order, welding again among geometries if required
+    size_t numVertices = _vertices.size(), numIndices = _indices.size();
+    for (size_t i = 0; i < collected.size(); ++i)
+    { numVertices += collected[i].vertices.size(); numIndices += collected[i].indices.size(); }
+    _vertices.reserve(numVertices); _indices.reserve(numIndices);
+
+    bool globalWelding = _weldVertices && _globalVertices;
+    if (globalWelding) _vertexMap.reserve(numVertices - _vertices.size());
+    else _vertexMap.clear();
+
+    std::vector<osg::Vec4>& na = _attributes[NormalAttr];
+    std::vector<osg::Vec4>& ca = _attributes[ColorAttr];
+    std::vector<osg::Vec4>& ta = _attributes[UvAttr];
+    for (size_t i = 0; i < collected.size(); ++i)
+    {
+        CollectedGeometry& data = collected[i];
+        unsigned int baseIndex = _vertices.size();
+        if (globalWelding)
+        {
+            std::vector<unsigned int> remap(data.vertices.size());
+            for (size_t v = 0; v < data.vertices.size(); ++v)
+            {
+                unsigned int index = _vertices.size();
+                remap[v] = _vertexMap.findOrInsert(data.vertices[v], index);
+                if (remap[v] != index) continue;
+
+                _vertices.push_back(data.vertices[v]);
+                if (!data.normals.empty()) na.push_back(data.normals[v]);
+                if (!data.colors.empty()) ca.push_back(data.colors[v]);
+                if (!data.uvs.empty()) ta.push_back(data.uvs[v]);
+            }
+
+            for (size_t t = 0; t < data.indices.size(); t += 3)
+            {
+                unsigned int i1 = remap[data.indices[t]], i2 = remap[data.indices[t + 1]],
+                             i3 = remap[data.indices[t + 2]];
+                if (i1 == i2 || i2 == i3 || i1 == i3) continue;
+                _indices.push_back(i1); _indices.push_back(i2); _indices.push_back(i3);
+            }
+        }
+        else
+        {
+            _vertices.insert(_vertices.end(), data.vertices.begin(), data.vertices.end());
+            na.insert(na.end(), data.normals.begin(), data.normals.end());
+            ca.insert(ca.end(), data.colors.begin(), data.colors.end());
+            ta.insert(ta.end(), data.uvs.begin(), data.uvs.end());
+            for (size_t t = 0; t < data.indices.size(); ++t)
+                _indices.push_back(baseIndex + data.indices[t]);
+        }
+
+        osg::StateSet* stateSet = _pendingGeometries[i].stateSet;
+        if (stateSet != NULL)
+        {
+            std::vector<size_t>& vids = _vertexOfStateSetMap[stateSet];
+            for (size_t v = baseIndex; v < _vertices.size(); ++v) vids.push_back(v);
+        }
+        data = CollectedGeometry();  // release memory as early as possible
+    }
+    _pendingGeometries.clear();
+    _hasPendingGeometries = false;
+}
+
 void MeshCollector::apply(osg::Node* n, osg::Drawable* d, osg::StateSet& ss)
 {
     osg::StateSet::TextureAttributeList& texAttrList = ss.getTextureAttributeList();
@@ -341,15 +502,18 @@ void MeshCollector::apply(osg::Node* n, osg::Drawable* d, osg::StateSet& ss)
 }
 
 osg::Geometry* BoundingVolumeVisitor::computeVHACD(bool findBestPlane, bool shrinkWrap,
-                                                   int resolution, int maxConvexHulls, float maxError)
+                                                   int resolution, int maxConvexHulls, float maxError,
+                                                   bool asyncACD)
 {
     VHACD::IVHACD::Parameters params;
     params.m_findBestPlane = findBestPlane;
     params.m_shrinkWrap = shrinkWrap;
+    params.m_asyncACD = asyncACD;
     if (resolution > 0) params.m_resolution = resolution;
     if (maxConvexHulls > 0) params.m_maxConvexHulls = maxConvexHulls;
     if (maxError > 0.0f) params.m_minimumVolumePercentErrorAllowed = maxError;
     // params.m_maxRecursionDepth; params.m_fillMode; params.m_maxNumVerticesPerCH; params.m_minEdgeLength
+    collectPendingGeometries();
     if (_vertices.empty() || _indices.empty()) return NULL;
 
     std::vector<double> points(_vertices.size() * 3);
@@ -390,6 +554,7 @@ osg::Geometry* BoundingVolumeVisitor::computeVHACD(bool findBestPlane, bool shri
 
 osg::BoundingBox BoundingVolumeVisitor::computeOBB(osg::Quat& rotation, float relativeExtent, int numSamples)
 {
+    collectPendingGeometries();
     ApproxMVBB::Matrix3Dyn points(3, _vertices.size());
     for (size_t i = 0; i < _vertices.size(); ++i)
     {
@@ -404,6 +569,13 @@ osg::BoundingBox BoundingVolumeVisitor::computeOBB(osg::Quat& rotation, float re
                             osg::Vec3(oobb.m_maxPoint.x(), oobb.m_maxPoint.y(), oobb.m_maxPoint.z()));
 }
 
+void BoundingVolumeVisitor::setMesh(const std::vector<osg::Vec3>& vertices,
+                                    const std::vector<unsigned int>& indices)
+{
+    reset(); _vertices = vertices; _indices = indices;
+    for (size_t i = 0; i < vertices.size(); ++i) _boundingBox.expandBy(vertices[i]);
+}
+
 void MeshTopologyVisitor::apply(osg::Node* n, osg::Drawable* d, osg::StateSet& ss)
 {
     if (!_stateset) _stateset = new osg::StateSet;
@@ -454,7 +626,6 @@ osg::Image* TexturePacker::pack(size_t& numImages, bool generateResult, bool sto
     stbrp_pack_rects(&context, rects, _input.size());
     free(nodes); _result.clear(); ptr = 0;
 
-    osg::observer_ptr<osg::Image> validChild;
     for (std::map<size_t, InputPair>::iterator itr = _input.begin();
          itr != _input.end(); ++itr, ++ptr)
     {
@@ -473,10 +644,23 @@ osg::Image* TexturePacker::pack(size_t& numImages, bool generateResult, bool sto
         if (totalW < (r.x + r.w)) totalW = r.x + r.w;
         if (totalH < (r.y + r.h)) totalH = r.y + r.h;
         _result[itr->first] = InputPair(pair.first, v);
-        if (pair.first.valid()) validChild = pair.first;
     }
     free(rects); numImages = _result.size();
     if (!generateResult) return NULL;
+    return createResult(totalW, totalH);
+}
+
+osg::Image* TexturePacker::createResult(int totalW, int totalH) const
+{
+    osg::observer_ptr<osg::Image> validChild;
+    for (std::map<size_t, InputPair>::const_iterator itr = _result.begin();
+         itr != _result.end(); ++itr)
+    {
+        const osg::Vec4& r = itr->second.second;
+        if (itr->second.first.valid()) validChild = itr->second.first;
+        if (totalW < (r[0] + r[2])) totalW = r[0] + r[2];
+        if (totalH < (r[1] + r[3])) totalH = r[1] + r[3];
+    }
 
     osg::ref_ptr<osg::Image> total = new osg::Image;
     if (validChild.valid())
@@ -488,10 +672,10 @@ osg::Image* TexturePacker::pack(size_t& numImages, bool generateResult, bool sto
     else
         total->allocateImage(totalW, totalH, 1, GL_RGBA, GL_UNSIGNED_BYTE);
 
-    for (std::map<size_t, InputPair>::iterator itr = _result.begin();
+    for (std::map<size_t, InputPair>::const_iterator itr = _result.begin();
          itr != _result.end(); ++itr)
     {
-        InputPair& pair = itr->second;
+        const InputPair& pair = itr->second;
         const osg::Vec4& r = itr->second.second;
         if (!pair.first.valid()) continue;
 
@@ -6,6 +6,8 @@
 #include <osg/Transform>
 #include <osg/Geometry>
 #include <osg/Camera>
+#include <atomic>
+#include <mutex>
 
 namespace osgVerse
 {
@@ -34,6 +36,31 @@ namespace osgVerse
         }
     };
 
+    /** Open-addressing spatial hash for welding vertices. With a positive epsilon, vertices are
+        snapped to a grid of that cell size before comparing; otherwise they must be equal */
+    class VertexWeldingHash
+    {
+    public:
+        VertexWeldingHash(double epsilon = 0.0) : _epsilon(0.0), _size(0) { setEpsilon(epsilon); }
+        void setEpsilon(double e) { _epsilon = e > 0.0 ? e : 0.0; clear(); }
+        double getEpsilon() const { return _epsilon; }
+
+        void clear() { _entries.clear(); _size = 0; }
+        void reserve(size_t numVertices);
+        size_t size() const { return _size; }
+
+        /** Return index of an existing vertex equal to v, or record v with given index and return it */
+        unsigned int findOrInsert(const osg::Vec3& v, unsigned int index);
+
+    protected:
+        struct Entry { long long key[3]; unsigned int value; };
+        void computeKey(const osg::Vec3& v, long long* key) const;
+        void rehash(size_t capacity);
+
+        std::vector<Entry> _entries;
+        double _epsilon; size_t _size;
+    };
+
     class MeshCollector : public osg::NodeVisitor
     {
     public:
@@ -43,6 +70,11 @@ namespace osgVerse
         void setLoadingFineLevels(bool b) { _loadedFineLevels = b; }
         void setOnlyVertexAndIndices(bool b) { _onlyVertexAndIndices = b; }
 
+        /** Set welding tolerance: vertices snapped to the same cell of this size are merged.
+            Default is 0, which only welds vertices at exactly the same position */
+        void setWeldingEpsilon(double e) { _vertexMap.setEpsilon(e); }
+        double getWeldingEpsilon() const { return _vertexMap.getEpsilon(); }
+
         inline void pushMatrix(const osg::Matrix& matrix) { _matrixStack.push_back(matrix); }
         inline void popMatrix() { _matrixStack.pop_back(); }
         inline void pushStateSet(osg::StateSet& ss) { _stateSetStack.push_back(&ss); }
@@ -58,15 +90,25 @@ namespace osgVerse
 
         virtual void apply(osg::Node* n, osg::Drawable* d, osg::StateSet& ss);
         virtual void apply(osg::Node* n, osg::Drawable* d, osg::Texture* ss, int u) {}
+
+        /** Geometries are only recorded while traversing. They are transformed and welded in
+            parallel and merged on first access of results, or when calling this explicitly.
+            Merging is guarded, so const getters may be called from several threads at once */
+        void collectPendingGeometries();
         
         enum VertexAttribute { WeightAttr, NormalAttr, ColorAttr, UvAttr };
-        std::vector<osg::Vec4>& getAttributes(VertexAttribute a) { return _attributes[a]; }
-        const std::vector<osg::Vec3>& getVertices() const { return _vertices; }
-        const std::vector<unsigned int>& getTriangles() const { return _indices; }
+        std::vector<osg::Vec4>& getAttributes(VertexAttribute a)
+        { collectPendingGeometries(); return _attributes[a]; }
+
+        const std::vector<osg::Vec3>& getVertices() const
+        { const_cast<MeshCollector*>(this)->collectPendingGeometries(); return _vertices; }
+
+        const std::vector<unsigned int>& getTriangles() const
+        { const_cast<MeshCollector*>(this)->collectPendingGeometries(); return _indices; }
         const osg::BoundingBoxd& getBoundingBox() const { return _boundingBox; }
 
         std::map<osg::StateSet*, std::vector<size_t>>& getVerticesOfStateSets()
-        { return _vertexOfStateSetMap; }
+        { collectPendingGeometries(); return _vertexOfStateSetMap; }
         
         enum NonManifoldType
         {
@@ -81,7 +123,16 @@ namespace osgVerse
         MatrixStack _matrixStack;
         StateSetStack _stateSetStack;
 
-        std::map<osg::Vec3, unsigned int, Vec3MapComparer> _vertexMap;
+        struct PendingGeometry
+        {
+            osg::ref_ptr<osg::Geometry> geometry;
+            osg::Matrix matrix; osg::StateSet* stateSet;
+        };
+        std::vector<PendingGeometry> _pendingGeometries;
+        std::atomic<bool> _hasPendingGeometries;
+        std::mutex _collectMutex;
+
+        VertexWeldingHash _vertexMap;
         std::map<VertexAttribute, std::vector<osg::Vec4>> _attributes;
         std::map<osg::StateSet*, std::vector<size_t>> _vertexOfStateSetMap;
         std::vector<osg::Vec3> _vertices;
@@ -102,12 +153,17 @@ namespace osgVerse
               - Low: resolution = 2000, maxConvexHulls = 4
               - Medium: resolution = 10000, maxConvexHulls = 8
               - High: resolution = 50000, maxConvexHulls = 20
+            Set asyncACD to false when calling from a thread pool, so VHACD doesn't start its own threads
         */
         osg::Geometry* computeVHACD(bool findBestPlane = false, bool shrinkWrap = true,
-                                    int resolution = 10000, int maxConvexHulls = 8, float maxError = 0.0f);
+                                    int resolution = 10000, int maxConvexHulls = 8, float maxError = 0.0f,
+                                    bool asyncACD = true);
 
         /** Return value is in OBB coordinates, using rotation to convert it */
         osg::BoundingBox computeOBB(osg::Quat& rotation, float relativeExtent = 0.1f, int numSamples = 500);
+
+        /** Set vertices and triangles directly instead of traversing, e.g., a chunk of another mesh */
+        void setMesh(const std::vector<osg::Vec3>& vertices, const std::vector<unsigned int>& indices);
     };
     
     class MeshTopologyVisitor : public MeshCollector
@@ -139,6 +195,10 @@ namespace osgVerse
         osg::Image* pack(size_t& numImages, bool generateResult, bool stopIfFailed = false);
         bool getPackingData(size_t id, int& x, int& y, int& w, int& h);
 
+        /** Create atlas image of last packing result, which is safe to call from other threads.
+            Given size is the minimum one, and will be enlarged to hold all packed elements */
+        osg::Image* createResult(int minWidth = 0, int minHeight = 0) const;
+
     protected:
         typedef std::pair<osg::observer_ptr<osg::Image>, osg::Vec4> InputPair;
         std::map<size_t, InputPair> _input, _result;
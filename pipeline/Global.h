@@ -32,6 +32,13 @@ namespace osgVerse
         /*12*/"osg_TexCoord4", /*13*/"osg_TexCoord5", /*14*/"osg_TexCoord6", /*15*/"osg_TexCoord7"
     };
 
+    /** Per-instance vertex attributes (with divisor 1) for instanced models like 3D Tiles i3dm.
+        They are rows of the affine instance matrix, applied before the model-view matrix by
+        pipeline shaders if uniform InstancingMode > 0. Locations reuse unused osg_TexCoord4-6 */
+    static std::string instanceAttributeNames[] =
+    { /*12*/"osg_InstanceRow0", /*13*/"osg_InstanceRow1", /*14*/"osg_InstanceRow2" };
+    static const int instanceAttributeStart = 12;
+
     /** Global-defined texture-map uniform names, for full-featured pipeline use */
     static std::string uniformNames[] =
     {
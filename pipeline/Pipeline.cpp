@@ -1250,12 +1250,17 @@ namespace osgVerse
             ss.setTextureAttributeAndModes(6, createDefaultTexture(color0));  // ReflectionMap
             for (int i = 0; i < 7; ++i) ss.addUniform(new osg::Uniform(uniformNames[i].c_str(), i));
         }
+        ss.addUniform(new osg::Uniform("InstancingMode", (int)0));
 
         osg::Program* prog = static_cast<osg::Program*>(ss.getAttribute(osg::StateAttribute::PROGRAM));
         if (prog != NULL)
         {
             prog->addBindAttribLocation(attributeNames[6], 6);
             //prog->addBindAttribLocation(attributeNames[7], 7);
+#if !defined(OSG_GLES1_AVAILABLE) && !defined(OSG_GLES2_AVAILABLE)
+            for (int i = 0; i < 3; ++i)
+                prog->addBindAttribLocation(instanceAttributeNames[i], instanceAttributeStart + i);
+#endif
         }
         return applyDefTextures ? 7 : 0;
     }
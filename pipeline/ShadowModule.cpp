@@ -194,6 +194,10 @@ namespace osgVerse
         {
             osg::ref_ptr<osg::Program> prog = new osg::Program;
             prog->setName("ShadowCaster_PROGRAM");
+#if !defined(OSG_GLES1_AVAILABLE) && !defined(OSG_GLES2_AVAILABLE)
+            for (int i = 0; i < 3; ++i)
+                prog->addBindAttribLocation(instanceAttributeNames[i], instanceAttributeStart + i);
+#endif
             for (int i = 0; i < _shadowNumber; ++i)
                 _pipeline->addStage(createShadowCaster(i, prog.get(), casterMask));
 
@@ -390,6 +394,7 @@ namespace osgVerse
         camera->getOrCreateStateSet()->setAttribute(_polygonOffset.get(), value);
         camera->getOrCreateStateSet()->setMode(GL_POLYGON_OFFSET_FILL, value);
         camera->getOrCreateStateSet()->setMode(GL_DEPTH_CLAMP, value);
+        camera->getOrCreateStateSet()->addUniform(new osg::Uniform("InstancingMode", (int)0));
         _shadowCameras.push_back(camera.get());
 
         Pipeline::Stage* stage = new Pipeline::Stage;
@@ -214,6 +214,11 @@ struct MikkTSpaceHelper
         sc->m_pInterface->m_setTSpaceBasic = MikkTSpaceHelper::mikk_setTSpaceBasic;
         sc->m_pInterface->m_setTSpace = NULL; sc->m_pUserData = this; _geometry = g;
 
+        // Quantized arrays (e.g., from KHR_mesh_quantization) are not handled here
+        if (!dynamic_cast<osg::Vec3Array*>(g->getVertexArray()) ||
+            !dynamic_cast<osg::Vec3Array*>(g->getNormalArray()) ||
+            !dynamic_cast<osg::Vec2Array*>(g->getTexCoordArray(0))) return false;
+
         osg::Vec3Array* va = vArray(); osg::Vec3Array* na = nArray();
         osg::Vec2Array* ta = tArray();
         if (!va || !na || !ta) return false;
@@ -5,6 +5,8 @@
 #include <osg/MatrixTransform>
 #include <osg/ProxyNode>
 #include <osg/PagedLOD>
+#include <osg/CullStack>
+#include <osg/Texture>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/ReadFile>
@@ -13,10 +15,16 @@
 #include "3rdparty/rapidxml/rapidxml.hpp"
 #include "3rdparty/picojson.h"
 #include "pipeline/Global.h"
+#include "TileContentReader.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
 #include <limits.h>
+#include <float.h>
 #define WRITE_TO_OSG 0
 
 static std::vector<std::string> split(const std::string& src, const char* seperator, bool ignoreEmpty)
@@ -42,6 +50,234 @@ static std::vector<std::string> split(const std::string& src, const char* sepera
     return slist;
 }
 
+class TilesetPagedLOD;
+class TilesetBudget : public osg::Referenced
+{
+public:
+    TilesetBudget(double maxSSE, size_t maxBytes)
+        : _maxScreenSpaceError(maxSSE), _maxResidentBytes(maxBytes),
+          _residentBytes(0), _lastEvictionFrame(UINT_MAX) {}
+
+    double getMaxScreenSpaceError() const { return _maxScreenSpaceError; }
+    size_t getMaxResidentBytes() const { return _maxResidentBytes; }
+    size_t getResidentBytes() const { return _residentBytes; }
+    bool isExceeded() const { return _maxResidentBytes > 0 && _residentBytes >= _maxResidentBytes; }
+
+    void addBytes(size_t s) { _residentBytes += s; }
+    void removeBytes(size_t s) { _residentBytes -= s; }
+
+    void registerTile(TilesetPagedLOD* tile)
+    { std::unique_lock<std::mutex> lock(_mutex); _tiles.insert(tile); }
+
+    void unregisterTile(TilesetPagedLOD* tile)
+    { std::unique_lock<std::mutex> lock(_mutex); _tiles.erase(tile); }
+
+    /** Mark least-recently-used tiles to drop their children, called once per frame */
+    void selectEvictions(unsigned int frameNumber);
+
+protected:
+    std::set<TilesetPagedLOD*> _tiles;
+    std::mutex _mutex;
+    double _maxScreenSpaceError;
+    size_t _maxResidentBytes;
+    std::atomic<size_t> _residentBytes;
+    std::atomic<unsigned int> _lastEvictionFrame;
+};
+
+/** Size record of a loaded <children> group, kept as its user data */
+class TileMemoryRecord : public osg::Referenced
+{
+public:
+    TileMemoryRecord(TilesetBudget* b, size_t s) : _budget(b), _bytes(s)
+    { if (_budget.valid()) _budget->addBytes(_bytes); }
+
+    size_t getBytes() const { return _bytes; }
+
+    static size_t computeBytes(osg::Node& node)
+    {
+        struct ByteCounter : public osg::NodeVisitor
+        {
+            ByteCounter() : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), bytes(0) {}
+            virtual void apply(osg::Geometry& geom)
+            {
+                for (unsigned int i = 0; i < geom.getNumPrimitiveSets(); ++i)
+                    bytes += geom.getPrimitiveSet(i)->getTotalDataSize();
+                const osg::Array* va = geom.getVertexArray(); if (va) bytes += va->getTotalDataSize();
+                const osg::Array* na = geom.getNormalArray(); if (na) bytes += na->getTotalDataSize();
+                const osg::Array* ca = geom.getColorArray(); if (ca) bytes += ca->getTotalDataSize();
+                for (unsigned int i = 0; i < geom.getNumTexCoordArrays(); ++i)
+                { const osg::Array* ta = geom.getTexCoordArray(i); if (ta) bytes += ta->getTotalDataSize(); }
+                apply(geom.getStateSet()); traverse(geom);
+            }
+
+            virtual void apply(osg::Node& node)
+            { apply(node.getStateSet()); traverse(node); }
+
+            void apply(osg::StateSet* ss)
+            {
+                if (!ss) return;
+                for (unsigned int i = 0; i < ss->getNumTextureAttributeLists(); ++i)
+                {
+                    osg::Texture* tex = dynamic_cast<osg::Texture*>(
+                        ss->getTextureAttribute(i, osg::StateAttribute::TEXTURE));
+                    for (unsigned int j = 0; tex && j < tex->getNumImages(); ++j)
+                    {
+                        osg::Image* image = tex->getImage(j);
+                        if (image) bytes += image->getTotalSizeInBytesIncludingMipmaps();
+                    }
+                }
+            }
+            size_t bytes;
+        } counter;
+        node.accept(counter); return counter.bytes;
+    }
+
+protected:
+    virtual ~TileMemoryRecord()
+    { if (_budget.valid()) _budget->removeBytes(_bytes); }
+
+    osg::ref_ptr<TilesetBudget> _budget;
+    size_t _bytes;
+};
+
+/** PagedLOD refined by screen-space error: child 0 is tile content, child 1 is <children> */
+class TilesetPagedLOD : public osg::PagedLOD
+{
+public:
+    TilesetPagedLOD(TilesetBudget* b, double geometricError, bool additive)
+        : _budget(b), _geometricError(geometricError), _lastUsedTime(0.0),
+          _lastUsedFrame(0), _additive(additive), _evicting(false)
+    {
+        if (_budget.valid())
+        { _budget->registerTile(this); setUpdateCallback(new EvictionCallback); }
+    }
+
+    double getLastUsedTime() const { return _lastUsedTime; }
+    unsigned int getLastUsedFrame() const { return _lastUsedFrame; }
+    void setEvicting(bool b) { _evicting = b; }
+
+    size_t getChildrenBytes() const
+    {
+        if (_children.size() < 2) return 0;
+        TileMemoryRecord* r = dynamic_cast<TileMemoryRecord*>(_children[1]->getUserData());
+        return r ? r->getBytes() : 0;
+    }
+
+    virtual void traverse(osg::NodeVisitor& nv)
+    {
+        osg::CullStack* cs = (nv.getVisitorType() == osg::NodeVisitor::CULL_VISITOR)
+                           ? dynamic_cast<osg::CullStack*>(&nv) : NULL;
+        if (!cs || !_budget || !cs->getProjectionMatrix() || !cs->getViewport() ||
+            _children.empty() || _perRangeDataList.size() < 2)
+        { osg::PagedLOD::traverse(nv); return; }
+
+        const osg::FrameStamp* fs = nv.getFrameStamp();
+        double timeStamp = fs ? fs->getReferenceTime() : 0.0;
+        unsigned int frameNumber = fs ? fs->getFrameNumber() : 0;
+        setFrameNumberOfLastTraversal(frameNumber);
+        _lastUsedTime = timeStamp; _lastUsedFrame = frameNumber;
+
+        double sse = computeScreenSpaceError(*cs, nv);
+        bool refine = sse > _budget->getMaxScreenSpaceError();
+        bool childrenLoaded = _children.size() > 1;
+        if (!refine || !childrenLoaded || _additive)
+            traverseChild(0, timeStamp, frameNumber, nv);
+
+        if (!refine) return;
+        if (childrenLoaded) traverseChild(1, timeStamp, frameNumber, nv);
+        else if (nv.getDatabaseRequestHandler() && !_budget->isExceeded())
+        {
+            // Requests are renewed every frame while the tile stays visible and coarse;
+            // the pager drops those not renewed, which cancels tiles that left the view
+            PerRangeData& data = _perRangeDataList[1];
+            std::string fileName = _databasePath.empty() ? data._filename
+                                 : (_databasePath + data._filename);
+            float priority = (float)osg::minimum(sse, (double)FLT_MAX) + data._priorityOffset;
+            nv.getDatabaseRequestHandler()->requestNodeFile(
+                fileName, nv.getNodePath(), priority, fs, data._databaseRequest, _databaseOptions.get());
+        }
+    }
+
+    /** Drop loaded children if still unused, called in update traversal */
+    void evictChildren(unsigned int frameNumber)
+    {
+        if (_evicting && _children.size() > 1 && _lastUsedFrame + 1 < frameNumber)
+        {
+            // Keep range and file data so the tile can be requested again, like
+            // PagedLOD::removeExpiredChildren() which also bypasses PagedLOD::removeChildren()
+            osg::Group::removeChildren(1, _children.size() - 1);
+            _perRangeDataList[1]._databaseRequest = NULL;
+        }
+        _evicting = false;
+    }
+
+protected:
+    virtual ~TilesetPagedLOD()
+    { if (_budget.valid()) _budget->unregisterTile(this); }
+
+    struct EvictionCallback : public osg::NodeCallback
+    {
+        virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            TilesetPagedLOD* tile = static_cast<TilesetPagedLOD*>(node);
+            const osg::FrameStamp* fs = nv->getFrameStamp();
+            if (fs && tile->_budget.valid())
+            {
+                tile->_budget->selectEvictions(fs->getFrameNumber());
+                tile->evictChildren(fs->getFrameNumber());
+            }
+            traverse(node, nv);
+        }
+    };
+
+    void traverseChild(unsigned int i, double timeStamp, unsigned int frameNumber,
+                       osg::NodeVisitor& nv)
+    {
+        _perRangeDataList[i]._timeStamp = timeStamp;
+        _perRangeDataList[i]._frameNumber = frameNumber;
+        _children[i]->accept(nv);
+    }
+
+    double computeScreenSpaceError(osg::CullStack& cs, osg::NodeVisitor& nv) const
+    {
+        const osg::RefMatrix& proj = *cs.getProjectionMatrix();
+        double height = cs.getViewport()->height();
+        if (proj(3, 3) > 0.0)  // orthographic: error in pixels is independent of distance
+            return _geometricError * proj(1, 1) * height * 0.5;
+
+        const osg::BoundingSphere& bs = getBound();
+        double distance = nv.getDistanceToViewPoint(bs.center(), true) - bs.radius();
+        if (distance <= 0.0) return DBL_MAX;  // camera inside the tile
+        return (_geometricError * height * proj(1, 1)) / (2.0 * distance);
+    }
+
+    osg::ref_ptr<TilesetBudget> _budget;
+    double _geometricError;
+    std::atomic<double> _lastUsedTime;  // written in cull, read in update
+    std::atomic<unsigned int> _lastUsedFrame;
+    bool _additive, _evicting;
+};
+
+void TilesetBudget::selectEvictions(unsigned int frameNumber)
+{
+    if (_lastEvictionFrame.exchange(frameNumber) == frameNumber || !isExceeded()) return;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Least recently used tiles first, skipping those still shown in last frame
+    std::vector<std::pair<double, TilesetPagedLOD*>> candidates;
+    for (std::set<TilesetPagedLOD*>::iterator itr = _tiles.begin(); itr != _tiles.end(); ++itr)
+    {
+        TilesetPagedLOD* tile = *itr;
+        if (tile->getNumChildren() < 2 || tile->getLastUsedFrame() + 1 >= frameNumber) continue;
+        candidates.push_back(std::pair<double, TilesetPagedLOD*>(tile->getLastUsedTime(), tile));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    size_t overflow = _residentBytes - _maxResidentBytes + _maxResidentBytes / 10, freed = 0;
+    for (size_t i = 0; i < candidates.size() && freed < overflow; ++i)
+    { candidates[i].second->setEvicting(true); freed += candidates[i].second->getChildrenBytes(); }
+}
+
 class ReaderWriter3dtiles : public osgDB::ReaderWriter
 {
 public:
@@ -54,6 +290,7 @@ public:
         supportsExtension("xml", "coordinate file of ContextCapture (metadata.xml)");
         supportsExtension("json", "Decription file of 3dtiles");
         supportsExtension("children", "Internal use of 3dtiles' <children> tag");
+        supportsOption("Parallel", "Set to 'false' to decode glTF of tile contents in one thread");
     }
 
     virtual const char* className() const
@@ -74,6 +311,7 @@ public:
             ext = osgDB::getFileExtension(fileName);
         }
         if (ext.empty()) return createFromFolder(fileName);
+        else if (isBinaryContent(ext)) return readTileContent(fileName, options);
 
         osg::ref_ptr<Options> localOptions = NULL;
         if (options) localOptions = options->cloneOptions();
@@ -130,8 +368,13 @@ public:
             picojson::value& root = document.get("root");
             if (root.is<picojson::object>())
             {
+                // External tilesets are read with our own options carrying the parent budget;
+                // user data of caller's options is left untouched
                 std::string name = options ? options->getPluginStringData("simple_name") : "";
-                osg::ref_ptr<osg::Node> node = createTile(root, prefix, name, "", options);
+                osg::ref_ptr<TilesetBudget> budget =
+                    options ? dynamic_cast<TilesetBudget*>(options->getUserData()) : NULL;
+                if (!budget) budget = createBudget(options);
+                osg::ref_ptr<osg::Node> node = createTile(root, prefix, name, "", budget.get());
 #if WRITE_TO_OSG
                 osgDB::writeNodeFile(*node, prefix + "/root.osgt");
 #endif
@@ -146,6 +389,32 @@ public:
     }
 
 protected:
+    static bool isBinaryContent(const std::string& ext)
+    {
+        std::string lowerExt = osgDB::convertToLowerCase(ext);
+        return lowerExt == "b3dm" || lowerExt == "i3dm" || lowerExt == "pnts" || lowerExt == "cmpt";
+    }
+
+    /// Local binary tile contents are decoded natively, remote ones by the glTF plugin
+    static std::string getContentFile(const std::string& uri, const std::string& ext)
+    {
+        if (ext == "json") return uri + ".verse_tiles";
+        else if (isBinaryContent(ext) && osgDB::getServerProtocol(uri).empty())
+            return uri + ".verse_tiles";
+        return uri + ".verse_gltf";
+    }
+
+    TilesetBudget* createBudget(const osgDB::Options* options) const
+    {
+        // MaxScreenSpaceError: in pixels; MaxResidentMemory: in megabytes, 0 = unlimited
+        std::string sseStr = options ? options->getPluginStringData("MaxScreenSpaceError") : "";
+        std::string memStr = options ? options->getPluginStringData("MaxResidentMemory") : "";
+        double maxSSE = sseStr.empty() ? 16.0 : std::atof(sseStr.c_str());
+        double maxMemory = memStr.empty() ? 0.0 : std::atof(memStr.c_str());
+        return new TilesetBudget(maxSSE > 0.0 ? maxSSE : 16.0,
+                                 (size_t)(osg::maximum(maxMemory, 0.0) * 1024.0 * 1024.0));
+    }
+
     osg::Node* createFromMetadata(const std::string& prefix, char* srs, char* origin) const
     {
         std::string dataFolder = prefix + "/Data/";
@@ -205,10 +474,11 @@ protected:
         std::string refine = localOptions->getPluginStringData("refinement");
         std::string prefix = localOptions->getPluginStringData("prefix");
 
+        TilesetBudget* budget = dynamic_cast<TilesetBudget*>(localOptions->getUserData());
         osg::Group* group = new osg::Group;
         for (size_t i = 0; i < children.size(); ++i)
         {
-            osg::ref_ptr<osg::Node> child = createTile(children[i], prefix, name, refine, opt.get());
+            osg::ref_ptr<osg::Node> child = createTile(children[i], prefix, name, refine, budget);
             if (child.valid()) group->addChild(child.get());
         }
 
@@ -217,6 +487,9 @@ protected:
             std::string fallback = localOptions->getPluginStringData("fallback");
             if (!fallback.empty()) group->addChild(osgDB::readNodeFile(fallback, opt.get()));
         }
+
+        if (budget != NULL)
+            group->setUserData(new TileMemoryRecord(budget, TileMemoryRecord::computeBytes(*group)));
 #if WRITE_TO_OSG
         osgDB::writeNodeFile(*group, prefix + "/" + name + ".osgt");
 #endif
@@ -224,9 +497,10 @@ protected:
     }
 
     osg::Node* createTile(picojson::value& root, const std::string& prefix, const std::string& name,
-                          const std::string& parentRefine, const osgDB::Options* options) const
+                          const std::string& parentRefine, TilesetBudget* budget) const
     {
         osg::ref_ptr<osgDB::Options> opt = _subOptions->cloneOptions();
+        if (budget != NULL) opt->setUserData(budget);  // shared with external tilesets
         picojson::value& bound = root.get("boundingVolume");
         picojson::value& content = root.get("content");
         picojson::value& rangeV = root.get("geometricError");
@@ -235,8 +509,9 @@ protected:
         picojson::value& trans = root.get("transform");
 
         double range = rangeV.is<double>() ? rangeV.get<double>() : 0.0;
-        double sseDenominator = 0.5629, height = 1080.0; // FIXME
+        double sseDenominator = 0.5629, height = 1080.0;  // only for non-cull traversals
         if (range < 0.0 || range > 99999.0) range = FLT_MAX;  // invalid range
+        double geometricError = range;
         range = (range * height) / (_maxScreenSpaceError * sseDenominator);
 
         osg::BoundingSphered bs = getBoundingSphere(bound);
@@ -244,7 +519,7 @@ protected:
         if (st.empty()) st = parentRefine;
 
         osg::ref_ptr<osg::Node> tile = createTile(
-            content, children, bs, range, st, prefix, name, opt.get());
+            content, children, bs, range, geometricError, st, prefix, name, budget, opt.get());
         if (trans.is<picojson::array>())
         {
             picojson::array& tArray = trans.get<picojson::array>();
@@ -261,9 +536,9 @@ protected:
     }
 
     osg::Node* createTile(picojson::value& content, picojson::value& children,
-                          const osg::BoundingSphered& bound, double range, const std::string& st,
-                          const std::string& prefix, const std::string& name,
-                          const osgDB::Options* options) const
+                          const osg::BoundingSphered& bound, double range, double geometricError,
+                          const std::string& st, const std::string& prefix, const std::string& name,
+                          TilesetBudget* budget, const osgDB::Options* options) const
     {
         std::string uri = (content.is<picojson::object>() && content.contains("uri"))
                          ? content.get("uri").to_str() : "";
@@ -281,10 +556,11 @@ protected:
         if (children.is<picojson::array>())
         {
             osg::ref_ptr<osg::Node> child0;
-            if (ext == "json") child0 = osgDB::readNodeFile(uri + ".verse_tiles", options);
-            else if (!ext.empty()) child0 = osgDB::readNodeFile(uri + ".verse_gltf", options);
+            if (!ext.empty()) child0 = osgDB::readNodeFile(getContentFile(uri, ext), options);
 
-            osg::PagedLOD* plod = new osg::PagedLOD;
+            // Culled by screen-space error if a budget exists, by the ranges below otherwise
+            osg::PagedLOD* plod = budget ? new TilesetPagedLOD(budget, geometricError, additive)
+                                : new osg::PagedLOD;
             plod->setDatabasePath(prefix);
             plod->addChild(child0.valid() ? child0.get() : new osg::Node);
             if (!child0 && !uri.empty())
@@ -297,8 +573,9 @@ protected:
             // Put <children> to a virtual file with options to fit OSG's LOD structure
             osgDB::StringList parts; osgDB::split(name, parts, '-');
             osgDB::Options* childOpt = new osgDB::Options(children.serialize());
-            childOpt->setPluginStringData("fallback", uri + (ext == "json" ? ".verse_tiles" : ".verse_gltf"));
+            childOpt->setPluginStringData("fallback", getContentFile(uri, ext));
             childOpt->setPluginStringData("refinement", st);
+            childOpt->setUserData(budget);
             plod->setDatabaseOptions(childOpt);
             plod->setFileName(1, name + "-" + std::to_string(parts.size()) + ".children.verse_tiles");
 
@@ -340,8 +617,7 @@ protected:
         else
         {
             if (ext.empty()) return new osg::Node;
-            else if (ext == "json") return osgDB::readNodeFile(uri + ".verse_tiles", options);
-            else return osgDB::readNodeFile(uri + ".verse_gltf", options);
+            else return osgDB::readNodeFile(getContentFile(uri, ext), options);
         }
     }
 
@@ -0,0 +1,555 @@
+#include <osg/io_utils>
+#include <osg/Version>
+#include <osg/ValueObject>
+#include <osg/Geometry>
+#include <osg/CoordinateSystemNode>
+#include <osg/MatrixTransform>
+#if OSG_MIN_VERSION_REQUIRED(3, 4, 0)
+#include <osg/VertexAttribDivisor>
+#endif
+#include <osgDB/FileNameUtils>
+#include <osgDB/ReadFile>
+#include <osgDB/fstream>
+#include <osgUtil/Optimizer>
+#include <readerwriter/LoadSceneGLTF.h>
+#include <pipeline/Global.h>
+
+#include "3rdparty/picojson.h"
+#include "TileContentReader.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <string.h>
+
+/* 3D Tiles binary containers (b3dm, i3dm, pnts, cmpt), see
+   https://github.com/CesiumGS/3d-tiles/tree/main/specification/TileFormats
+   All positions are converted from the tileset's Z-up space to Y-up like other contents */
+namespace
+{
+    inline osg::Vec3d toYUp(const osg::Vec3d& v) { return osg::Vec3d(v[0], v[2], -v[1]); }
+
+    struct FeatureTable
+    {
+        picojson::value json;
+        const char* binary; size_t binarySize;
+
+        FeatureTable() : binary(NULL), binarySize(0) {}
+        bool parse(const char* jsonData, size_t jsonSize, const char* bin, size_t binSize)
+        {
+            binary = bin; binarySize = binSize;
+            if (jsonSize == 0) { json = picojson::value(picojson::object()); return true; }
+
+            std::string err = picojson::parse(json, std::string(jsonData, jsonData + jsonSize));
+            if (!err.empty() || !json.is<picojson::object>())
+            {
+                OSG_WARN << "[TileContentReader] Failed to parse feature table: " << err << std::endl;
+                json = picojson::value(picojson::object()); return false;
+            }
+            return true;
+        }
+
+        bool has(const std::string& name) const { return json.contains(name); }
+
+        double getNumber(const std::string& name, double defValue) const
+        {
+            if (!json.contains(name)) return defValue;
+            const picojson::value& v = json.get(name);
+            if (v.is<double>()) return v.get<double>();
+            else if (v.is<bool>()) return v.get<bool>() ? 1.0 : 0.0;
+            return defValue;
+        }
+
+        /// Read a global or per-feature property, either inline JSON or binary reference
+        template<typename T>
+        bool getValues(const std::string& name, size_t count, int components,
+                       const std::string& defType, std::vector<T>& out) const
+        {
+            if (!json.contains(name)) return false;
+            const picojson::value& v = json.get(name);
+            size_t total = count * components;
+            if (v.is<picojson::array>())
+            {
+                const picojson::array& values = v.get<picojson::array>();
+                if (values.size() < total) return false;
+                out.resize(total);
+                for (size_t i = 0; i < total; ++i)
+                    out[i] = values[i].is<double>() ? (T)values[i].get<double>() : T();
+                return true;
+            }
+            else if (!v.is<picojson::object>() || !v.contains("byteOffset") ||
+                     !v.get("byteOffset").is<double>()) return false;
+
+            // Validate the range in binary body before allocating anything
+            std::string type = v.contains("componentType")
+                             ? v.get("componentType").to_str() : defType;
+            double byteOffset = v.get("byteOffset").get<double>();
+            if (byteOffset < 0.0 || byteOffset > (double)binarySize) return false;
+            size_t offset = (size_t)byteOffset;
+            const char* src = binary + offset;
+#define READ_COMPONENTS(srcType) { \
+                if (total > (binarySize - offset) / sizeof(srcType)) return false; \
+                out.resize(total); for (size_t i = 0; i < total; ++i) { \
+                    srcType value; memcpy(&value, src + i * sizeof(srcType), sizeof(srcType)); \
+                    out[i] = (T)value; } return true; }
+            if (type == "FLOAT") READ_COMPONENTS(float)
+            else if (type == "DOUBLE") READ_COMPONENTS(double)
+            else if (type == "UNSIGNED_BYTE") READ_COMPONENTS(unsigned char)
+            else if (type == "BYTE") READ_COMPONENTS(signed char)
+            else if (type == "UNSIGNED_SHORT") READ_COMPONENTS(unsigned short)
+            else if (type == "SHORT") READ_COMPONENTS(short)
+            else if (type == "UNSIGNED_INT") READ_COMPONENTS(unsigned int)
+            else if (type == "INT") READ_COMPONENTS(int)
+#undef READ_COMPONENTS
+            OSG_WARN << "[TileContentReader] Unknown component type " << type
+                     << " of " << name << std::endl;
+            return false;
+        }
+
+        bool getRtcCenter(osg::Vec3d& center) const
+        {
+            std::vector<double> values;
+            if (!getValues<double>("RTC_CENTER", 1, 3, "FLOAT", values)) return false;
+            center.set(values[0], values[1], values[2]); return true;
+        }
+    };
+
+    struct TileHeader
+    {
+        std::string magic;
+        unsigned int version, byteLength, gltfFormat;
+        unsigned int featureJsonLength, featureBinLength, batchJsonLength, batchBinLength;
+        size_t headerSize;
+
+        bool read(const char* data, size_t size)
+        {
+            if (size < 28) return false;
+            magic.assign(data, data + 4); headerSize = 28; gltfFormat = 1;
+            unsigned int values[8]; memcpy(values, data + 4, sizeof(unsigned int) * 6);
+            version = values[0]; byteLength = values[1];
+            featureJsonLength = values[2]; featureBinLength = values[3];
+            batchJsonLength = values[4]; batchBinLength = values[5];
+            if (magic == "i3dm")
+            {
+                if (size < 32) return false;
+                memcpy(&gltfFormat, data + 28, sizeof(unsigned int)); headerSize = 32;
+            }
+            return byteLength <= size && getBodyOffset() <= byteLength;
+        }
+
+        size_t getBodyOffset() const
+        { return headerSize + featureJsonLength + featureBinLength + batchJsonLength + batchBinLength; }
+    };
+
+    void applyBatchTable(osg::Node* node, const char* data, const TileHeader& header, double batchLength)
+    {
+        // Batch table JSON is kept as-is for picking / styling on application side
+        size_t offset = header.headerSize + header.featureJsonLength + header.featureBinLength;
+        if (header.batchJsonLength > 0)
+        {
+            const char* batchJson = data + offset;
+            node->setUserValue("BatchTable", std::string(batchJson, batchJson + header.batchJsonLength));
+        }
+        if (batchLength > 0.0) node->setUserValue("BatchLength", (int)batchLength);
+    }
+
+    osg::Node* wrapRtcCenter(osg::Node* node, const osg::Vec3d& rtcCenter)
+    {
+        if (!node || rtcCenter.length2() == 0.0) return node;
+        osg::MatrixTransform* mt = new osg::MatrixTransform;
+        mt->setMatrix(osg::Matrix::translate(toYUp(rtcCenter)));
+        mt->addChild(node); return mt;
+    }
+
+    bool useParallel(const osgDB::Options* options)
+    {
+        // Same "Parallel" option as the glTF plugin
+        std::string parallel = options ? options->getPluginStringData("Parallel") : "";
+        std::transform(parallel.begin(), parallel.end(), parallel.begin(), ::tolower);
+        return !(parallel == "false" || parallel == "off" || parallel == "0");
+    }
+
+    osg::Node* readGltfBody(const char* data, size_t size, const std::string& dir,
+                            const osgDB::Options* options)
+    {
+        std::stringstream gltfData(std::ios::in | std::ios::out | std::ios::binary);
+        gltfData.write(data, size);
+        return osgVerse::loadGltf2(gltfData, dir, true, useParallel(options)).release();
+    }
+
+    osg::Vec3d octDecode(double x, double y, double range)
+    {
+        osg::Vec3d n(x / range * 2.0 - 1.0, y / range * 2.0 - 1.0, 0.0);
+        n.z() = 1.0 - fabs(n.x()) - fabs(n.y());
+        if (n.z() < 0.0)
+        {
+            double oldX = n.x();
+            n.x() = (1.0 - fabs(n.y())) * (oldX >= 0.0 ? 1.0 : -1.0);
+            n.y() = (1.0 - fabs(oldX)) * (n.y() >= 0.0 ? 1.0 : -1.0);
+        }
+        n.normalize(); return n;
+    }
+
+    /** Read positions relative to offset, which is QUANTIZED_VOLUME_OFFSET for quantized positions.
+        It is returned separately, so pnts can keep geocentric offsets in a transform */
+    bool readPositions(const FeatureTable& ft, size_t count, std::vector<osg::Vec3d>& positions,
+                       osg::Vec3d& offset)
+    {
+        std::vector<double> values; offset = osg::Vec3d();
+        if (ft.getValues<double>("POSITION", count, 3, "FLOAT", values))
+        {
+            positions.resize(count);
+            for (size_t i = 0; i < count; ++i)
+                positions[i].set(values[i * 3], values[i * 3 + 1], values[i * 3 + 2]);
+            return true;
+        }
+        else if (ft.getValues<double>("POSITION_QUANTIZED", count, 3, "UNSIGNED_SHORT", values))
+        {
+            std::vector<double> volumeOffset, scale;
+            if (!ft.getValues<double>("QUANTIZED_VOLUME_OFFSET", 1, 3, "FLOAT", volumeOffset) ||
+                !ft.getValues<double>("QUANTIZED_VOLUME_SCALE", 1, 3, "FLOAT", scale)) return false;
+            positions.resize(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                    positions[i][c] = values[i * 3 + c] / 65535.0 * scale[c];
+            }
+            offset.set(volumeOffset[0], volumeOffset[1], volumeOffset[2]);
+            return true;
+        }
+        return false;
+    }
+
+#if OSG_MIN_VERSION_REQUIRED(3, 4, 0)
+    /** Instance matrices are set as per-instance vertex attributes, which are applied by pipeline
+        shaders (see osgVerse::instanceAttributeNames), so glTF materials are kept as they are */
+    class ApplyInstancingVisitor : public osg::NodeVisitor
+    {
+    public:
+        ApplyInstancingVisitor(const std::vector<osg::Matrixf>& m)
+        : osg::NodeVisitor(TRAVERSE_ALL_CHILDREN), _matrices(m)
+        {
+            // OSG matrices transform row vectors, so column r is the r-th row of affine matrix
+            for (int r = 0; r < 3; ++r) _rows[r] = new osg::Vec4Array(m.size());
+            for (size_t i = 0; i < m.size(); ++i)
+            {
+                const osg::Matrixf& mat = m[i];
+                for (int r = 0; r < 3; ++r) (*_rows[r])[i].set(mat(0, r), mat(1, r), mat(2, r), mat(3, r));
+            }
+        }
+
+        virtual void apply(osg::Geode& geode)
+        {
+            for (unsigned int i = 0; i < geode.getNumDrawables(); ++i)
+            {
+                osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
+                if (geom) applyGeometry(*geom);
+            }
+        }
+
+        void applyGeometry(osg::Geometry& geom)
+        {
+            unsigned int numInstances = (unsigned int)_matrices.size();
+            geom.setUseDisplayList(false);
+            geom.setUseVertexBufferObjects(true);
+            for (int r = 0; r < 3; ++r)
+            {
+                geom.setVertexAttribArray(osgVerse::instanceAttributeStart + r, _rows[r].get(),
+                                          osg::Array::BIND_PER_VERTEX);
+            }
+            for (unsigned int i = 0; i < geom.getNumPrimitiveSets(); ++i)
+                geom.getPrimitiveSet(i)->setNumInstances(numInstances);
+
+            // Instances are placed in shader, so bound of all instances must be given here
+            osg::BoundingBox bb0 = geom.getBoundingBox(), bb;
+            for (size_t i = 0; i < _matrices.size(); ++i)
+            {
+                for (int c = 0; c < 8; ++c) bb.expandBy(bb0.corner(c) * _matrices[i]);
+            }
+            geom.setInitialBound(bb);
+        }
+
+        void applyStateSet(osg::StateSet& ss)
+        {
+            // Instance rows advance once per instance instead of per vertex
+            ss.addUniform(new osg::Uniform("InstancingMode", (int)1));
+            for (int r = 0; r < 3; ++r)
+                ss.setAttribute(new osg::VertexAttribDivisor(osgVerse::instanceAttributeStart + r, 1));
+        }
+
+    protected:
+        const std::vector<osg::Matrixf>& _matrices;
+        osg::ref_ptr<osg::Vec4Array> _rows[3];
+    };
+#endif
+
+    osg::Node* readB3dm(const char* data, size_t size, const std::string& dir,
+                        const osgDB::Options* options)
+    {
+        TileHeader header; FeatureTable ft;
+        if (!header.read(data, size)) return NULL;
+        ft.parse(data + header.headerSize, header.featureJsonLength,
+                 data + header.headerSize + header.featureJsonLength, header.featureBinLength);
+
+        size_t offset = header.getBodyOffset();
+        osg::ref_ptr<osg::Node> model =
+            readGltfBody(data + offset, header.byteLength - offset, dir, options);
+        if (!model) return NULL;
+
+        osg::Vec3d rtcCenter; ft.getRtcCenter(rtcCenter);
+        applyBatchTable(model.get(), data, header, ft.getNumber("BATCH_LENGTH", 0.0));
+        return wrapRtcCenter(model.release(), rtcCenter);
+    }
+
+    osg::Node* readI3dm(const char* data, size_t size, const std::string& dir,
+                        const osgDB::Options* options)
+    {
+        TileHeader header; FeatureTable ft;
+        if (!header.read(data, size)) return NULL;
+        ft.parse(data + header.headerSize, header.featureJsonLength,
+                 data + header.headerSize + header.featureJsonLength, header.featureBinLength);
+
+        size_t count = (size_t)ft.getNumber("INSTANCES_LENGTH", 0.0), offset = header.getBodyOffset();
+        std::vector<osg::Vec3d> positions; osg::Vec3d volumeOffset;
+        if (count == 0 || !readPositions(ft, count, positions, volumeOffset))
+        {
+            OSG_WARN << "[TileContentReader] Invalid i3dm instances: " << count << std::endl;
+            return NULL;
+        }
+        for (size_t i = 0; i < count; ++i) positions[i] += volumeOffset;  // all in double here
+
+        osg::ref_ptr<osg::Node> model;
+        if (header.gltfFormat == 0)
+        {
+            std::string uri(data + offset, data + header.byteLength);
+            uri = uri.substr(0, uri.find_last_not_of(std::string(" \t\r\n\0", 5)) + 1);
+            model = osgDB::readNodeFile(dir + "/" + uri + ".verse_gltf", options);
+        }
+        else
+            model = readGltfBody(data + offset, header.byteLength - offset, dir, options);
+        if (!model) return NULL;
+
+        // Orientations, scales and ENU frames
+        std::vector<double> up, right, scale, scaleNU;
+        bool hasNormals = ft.getValues<double>("NORMAL_UP", count, 3, "FLOAT", up) &&
+                          ft.getValues<double>("NORMAL_RIGHT", count, 3, "FLOAT", right);
+        bool hasOctNormals = !hasNormals &&
+            ft.getValues<double>("NORMAL_UP_OCT32P", count, 2, "UNSIGNED_SHORT", up) &&
+            ft.getValues<double>("NORMAL_RIGHT_OCT32P", count, 2, "UNSIGNED_SHORT", right);
+        bool hasScale = ft.getValues<double>("SCALE", count, 1, "FLOAT", scale);
+        bool hasScaleNU = ft.getValues<double>("SCALE_NON_UNIFORM", count, 3, "FLOAT", scaleNU);
+        bool eastNorthUp = ft.getNumber("EAST_NORTH_UP", 0.0) > 0.0;
+
+        osg::Vec3d rtcCenter; bool hasRtc = ft.getRtcCenter(rtcCenter);
+        osg::BoundingBoxd posBound;
+        for (size_t i = 0; i < count; ++i) posBound.expandBy(positions[i]);
+        osg::Vec3d center = hasRtc ? osg::Vec3d() : posBound.center();
+
+        // World(Y-up) = Model(Y-up) * zUp * Instance(Z-up) * yUp
+        osg::Matrixd yUp(1.0, 0.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0,
+                         0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 1.0), zUp = osg::Matrixd::inverse(yUp);
+        osg::ref_ptr<osg::EllipsoidModel> ellipsoid = new osg::EllipsoidModel;
+        std::vector<osg::Matrixf> matrices(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            osg::Matrixd rotation;
+            if (hasNormals || hasOctNormals)
+            {
+                osg::Vec3d u = hasNormals ? osg::Vec3d(up[i * 3], up[i * 3 + 1], up[i * 3 + 2])
+                             : octDecode(up[i * 2], up[i * 2 + 1], 65535.0);
+                osg::Vec3d r = hasNormals ? osg::Vec3d(right[i * 3], right[i * 3 + 1], right[i * 3 + 2])
+                             : octDecode(right[i * 2], right[i * 2 + 1], 65535.0);
+                osg::Vec3d f = r ^ u; f.normalize();
+                rotation.set(r[0], r[1], r[2], 0.0, u[0], u[1], u[2], 0.0,
+                             f[0], f[1], f[2], 0.0, 0.0, 0.0, 0.0, 1.0);
+            }
+            else if (eastNorthUp)
+            {
+                osg::Vec3d ecef = positions[i] + rtcCenter;
+                ellipsoid->computeLocalToWorldTransformFromXYZ(ecef[0], ecef[1], ecef[2], rotation);
+                rotation.setTrans(osg::Vec3d());
+            }
+
+            osg::Vec3d s(1.0, 1.0, 1.0);
+            if (hasScaleNU) s.set(scaleNU[i * 3], scaleNU[i * 3 + 1], scaleNU[i * 3 + 2]);
+            if (hasScale) s *= scale[i];
+            matrices[i] = zUp * osg::Matrixd::scale(s) * rotation *
+                          osg::Matrixd::translate(positions[i] - center) * yUp;
+        }
+
+        osg::ref_ptr<osg::Group> root = new osg::Group;
+#if OSG_MIN_VERSION_REQUIRED(3, 4, 0)
+        // Instancing applies before node transforms in shader, so bake them into vertices
+        osgUtil::Optimizer optimizer;
+        optimizer.optimize(model.get(), osgUtil::Optimizer::FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS);
+        ApplyInstancingVisitor aiv(matrices); model->accept(aiv);
+        aiv.applyStateSet(*root->getOrCreateStateSet());
+        root->addChild(model.get());
+#else
+        // No vertex attribute divisor: fall back to one transform for each instance
+        for (size_t i = 0; i < count; ++i)
+        {
+            osg::MatrixTransform* mt = new osg::MatrixTransform(matrices[i]);
+            mt->addChild(model.get()); root->addChild(mt);
+        }
+#endif
+        root->setUserValue("InstancesLength", (int)count);
+        applyBatchTable(root.get(), data, header, ft.getNumber("BATCH_LENGTH", 0.0));
+        return wrapRtcCenter(root.release(), hasRtc ? rtcCenter : center);
+    }
+
+    osg::Node* readPnts(const char* data, size_t size)
+    {
+        TileHeader header; FeatureTable ft;
+        if (!header.read(data, size)) return NULL;
+        ft.parse(data + header.headerSize, header.featureJsonLength,
+                 data + header.headerSize + header.featureJsonLength, header.featureBinLength);
+        if (ft.has("extensions"))
+        {
+            OSG_WARN << "[TileContentReader] Extensions of point cloud (e.g., Draco) "
+                     << "are not supported" << std::endl;
+        }
+
+        size_t count = (size_t)ft.getNumber("POINTS_LENGTH", 0.0);
+        std::vector<osg::Vec3d> positions; osg::Vec3d volumeOffset;
+        if (count == 0 || !readPositions(ft, count, positions, volumeOffset))
+        {
+            OSG_WARN << "[TileContentReader] Invalid pnts points: " << count << std::endl;
+            return NULL;
+        }
+
+        osg::ref_ptr<osg::Vec3Array> va = new osg::Vec3Array(count);
+        for (size_t i = 0; i < count; ++i) (*va)[i] = toYUp(positions[i]);
+
+        osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+        geom->setUseDisplayList(false);
+        geom->setUseVertexBufferObjects(true);
+        geom->setVertexArray(va.get());
+
+        std::vector<unsigned char> colors; std::vector<unsigned short> colors565;
+        osg::ref_ptr<osg::Vec4ubArray> ca;
+        if (ft.getValues<unsigned char>("RGBA", count, 4, "UNSIGNED_BYTE", colors))
+        {
+            ca = new osg::Vec4ubArray(count);
+            memcpy(&(*ca)[0], &colors[0], count * 4);
+        }
+        else if (ft.getValues<unsigned char>("RGB", count, 3, "UNSIGNED_BYTE", colors))
+        {
+            ca = new osg::Vec4ubArray(count);
+            for (size_t i = 0; i < count; ++i)
+                (*ca)[i].set(colors[i * 3], colors[i * 3 + 1], colors[i * 3 + 2], 255);
+        }
+        else if (ft.getValues<unsigned short>("RGB565", count, 1, "UNSIGNED_SHORT", colors565))
+        {
+            ca = new osg::Vec4ubArray(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                unsigned short c = colors565[i];
+                (*ca)[i].set(((c >> 11) & 0x1f) * 255 / 31, ((c >> 5) & 0x3f) * 255 / 63,
+                             (c & 0x1f) * 255 / 31, 255);
+            }
+        }
+        else if (ft.getValues<unsigned char>("CONSTANT_RGBA", 1, 4, "UNSIGNED_BYTE", colors))
+        {
+            ca = new osg::Vec4ubArray(1);
+            (*ca)[0].set(colors[0], colors[1], colors[2], colors[3]);
+        }
+
+        if (ca.valid())
+        {
+            ca->setNormalize(true);
+            geom->setColorArray(ca.get());
+            geom->setColorBinding(ca->size() == 1 ? osg::Geometry::BIND_OVERALL
+                                                  : osg::Geometry::BIND_PER_VERTEX);
+        }
+
+        std::vector<double> normals;
+        bool hasNormals = ft.getValues<double>("NORMAL", count, 3, "FLOAT", normals);
+        bool hasOctNormals = !hasNormals &&
+            ft.getValues<double>("NORMAL_OCT16P", count, 2, "UNSIGNED_BYTE", normals);
+        if (hasNormals || hasOctNormals)
+        {
+            osg::ref_ptr<osg::Vec3Array> na = new osg::Vec3Array(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                osg::Vec3d n = hasNormals ? osg::Vec3d(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2])
+                             : octDecode(normals[i * 2], normals[i * 2 + 1], 255.0);
+                (*na)[i] = toYUp(n);
+            }
+            geom->setNormalArray(na.get());
+            geom->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
+        }
+        else
+            geom->getOrCreateStateSet()->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+
+        std::vector<unsigned int> batchIDs;
+        if (ft.getValues<unsigned int>("BATCH_ID", count, 1, "UNSIGNED_SHORT", batchIDs))
+        {
+            osg::ref_ptr<osg::FloatArray> ba = new osg::FloatArray(count);
+            for (size_t i = 0; i < count; ++i) (*ba)[i] = (float)batchIDs[i];
+            // Attribute 1 is unused by LoadSceneGLTF (which doesn't read _BATCHID of b3dm),
+            // so styling shaders of points can read batch IDs from it
+            geom->setVertexAttribArray(1, ba.get());
+            geom->setVertexAttribBinding(1, osg::Geometry::BIND_PER_VERTEX);
+        }
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, count));
+
+        osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+        geode->addDrawable(geom.get());
+        osg::Vec3d rtcCenter; ft.getRtcCenter(rtcCenter);
+        applyBatchTable(geode.get(), data, header, ft.getNumber("BATCH_LENGTH", 0.0));
+
+        // Keep float vertices small: RTC center and quantized volume offset go to the transform
+        return wrapRtcCenter(geode.release(), rtcCenter + volumeOffset);
+    }
+
+    osg::Node* readContentData(const char* data, size_t size, const std::string& dir,
+                               const osgDB::Options* options);
+    osg::Node* readCmpt(const char* data, size_t size, const std::string& dir,
+                        const osgDB::Options* options)
+    {
+        if (size < 16) return NULL;
+        unsigned int values[3]; memcpy(values, data + 4, sizeof(unsigned int) * 3);
+        size_t byteLength = osg::minimum((size_t)values[1], size), offset = 16;
+
+        osg::ref_ptr<osg::Group> group = new osg::Group;
+        for (unsigned int t = 0; t < values[2] && offset + 12 <= byteLength; ++t)
+        {
+            unsigned int tileLength = 0; memcpy(&tileLength, data + offset + 8, sizeof(unsigned int));
+            if (tileLength < 12 || offset + tileLength > byteLength) break;
+
+            osg::ref_ptr<osg::Node> child = readContentData(data + offset, tileLength, dir, options);
+            if (child.valid()) group->addChild(child.get());
+            offset += tileLength;
+        }
+        return group.release();
+    }
+
+    osg::Node* readContentData(const char* data, size_t size, const std::string& dir,
+                               const osgDB::Options* options)
+    {
+        std::string magic = size < 4 ? "" : std::string(data, data + 4);
+        if (magic == "b3dm") return readB3dm(data, size, dir, options);
+        else if (magic == "i3dm") return readI3dm(data, size, dir, options);
+        else if (magic == "pnts") return readPnts(data, size);
+        else if (magic == "cmpt") return readCmpt(data, size, dir, options);
+        else if (magic == "glTF") return readGltfBody(data, size, dir, options);
+        OSG_NOTICE << "[TileContentReader] Unknown format: " << magic << std::endl;
+        return NULL;
+    }
+}
+
+osg::Node* readTileContent(const std::string& file, const osgDB::Options* options)
+{
+    osgDB::ifstream fin(file.c_str(), std::ios::in | std::ios::binary);
+    if (!fin) return NULL;
+
+    std::istreambuf_iterator<char> eos;
+    std::vector<char> data(std::istreambuf_iterator<char>(fin), eos);
+    if (data.empty()) return NULL;
+
+    osg::ref_ptr<osg::Node> node =
+        readContentData(&data[0], data.size(), osgDB::getFilePath(file), options);
+    if (node.valid()) node->setName(file);
+    else OSG_WARN << "[TileContentReader] Failed to read " << file << std::endl;
+    return node.release();
+}
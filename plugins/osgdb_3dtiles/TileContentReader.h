@@ -0,0 +1,12 @@
+#ifndef MANA_READERWRITER_TILE_CONTENT_READER_HPP
+#define MANA_READERWRITER_TILE_CONTENT_READER_HPP
+
+#include <osg/Node>
+#include <osgDB/Options>
+#include <string>
+
+/** Read a local 3D Tiles binary content file (b3dm, i3dm, pnts or cmpt). Instances of i3dm are
+    drawn with per-instance attributes, which are applied by osgVerse pipeline shaders */
+osg::Node* readTileContent(const std::string& file, const osgDB::Options* options);
+
+#endif
@@ -7,35 +7,108 @@
 
 #include "ReaderWriterEPT_Setting.h"
 #include "3rdparty/laszip/laszip_api.h"
+#include <mio.hpp>
 #include <iostream>
+#include <iterator>
 
-osg::Node* readNodeFromUnityPoint(const std::string& file, const ReadEptSettings& settings)
+static osg::Node* readNodeFromUnityPointData(const char* data, size_t dataSize, const std::string& file,
+                                             const ReadEptSettings& settings)
 {
-    osgDB::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
-    if (!in) return NULL;
-
-    double bounds[6] = { 0.0 }; in.read((char*)bounds, sizeof(double) * 6);
-    size_t numPoints = 0; in.read((char*)&numPoints, sizeof(size_t));
+    // Layout: bounds (6 doubles), point count (size_t), mode (int), ID list (uint),
+    //         vertices (3 floats), normals (3 floats, mode & 0x2), colors (4 floats, mode & 0x1)
+    size_t headerSize = sizeof(double) * 6 + sizeof(size_t) + sizeof(int);
+    if (dataSize < headerSize) return NULL;
+
+    size_t numPoints = 0; int mode = 0;
+    memcpy(&numPoints, data + sizeof(double) * 6, sizeof(size_t));
+    memcpy(&mode, data + sizeof(double) * 6 + sizeof(size_t), sizeof(int));
     if (numPoints == 0) return NULL;
 
-    std::vector<float> vertices(numPoints * 3), normals(numPoints * 3), colors(numPoints * 4);
-    std::vector<unsigned int> idList(numPoints);
-    int mode = 0; in.read((char*)&mode, sizeof(int));
+    // Check point count before multiplying, so a corrupted header can't overflow the sizes
+    size_t pointSize = sizeof(unsigned int) + sizeof(float) * 3 + ((mode & 0x2) ? sizeof(float) * 3 : 0)
+                     + ((mode & 0x1) ? sizeof(float) * 4 : 0);
+    if (numPoints > (dataSize - headerSize) / pointSize)
+    {
+        OSG_NOTICE << "Unity point file " << file << " is truncated" << std::endl;
+        return NULL;
+    }
+
+    size_t idSize = sizeof(unsigned int) * numPoints, vecSize = sizeof(float) * 3 * numPoints;
 
-    in.read((char*)&(idList[0]), sizeof(unsigned int) * idList.size());
-    in.read((char*)&(vertices[0]), sizeof(float) * vertices.size());
-    if (mode & 0x2) in.read((char*)&(normals[0]), sizeof(float) * normals.size());
-    if (mode & 0x1) in.read((char*)&(colors[0]), sizeof(float) * colors.size());
+    const float* vertices = (const float*)(data + headerSize + idSize);
+    const float* normals = (mode & 0x2) ? (vertices + numPoints * 3) : NULL;
+    const float* colors = (mode & 0x1) ? (vertices + numPoints * ((mode & 0x2) ? 6 : 3)) : NULL;
+    osg::ref_ptr<osg::Array> va, ca, na; osg::Matrix matrix; osg::BoundingBox quantizedBound;
 
-    osg::ref_ptr<osg::Vec3Array> va = new osg::Vec3Array(numPoints, (osg::Vec3f*)&(vertices[0]));
-    osg::ref_ptr<osg::Vec4Array> ca = (mode & 0x1) ? new osg::Vec4Array(numPoints, (osg::Vec4f*)&(colors[0])) : NULL;
-    osg::ref_ptr<osg::Vec3Array> na = (mode & 0x2) ? new osg::Vec3Array(numPoints, (osg::Vec3f*)&(normals[0])) : NULL;
-    for (int i = 0; i < numPoints; ++i) if (ca) (*ca)[i] = (*ca)[i] * settings.invR;
-    in.close();
+    // Copy or quantize mapped data to arrays directly in one flat pass each
+    if (settings.quantizedPositions)
+    {
+        osg::BoundingBox bb;
+        for (size_t i = 0; i < numPoints; ++i)
+            bb.expandBy(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+
+        // Signed shorts, as fixed-function glVertexPointer() doesn't accept GL_UNSIGNED_SHORT
+        osg::Vec3 center = bb.center(), extent = bb._max - bb._min, scale, invScale;
+        for (int k = 0; k < 3; ++k)
+        {
+            scale[k] = (extent[k] > 0.0f) ? (65534.0f / extent[k]) : 0.0f;
+            invScale[k] = (extent[k] > 0.0f) ? (extent[k] / 65534.0f) : 1.0f;
+        }
+
+        osg::ref_ptr<osg::Vec3sArray> qa = new osg::Vec3sArray(numPoints);
+        for (size_t i = 0; i < numPoints; ++i)
+        {
+            const float* v = vertices + i * 3; osg::Vec3s& q = (*qa)[i];
+            q[0] = (short)osg::round((v[0] - center[0]) * scale[0]);
+            q[1] = (short)osg::round((v[1] - center[1]) * scale[1]);
+            q[2] = (short)osg::round((v[2] - center[2]) * scale[2]);
+        }
+
+        // OSG can't compute bounds of short vertices, so set the quantized range explicitly
+        for (int k = 0; k < 3; ++k)
+        {
+            quantizedBound._min[k] = osg::round((bb._min[k] - center[k]) * scale[k]);
+            quantizedBound._max[k] = osg::round((bb._max[k] - center[k]) * scale[k]);
+        }
+        matrix = osg::Matrix::scale(invScale) * osg::Matrix::translate(center); va = qa;
+    }
+    else
+    {
+        osg::ref_ptr<osg::Vec3Array> fa = new osg::Vec3Array(numPoints);
+        memcpy(&(*fa)[0], vertices, vecSize); va = fa;
+    }
+
+    if (normals != NULL)
+    {
+        osg::ref_ptr<osg::Vec3Array> fa = new osg::Vec3Array(numPoints);
+        memcpy(&(*fa)[0], normals, vecSize); na = fa;
+    }
+
+    if (colors != NULL)
+    {
+        if (settings.quantizedColors)
+        {
+            float scale = settings.invR * 255.0f;
+            osg::ref_ptr<osg::Vec4ubArray> qa = new osg::Vec4ubArray(numPoints);
+            unsigned char* dst = (unsigned char*)&(*qa)[0];
+            for (size_t i = 0; i < numPoints * 4; ++i)
+                dst[i] = (unsigned char)osg::clampBetween(colors[i] * scale + 0.5f, 0.0f, 255.0f);
+            qa->setNormalize(true); ca = qa;
+        }
+        else
+        {
+            float invR = settings.invR;
+            osg::ref_ptr<osg::Vec4Array> fa = new osg::Vec4Array(numPoints);
+            float* dst = (float*)&(*fa)[0];
+            for (size_t i = 0; i < numPoints * 4; ++i) dst[i] = colors[i] * invR;
+            ca = fa;
+        }
+    }
 
     osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
     geom->setUseDisplayList(false); geom->setUseVertexBufferObjects(true);
     geom->setName(file); geom->setVertexArray(va.get());
+    if (quantizedBound.valid()) geom->setInitialBound(quantizedBound);
 #if OSG_VERSION_GREATER_THAN(3, 1, 8)
     if (ca.get()) { geom->setColorArray(ca.get(), osg::Array::BIND_PER_VERTEX); }
     if (na.get()) { geom->setNormalArray(na.get(), osg::Array::BIND_PER_VERTEX); }
@@ -49,10 +122,26 @@ osg::Node* readNodeFromUnityPoint(const std::string& file, const ReadEptSettings
     geode->addDrawable(geom.get());
 
     osg::ref_ptr<osg::MatrixTransform> mt = new osg::MatrixTransform;
-    mt->addChild(geode.get());
+    mt->setMatrix(matrix); mt->addChild(geode.get());
     return mt.release();
 }
 
+osg::Node* readNodeFromUnityPoint(const std::string& file, const ReadEptSettings& settings)
+{
+    std::error_code error;
+    mio::mmap_source mapped = mio::make_mmap_source(file, error);
+    if (!error && mapped.is_mapped())
+        return readNodeFromUnityPointData(mapped.data(), mapped.size(), file, settings);
+
+    // Fallback to read whole file at once, e.g., for non-ASCII paths
+    osgDB::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+    if (!in) return NULL;
+
+    std::vector<char> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (buffer.empty()) return NULL;
+    return readNodeFromUnityPointData(&buffer[0], buffer.size(), file, settings);
+}
+
 osg::Node* readNodeFromLaz(const std::string& file, const ReadEptSettings& settings)
 {
     laszip_POINTER laszipReader;
@@ -2,6 +2,7 @@
 #include <osg/Geometry>
 #include <osg/MatrixTransform>
 #include <osg/PagedLOD>
+#include <osg/CullStack>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
@@ -11,6 +12,8 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <mutex>
+#include <set>
 
 static std::vector<std::string> split(const std::string& src, const char* seperator, bool ignoreEmpty)
 {
@@ -35,11 +38,136 @@ static std::vector<std::string> split(const std::string& src, const char* sepera
     return slist;
 }
 
+/// EPT hierarchy indexed on demand: a sub-hierarchy file is read only when its root node is reached
+class EptHierarchy : public osg::Referenced
+{
+public:
+    EptHierarchy(const std::string& hPath) : _hierarchyPath(hPath) {}
+
+    void addNodes(picojson::object& jsonMap)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (picojson::value::object::const_iterator i = jsonMap.begin(); i != jsonMap.end(); ++i)
+            _pointCounts[i->first] = atoi(i->second.to_str().c_str());
+    }
+
+    bool hasNode(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _pointCounts.find(key) != _pointCounts.end();
+    }
+
+    /** Make sure children of the node are indexed, loading its sub-hierarchy file if necessary */
+    void prepareNode(const std::string& key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::map<std::string, int>::iterator itr = _pointCounts.find(key);
+            if (itr == _pointCounts.end() || itr->second > 1) return;
+            if (_loadedFiles.find(key) != _loadedFiles.end()) return;
+            _loadedFiles.insert(key);
+        }
+
+        // Try to get and save data from another file
+        std::string subHierarchy(_hierarchyPath + key + ".json");
+        std::ifstream subHierarchyStream(subHierarchy.c_str());
+        if (!subHierarchyStream)
+        {
+            OSG_NOTICE << "Failed to found file " << subHierarchy << std::endl;
+            return;
+        }
+
+        typedef std::istreambuf_iterator<char> sbuf_iterator;
+        picojson::value subHierarchyJson;
+        std::string stat = picojson::parse(
+            subHierarchyJson, std::string((sbuf_iterator(subHierarchyStream)), sbuf_iterator()));
+        if (!stat.empty())
+            OSG_NOTICE << "Failed to parse " << subHierarchy << ": " << stat << std::endl;
+        else
+            addNodes(subHierarchyJson.get<picojson::object>());
+    }
+
+protected:
+    std::map<std::string, int> _pointCounts;
+    std::set<std::string> _loadedFiles;
+    std::string _hierarchyPath;
+    std::mutex _mutex;
+};
+
+/// Keeps number of resident points in settings while the tile is in memory
+class ResidentPointCounter : public osg::Referenced
+{
+public:
+    ResidentPointCounter(ReadEptSettings* s, size_t num) : _settings(s), _numPoints(num)
+    { _settings->residentPoints += _numPoints; }
+
+    static size_t countPoints(osg::Node* node)
+    {
+        osg::MatrixTransform* mt = dynamic_cast<osg::MatrixTransform*>(node);
+        osg::Geode* geode = (mt && mt->getNumChildren() > 0) ? mt->getChild(0)->asGeode() : NULL;
+        if (!geode) return 0; size_t numPoints = 0;
+        for (unsigned int i = 0; i < geode->getNumDrawables(); ++i)
+        {
+            osg::Geometry* geom = geode->getDrawable(i)->asGeometry();
+            if (geom && geom->getVertexArray()) numPoints += geom->getVertexArray()->getNumElements();
+        }
+        return numPoints;
+    }
+
+protected:
+    virtual ~ResidentPointCounter() { _settings->residentPoints -= _numPoints; }
+    osg::ref_ptr<ReadEptSettings> _settings;
+    size_t _numPoints;
+};
+
+/// Paged node which requests children by screen-space size and respects the point budget
+class EptPagedLOD : public osg::PagedLOD
+{
+public:
+    EptPagedLOD(ReadEptSettings* s) : _settings(s) {}
+
+    virtual void traverse(osg::NodeVisitor& nv)
+    {
+        if (nv.getVisitorType() != osg::NodeVisitor::CULL_VISITOR || !_settings)
+        { osg::PagedLOD::traverse(nv); return; }
+
+        // Database pager handles requests with higher priority first
+        float screenSize = computeScreenSize(nv);
+        for (unsigned int i = 0; i < _perRangeDataList.size(); ++i)
+            _perRangeDataList[i]._priorityOffset = screenSize;
+
+        size_t maxPoints = _settings->maxResidentPoints;
+        if (maxPoints > 0 && _settings->residentPoints >= maxPoints)
+        {
+            // Keep loaded children alive, but request nothing more until some are expired
+            osg::ref_ptr<osg::NodeVisitor::DatabaseRequestHandler> handler = nv.getDatabaseRequestHandler();
+            nv.setDatabaseRequestHandler(NULL); osg::PagedLOD::traverse(nv);
+            nv.setDatabaseRequestHandler(handler.get());
+        }
+        else
+            osg::PagedLOD::traverse(nv);
+    }
+
+protected:
+    float computeScreenSize(osg::NodeVisitor& nv) const
+    {
+        osg::CullStack* cullStack = dynamic_cast<osg::CullStack*>(&nv);
+        if (_rangeMode == osg::LOD::PIXEL_SIZE_ON_SCREEN && cullStack && cullStack->getLODScale() > 0.0f)
+            return cullStack->clampedPixelSize(getBound()) / cullStack->getLODScale();
+
+        float distance = nv.getDistanceToViewPoint(getCenter(), true);
+        return (distance > 0.0f) ? (getRadius() / distance) : FLT_MAX;
+    }
+
+    osg::ref_ptr<ReadEptSettings> _settings;
+};
+
 class EptBuilder
 {
 public:
-    EptBuilder(const std::string& dir, const std::string& ext, osgDB::Options* op = NULL)
-        : _dataFilePath(dir), _dataFileExtIncludingDot(ext)
+    EptBuilder(const std::string& dir, const std::string& ext,
+               EptHierarchy* hierarchy, osgDB::Options* op = NULL)
+        : _hierarchy(hierarchy), _dataFilePath(dir), _dataFileExtIncludingDot(ext)
     {
         loadDataFromOptions(op);
         if (!_readEptSettings) _readEptSettings = getDefaultEptSettings();
@@ -58,14 +186,11 @@ public:
         _maxTotalBound[2] = atof(op->getPluginStringData("MaxTotalBoundZ").c_str());
     }
 
-    osg::Node* createEptScene(picojson::value& eptRootJson, picojson::value& hierarchyJson,
-        const std::string& hPath, osgDB::Options* globalOptions)
+    osg::Node* createEptScene(picojson::value& eptRootJson, osgDB::Options* globalOptions)
     {
-        std::map<std::string, int> dataFileMap;
+        // Only total bounds are kept in options, which are copied into every paged request;
+        // the hierarchy is shared by all tiles and indexed on demand
         retrieveTotalBounds(eptRootJson.get<picojson::object>());
-        retrieveDataFileMap(dataFileMap, hierarchyJson.get<picojson::object>(), hPath);
-        for (std::map<std::string, int>::iterator itr = dataFileMap.begin(); itr != dataFileMap.end(); ++itr)
-            globalOptions->setPluginStringData(itr->first, std::to_string(itr->second));
         _options = globalOptions;
 
         globalOptions->setPluginStringData("MinTotalBoundX", std::to_string(_minTotalBound[0]));
@@ -81,12 +206,13 @@ public:
     {
         std::vector<std::string> loc = split(hierarchyName, "-", false);
         if (loc.size() < 4) return NULL;
+        if (_hierarchy.valid()) _hierarchy->prepareNode(hierarchyName);
 
         int level = atoi(loc[0].c_str()), locX = atoi(loc[1].c_str()),
             locY = atoi(loc[2].c_str()), locZ = atoi(loc[3].c_str());
         osg::BoundingBoxd bb = computeBound(level, locX, locY, locZ);
 
-        osg::ref_ptr<osg::PagedLOD> plod = new osg::PagedLOD;
+        osg::ref_ptr<osg::PagedLOD> plod = new EptPagedLOD(_readEptSettings.get());
         plod->setName(hierarchyName);
         plod->setCenter(bb.center());
         plod->setRadius(bb.radius());
@@ -95,6 +221,8 @@ public:
         osg::Node* child = (_dataFileExtIncludingDot.find("unitypoint") != std::string::npos)
             ? readNodeFromUnityPoint(_dataFilePath + hierarchyName + _dataFileExtIncludingDot, *_readEptSettings)
             : readNodeFromLaz(_dataFilePath + hierarchyName + _dataFileExtIncludingDot, *_readEptSettings);
+        size_t numPoints = ResidentPointCounter::countPoints(child);
+        if (numPoints > 0) plod->setUserData(new ResidentPointCounter(_readEptSettings.get(), numPoints));
         plod->addChild(child, _readEptSettings->levelToLodRangeMin[level], FLT_MAX);
 
         int index = plod->getNumChildren();
@@ -104,7 +232,7 @@ public:
                 {
                     std::stringstream ss;
                     ss << (level + 1) << "-" << (locX * 2 + x) << "-" << (locY * 2 + y) << "-" << (locZ * 2 + z);
-                    if (_options.valid() && _options->getPluginStringData(ss.str()).empty()) continue;
+                    if (_hierarchy.valid() && !_hierarchy->hasNode(ss.str())) continue;
 
                     plod->setFileName(index, _dataFilePath + ss.str() + _dataFileExtIncludingDot + ".eptile");
                     plod->setRange(index, _readEptSettings->levelToLodRangeMax[level], FLT_MAX);
@@ -131,41 +259,6 @@ protected:
         }
     }
 
-    void retrieveDataFileMap(std::map<std::string, int>& dataFileMap, picojson::object& jsonMap, const std::string& hPath)
-    {
-        for (picojson::value::object::const_iterator i = jsonMap.begin(); i != jsonMap.end(); ++i)
-        {
-            int count = atoi(i->second.to_str().c_str());
-            if (count <= 1)
-            {
-                // Try to get and save data from another file
-                std::string subHierarchy(hPath + i->first + ".json");
-                std::ifstream subHierarchyStream(subHierarchy.c_str());
-                if (!subHierarchyStream)
-                {
-                    OSG_NOTICE << "Failed to found file " << subHierarchy << std::endl;
-                    continue;
-                }
-                else
-                {
-                    typedef std::istreambuf_iterator<char> sbuf_iterator;
-                    picojson::value subHierarchyJson;
-                    std::string stat = picojson::parse(
-                        subHierarchyJson, std::string((sbuf_iterator(subHierarchyStream)), sbuf_iterator()));
-                    if (!stat.empty())
-                    {
-                        OSG_NOTICE << "Failed to parse " << subHierarchy << ": " << stat << std::endl;
-                        continue;
-                    }
-
-                    // Read hierarchy data from this file
-                    retrieveDataFileMap(dataFileMap, subHierarchyJson.get<picojson::object>(), hPath);
-                }
-            }
-            dataFileMap[i->first] = count;
-        }
-    }
-
     osg::BoundingBoxd computeBound(int level, int locX, int locY, int locZ)
     {
         osg::Vec3d cellSize = (_maxTotalBound - _minTotalBound) / pow(2.0, (double)level);
@@ -181,6 +274,7 @@ protected:
     }
 
     osg::ref_ptr<ReadEptSettings> _readEptSettings;
+    osg::ref_ptr<EptHierarchy> _hierarchy;
     osg::ref_ptr<osgDB::Options> _options;
     osg::Vec3d _minTotalBound, _maxTotalBound;
     std::string _dataFilePath, _dataFileExtIncludingDot;
@@ -218,14 +312,20 @@ public:
             if (eptTileFile.empty()) return ReadResult::FILE_NOT_FOUND;
 
             std::string tileDir = osgDB::getFilePath(eptTileFile) + "/";
-            if (!_globalOptions[pathKey])
+            osg::ref_ptr<osgDB::Options> globalOptions; osg::ref_ptr<EptHierarchy> hierarchy;
+            {
+                std::lock_guard<std::mutex> lock(_globalMutex);
+                globalOptions = _globalOptions[pathKey]; hierarchy = _hierarchies[pathKey];
+            }
+
+            if (!globalOptions)
             {
                 OSG_NOTICE << "Tile file " << eptTileFile << " lost its options" << std::endl;
                 return ReadResult::ERROR_IN_READING_FILE;
             }
 
             EptBuilder builder(tileDir, osgDB::getFileExtensionIncludingDot(eptTileFile),
-                               _globalOptions[pathKey].get());
+                               hierarchy.get(), globalOptions.get());
             return builder.createPagedNode(osgDB::getStrippedName(eptTileFile));
         }
         else if (ext == "verse_ept")
@@ -316,13 +416,24 @@ protected:
             if (!stat1.empty() || !stat2.empty()) return ReadResult::ERROR_IN_READING_FILE;
         }
 
-        EptBuilder builder(eptPath + "/ept-data/", osgDB::getFileExtensionIncludingDot(eptRootDataFile[0]));
-        std::string subDirName = "/ept-hierarchy/"; _globalOptions[pathKey] = new osgDB::Options;
-        return builder.createEptScene(eptRootJson, hierarchyJson, eptPath + subDirName,
-                                      _globalOptions[pathKey].get());
+        osg::ref_ptr<EptHierarchy> hierarchy = new EptHierarchy(eptPath + "/ept-hierarchy/");
+        hierarchy->addNodes(hierarchyJson.get<picojson::object>());
+
+        osg::ref_ptr<osgDB::Options> globalOptions = new osgDB::Options;
+        if (options != NULL) globalOptions->setUserData(const_cast<osg::Referenced*>(options->getUserData()));
+        {
+            std::lock_guard<std::mutex> lock(_globalMutex);
+            _globalOptions[pathKey] = globalOptions; _hierarchies[pathKey] = hierarchy;
+        }
+
+        EptBuilder builder(eptPath + "/ept-data/", osgDB::getFileExtensionIncludingDot(eptRootDataFile[0]),
+                           hierarchy.get(), globalOptions.get());
+        return builder.createEptScene(eptRootJson, globalOptions.get());
     }
 
     mutable std::map<std::string, osg::ref_ptr<osgDB::Options>> _globalOptions;
+    mutable std::map<std::string, osg::ref_ptr<EptHierarchy>> _hierarchies;
+    mutable std::mutex _globalMutex;
 };
 
 // Now register with Registry to instantiate the above reader/writer.
@@ -3,16 +3,25 @@
 
 #include <osg/Geode>
 #include <osg/PagedLOD>
+#include <atomic>
 
 struct ReadEptSettings : public osg::Referenced
 {
     bool lazOffsetToVertices;
+    bool quantizedPositions;  // store unity points as short positions dequantized by parent matrix
+    bool quantizedColors;     // store unity point colors as normalized ubytes
     float minimumExpiryTime, invR;
     osg::LOD::RangeMode rangeMode;
+
+    /// Maximum number of resident points; no more tiles are requested when exceeded (0 = no limit)
+    size_t maxResidentPoints;
+    std::atomic<size_t> residentPoints;
     std::map<int, float> levelToLodRangeMin;
     std::map<int, float> levelToLodRangeMax;
 
-    ReadEptSettings() : lazOffsetToVertices(true), minimumExpiryTime(0.0f)
+    ReadEptSettings() : lazOffsetToVertices(true), quantizedPositions(false),
+                        quantizedColors(false), minimumExpiryTime(0.0f),
+                        maxResidentPoints(0), residentPoints(0)
     {
         invR = 1.0 / 255.0f; rangeMode = osg::LOD::PIXEL_SIZE_ON_SCREEN;
         levelToLodRangeMin = { {0, 5.0f}, {1, 114.87f}, {2, 124.573f}, {3, 131.951f}, {4, 137.973f},
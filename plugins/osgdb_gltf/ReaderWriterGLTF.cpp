@@ -21,6 +21,9 @@ public:
         supportsExtension("cmpt", "Cesium cmposite tiles");
         supportsOption("Directory", "Setting the working directory");
         supportsOption("Mode", "Set to 'ascii/binary' to read specific GLTF data");
+        supportsOption("Parallel", "Set to 'false' to decode meshes and images in one thread");
+        supportsOption("KeepQuantized", "Set to 'true' to keep quantized vertex data in integer "
+                                        "arrays (for shader-based rendering only)");
     }
 
     virtual const char* className() const
@@ -41,13 +44,14 @@ public:
             ext = osgDB::getFileExtension(fileName);
         }
 
-        osg::ref_ptr<osg::Node> group;
+        osg::ref_ptr<osg::Node> group; bool parallel = useParallel(options);
+        bool quantized = getBoolOption(options, "KeepQuantized");
         if (ext == "cmpt")
             group = readCesiumFormatCmpt(fileName, osgDB::getFilePath(fileName));
         else if (ext == "glb" || ext == "b3dm" || ext == "i3dm")
-            group = osgVerse::loadGltf(fileName, true).get();
+            group = osgVerse::loadGltf(fileName, true, parallel, quantized).get();
         else
-            group = osgVerse::loadGltf(fileName, false).get();
+            group = osgVerse::loadGltf(fileName, false, parallel, quantized).get();
         if (!group) OSG_WARN << "[ReaderWriterGLTF] Failed to load " << fileName << std::endl;
         return group.get();
     }
@@ -73,10 +77,25 @@ public:
 
         if (dir.empty() && options && !options->getDatabasePathList().empty())
             dir = options->getDatabasePathList().front();
-        return osgVerse::loadGltf2(fin, dir, isBinary).get();
+        return osgVerse::loadGltf2(fin, dir, isBinary, useParallel(options),
+                                   getBoolOption(options, "KeepQuantized")).get();
     }
 
 protected:
+    static bool useParallel(const osgDB::Options* options)
+    {
+        std::string parallel = options ? options->getPluginStringData("Parallel") : "";
+        std::transform(parallel.begin(), parallel.end(), parallel.begin(), ::tolower);
+        return !(parallel == "false" || parallel == "off" || parallel == "0");
+    }
+
+    static bool getBoolOption(const osgDB::Options* options, const std::string& name)
+    {
+        std::string value = options ? options->getPluginStringData(name) : "";
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        return value == "true" || value == "on" || value == "1";
+    }
+
     osg::Group* readCesiumFormatCmpt(const std::string& fileName, const std::string& dir) const
     {
         std::ifstream fin(fileName, std::ios::in | std::ios::binary);
@@ -20,6 +20,8 @@ public:
         supportsOption("ThreadCount", "Number of threads used for compression: default=1");
         supportsOption("CompressLevel", "Encoding speed vs. quality tradeoff [0-5]: default=1");
         supportsOption("QualityLevel", "Compression quality [1,255]: default=128");
+        supportsOption("StreamingBaseSize", "Read Basis KTX2 with only mipmaps not larger than this size, "
+                                            "and stream others later by sizes on screen");
     }
 
     virtual const char* className() const
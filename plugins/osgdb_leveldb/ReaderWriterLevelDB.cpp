@@ -6,13 +6,164 @@
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
 #include <osgDB/Archive>
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <memory>
 #include "3rdparty/leveldb/db.h"
+#include "3rdparty/leveldb/cache.h"
+#include "3rdparty/leveldb/filter_policy.h"
+#include "3rdparty/leveldb/write_batch.h"
 
 enum LevelDBObjectType { OBJECT, ARCHIVE, IMAGE, HEIGHTFIELD, NODE, SHADER };
+static int getIntOption(const osgDB::Options* options, const std::string& name, int defValue)
+{
+    std::string value = options ? options->getPluginStringData(name) : "";
+    return value.empty() ? defValue : atoi(value.c_str());
+}
+
+/** An opened database, with its block cache and bloom filter, pending write batch and
+    values of sibling keys which are read ahead */
+class LevelDBData
+{
+public:
+    LevelDBData() : db(NULL), blockCache(NULL), filterPolicy(NULL),
+                    _numBatched(0), _prefetchedBytes(0) {}
+    ~LevelDBData()
+    {
+        flush(); delete db;  // delete DB before its cache and filter policy
+        delete blockCache; delete filterPolicy;
+    }
+
+    bool flush()
+    { std::lock_guard<std::mutex> lock(_mutex); return flushUnlocked(); }
+
+    /// Puts are collected into an atomic write batch, until there are 'batchSize' of them
+    bool put(const std::string& key, const std::string& value, int batchSize)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        PrefetchMap::iterator itr = _prefetched.find(key);
+        if (itr != _prefetched.end()) erasePrefetched(itr);
+
+        if (batchSize <= 1)
+        {
+            if (!flushUnlocked()) return false;
+            return db->Put(leveldb::WriteOptions(), key, value).ok();
+        }
+
+        _batch.Put(key, value); _numBatched++;
+        if (_numBatched >= (size_t)batchSize || _batch.ApproximateSize() > s_maxBatchBytes)
+            return flushUnlocked();
+        return true;
+    }
+
+    /// Read one value, and optionally read following 'readAhead' keys in the same directory
+    bool get(const std::string& key, std::string& value, int readAhead)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex); flushUnlocked();
+            PrefetchMap::iterator itr = _prefetched.find(key);
+            if (itr != _prefetched.end())
+            { erasePrefetched(itr, &value); return true; }
+        }
+        if (readAhead <= 0) return db->Get(leveldb::ReadOptions(), key, &value).ok();
+
+        // Keys are sorted, so sibling tiles are next to each other and share table blocks
+        std::unique_ptr<leveldb::Iterator> it(db->NewIterator(leveldb::ReadOptions()));
+        it->Seek(key); if (!it->Valid() || it->key() != leveldb::Slice(key)) return false;
+        value = it->value().ToString();
+
+        std::string dir = osgDB::getFilePath(key);
+        std::vector<std::pair<std::string, std::string>> siblings;
+        for (it->Next(); it->Valid() && (int)siblings.size() < readAhead; it->Next())
+        {
+            std::string siblingKey = it->key().ToString();
+            if (osgDB::getFilePath(siblingKey) != dir) break;
+            siblings.push_back(std::pair<std::string, std::string>(
+                siblingKey, it->value().ToString()));
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < siblings.size(); ++i)
+        {
+            const std::string& siblingKey = siblings[i].first;
+            if (_prefetched.find(siblingKey) != _prefetched.end()) continue;
+
+            PrefetchedValue& v = _prefetched[siblingKey]; v.first.swap(siblings[i].second);
+            v.second = _prefetchOrder.insert(_prefetchOrder.end(), siblingKey);
+            _prefetchedBytes += v.first.size();
+        }
+
+        // Oldest entries go first; consumed ones have already left the order list
+        while (_prefetchedBytes > s_maxPrefetchBytes && !_prefetchOrder.empty())
+            erasePrefetched(_prefetched.find(_prefetchOrder.front()));
+        return true;
+    }
+
+    /// Read a list of values from one snapshot, missing ones will be empty
+    void getMany(const std::vector<std::string>& keys, std::vector<std::string>& values)
+    {
+        { std::lock_guard<std::mutex> lock(_mutex); flushUnlocked(); }
+        leveldb::ReadOptions readOptions; readOptions.snapshot = db->GetSnapshot();
+
+        // Sorted lookups visit each table block only once
+        std::vector<size_t> order(keys.size()); values.resize(keys.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            size_t index = order[i];
+            if (!db->Get(readOptions, keys[index], &values[index]).ok()) values[index].clear();
+        }
+        db->ReleaseSnapshot(readOptions.snapshot);
+    }
+
+    bool exists(const std::string& key)
+    {
+        std::string value;
+        {
+            std::lock_guard<std::mutex> lock(_mutex); flushUnlocked();
+            if (_prefetched.find(key) != _prefetched.end()) return true;
+        }
+        return db->Get(leveldb::ReadOptions(), key, &value).ok();
+    }
+
+    leveldb::DB* db;
+    leveldb::Cache* blockCache;
+    const leveldb::FilterPolicy* filterPolicy;
+
+protected:
+    bool flushUnlocked()
+    {
+        if (_numBatched == 0) return true;
+        leveldb::Status status = db->Write(leveldb::WriteOptions(), &_batch);
+        if (!status.ok()) OSG_WARN << "[leveldb] Failed to write batch: " << status.ToString() << "\n";
+        _batch.Clear(); _numBatched = 0; return status.ok();
+    }
+
+    typedef std::pair<std::string, std::list<std::string>::iterator> PrefetchedValue;
+    typedef std::map<std::string, PrefetchedValue> PrefetchMap;
+    void erasePrefetched(PrefetchMap::iterator itr, std::string* value = NULL)
+    {
+        _prefetchedBytes -= itr->second.first.size();
+        if (value != NULL) value->swap(itr->second.first);
+        _prefetchOrder.erase(itr->second.second); _prefetched.erase(itr);
+    }
+
+    static const size_t s_maxBatchBytes = 64 * 1024 * 1024;
+    static const size_t s_maxPrefetchBytes = 64 * 1024 * 1024;
+    leveldb::WriteBatch _batch;
+    PrefetchMap _prefetched;
+    std::list<std::string> _prefetchOrder;
+    size_t _numBatched, _prefetchedBytes;
+    std::mutex _mutex;
+};
 class LevelDBArchive : public osgDB::Archive
 {
 public:
-    LevelDBArchive(const osgDB::ReaderWriter* rw, ArchiveStatus status, const std::string& dbName);
+    LevelDBArchive(const osgDB::ReaderWriter* rw, ArchiveStatus status,
+                   const std::string& dbName, const osgDB::Options* options);
     virtual ~LevelDBArchive() { close(); }
 
     virtual const char* libraryName() const { return "osgVerse"; }
@@ -61,7 +212,7 @@ public:
 
 protected:
     osg::observer_ptr<osgDB::ReaderWriter> _readerWriter;
-    leveldb::DB* _db; std::string _dbName;
+    LevelDBData* _db; std::string _dbName;
 };
 
 class ReaderWriterLevelDB : public osgDB::ReaderWriter
@@ -70,7 +221,12 @@ public:
     ReaderWriterLevelDB()
     {
         supportsProtocol("leveldb", "Read from LevelDB database.");
-        supportsOption("WriteBufferSize=<s>", "Size in byte, default is 4Mb");
+        supportsOption("WriteBufferSize=<s>", "Size in byte, default is 256Mb");
+        supportsOption("BlockCacheSize=<s>", "LRU cache of table blocks in byte, default is 64Mb");
+        supportsOption("BloomFilterBits=<n>", "Bloom filter bits per key, 0 to disable, default is 10");
+        supportsOption("WriteBatchSize=<n>", "Number of writes committed in one atomic batch, default is 1");
+        supportsOption("ReadAhead=<n>", "Number of following keys in the same directory to prefetch");
+        supportsOption("MultiGet=<k1;k2;...>", "Read all keys at once to a group, in the same order");
 
         // Examples:
         // - Writing: osgconv cessna.osg leveldb://test.db/cessna.osg.verse_leveldb
@@ -81,7 +237,7 @@ public:
 
     virtual ~ReaderWriterLevelDB()
     {
-        for (std::map<std::string, leveldb::DB*>::iterator itr = _dbMap.begin();
+        for (DatabaseMap::iterator itr = _dbMap.begin();
              itr != _dbMap.end(); ++itr) { delete itr->second; }
     }
     
@@ -99,7 +255,7 @@ public:
     {
         // Create archive from DB
         std::string dbName = osgDB::getServerAddress(fullFileName);
-        return new LevelDBArchive(this, status, dbName);
+        return new LevelDBArchive(this, status, dbName, options);
     }
 
     virtual ReadResult readObject(const std::string& fileName, const Options* options) const
@@ -171,12 +327,9 @@ public:
         if (scheme == "leveldb")
         {
             std::string dbName = osgDB::getServerAddress(filename);
-            std::string keyName = osgDB::getServerFileName(filename), value;
-            leveldb::DB* db = getOrCreateDatabase(dbName, false);
-            if (!db) return false;
-
-            leveldb::Status status = db->Get(leveldb::ReadOptions(), keyName, &value);
-            return status.ok();
+            std::string keyName = osgDB::getServerFileName(filename);
+            LevelDBData* db = getOrCreateDatabase(dbName, false, options);
+            return db ? db->exists(keyName) : false;
         }
         return ReaderWriter::fileExists(filename, options);
     }
@@ -211,6 +364,15 @@ public:
             return ReadResult::FILE_NOT_HANDLED;
         }
 
+        std::string dbName = osgDB::getServerAddress(fullFileName);
+        std::string keyList = options ? options->getPluginStringData("MultiGet") : "";
+        if (!keyList.empty())
+        {
+            LevelDBData* db = getOrCreateDatabase(dbName, false, options);
+            if (!db) return ReadResult::ERROR_IN_READING_FILE;
+            return readMany(db, "leveldb://" + dbName + "/", keyList, options);
+        }
+
         osgDB::ReaderWriter* reader =
             osgDB::Registry::instance()->getReaderWriterForExtension(ext);
         if (!reader)
@@ -220,20 +382,58 @@ public:
         }
 
         // Read data from DB
-        std::string dbName = osgDB::getServerAddress(fullFileName);
         std::string keyName = osgDB::getServerFileName(fullFileName);
-        leveldb::DB* db = getOrCreateDatabase(dbName, false);
+        LevelDBData* db = getOrCreateDatabase(dbName, false, options);
         if (!db) return ReadResult::ERROR_IN_READING_FILE;
         else return read(db, fileName, keyName, objectType, reader, options);
     }
 
-    ReadResult read(leveldb::DB* db, const std::string& fileName, const std::string& keyName,
+    ReadResult read(LevelDBData* db, const std::string& fileName, const std::string& keyName,
                     LevelDBObjectType type, osgDB::ReaderWriter* rw, const osgDB::Options* options) const
     {
-        std::stringstream buffer; std::string value;
-        leveldb::Status status = db->Get(leveldb::ReadOptions(), keyName, &value);
-        if (!status.ok()) return ReadResult::FILE_NOT_FOUND;
-        else buffer.write(value.data(), value.length());
+        std::string value;
+        if (!db->get(keyName, value, getIntOption(options, "ReadAhead", 0)))
+            return ReadResult::FILE_NOT_FOUND;
+        return parse(fileName, value, type, rw, options);
+    }
+
+    /// Read values of ';' separated keys, and return a group with children in the same order.
+    /// A missing or unreadable key results in an empty osg::Node child
+    ReadResult readMany(LevelDBData* db, const std::string& prefix, const std::string& keyList,
+                        const osgDB::Options* options) const
+    {
+        std::vector<std::string> keys, values;
+        std::stringstream ss(keyList); std::string key;
+        while (std::getline(ss, key, ';')) { if (!key.empty()) keys.push_back(key); }
+        db->getMany(keys, values);
+
+        osg::ref_ptr<Options> lOptions = options ?
+            static_cast<Options*>(options->clone(osg::CopyOp::SHALLOW_COPY)) : new Options;
+        lOptions->setPluginStringData("MultiGet", "");
+
+        // Values are in memory now, so decode them in parallel
+        std::vector<osg::ref_ptr<osg::Node>> nodes(keys.size());
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < (int)keys.size(); ++i)
+        {
+            if (values[i].empty()) continue;
+            std::string ext = osgDB::getFileExtension(keys[i]);
+            osgDB::ReaderWriter* reader =
+                osgDB::Registry::instance()->getReaderWriterForExtension(ext);
+            if (!reader) continue;
+            nodes[i] = parse(prefix + keys[i], values[i], NODE, reader, lOptions.get()).getNode();
+        }
+
+        osg::ref_ptr<osg::Group> group = new osg::Group;
+        for (size_t i = 0; i < nodes.size(); ++i)
+            group->addChild(nodes[i].valid() ? nodes[i].get() : new osg::Node);
+        return group.get();
+    }
+
+    ReadResult parse(const std::string& fileName, const std::string& value, LevelDBObjectType type,
+                     osgDB::ReaderWriter* rw, const osgDB::Options* options) const
+    {
+        std::stringstream buffer; buffer.write(value.data(), value.length());
 
         // Load by other readerwriter
         osg::ref_ptr<Options> lOptions = options ?
@@ -275,7 +475,7 @@ public:
 
         std::string dbName = osgDB::getServerAddress(fullFileName);
         std::string keyName = osgDB::getServerFileName(fullFileName);
-        leveldb::DB* db = getOrCreateDatabase(dbName, true);
+        LevelDBData* db = getOrCreateDatabase(dbName, true, options);
         if (!db) return WriteResult::ERROR_IN_WRITING_FILE;
 
         osgDB::ReaderWriter* writer = osgDB::Registry::instance()->getReaderWriterForExtension(ext);
@@ -283,52 +483,63 @@ public:
         else return write(db, obj, keyName, writer, options);
     }
 
-    WriteResult write(leveldb::DB* db, const osg::Object& obj, const std::string& keyName,
+    WriteResult write(LevelDBData* db, const osg::Object& obj, const std::string& keyName,
                       osgDB::ReaderWriter* rw, const osgDB::Options* options) const
     {
         std::stringstream requestBuffer;
         osgDB::ReaderWriter::WriteResult result = writeFile(obj, rw, requestBuffer, options);
         if (!result.success()) return result;
 
-        leveldb::Status status = db->Put(leveldb::WriteOptions(), keyName, requestBuffer.str());
-        return status.ok() ? WriteResult::FILE_SAVED : WriteResult::FILE_NOT_HANDLED;
+        bool ok = db->put(keyName, requestBuffer.str(), getIntOption(options, "WriteBatchSize", 1));
+        return ok ? WriteResult::FILE_SAVED : WriteResult::FILE_NOT_HANDLED;
     }
 
-    leveldb::DB* getOrCreateDatabase(const std::string& name, bool createdIfMissing) const
+    /// Options only take effect when the database is opened at the first time
+    LevelDBData* getOrCreateDatabase(const std::string& name, bool createdIfMissing,
+                                     const osgDB::Options* options = NULL) const
     {
-        leveldb::DB* db = NULL;
+        std::lock_guard<std::mutex> lock(_dbMutex);
         DatabaseMap& dbMap = const_cast<DatabaseMap&>(_dbMap);
-        if (dbMap.find(name) == dbMap.end())
-        {
-            leveldb::Options options;
-            options.create_if_missing = createdIfMissing;
-            options.write_buffer_size = 256 * 1024 * 1024;
-
-            leveldb::Status status = leveldb::DB::Open(options, name, &db);
-            if (!status.ok()) return NULL; else dbMap[name] = db;
-        }
-        else
-            db = dbMap[name];
-        return db;
+        DatabaseMap::iterator itr = dbMap.find(name);
+        if (itr != dbMap.end()) return itr->second;
+
+        int bloomBits = getIntOption(options, "BloomFilterBits", 10);
+        LevelDBData* data = new LevelDBData;
+        data->blockCache = leveldb::NewLRUCache(
+            getIntOption(options, "BlockCacheSize", 64 * 1024 * 1024));
+        data->filterPolicy = (bloomBits > 0) ? leveldb::NewBloomFilterPolicy(bloomBits) : NULL;
+
+        leveldb::Options dbOptions;
+        dbOptions.create_if_missing = createdIfMissing;
+        dbOptions.write_buffer_size = getIntOption(options, "WriteBufferSize", 256 * 1024 * 1024);
+        dbOptions.block_cache = data->blockCache;
+        dbOptions.filter_policy = data->filterPolicy;
+
+        leveldb::Status status = leveldb::DB::Open(dbOptions, name, &(data->db));
+        if (!status.ok()) { delete data; return NULL; }
+        dbMap[name] = data; return data;
     }
 
     void closeDatabase(const std::string& name)
     {
+        std::lock_guard<std::mutex> lock(_dbMutex);
         DatabaseMap::iterator itr = _dbMap.find(name);
         if (itr != _dbMap.end()) { delete itr->second; _dbMap.erase(itr); }
     }
 
 protected:
-    typedef std::map<std::string, leveldb::DB*> DatabaseMap;
+    typedef std::map<std::string, LevelDBData*> DatabaseMap;
     DatabaseMap _dbMap;
+    mutable std::mutex _dbMutex;
 };
 
-LevelDBArchive::LevelDBArchive(const osgDB::ReaderWriter* rw, ArchiveStatus status, const std::string& dbName)
+LevelDBArchive::LevelDBArchive(const osgDB::ReaderWriter* rw, ArchiveStatus status,
+                               const std::string& dbName, const osgDB::Options* options)
     : _readerWriter(NULL), _dbName(dbName)
 {
     ReaderWriterLevelDB* rwdb = static_cast<ReaderWriterLevelDB*>(const_cast<ReaderWriter*>(rw));
     if (!rwdb) { _db = NULL; return; } else _readerWriter = rwdb;
-    _db = rwdb->getOrCreateDatabase(dbName, status == ArchiveStatus::CREATE);
+    _db = rwdb->getOrCreateDatabase(dbName, status == ArchiveStatus::CREATE, options);
 }
 
 void LevelDBArchive::close()
@@ -339,20 +550,21 @@ void LevelDBArchive::close()
 
 bool LevelDBArchive::fileExists(const std::string& filename) const
 {
-    std::string value; if (!_db) return false;
-    leveldb::Status status = _db->Get(leveldb::ReadOptions(), filename, &value);
-    return status.ok();
+    return _db ? _db->exists(filename) : false;
 }
 
 osgDB::ReaderWriter::ReadResult LevelDBArchive::readFile(
     LevelDBObjectType type, const std::string& fileName, const osgDB::Options* op) const
 {
+    ReaderWriterLevelDB* rwdb = static_cast<ReaderWriterLevelDB*>(_readerWriter.get());
+    if (!rwdb || !_db) return ReadResult::FILE_NOT_HANDLED;
+
+    std::string keyList = op ? op->getPluginStringData("MultiGet") : "";
+    if (!keyList.empty()) return rwdb->readMany(_db, getMasterFileName(), keyList, op);
+
     std::string ext = osgDB::getFileExtension(fileName);
     osgDB::ReaderWriter* reader = osgDB::Registry::instance()->getReaderWriterForExtension(ext);
     if (!reader) return ReadResult::FILE_NOT_HANDLED;
-
-    ReaderWriterLevelDB* rwdb = static_cast<ReaderWriterLevelDB*>(_readerWriter.get());
-    if (!rwdb || !_db) return ReadResult::FILE_NOT_HANDLED;
     return rwdb->read(_db, getMasterFileName() + fileName, fileName, type, reader, op);
 }
 
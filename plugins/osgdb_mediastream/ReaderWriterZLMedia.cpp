@@ -11,6 +11,7 @@
 #include "pipeline/Global.h"
 #include "3rdparty/xxYUV/rgb2yuv.h"
 #include <mk_mediakit.h>
+#include <atomic>
 #include <chrono>
 #define ALIGN(v, a) ((v) + ((a) - 1) & ~((a) - 1))
 
@@ -304,6 +305,56 @@ protected:
     osg::observer_ptr<osgVerse::UserCallback> _httpApiCallback;
 };
 
+/** Triple-buffered frame pool shared by one decoder (producer) and one update thread (consumer).
+    The producer always owns the back slot and the consumer owns the front one, so decoded pixels
+    are written in place and handed over by exchanging slot indices, without locks or copies */
+class ZLMediaFramePool
+{
+public:
+    ZLMediaFramePool() : _middle(1), _back(0), _front(2)
+    {
+        for (int i = 0; i < 3; ++i) { _slots[i] = new osg::Image; _pts[i] = 0; }
+    }
+
+    /// Producer: get the slot to write the next frame into, reallocated only on size changes
+    osg::Image* acquireBack(int w, int h, GLenum pixelFormat, GLenum dataType)
+    {
+        osg::Image* img = _slots[_back].get();
+        if (img->s() != w || img->t() != h || img->getPixelFormat() != pixelFormat ||
+            img->getDataType() != dataType)
+        {
+            // Drawing thread may still read from the old buffer, so replace instead of reallocating
+            img = new osg::Image; _slots[_back] = img;
+            img->allocateImage(w, h, 1, pixelFormat, dataType);
+        }
+        return img;
+    }
+
+    /// Producer: publish the back slot as the latest frame
+    void publishBack(long long pts)
+    {
+        _pts[_back] = pts;
+        int last = _middle.exchange(_back | FRESH_BIT, std::memory_order_acq_rel);
+        _back = last & INDEX_MASK;
+    }
+
+    /// Consumer: get the latest published frame, or NULL if nothing new since last call
+    osg::Image* acquireFront(long long* pts)
+    {
+        if (!(_middle.load(std::memory_order_acquire) & FRESH_BIT)) return NULL;
+        int last = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = last & INDEX_MASK; if (pts) *pts = _pts[_front];
+        return _slots[_front].get();
+    }
+
+protected:
+    enum { INDEX_MASK = 0x3, FRESH_BIT = 0x4 };
+    osg::ref_ptr<osg::Image> _slots[3];
+    long long _pts[3];
+    std::atomic<int> _middle;
+    int _back, _front;
+};
+
 class ZLMediaPlayer : public osg::ImageStream, public OpenThreads::Thread
 {
 public:
@@ -330,20 +381,22 @@ public:
 
 protected:
     virtual ~ZLMediaPlayer() { quit(true); }
-    void updateImage();
+    bool updateImage();
 
     virtual void run()
     {
         _done = false;
         while (!_done)
         {
-            if (_status == PLAYING) updateImage();
+            bool updated = false;
+            if (_status == PLAYING) updated = updateImage();
             else if (_status == REWINDING) _status = PLAYING;
-            YieldCurrentThread();
+            if (!updated) microSleep(1000); else YieldCurrentThread();
         }
     }
 
     osg::observer_ptr<osgDB::ReaderWriter> _reader;
+    osg::ref_ptr<osg::Image> _frame;  // front slot of the frame pool we are pointing to
     std::string _name; bool _done;
 };
 
@@ -445,51 +498,18 @@ public:
         return ctx->pushNewFrame(&image);
     }
 
+    /// Get latest decoded frame (owned by the pool, valid until next call) or NULL if not changed
     osg::Image* getPlayerImage(const std::string& fileName, long long* pts)
     {
-        PlayerContext* ctx = _players[fileName];
-        return ctx ? ctx->pullFromImageList(pts) : NULL;
+        std::map<std::string, PlayerContext*>::iterator itr = _players.find(fileName);
+        return (itr != _players.end()) ? itr->second->frames.acquireFront(pts) : NULL;
     }
 
 protected:
-    class BaseContext
-    {
-    protected:
-        typedef std::pair<osg::ref_ptr<osg::Image>, long long> ImagePair;
-        std::list<ImagePair> _images;
-        OpenThreads::Mutex _mutex;
-        unsigned int _maxImages;
-
-    public:
-        void clear(unsigned int m)
-        { _maxImages = m; _images.clear(); }
-
-        void pushToImageList(osg::Image* img, long long pts)
-        {
-            _mutex.lock();
-            _images.push_back(ImagePair(img, pts));
-            if (_maxImages < _images.size()) _images.pop_front();
-            _mutex.unlock();
-        }
-
-        osg::Image* pullFromImageList(long long* pts = NULL)
-        {
-            osg::ref_ptr<osg::Image> image; _mutex.lock();
-            if (!_images.empty())
-            {
-                ImagePair& pair = _images.front();
-                image = (osg::Image*)pair.first->clone(osg::CopyOp::DEEP_COPY_ALL);
-                if (pts) *pts = pair.second; _images.pop_front();
-            }
-            _mutex.unlock();
-            return image.release();
-        }
-    };
-    
-    class PusherContext : public BaseContext
+    class PusherContext
     {
     public:
-        PusherContext() : BaseContext() {}
+        PusherContext() : media(NULL), pusher(NULL) {}
         mk_media media;
         mk_pusher pusher;
         std::string pushUrl;
@@ -503,7 +523,7 @@ protected:
             ctx->media = mk_media_create("__defaultVhost__", app, stream, 0, 0, 0);
             mk_media_init_video(ctx->media, MKCodecH264, w, h, fps, bitRate);
             mk_media_set_on_regist(ctx->media, ReaderWriterZLMedia::onMkRegisterMediaSource, ctx);
-            ctx->clear(1); return ctx;
+            return ctx;
         }
 
         void destroy()
@@ -512,56 +532,65 @@ protected:
             if (media) mk_media_release(media);
         }
 
-        WriteResult pushNewFrame(const osg::Image* img)
+        WriteResult pushNewFrame(const osg::Image* image)
         {
             long long pts = std::chrono::duration_cast<std::chrono::milliseconds>(
                 std::chrono::system_clock::now().time_since_epoch()).count();
-            pushToImageList(const_cast<osg::Image*>(img), pts);
             if (!media) return WriteResult::FILE_SAVED;  // not prepared
-
-            osg::ref_ptr<osg::Image> image = pullFromImageList(&pts);
-            if (image.valid() && image->s() > 0 && image->t() > 0)
+            if (!image || image->s() < 2 || image->t() < 2)
+                return WriteResult::ERROR_IN_WRITING_FILE;
+            if (osg::Image::computeNumComponents(image->getPixelFormat()) != 3 ||
+                image->getDataType() != GL_UNSIGNED_BYTE)
             {
-                if (osg::Image::computeNumComponents(image->getPixelFormat()) != 3 ||
-                    image->getDataType() != GL_UNSIGNED_BYTE)
-                {
-                    OSG_NOTICE << "[ReaderWriterZLMedia] Unsupported image type" << std::endl;
-                    return WriteResult::NOT_IMPLEMENTED;
-                }
+                OSG_NOTICE << "[ReaderWriterZLMedia] Unsupported image type" << std::endl;
+                return WriteResult::NOT_IMPLEMENTED;
+            }
 
+            // Convert from the input image directly, no intermediate copies
+            int width = image->s(), height = image->t();
+            int strideRGB = (int)image->getRowStepInBytes();
+            int strideY = ALIGN(width, 16), strideUV = strideY / 2;
+            int sizeY = strideY * height, sizeUV = strideUV * ((height + 1) / 2);
+            size_t yuvSize = sizeY + sizeUV * 2;
+            if (yuvSize != yuvBuffer.size()) yuvBuffer.resize(yuvSize);
+
+            char* ptrY = &yuvBuffer[0];
+            char* ptrV = ptrY + sizeY;  // YV12: V plane before U plane
+            char* ptrU = ptrV + sizeUV;
+            const unsigned char* ptrRGB = image->data();
+
+            // Split into bands of even rows, each converted with the SIMD path of xxYUV
+            const int bandRows = 64, numBands = (height + bandRows - 1) / bandRows;
+#pragma omp parallel for schedule(dynamic, 1)
+            for (int b = 0; b < numBands; ++b)
+            {
+                int row0 = b * bandRows, rows = osg::minimum(bandRows, height - row0);
                 rgb2yuv_parameter rgb2yuv;
                 memset(&rgb2yuv, 0, sizeof(rgb2yuv_parameter));
-                rgb2yuv.width = image->s(); rgb2yuv.height = image->t();
-                rgb2yuv.rgb = image->data(); rgb2yuv.componentRGB = 3;
-                rgb2yuv.strideRGB = 0; rgb2yuv.swizzleRGB = true;
+                rgb2yuv.width = width; rgb2yuv.height = rows;
+                rgb2yuv.rgb = ptrRGB + (size_t)row0 * strideRGB; rgb2yuv.componentRGB = 3;
+                rgb2yuv.strideRGB = strideRGB; rgb2yuv.swizzleRGB = true;
+                rgb2yuv.y = ptrY + (size_t)row0 * strideY;
+                rgb2yuv.u = ptrU + (size_t)(row0 / 2) * strideUV;
+                rgb2yuv.v = ptrV + (size_t)(row0 / 2) * strideUV;
+                rgb2yuv.strideY = strideY; rgb2yuv.strideU = strideUV; rgb2yuv.strideV = strideUV;
                 rgb2yuv.alignWidth = 16; rgb2yuv.alignHeight = 1;
                 rgb2yuv.alignSize = 1; rgb2yuv.videoRange = false;
-
-                int strideY = ALIGN(rgb2yuv.width, rgb2yuv.alignWidth);
-                int strideU = strideY / 2, strideV = strideY / 2;
-                int sizeY = ALIGN(strideY * ALIGN(rgb2yuv.height, rgb2yuv.alignHeight), rgb2yuv.alignSize);
-                int sizeU = ALIGN(strideU * ALIGN(rgb2yuv.height, rgb2yuv.alignHeight) / 2, rgb2yuv.alignSize);
-                size_t yuvSize = sizeY + sizeU + sizeU, lastSize = yuvBuffer.size();
-                if (yuvSize != lastSize) yuvBuffer.resize(yuvSize);
-                if (yuvSize == 0) return WriteResult::ERROR_IN_WRITING_FILE;
-                
-                char* ptr = &yuvBuffer[0]; rgb2yuv.y = ptr;
-                rgb2yuv.u = ptr + sizeY; rgb2yuv.v = ptr + sizeY + sizeU;
                 rgb2yuv_yv12(&rgb2yuv);
-                
-                char* yuvData[3] = { (char*)rgb2yuv.y, (char*)rgb2yuv.u, (char*)rgb2yuv.v };
-                int linesize[3] = { rgb2yuv.width, rgb2yuv.width / 2, rgb2yuv.width / 2 };
-                mk_media_input_yuv(media, (const char**)yuvData, linesize, pts);
-                return WriteResult::FILE_SAVED;
             }
-            return WriteResult::ERROR_IN_WRITING_FILE;
+
+            char* yuvData[3] = { ptrY, ptrU, ptrV };
+            int linesize[3] = { strideY, strideUV, strideUV };
+            mk_media_input_yuv(media, (const char**)yuvData, linesize, pts);
+            return WriteResult::FILE_SAVED;
         }
     };
 
-    class PlayerContext : public BaseContext
+    class PlayerContext
     {
     public:
-        PlayerContext() : BaseContext() {}
+        PlayerContext() : player(NULL), decoder(NULL), swscale(NULL) {}
+        ZLMediaFramePool frames;
         mk_player player;
         mk_decoder decoder;
         mk_swscale swscale;
@@ -573,7 +602,7 @@ protected:
             ctx->swscale = mk_swscale_create(pixelFormat, 0, 0);
             mk_player_set_on_result(ctx->player, ReaderWriterZLMedia::onMkPlayerEvent, ctx);
             mk_player_set_on_shutdown(ctx->player, ReaderWriterZLMedia::onMkShutdown, ctx);
-            ctx->clear(1); return ctx;
+            return ctx;
         }
 
         void destroy()
@@ -656,14 +685,12 @@ protected:
         int w = mk_get_av_frame_width(frameData), h = mk_get_av_frame_height(frameData);
         long long pts = mk_get_av_frame_pts(frameData);
 
-        osg::Image* img = new osg::Image;
-        img->allocateImage(w, h, 1, GL_BGR, GL_UNSIGNED_BYTE);
-        img->setInternalTextureFormat(GL_RGB8);
-        img->setFileName(std::to_string(pts));
-
+        // Scale directly into the pooled back buffer and hand it over to the update thread
         PlayerContext* ctx = (PlayerContext*)userData;
+        osg::Image* img = ctx->frames.acquireBack(w, h, GL_BGR, GL_UNSIGNED_BYTE);
+        img->setInternalTextureFormat(GL_RGB8);
         mk_swscale_input_frame(ctx->swscale, frame, img->data());
-        ctx->pushToImageList(img, pts);
+        ctx->frames.publishBack(pts);
     }
 
     static void API_CALL onMkShutdown(void* userData, int errCode, const char* errMsg,
@@ -752,22 +779,20 @@ ZLMediaServerArchive::ZLMediaServerArchive(const osgDB::Options* options)
     mk_events_listen(&events);
 }
 
-void ZLMediaPlayer::updateImage()
+bool ZLMediaPlayer::updateImage()
 {
     ReaderWriterZLMedia* rw = static_cast<ReaderWriterZLMedia*>(_reader.get());
-    if (!rw || _name.empty()) return;
+    if (!rw || _name.empty()) return false;
 
     long long pts = 0;
-    osg::ref_ptr<osg::Image> img = rw->getPlayerImage(_name, &pts);
-    if (img.valid())
-    {
-        if (s() != img->s() || t() != img->t())
-        {
-            allocateImage(img->s(), img->t(), 1, img->getPixelFormat(), img->getDataType());
-            setInternalTextureFormat(img->getInternalTextureFormat());
-        }
-        memcpy(data(), img->data(), img->getTotalSizeInBytes()); dirty();
-    }
+    osg::Image* img = rw->getPlayerImage(_name, &pts);
+    if (!img || !img->data()) return false;
+
+    // Point to the pooled frame directly; it won't be overwritten until we acquire next one
+    _frame = img;
+    setImage(img->s(), img->t(), 1, img->getInternalTextureFormat(), img->getPixelFormat(),
+             img->getDataType(), img->data(), osg::Image::NO_DELETE);
+    setFileName(std::to_string(pts)); return true;
 }
 
 // Now register with Registry to instantiate the above reader/writer.
@@ -2,6 +2,7 @@
 #include <osg/Version>
 #include <osg/Image>
 #include <osg/ImageSequence>
+#include <osg/ValueObject>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
@@ -11,6 +12,7 @@
 #include <stdarg.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <algorithm>
 
 static std::string formattedErrorMessage(const char* fmt, va_list ap)
 {
@@ -256,17 +258,217 @@ static unsigned int computeInternalFormat(unsigned int pixelFormat, unsigned int
     return -1;
 }
 
+static osg::Image* createTiffImage(uint32_t w, uint32_t h, uint32_t d, unsigned char* buffer,
+                                   int numComponents, uint16_t bitspersample)
+{
+    unsigned int pixelFormat =
+        (numComponents) == 1 ? GL_LUMINANCE :
+        (numComponents) == 2 ? GL_LUMINANCE_ALPHA :
+        (numComponents) == 3 ? GL_RGB :
+        (numComponents) == 4 ? GL_RGBA : (GLenum)-1;
+    unsigned int dataType =
+        (bitspersample == 8) ? GL_UNSIGNED_BYTE :
+        (bitspersample == 16) ? GL_UNSIGNED_SHORT :
+        (bitspersample == 32) ? GL_FLOAT : (GLenum)-1;
+    unsigned int internalFormat = computeInternalFormat(pixelFormat, dataType);
+    if (internalFormat <= 0)
+    {
+        OSG_WARN << "[ReaderWriterTiff] Unsupported image format" << std::endl;
+        return NULL;
+    }
+
+    osg::Image* image = new osg::Image;
+    image->setImage(w, h, d, internalFormat, pixelFormat, dataType,
+                    buffer, osg::Image::USE_NEW_DELETE);
+    return image;
+}
+
+static TIFF* tiffOpen(std::istream& fin)
+{
+    return TIFFClientOpen("inputstream", "r", (thandle_t)&fin,
+                          tiffStreamReadProc, tiffStreamWriteProc,
+                          tiffStreamSeekProc, tiffStreamCloseProc,
+                          tiffStreamSizeProc, tiffStreamMapProc, tiffStreamUnmapProc);
+}
+
 #define CVT(x)      (((x) * 255L) / ((1L << 16) - 1))
 #define PACK(a, b)  ((a) << 8 | (b))
 
-static osg::ImageSequence* tiffLoad(std::istream& fin, const osgDB::Options* options)
+/** Read a region of one resolution level, which is useful for large GeoTIFF / COG files.
+    Overviews are reduced-resolution directories following the main image (masks are ignored).
+    Options:
+    - Overview=<n>: resolution level to read, 0 is the full resolution
+    - Window=<x,y,w,h>: region in full-resolution pixels, origin at top-left of the image
+    Tiles (or strips) are decoded in parallel, each thread with its own file handle if the
+    file name is known. Result image is flipped to bottom-up like the full reader */
+static osg::Image* tiffLoadWindow(TIFF* in, const std::string& fileName, const osgDB::Options* options,
+                                  uint16_t photometric, uint16_t samplesperpixel, uint16_t bitspersample)
+{
+    // Find all resolution levels
+    std::vector<std::pair<tdir_t, uint32_t>> levels;  // directory, width
+    uint32_t fullW = 0, fullH = 0;
+    TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &fullW); TIFFGetField(in, TIFFTAG_IMAGELENGTH, &fullH);
+    do
+    {
+        uint32_t subType = 0, width = 0; uint16_t samples = 0;
+        TIFFGetField(in, TIFFTAG_SUBFILETYPE, &subType);
+        TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(in, TIFFTAG_SAMPLESPERPIXEL, &samples);
+        if ((subType & FILETYPE_MASK) || samples != samplesperpixel) continue;
+        if (levels.empty() || width < levels.back().second)
+            levels.push_back(std::pair<tdir_t, uint32_t>(TIFFCurrentDirectory(in), width));
+    } while (TIFFReadDirectory(in));
+
+    int level = 0;
+    std::string overview = options ? options->getPluginStringData("Overview") : "";
+    if (!overview.empty()) level = osg::clampBetween(atoi(overview.c_str()), 0, (int)levels.size() - 1);
+    if (levels.empty() || !TIFFSetDirectory(in, levels[level].first))
+    {
+        OSG_WARN << "[ReaderWriterTiff] Unable to set directory of overview " << level << std::endl;
+        return NULL;
+    }
+
+    uint32_t w = 0, h = 0; uint16_t config = 0;
+    TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &w); TIFFGetField(in, TIFFTAG_IMAGELENGTH, &h);
+    TIFFGetField(in, TIFFTAG_PLANARCONFIG, &config);
+    double scaleX = (double)w / fullW, scaleY = (double)h / fullH;
+
+    // Compute window at current level
+    int x0 = 0, y0 = 0, x1 = w, y1 = h;
+    std::string window = options ? options->getPluginStringData("Window") : "";
+    if (!window.empty())
+    {
+        double wx = 0.0, wy = 0.0, ww = fullW, wh = fullH;
+        std::replace(window.begin(), window.end(), ',', ' ');
+        std::stringstream ss(window); ss >> wx >> wy >> ww >> wh;
+        x0 = osg::clampBetween((int)floor(wx * scaleX), 0, (int)w);
+        y0 = osg::clampBetween((int)floor(wy * scaleY), 0, (int)h);
+        x1 = osg::clampBetween((int)ceil((wx + ww) * scaleX), x0, (int)w);
+        y1 = osg::clampBetween((int)ceil((wy + wh) * scaleY), y0, (int)h);
+    }
+
+    int outW = x1 - x0, outH = y1 - y0;
+    if (outW <= 0 || outH <= 0)
+    {
+        OSG_WARN << "[ReaderWriterTiff] Empty window: " << window << std::endl;
+        return NULL;
+    }
+
+    // Blocks are either tiles or strips
+    bool tiled = TIFFIsTiled(in) != 0; uint32_t blockW = w, blockH = h;
+    if (tiled)
+    { TIFFGetField(in, TIFFTAG_TILEWIDTH, &blockW); TIFFGetField(in, TIFFTAG_TILELENGTH, &blockH); }
+    else
+        TIFFGetFieldDefaulted(in, TIFFTAG_ROWSPERSTRIP, &blockH);
+    blockH = osg::minimum(osg::maximum(blockH, 1u), h);
+
+    bool separated = (config == PLANARCONFIG_SEPARATE);
+    int numPlanes = separated ? samplesperpixel : 1, bytespersample = bitspersample / 8;
+    int bytesperpixel = bytespersample * samplesperpixel;
+    int planeBytes = separated ? bytespersample : bytesperpixel;
+    int bx0 = x0 / blockW, bx1 = (x1 - 1) / blockW, by0 = y0 / blockH, by1 = (y1 - 1) / blockH;
+    int numBlocksX = bx1 - bx0 + 1, numBlocks = numBlocksX * (by1 - by0 + 1) * numPlanes;
+
+    std::vector<unsigned char> raw((size_t)outW * outH * bytesperpixel);
+    bool parallel = !fileName.empty() && numBlocks > 1; int hasError = 0;
+    tdir_t directory = levels[level].first;
+#pragma omp parallel if (parallel) reduction(|:hasError)
+    {
+        std::ifstream localFile; TIFF* local = in;
+        if (parallel)
+        {
+            localFile.open(fileName.c_str(), std::ios::in | std::ios::binary);
+            local = tiffOpen(localFile);
+            if (local && !TIFFSetDirectory(local, directory)) { TIFFClose(local); local = NULL; }
+        }
+
+        tmsize_t blockSize = local ? (tiled ? TIFFTileSize(local) : TIFFStripSize(local)) : 0;
+        std::vector<unsigned char> blockData(osg::maximum(blockSize, (tmsize_t)1));
+#pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            int plane = i % numPlanes, bx = bx0 + (i / numPlanes) % numBlocksX,
+                by = by0 + (i / numPlanes) / numBlocksX;
+            uint32_t px = bx * blockW, py = by * blockH;
+            tmsize_t result = -1;
+            if (local == NULL) {}
+            else if (tiled)
+                result = TIFFReadTile(local, &blockData[0], px, py, 0, (tsample_t)plane);
+            else
+                result = TIFFReadEncodedStrip(local, TIFFComputeStrip(local, py, (tsample_t)plane),
+                                              &blockData[0], blockSize);
+            if (result < 0) { hasError = 1; continue; }
+
+            // Copy intersection of this block and the window
+            int cx0 = osg::maximum((int)px, x0), cx1 = osg::minimum((int)(px + blockW), x1);
+            int cy0 = osg::maximum((int)py, y0), cy1 = osg::minimum((int)(py + blockH), y1);
+            for (int y = cy0; y < cy1; ++y)
+            {
+                const unsigned char* src = &blockData[0] +
+                    ((size_t)(y - py) * blockW + (cx0 - px)) * planeBytes;
+                unsigned char* dst = &raw[0] + ((size_t)(y - y0) * outW + (cx0 - x0)) * bytesperpixel;
+                if (!separated) memcpy(dst, src, (cx1 - cx0) * bytesperpixel);
+                else
+                {
+                    dst += plane * bytespersample;
+                    for (int x = cx0; x < cx1; ++x, src += bytespersample, dst += bytesperpixel)
+                        memcpy(dst, src, bytespersample);
+                }
+            }
+        }
+        if (local && local != in) TIFFClose(local);
+    }
+
+    if (hasError)
+    {
+        OSG_WARN << "[ReaderWriterTiff] Failed to read blocks of overview " << level << std::endl;
+        return NULL;
+    }
+
+    // Convert to output image, bottom-up
+    uint16_t *red = NULL, *green = NULL, *blue = NULL;
+    int format = bytesperpixel;
+    if (photometric == PHOTOMETRIC_PALETTE)
+    {
+        if (bitspersample != 8 || TIFFGetField(in, TIFFTAG_COLORMAP, &red, &green, &blue) != 1)
+        {
+            OSG_WARN << "[ReaderWriterTiff] Unsupported palette image" << std::endl;
+            return NULL;
+        }
+        else if (checkColormap(1 << bitspersample, red, green, blue) == 16)
+        {
+            for (int i = (1 << bitspersample) - 1; i >= 0; --i)
+            { red[i] = CVT(red[i]); green[i] = CVT(green[i]); blue[i] = CVT(blue[i]); }
+        }
+        format = 3;
+    }
+
+    unsigned char* buffer = new unsigned char[(size_t)outW * outH * format];
+    for (int y = 0; y < outH; ++y)
+    {
+        unsigned char* src = &raw[0] + (size_t)y * outW * bytesperpixel;
+        unsigned char* dst = buffer + (size_t)(outH - 1 - y) * outW * format;
+        if (photometric == PHOTOMETRIC_PALETTE) remapRow(dst, src, outW, red, green, blue);
+        else invertRow(dst, src, samplesperpixel * outW,
+                       photometric == PHOTOMETRIC_MINISWHITE, bitspersample);
+    }
+
+    int numComponents = (photometric == PHOTOMETRIC_PALETTE) ? format : samplesperpixel;
+    osg::Image* image = createTiffImage(outW, outH, 1, buffer, numComponents, bitspersample);
+    if (!image) { delete[] buffer; return NULL; }
+
+    // Record actual level and window in full-resolution pixels, for pagers to place the result
+    image->setUserValue("TiffOverview", level);
+    image->setUserValue("TiffWindow", osg::Vec4(x0 / scaleX, y0 / scaleY, outW / scaleX, outH / scaleY));
+    return image;
+}
+
+static osg::ImageSequence* tiffLoad(std::istream& fin, const std::string& fileName,
+                                    const osgDB::Options* options)
 {
     TIFFSetErrorHandler(tiffError);
     TIFFSetWarningHandler(tiffWarn);
-    TIFF* in = TIFFClientOpen("inputstream", "r", (thandle_t)&fin,
-                              tiffStreamReadProc, tiffStreamWriteProc,
-                              tiffStreamSeekProc, tiffStreamCloseProc,
-                              tiffStreamSizeProc, tiffStreamMapProc, tiffStreamUnmapProc);
+    TIFF* in = tiffOpen(fin);
     if (in == NULL) { OSG_WARN << "[ReaderWriterTiff] Unable to open stream" << std::endl; return NULL; }
 
     uint16_t photometric = 0;
@@ -332,7 +534,16 @@ static osg::ImageSequence* tiffLoad(std::istream& fin, const osgDB::Options* opt
     TIFFGetField(in, TIFFTAG_IMAGEDEPTH, &d);
 
     osg::ref_ptr<osg::ImageSequence> seq = new osg::ImageSequence;
-    if (d > 1)
+    bool windowed = options && (!options->getPluginStringData("Window").empty() ||
+                                !options->getPluginStringData("Overview").empty());
+    if (d <= 1 && (windowed || TIFFIsTiled(in)))
+    {
+        // Tiled images (e.g., COG) can't be read by scanlines, so always go this way
+        osg::Image* image = tiffLoadWindow(in, fileName, options, photometric,
+                                           samplesperpixel, bitspersample);
+        if (image) seq->addImage(image);
+    }
+    else if (d > 1)
     {
         // TODO...
         OSG_WARN << "[ReaderWriterTiff] Unsupported dimension" << std::endl;
@@ -425,25 +636,8 @@ static osg::ImageSequence* tiffLoad(std::istream& fin, const osgDB::Options* opt
             }
 
             int numComponents = (photometric == PHOTOMETRIC_PALETTE) ? format : samplesperpixel;
-            unsigned int pixelFormat =
-                (numComponents) == 1 ? GL_LUMINANCE :
-                (numComponents) == 2 ? GL_LUMINANCE_ALPHA :
-                (numComponents) == 3 ? GL_RGB :
-                (numComponents) == 4 ? GL_RGBA : (GLenum)-1;
-            unsigned int dataType =
-                (bitspersample == 8) ? GL_UNSIGNED_BYTE :
-                (bitspersample == 16) ? GL_UNSIGNED_SHORT :
-                (bitspersample == 32) ? GL_FLOAT : (GLenum)-1;
-            unsigned int internalFormat = computeInternalFormat(pixelFormat, dataType);
-            if (internalFormat <= 0)
-            {
-                OSG_WARN << "[ReaderWriterTiff] Unsupported image format" << std::endl;
-                continue;
-            }
-
-            osg::Image* image = new osg::Image;
-            image->setImage(w, h, d, internalFormat, pixelFormat, dataType,
-                            buffer, osg::Image::USE_NEW_DELETE);
+            osg::Image* image = createTiffImage(w, h, d, buffer, numComponents, bitspersample);
+            if (!image) { delete[] buffer; continue; }
             seq->addImage(image);
         } while (TIFFReadDirectory(in));
     }
@@ -462,6 +656,8 @@ public:
         supportsExtension("verse_tiff", "osgVerse pseudo-loader");
         supportsExtension("tiff", "Tiff image format");
         supportsExtension("tif", "Tiff image format");
+        supportsOption("Overview=<n>", "Read option: resolution level, 0 is the full resolution");
+        supportsOption("Window=<x,y,w,h>", "Read option: region in full-resolution pixels, from top-left");
     }
 
     virtual const char* className() const
@@ -483,12 +679,17 @@ public:
         }
 
         std::ifstream in(fileName, std::ios::in | std::ios::binary);
-        return readImage(in, options);
+        return readImage(in, fileName, options);
     }
 
     virtual ReadResult readImage(std::istream& fin, const Options* options) const
+    { return readImage(fin, "", options); }
+
+    /// Known file name allows each thread to open its own handle for parallel tile decoding
+    ReadResult readImage(std::istream& fin, const std::string& fileName, const Options* options) const
     {
-        osg::ref_ptr<osg::ImageSequence> seq = tiffLoad(fin, options);
+        osg::ref_ptr<osg::ImageSequence> seq = tiffLoad(fin, fileName, options);
+        if (!seq) return ReadResult::ERROR_IN_READING_FILE;
 #if OSG_VERSION_GREATER_THAN(3, 3, 0)
         osg::ImageSequence::ImageDataList images = seq->getImageDataList();
         return images.empty() ? NULL : ((images.size() == 1) ?
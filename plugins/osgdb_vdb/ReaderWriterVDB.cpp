@@ -2,6 +2,7 @@
 #include <osg/ImageUtils>
 #include <osg/Image>
 #include <osg/ImageSequence>
+#include <osg/ValueObject>
 #include <osg/Geometry>
 #include <osg/Geode>
 #include <osgDB/FileNameUtils>
@@ -13,6 +14,7 @@
 #include <tbb/enumerable_thread_specific.h>
 #include <tbb/parallel_for.h>
 #include <openvdb/openvdb.h>
+#include <openvdb/tree/LeafManager.h>
 #include <openvdb/io/Stream.h>
 #include <openvdb/tools/VolumeToMesh.h>
 #include <openvdb/tools/MeshToVolume.h>
@@ -27,6 +29,7 @@ public:
         supportsExtension("vdb", "VDB point cloud and texture file");
         supportsOption("ReadDataType=<hint>", "Read option: <Mesh/Points>");
         supportsOption("DimensionScale=<hint>", "Read option: volume image size scale, default is 1.0");
+        supportsOption("BrickSize=<n>", "Read option: read as sparse brick atlas with n^3 bricks (8/16/32)");
         openvdb::initialize();
     }
 
@@ -180,6 +183,15 @@ public:
         std::vector<osg::ref_ptr<osg::Image>> images;
         std::string hintStr = options ? options->getPluginStringData("DimensionScale") : "1";
         float scale = atof(hintStr.c_str()); if (scale <= 0.0f) scale = 1.0f;
+
+        std::string brickStr = options ? options->getPluginStringData("BrickSize") : "";
+        int brickSize = brickStr.empty() ? 0 : atoi(brickStr.c_str());
+        if (brickSize != 0 && brickSize != 8 && brickSize != 16 && brickSize != 32)
+        {
+            OSG_WARN << "[ReaderWriterVDB] Unsupported BrickSize " << brickStr
+                     << ", which should be 8, 16 or 32" << std::endl;
+            return ReadResult::ERROR_IN_READING_FILE;
+        }
         for (size_t i = 0; i < grids->size(); ++i)
         {
             osg::ref_ptr<osg::Image> img = new osg::Image;
@@ -189,6 +201,18 @@ public:
                            osg::Image::computeNearestPowerOfTwo(bbox.dim().z() * scale));
 
             openvdb::FloatGrid::Ptr g0 = openvdb::gridPtrCast<openvdb::FloatGrid>((*grids)[i]);
+            openvdb::Int32Grid::Ptr g1 = openvdb::gridPtrCast<openvdb::Int32Grid>((*grids)[i]);
+            openvdb::DoubleGrid::Ptr g2 = openvdb::gridPtrCast<openvdb::DoubleGrid>((*grids)[i]);
+            if (brickSize > 0)
+            {
+                osg::ref_ptr<osg::Image> atlas;
+                if (g0) atlas = createBrickVolume(*g0, brickSize);
+                else if (g1) atlas = createBrickVolume(*g1, brickSize);
+                else if (g2) atlas = createBrickVolume(*g2, brickSize);
+                if (atlas.valid()) images.push_back(atlas);
+                continue;
+            }
+
             if (g0)
             {
                 img->allocateImage(res[0], res[1], res[2], GL_LUMINANCE, GL_UNSIGNED_BYTE);
@@ -197,7 +221,6 @@ public:
                 if (img->valid()) images.push_back(img);
             }
 
-            openvdb::Int32Grid::Ptr g1 = openvdb::gridPtrCast<openvdb::Int32Grid>((*grids)[i]);
             if (g1)
             {
                 img->allocateImage(res[0], res[1], res[2], GL_LUMINANCE, GL_UNSIGNED_BYTE);
@@ -206,7 +229,6 @@ public:
                 if (img->valid()) images.push_back(img);
             }
 
-            openvdb::DoubleGrid::Ptr g2 = openvdb::gridPtrCast<openvdb::DoubleGrid>((*grids)[i]);
             if (g2)
             {
                 img->allocateImage(res[0], res[1], res[2], GL_LUMINANCE, GL_UNSIGNED_BYTE);
@@ -358,7 +380,7 @@ public:
 protected:
     template<typename T> struct ValueRange
     {
-        ValueRange() : _min(std::numeric_limits<T>::max()), _max(std::numeric_limits<T>::min()) {}
+        ValueRange() : _min(std::numeric_limits<T>::max()), _max(std::numeric_limits<T>::lowest()) {}
         ValueRange(T min_v, T max_v) : m_min(min_v), m_max(max_v) {}
         void addValue(T value) { _min = std::min(_min, value); _max = std::max(_max, value); }
         T _min, _max;
@@ -418,6 +440,148 @@ protected:
         });
     }
 
+    /** Create an atlas of occupied bricks (1-voxel apron on each side for filtering) and an
+        indirection image (RGBA8: atlas brick coordinates, alpha = 0 for empty bricks).
+        Bricks are aligned to VDB leaf nodes, so each leaf lies in exactly one brick.
+        Check sampleBrickVolume() for the CPU reference of how to sample the result */
+    template<typename GridType>
+    osg::Image* createBrickVolume(const GridType& grid, int brickSize) const
+    {
+        typedef typename GridType::TreeType TreeType;
+        typedef typename GridType::ValueType ValueType;
+        openvdb::CoordBBox bbox = grid.evalActiveVoxelBoundingBox();
+        if (bbox.empty()) return NULL;
+
+        openvdb::Coord minB(floorDiv(bbox.min().x(), brickSize), floorDiv(bbox.min().y(), brickSize),
+                            floorDiv(bbox.min().z(), brickSize));
+        openvdb::Coord maxB(floorDiv(bbox.max().x(), brickSize), floorDiv(bbox.max().y(), brickSize),
+                            floorDiv(bbox.max().z(), brickSize));
+        openvdb::Coord numB = maxB - minB + openvdb::Coord(1, 1, 1);
+        if (numB.x() > 65535 || numB.y() > 65535 || numB.z() > 65535) return NULL;
+
+        // Compute value range in parallel over leaf nodes
+        openvdb::tree::LeafManager<const TreeType> leafManager(grid.tree());
+        tbb::enumerable_thread_specific<ValueRange<ValueType>> ranges;
+        tbb::parallel_for(leafManager.leafRange(),
+            [&ranges](const typename openvdb::tree::LeafManager<const TreeType>::LeafRange& range)
+        {
+            ValueRange<ValueType>& thisRange = ranges.local();
+            for (typename openvdb::tree::LeafManager<const TreeType>::LeafRange::Iterator leaf =
+                 range.begin(); leaf; ++leaf)
+            { for (auto v = leaf->cbeginValueOn(); v; ++v) thisRange.addValue(*v); }
+        });
+
+        // Mark occupied bricks from leaf nodes and active tiles
+        std::vector<unsigned char> occupied((size_t)numB.x() * numB.y() * numB.z(), 0);
+        std::function<void (const openvdb::CoordBBox&)> markBricks =
+            [&](const openvdb::CoordBBox& box)
+        {
+            for (int z = floorDiv(box.min().z(), brickSize); z <= floorDiv(box.max().z(), brickSize); ++z)
+                for (int y = floorDiv(box.min().y(), brickSize); y <= floorDiv(box.max().y(), brickSize); ++y)
+                    for (int x = floorDiv(box.min().x(), brickSize); x <= floorDiv(box.max().x(), brickSize); ++x)
+                    {
+                        openvdb::Coord c = openvdb::Coord(x, y, z) - minB;
+                        occupied[((size_t)c.z() * numB.y() + c.y()) * numB.x() + c.x()] = 1;
+                    }
+        };
+
+        for (size_t i = 0; i < leafManager.leafCount(); ++i)
+        {
+            const typename TreeType::LeafNodeType& leaf = leafManager.leaf(i);
+            if (!leaf.isEmpty()) markBricks(leaf.getNodeBoundingBox());
+        }
+
+        ValueRange<ValueType> valueRange;
+        typename GridType::ValueOnCIter tileItr = grid.cbeginValueOn();
+        tileItr.setMaxDepth(GridType::ValueOnCIter::LEAF_DEPTH - 1);
+        for (; tileItr; ++tileItr)
+        {
+            openvdb::CoordBBox tileBox; tileItr.getBoundingBox(tileBox);
+            tileBox.intersect(bbox); markBricks(tileBox); valueRange.addValue(*tileItr);
+        }
+
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+            const ValueRange<ValueType>& perThreadRange = *(ranges.begin() + i);
+            if (perThreadRange._max < perThreadRange._min) continue;  // no values in this thread
+            valueRange.addValue(perThreadRange._min); valueRange.addValue(perThreadRange._max);
+        }
+
+        std::vector<openvdb::Coord> bricks;
+        for (int z = 0; z < numB.z(); ++z) for (int y = 0; y < numB.y(); ++y)
+            for (int x = 0; x < numB.x(); ++x)
+            { if (occupied[((size_t)z * numB.y() + y) * numB.x() + x]) bricks.push_back(openvdb::Coord(x, y, z)); }
+        if (bricks.empty()) return NULL;
+
+        // Allocate the atlas as cube-like as possible
+        int padded = brickSize + 2, numBricks = (int)bricks.size();
+        int nx = (int)ceil(pow((double)numBricks, 1.0 / 3.0)), ny = nx;
+        int nz = (numBricks + nx * ny - 1) / (nx * ny);
+        if (nx > 256 || nz > 256)
+        {
+            OSG_WARN << "[ReaderWriterVDB] Too many bricks: " << numBricks << std::endl;
+            return NULL;
+        }
+        else if (nx * padded > 2048 || nz * padded > 2048)
+            OSG_NOTICE << "[ReaderWriterVDB] Brick atlas " << nx * padded << "x" << ny * padded << "x"
+                       << nz * padded << " may exceed 3D texture limits" << std::endl;
+
+        osg::ref_ptr<osg::Image> atlas = new osg::Image;
+        atlas->allocateImage(nx * padded, ny * padded, nz * padded, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+        atlas->setInternalTextureFormat(GL_LUMINANCE8);
+        memset(atlas->data(), 0, atlas->getTotalSizeInBytes());
+
+        osg::ref_ptr<osg::Image> indirection = new osg::Image;
+        indirection->allocateImage(numB.x(), numB.y(), numB.z(), GL_RGBA, GL_UNSIGNED_BYTE);
+        indirection->setInternalTextureFormat(GL_RGBA8);
+        memset(indirection->data(), 0, indirection->getTotalSizeInBytes());
+
+        // Fill bricks (with aprons) in parallel, each task with its own cached accessor
+        double minValue = (double)valueRange._min, maxValue = (double)valueRange._max;
+        double inv = (maxValue > minValue) ? 1.0 / (maxValue - minValue) : 1.0;
+        tbb::parallel_for(tbb::blocked_range<int>(0, numBricks),
+            [&](const tbb::blocked_range<int>& range)
+        {
+            typename GridType::ConstAccessor accessor = grid.getConstAccessor();
+            for (int b = range.begin(); b < range.end(); ++b)
+            {
+                int ax = b % nx, ay = (b / nx) % ny, az = b / (nx * ny);
+                openvdb::Coord origin = scaled(bricks[b] + minB, brickSize);
+                for (int k = 0; k < padded; ++k) for (int j = 0; j < padded; ++j)
+                {
+                    unsigned char* ptr = atlas->data(ax * padded, ay * padded + j, az * padded + k);
+                    for (int i = 0; i < padded; ++i)
+                    {
+                        openvdb::Coord c = origin + openvdb::Coord(i - 1, j - 1, k - 1);
+                        double v = ((double)accessor.getValue(c) - minValue) * inv;
+                        *(ptr + i) = (unsigned char)(osg::clampBetween(v, 0.0, 1.0) * 255.0);
+                    }
+                }
+
+                unsigned char* entry = indirection->data(bricks[b].x(), bricks[b].y(), bricks[b].z());
+                entry[0] = ax; entry[1] = ay; entry[2] = az; entry[3] = 255;
+            }
+        });
+
+        openvdb::Coord originVoxel = scaled(minB, brickSize), dimVoxel = scaled(numB, brickSize);
+        atlas->setName(grid.getName());
+        atlas->setUserValue("BrickSize", brickSize);
+        atlas->setUserValue("BrickOrigin", osg::Vec3(originVoxel.x(), originVoxel.y(), originVoxel.z()));
+        atlas->setUserValue("VoxelDimensions", osg::Vec3(dimVoxel.x(), dimVoxel.y(), dimVoxel.z()));
+        atlas->setUserValue("ValueRange", osg::Vec2(minValue, maxValue));
+        indirection->setName("BrickIndirection");
+        atlas->getOrCreateUserDataContainer()->addUserObject(indirection.get());
+        OSG_NOTICE << "[ReaderWriterVDB] " << grid.getName() << ": " << numBricks << " of "
+                   << occupied.size() << " bricks occupied" << std::endl;
+        return atlas.release();
+    }
+
+    static int floorDiv(int a, int b)
+    { return (a >= 0) ? (a / b) : -((-a + b - 1) / b); }
+
+    static openvdb::Coord scaled(const openvdb::Coord& c, int s)
+    { return openvdb::Coord(c.x() * s, c.y() * s, c.z() * s); }
+
     osg::DrawElementsUInt* createTreeTopology(openvdb::FloatGrid& grid, osg::Vec3Array* va,
                                               osg::Vec3Array* na, osg::Vec4Array* ca) const
     {
@@ -7,7 +7,195 @@
 #include <osgDB/Registry>
 
 #include "3rdparty/libhv/all/client/requests.h"
+#include "3rdparty/libhv/all/client/AsyncHttpClient.h"
 #include <readerwriter/Utilities.h>
+#include <ghc/filesystem.hpp>
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <ctime>
+
+static int getIntOption(const osgDB::Options* options, const std::string& name, int defValue)
+{
+    std::string value = options ? options->getPluginStringData(name) : "";
+    return value.empty() ? defValue : atoi(value.c_str());
+}
+
+/** On-disk cache of fetched web files. Each URL is saved as <xxhash64>.cache, starting with
+    a small header (URL, ETag, Last-Modified and expiring time) and followed by the body.
+    Least recently used files are removed when total size exceeds the limit */
+class WebDiskCache : public osg::Referenced
+{
+public:
+    struct Entry
+    {
+        std::string url, etag, lastModified, body;
+        int64_t expiry; Entry() : expiry(0) {}
+        bool expired() const { return expiry <= (int64_t)time(NULL); }
+    };
+
+    WebDiskCache(const std::string& dir, uint64_t maxSize)
+    :   _directory(dir), _maxSize(maxSize), _totalSize(0), _accessCount(0)
+    {
+        std::error_code ec; ghc::filesystem::create_directories(dir, ec);
+        for (auto itr : ghc::filesystem::directory_iterator(dir, ec))
+        {
+            const ghc::filesystem::path& file = itr.path();
+            if (file.extension() != ".cache") continue;
+
+            uint64_t size = ghc::filesystem::file_size(file, ec);
+            if (ec) continue;
+            _index[file.filename().string()] = FileState(size, 0);
+            _totalSize += size;
+        }
+    }
+
+    bool read(const std::string& url, Entry& entry)
+    {
+        std::string name = getCacheName(url);
+        std::ifstream in(_directory + "/" + name, std::ios::in | std::ios::binary);
+        if (!in) return false;
+
+        char magic[4] = { 0 }; in.read(magic, 4);
+        if (strncmp(magic, "VWC1", 4) != 0) return false;
+        entry.url = readString(in); if (entry.url != url) return false;  // hash collision
+        entry.etag = readString(in); entry.lastModified = readString(in);
+        in.read((char*)&entry.expiry, sizeof(int64_t));
+        entry.body = std::string((std::istreambuf_iterator<char>(in)),
+                                 std::istreambuf_iterator<char>());
+        if (in.bad()) return false;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::map<std::string, FileState>::iterator itr = _index.find(name);
+        if (itr != _index.end()) itr->second.second = ++_accessCount;
+        return true;
+    }
+
+    bool write(const Entry& entry)
+    {
+        std::string name = getCacheName(entry.url), file = _directory + "/" + name;
+        std::string tempFile = file + "." + std::to_string((size_t)&entry) + ".tmp";
+        {
+            std::ofstream out(tempFile, std::ios::out | std::ios::binary);
+            if (!out) return false;
+            out.write("VWC1", 4); writeString(out, entry.url);
+            writeString(out, entry.etag); writeString(out, entry.lastModified);
+            out.write((char*)&entry.expiry, sizeof(int64_t));
+            out.write(entry.body.data(), entry.body.size());
+            if (!out) { out.close(); std::remove(tempFile.c_str()); return false; }
+        }
+
+        // Rename after fully written, so other readers/processes never see partial files
+        std::error_code ec; ghc::filesystem::rename(tempFile, file, ec);
+        if (ec) { std::remove(tempFile.c_str()); return false; }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        FileState& state = _index[name]; _totalSize -= state.first;
+        state.first = ghc::filesystem::file_size(file, ec);
+        state.second = ++_accessCount; _totalSize += state.first;
+        if (_totalSize > _maxSize) trim(_maxSize * 9 / 10);
+        return true;
+    }
+
+protected:
+    typedef std::pair<uint64_t, uint64_t> FileState;  // size, last access
+
+    std::string getCacheName(const std::string& url) const
+    {
+        std::stringstream ss; ss << std::hex << XXH64(url.data(), url.size(), 0);
+        return ss.str() + ".cache";
+    }
+
+    static std::string readString(std::istream& in)
+    {
+        unsigned int size = 0; in.read((char*)&size, sizeof(unsigned int));
+        if (!in || size > 65536) return "";
+        std::string value(size, '\0'); if (size > 0) in.read(&value[0], size);
+        return value;
+    }
+
+    static void writeString(std::ostream& out, const std::string& value)
+    {
+        unsigned int size = value.size(); out.write((char*)&size, sizeof(unsigned int));
+        out.write(value.data(), size);
+    }
+
+    void trim(uint64_t targetSize)
+    {
+        std::vector<std::pair<uint64_t, std::string>> accessList;
+        for (std::map<std::string, FileState>::iterator itr = _index.begin();
+             itr != _index.end(); ++itr) accessList.push_back(std::make_pair(itr->second.second, itr->first));
+        std::sort(accessList.begin(), accessList.end());
+
+        for (size_t i = 0; i < accessList.size() && _totalSize > targetSize; ++i)
+        {
+            const std::string& name = accessList[i].second; std::error_code ec;
+            ghc::filesystem::remove(_directory + "/" + name, ec);
+            _totalSize -= _index[name].first; _index.erase(name);
+        }
+    }
+
+    std::map<std::string, FileState> _index;
+    std::string _directory;
+    std::mutex _mutex;
+    uint64_t _maxSize, _totalSize, _accessCount;
+};
+
+/** Shared asynchronous HTTP client. libhv keeps alive connections per peer in its event loop,
+    so successive requests to the same host reuse sockets. Number of concurrent requests to
+    one host is also limited here, so that paging threads don't flood the server */
+class WebFetchPool : public osg::Referenced
+{
+public:
+    WebFetchPool() : _client(new hv::AsyncHttpClient) {}
+
+    HttpResponsePtr fetch(const HttpRequestPtr& req, int maxPerHost)
+    {
+        std::string host = osgDB::getServerAddress(req->url);
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [&]() { return _numActive[host] < maxPerHost; });
+            _numActive[host]++;
+        }
+
+        std::shared_ptr<std::promise<HttpResponsePtr>> promise =
+            std::make_shared<std::promise<HttpResponsePtr>>();
+        std::future<HttpResponsePtr> future = promise->get_future();
+        WebFetchPool* pool = this;  // client is deleted first in destructor, so no callback after
+        _client->send(req, [promise, pool, host](const HttpResponsePtr& resp)
+        {
+            // Release the host slot only when the request really ends (libhv also calls back
+            // on errors), even if the caller stopped waiting, so the per-host limit holds
+            pool->release(host);
+            try { promise->set_value(resp); }
+            catch (std::future_error&) {}  // already satisfied
+        });
+
+        // libhv closes timed out connections itself, but don't wait forever in any case
+        HttpResponsePtr response;
+        if (req->timeout <= 0) response = future.get();
+        else if (future.wait_for(std::chrono::seconds(req->timeout + 5)) == std::future_status::ready)
+            response = future.get();
+        return response;
+    }
+
+protected:
+    virtual ~WebFetchPool() { delete _client; }
+
+    void release(const std::string& host)
+    {
+        { std::unique_lock<std::mutex> lock(_mutex); _numActive[host]--; }
+        _condition.notify_all();
+    }
+
+    hv::AsyncHttpClient* _client;
+    std::map<std::string, int> _numActive;
+    std::condition_variable _condition;
+    std::mutex _mutex;
+};
 
 class ReaderWriterWeb : public osgDB::ReaderWriter
 {
@@ -17,6 +205,9 @@ public:
     ReaderWriterWeb()
     {
         _client = new hv::HttpClient;
+#ifndef __EMSCRIPTEN__
+        _fetchPool = new WebFetchPool;
+#endif
 
         supportsProtocol("http", "Read from http port using libhv.");
         supportsProtocol("https", "Read from https port using libhv.");
@@ -28,6 +219,10 @@ public:
         // osgviewer --image ftp://ftp.techtrade.si/SLIKE/0002133.jpg.verse_web
         supportsExtension("verse_web", "Pseudo file extension, used to select libhv plugin.");
         supportsExtension("*", "Passes all read files to other plugins to handle actual model loading.");
+        supportsOption("CacheDirectory=<path>", "Save fetched files to local disk cache and revalidate them");
+        supportsOption("CacheMaxSize=<MB>", "Max size of the disk cache, default is 1024MB");
+        supportsOption("MaxConnectionsPerHost=<n>", "Max concurrent requests to one host, default is 6");
+        supportsOption("Timeout=<s>", "Request timeout in seconds, default is 60");
     }
 
     virtual ~ReaderWriterWeb()
@@ -175,29 +370,66 @@ public:
         std::stringstream buffer(std::ios::in | std::ios::out | std::ios::binary);
         buffer.write((char*)&wf->buffer[0], wf->buffer.size());
 #else
-        HttpRequest req;
+        std::string cacheDir = options ? options->getPluginStringData("CacheDirectory") : "";
+        osg::ref_ptr<WebDiskCache> cache = cacheDir.empty() ? NULL : getOrCreateCache(
+            cacheDir, (uint64_t)getIntOption(options, "CacheMaxSize", 1024) * 1024 * 1024);
 
-        // Read data from web
-        req.method = HTTP_GET;
-        req.url = fileName;
-        req.scheme = scheme;
-
-        HttpResponse response;
-        int result = _client->send(&req, &response);
-        if (result != 0)
+        WebDiskCache::Entry cached; cached.url = fileName;
+        bool hasCache = cache.valid() && cache->read(fileName, cached);
+        std::stringstream buffer(std::ios::in | std::ios::out | std::ios::binary);
+        if (hasCache && !cached.expired())
+            buffer.write(cached.body.data(), cached.body.size());
+        else
         {
-            OSG_WARN << "[libhv] Failed getting " << fileName << ": " << result << std::endl;
-            return ReadResult::ERROR_IN_READING_FILE;
+            // Read data from web, with conditional headers if we have a stale copy
+            HttpRequestPtr req(new HttpRequest);
+            req->method = HTTP_GET;
+            req->url = fileName;
+            req->scheme = scheme;
+            req->timeout = getIntOption(options, "Timeout", 60);
+            if (hasCache && !cached.etag.empty()) req->headers["If-None-Match"] = cached.etag;
+            if (hasCache && !cached.lastModified.empty())
+                req->headers["If-Modified-Since"] = cached.lastModified;
+
+            HttpResponsePtr response = _fetchPool->fetch(
+                req, osg::maximum(getIntOption(options, "MaxConnectionsPerHost", 6), 1));
+            if (!response)
+            {
+                if (!hasCache)
+                {
+                    OSG_WARN << "[libhv] Failed getting " << fileName << std::endl;
+                    return ReadResult::ERROR_IN_READING_FILE;
+                }
+                OSG_NOTICE << "[libhv] Failed getting " << fileName
+                           << ", using stale cache instead" << std::endl;
+                buffer.write(cached.body.data(), cached.body.size());
+            }
+            else if (hasCache && response->status_code == HTTP_STATUS_NOT_MODIFIED)
+            {
+                cached.expiry = getExpiryTime(*response);
+                cache->write(cached);  // refresh expiring time
+                buffer.write(cached.body.data(), cached.body.size());
+            }
+            else if (response->status_code > 200 || response->body.empty())
+            {
+                OSG_WARN << "[libhv] Failed getting " << fileName << ": Code = "
+                         << response->status_code << ", Size = " << response->body.size() << std::endl;
+                return ReadResult::ERROR_IN_READING_FILE;
+            }
+            else
+            {
+                if (cache.valid())
+                {
+                    cached.etag = response->GetHeader("ETag");
+                    cached.lastModified = response->GetHeader("Last-Modified");
+                    cached.expiry = getExpiryTime(*response);
+                    cached.body.swap(response->body); cache->write(cached);
+                    buffer.write(cached.body.data(), cached.body.size());
+                }
+                else
+                    buffer.write((char*)response->body.data(), response->body.size());
+            }
         }
-        else if (response.status_code > 200 || response.body.empty())
-        {
-            OSG_WARN << "[libhv] Failed getting " << fileName << ": Code = "
-                     << response.status_code << ", Size = " << response.body.size() << std::endl;
-            return ReadResult::ERROR_IN_READING_FILE;
-        }
-
-        std::stringstream buffer(std::ios::in | std::ios::out | std::ios::binary);
-        buffer.write((char*)response.body.data(), response.body.size());
 #endif
 
         // Load by other readerwriter
@@ -267,11 +499,35 @@ public:
         req.headers["Connection"] = connection;
         req.headers["Content-Type"] = mimeType;
 
+        std::lock_guard<std::mutex> lock(_clientMutex);  // hv::HttpClient is not thread-safe
         HttpResponse response; int code = _client->send(&req, &response);
         return (code != 0) ? WriteResult::ERROR_IN_WRITING_FILE : WriteResult::FILE_SAVED;
     }
 
 protected:
+    /// Compute expiring time from Cache-Control max-age; otherwise revalidate at next reading
+    static int64_t getExpiryTime(HttpResponse& response)
+    {
+        std::string control = response.GetHeader("Cache-Control");
+        if (control.find("no-cache") != std::string::npos ||
+            control.find("no-store") != std::string::npos) return 0;
+
+        size_t pos = control.find("max-age=");
+        if (pos == std::string::npos) return 0;
+        return (int64_t)time(NULL) + atol(control.c_str() + pos + 8);
+    }
+
+    WebDiskCache* getOrCreateCache(const std::string& dir, uint64_t maxSize) const
+    {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        osg::ref_ptr<WebDiskCache>& cache = _caches[dir];
+        if (!cache) cache = new WebDiskCache(dir, maxSize);
+        return cache.get();
+    }
+
+    mutable std::map<std::string, osg::ref_ptr<WebDiskCache>> _caches;
+    mutable std::mutex _cacheMutex, _clientMutex;
+    osg::ref_ptr<WebFetchPool> _fetchPool;
     hv::HttpClient* _client;
 };
 
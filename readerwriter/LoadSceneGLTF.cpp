@@ -24,6 +24,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "LoadSceneGLTF.h"
+#include "MeshoptProcessor.h"
 #include "Utilities.h"
 
 namespace osgVerse
@@ -173,6 +174,15 @@ namespace osgVerse
         return 8 * sizeof(int) + header[3] + header[4] + header[5] + header[6];
     }
 
+    static bool DeferImageData(tinygltf::Image* image, const int image_idx, std::string* err,
+                               std::string* warn, int req_width, int req_height,
+                               const unsigned char* bytes, int size, void* user_data)
+    {
+        // Keep encoded bytes only, they will be decoded in parallel after parsing
+        image->image.assign(bytes, bytes + size);
+        image->width = image->height = -1; return true;
+    }
+
     bool LoadImageDataEx(tinygltf::Image* image, const int image_idx, std::string* err,
                          std::string* warn, int req_width, int req_height,
                          const unsigned char* bytes, int size, void* user_data)
@@ -275,7 +285,9 @@ namespace osgVerse
         stbi_image_free(data); return true;
     }
 
-    LoaderGLTF::LoaderGLTF(std::istream& in, const std::string& d, bool isBinary)
+    LoaderGLTF::LoaderGLTF(std::istream& in, const std::string& d, bool isBinary,
+                           bool parallel, bool keepQuantized)
+        : _parallel(parallel), _keepQuantized(keepQuantized)
     {
         std::string protocol = osgDB::getServerProtocol(d);
         osgDB::ReaderWriter* rwWeb = (protocol.empty()) ? NULL
@@ -291,9 +303,11 @@ namespace osgVerse
         std::vector<char> data(std::istreambuf_iterator<char>(in), eos);
         if (data.empty()) { OSG_WARN << "[LoaderGLTF] Unable to read from stream\n"; return; }
 
-        tinygltf::TinyGLTF loader;
+        tinygltf::TinyGLTF loader; tinygltf::LoadImageDataOption imageOption;
+        imageOption.preserve_channels = true;
         loader.SetStoreOriginalJSONForExtrasAndExtensions(true);
-        loader.SetImageLoader(&LoadImageDataEx, this);
+        if (_parallel) loader.SetImageLoader(&DeferImageData, NULL);
+        else loader.SetImageLoader(&LoadImageDataEx, &imageOption);
         loader.SetFsCallbacks(fs);
         if (isBinary)
         {
@@ -340,6 +354,8 @@ namespace osgVerse
         if (!err.empty()) OSG_WARN << "[LoaderGLTF] Errors found: " << err << std::endl;
         if (!warn.empty()) OSG_WARN << "[LoaderGLTF] Warnings found: " << warn << std::endl;
         if (!loaded) { OSG_WARN << "[LoaderGLTF] Unable to load GLTF scene" << std::endl; return; }
+        if (_parallel) decodeImages();
+        decodeMeshoptBuffers();
 
         if (rtcCenter.length2() > 0.0)
         {
@@ -392,10 +408,33 @@ namespace osgVerse
         }
 
         // Load geometries to geodes (after all nodes have registered with an ID)
+        std::map<int, size_t> staticMeshOwners; std::vector<size_t> staticMeshes;
         for (size_t i = 0; i < _deferredMeshList.size(); ++i)
         {
             DeferredMeshData& mData = _deferredMeshList[i];
-            createMesh(mData.meshRoot.get(), mData.mesh, mData.skinIndex);
+            if (!_parallel || !isStaticMesh(mData))
+                createMesh(mData.meshRoot.get(), _modelDef.meshes[mData.meshIndex], mData.skinIndex);
+            else if (staticMeshOwners.find(mData.meshIndex) == staticMeshOwners.end())
+                { staticMeshOwners[mData.meshIndex] = i; staticMeshes.push_back(i); }
+        }
+
+        // Static meshes don't touch shared scene data except materials, so decode them in parallel
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < (int)staticMeshes.size(); ++i)
+        {
+            DeferredMeshData& mData = _deferredMeshList[staticMeshes[i]];
+            createMesh(mData.meshRoot.get(), _modelDef.meshes[mData.meshIndex], mData.skinIndex);
+        }
+
+        for (size_t i = 0; i < _deferredMeshList.size() && !staticMeshes.empty(); ++i)
+        {
+            DeferredMeshData& mData = _deferredMeshList[i];
+            std::map<int, size_t>::iterator itr = staticMeshOwners.find(mData.meshIndex);
+            if (itr == staticMeshOwners.end() || itr->second == i || !isStaticMesh(mData)) continue;
+
+            osg::Geode* owner = _deferredMeshList[itr->second].meshRoot.get();
+            for (unsigned int j = 0; j < owner->getNumDrawables(); ++j)
+                mData.meshRoot->addDrawable(owner->getDrawable(j));
         }
 
         // Configure skinning data and player objects
@@ -495,8 +534,7 @@ namespace osgVerse
         if (geode.valid())
         {
             geode->setName(node.name + "_Geode");
-            _deferredMeshList.push_back(
-                DeferredMeshData(geode.get(), _modelDef.meshes[node.mesh], node.skin));
+            _deferredMeshList.push_back(DeferredMeshData(geode.get(), node.mesh, node.skin));
         }
         /*if (emptyTRS && emptyM && node.children.empty())
         {
@@ -529,6 +567,65 @@ namespace osgVerse
         group->setMatrix(matrix); return group.release();
     }
 
+    static osg::BoundingBox getAccessorBound(const tinygltf::Accessor& accessor)
+    {
+        osg::BoundingBox bb;
+        if (accessor.minValues.size() < 3 || accessor.maxValues.size() < 3) return bb;
+        osg::Vec3 minV(accessor.minValues[0], accessor.minValues[1], accessor.minValues[2]);
+        osg::Vec3 maxV(accessor.maxValues[0], accessor.maxValues[1], accessor.maxValues[2]);
+        if (accessor.normalized && (maxV.length2() > 3.0f || minV.length2() > 3.0f))
+        {
+            // Some exporters write integer ranges instead of normalized ones
+            float scale = 1.0f;
+            switch (accessor.componentType)
+            {
+            case TINYGLTF_COMPONENT_TYPE_BYTE: scale = 1.0f / 127.0f; break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: scale = 1.0f / 255.0f; break;
+            case TINYGLTF_COMPONENT_TYPE_SHORT: scale = 1.0f / 32767.0f; break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: scale = 1.0f / 65535.0f; break;
+            default: break;
+            }
+            minV *= scale; maxV *= scale;
+        }
+        bb.set(minV, maxV); return bb;
+    }
+
+    static float readNormalizedComponent(const unsigned char* ptr, int componentType, bool normalized)
+    {
+        switch (componentType)
+        {
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+            { float v = *(const signed char*)ptr; return normalized ? osg::maximum(v / 127.0f, -1.0f) : v; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            { float v = *ptr; return normalized ? v / 255.0f : v; }
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+            { float v = *(const short*)ptr; return normalized ? osg::maximum(v / 32767.0f, -1.0f) : v; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            { float v = *(const unsigned short*)ptr; return normalized ? v / 65535.0f : v; }
+        case TINYGLTF_COMPONENT_TYPE_FLOAT: return *(const float*)ptr;
+        default: return 0.0f;
+        }
+    }
+
+    template<typename ArrayType>
+    static ArrayType* createFloatArray(const tinygltf::Accessor& accessor, const unsigned char* src,
+                                       size_t stride, int compNum)
+    {
+        int compSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        int numToRead = osg::minimum(compNum, (int)ArrayType::ElementDataType::num_components);
+        size_t step = (stride > 0) ? stride : (size_t)(compSize * compNum);
+
+        ArrayType* arr = new ArrayType(accessor.count);
+        for (size_t i = 0; i < accessor.count; ++i)
+        {
+            const unsigned char* ptr = src + i * step;
+            for (int c = 0; c < numToRead; ++c)
+                (*arr)[i][c] = readNormalizedComponent(
+                    ptr + c * compSize, accessor.componentType, accessor.normalized);
+        }
+        return arr;
+    }
+
     bool LoaderGLTF::createMesh(osg::Geode* geode, tinygltf::Mesh& mesh, int skinIndex)
     {
         SkinningData* sd = (skinIndex < 0) ? NULL : &_skinningDataList[skinIndex];
@@ -545,7 +642,8 @@ namespace osgVerse
             geom->setName(mesh.name + "_" + std::to_string(i));
             geom->setUseDisplayList(false); geom->setUseVertexBufferObjects(true);
 
-            tinygltf::Primitive primitive = mesh.primitives[i];
+            tinygltf::Primitive& primitive = mesh.primitives[i];
+            bool animated = (sd != NULL) || !primitive.targets.empty();
             for (std::map<std::string, int>::iterator attrib = primitive.attributes.begin();
                 attrib != primitive.attributes.end(); ++attrib)
             {
@@ -563,10 +661,42 @@ namespace osgVerse
 
                 //std::cout << attrib->first << ": Size = " << size << ", Components = " << compNum
                 //          << ", ComponentBytes = " << compSize << std::endl;
-                if (attrib->first.compare("POSITION") == 0 && compSize == 4 && compNum == 3)
+                const std::string& name = attrib->first;
+                if (compSize < 4 && compNum > 1 && (name == "POSITION" || name == "NORMAL" ||
+                    name == "TANGENT" || name == "COLOR_0" || name.find("TEXCOORD_") == 0))
                 {
-                    osg::Vec3Array* va = new osg::Vec3Array(size);
-                    copyBufferData(&(*va)[0], &buffer.data[offset], copySize, stride, size);
+                    // KHR_mesh_quantization: convert to floating arrays, as fixed-function
+                    // rendering and most modeling utilities expect Vec*Array. Integer data is
+                    // kept compact only if required, and never for animated meshes
+                    osg::Array* arr = createQuantizedArray(
+                        attrAccessor, &buffer.data[offset], stride, _keepQuantized && !animated);
+                    if (!arr) continue;
+#if OSG_VERSION_GREATER_THAN(3, 1, 8)
+                    if (name == "POSITION")
+                    {
+                        // Integer vertices are not handled by OSG bound computing
+                        osg::BoundingBox bb = getAccessorBound(attrAccessor);
+                        geom->setVertexArray(arr);
+                        if (arr->getDataType() != GL_FLOAT && bb.valid()) geom->setInitialBound(bb);
+                    }
+                    else if (name == "NORMAL") geom->setNormalArray(arr, osg::Array::BIND_PER_VERTEX);
+                    else if (name == "TANGENT") geom->setVertexAttribArray(6, arr, osg::Array::BIND_PER_VERTEX);
+                    else if (name == "COLOR_0") geom->setColorArray(arr, osg::Array::BIND_PER_VERTEX);
+                    else geom->setTexCoordArray(atoi(name.substr(9).c_str()), arr);
+#else
+                    if (name == "POSITION") geom->setVertexArray(arr);
+                    else if (name == "NORMAL")
+                    { geom->setNormalArray(arr); geom->setNormalBinding(osg::Geometry::BIND_PER_VERTEX); }
+                    else if (name == "TANGENT")
+                    { geom->setVertexAttribArray(6, arr); geom->setVertexAttribBinding(6, osg::Geometry::BIND_PER_VERTEX); }
+                    else if (name == "COLOR_0")
+                    { geom->setColorArray(arr); geom->setColorBinding(osg::Geometry::BIND_PER_VERTEX); }
+                    else geom->setTexCoordArray(atoi(name.substr(9).c_str()), arr);
+#endif
+                }
+                else if (attrib->first.compare("POSITION") == 0 && compSize == 4 && compNum == 3)
+                {
+                    osg::Vec3Array* va = createBufferArray<osg::Vec3Array>(&buffer.data[offset], stride, size);
 #if OSG_VERSION_GREATER_THAN(3, 1, 8)
                     va->setNormalize(attrAccessor.normalized);
 #endif
@@ -574,8 +704,7 @@ namespace osgVerse
                 }
                 else if (attrib->first.compare("NORMAL") == 0 && compSize == 4 && compNum == 3)
                 {
-                    osg::Vec3Array* na = new osg::Vec3Array(size);
-                    copyBufferData(&(*na)[0], &buffer.data[offset], copySize, stride, size);
+                    osg::Vec3Array* na = createBufferArray<osg::Vec3Array>(&buffer.data[offset], stride, size);
 #if OSG_VERSION_GREATER_THAN(3, 1, 8)
                     na->setNormalize(attrAccessor.normalized);
                     geom->setNormalArray(na, osg::Array::BIND_PER_VERTEX);
@@ -585,8 +714,7 @@ namespace osgVerse
                 }
                 else if (attrib->first.compare("COLOR") == 0 && compNum == 4 && compSize == 4)
                 {
-                    osg::Vec4Array* ca = new osg::Vec4Array(size);
-                    copyBufferData(&(*ca)[0], &buffer.data[offset], copySize, stride, size);
+                    osg::Vec4Array* ca = createBufferArray<osg::Vec4Array>(&buffer.data[offset], stride, size);
 #if OSG_VERSION_GREATER_THAN(3, 1, 8)
                     ca->setNormalize(attrAccessor.normalized);
                     geom->setColorArray(ca, osg::Array::BIND_PER_VERTEX);
@@ -596,8 +724,7 @@ namespace osgVerse
                 }
                 else if (attrib->first.compare("TANGENT") == 0 && compSize == 4 && compNum == 4)
                 {
-                    osg::Vec4Array* ta = new osg::Vec4Array(size);
-                    copyBufferData(&(*ta)[0], &buffer.data[offset], copySize, stride, size);
+                    osg::Vec4Array* ta = createBufferArray<osg::Vec4Array>(&buffer.data[offset], stride, size);
 #if OSG_VERSION_GREATER_THAN(3, 1, 8)
                     ta->setNormalize(attrAccessor.normalized);
                     geom->setVertexAttribArray(6, ta, osg::Array::BIND_PER_VERTEX);
@@ -607,8 +734,7 @@ namespace osgVerse
                 }
                 else if (attrib->first.find("TEXCOORD_") != std::string::npos && compSize == 4 && compNum == 2)
                 {
-                    osg::Vec2Array* ta = new osg::Vec2Array(size);
-                    copyBufferData(&(*ta)[0], &buffer.data[offset], copySize, stride, size);
+                    osg::Vec2Array* ta = createBufferArray<osg::Vec2Array>(&buffer.data[offset], stride, size);
 #if OSG_VERSION_GREATER_THAN(3, 1, 8)
                     ta->setNormalize(attrAccessor.normalized);
 #endif
@@ -649,12 +775,12 @@ namespace osgVerse
             // Configure primitive index array
             tinygltf::Accessor indexAccessor = _modelDef.accessors[primitive.indices];
             const tinygltf::BufferView& indexView = _modelDef.bufferViews[indexAccessor.bufferView];
-            osg::Vec3Array* va = static_cast<osg::Vec3Array*>(geom->getVertexArray());
-            if (!va || (va && va->empty())) continue;
+            osg::Array* va = geom->getVertexArray();
+            if (!va || (va && va->getNumElements() == 0)) continue;
 
             osg::ref_ptr<osg::PrimitiveSet> p;
             if (indexView.target == 0)
-                p = new osg::DrawArrays(GL_POINTS, 0, va->size());
+                p = new osg::DrawArrays(GL_POINTS, 0, va->getNumElements());
             else  // ELEMENT_ARRAY_BUFFER = 34963
             {
                 const tinygltf::Buffer& indexBuffer = _modelDef.buffers[indexView.buffer];
@@ -668,20 +794,38 @@ namespace osgVerse
                 {
                 case 1:
                     {
-                        osg::DrawElementsUByte* de = new osg::DrawElementsUByte(GL_POINTS, size); p = de;
-                        copyBufferData(&(*de)[0], &indexBuffer.data[offset], size * compSize, stride, size);
+                        osg::DrawElementsUByte* de = NULL; const GLubyte* src = (const GLubyte*)&indexBuffer.data[offset];
+                        if (stride == 0) de = new osg::DrawElementsUByte(GL_POINTS, size, src);
+                        else
+                        {
+                            de = new osg::DrawElementsUByte(GL_POINTS, size);
+                            copyBufferData(&(*de)[0], src, size * compSize, stride, size);
+                        }
+                        p = de;
                     }
                     break;
                 case 2:
                     {
-                        osg::DrawElementsUShort* de = new osg::DrawElementsUShort(GL_POINTS, size); p = de;
-                        copyBufferData(&(*de)[0], &indexBuffer.data[offset], size * compSize, stride, size);
+                        osg::DrawElementsUShort* de = NULL; const GLushort* src = (const GLushort*)&indexBuffer.data[offset];
+                        if (stride == 0) de = new osg::DrawElementsUShort(GL_POINTS, size, src);
+                        else
+                        {
+                            de = new osg::DrawElementsUShort(GL_POINTS, size);
+                            copyBufferData(&(*de)[0], src, size * compSize, stride, size);
+                        }
+                        p = de;
                     }
                     break;
                 case 4:
                     {
-                        osg::DrawElementsUInt* de = new osg::DrawElementsUInt(GL_POINTS, size); p = de;
-                        copyBufferData(&(*de)[0], &indexBuffer.data[offset], size * compSize, stride, size);
+                        osg::DrawElementsUInt* de = NULL; const GLuint* src = (const GLuint*)&indexBuffer.data[offset];
+                        if (stride == 0) de = new osg::DrawElementsUInt(GL_POINTS, size, src);
+                        else
+                        {
+                            de = new osg::DrawElementsUInt(GL_POINTS, size);
+                            copyBufferData(&(*de)[0], src, size * compSize, stride, size);
+                        }
+                        p = de;
                     }
                     break;
                 default:
@@ -704,10 +848,14 @@ namespace osgVerse
             // Apply to geode and create material
             geom->addPrimitiveSet(p.get());
             geode->addDrawable(geom.get());
-            if (primitive.material >= 0)
+            if (primitive.material >= 0 && primitive.material < (int)_modelDef.materials.size())
             {
-                tinygltf::Material& material = _modelDef.materials[primitive.material];
-                createMaterial(geom->getOrCreateStateSet(), material);
+                // Skinned and morphed geometries keep a state set of their own, as the animation
+                // player may alter it per geometry; others share the material state set
+                osg::StateSet* ss = getOrCreateMaterial(primitive.material);
+                if (sd != NULL || !primitive.targets.empty())
+                    geom->setStateSet(osg::clone(ss, osg::CopyOp::SHALLOW_COPY));
+                else geom->setStateSet(ss);
             }
 
             // Handle skinning data
@@ -771,6 +919,146 @@ namespace osgVerse
         tex2D->setImage(image.get()); return tex2D.release();
     }
 
+    bool LoaderGLTF::isStaticMesh(const DeferredMeshData& mData) const
+    {
+        // Skinned and morphing meshes change shared skeleton / callback data when created
+        if (mData.skinIndex >= 0 || mData.meshIndex < 0) return false;
+        const tinygltf::Mesh& mesh = _modelDef.meshes[mData.meshIndex];
+        if (!mesh.weights.empty()) return false;
+        for (size_t i = 0; i < mesh.primitives.size(); ++i)
+        { if (!mesh.primitives[i].targets.empty()) return false; }
+        return true;
+    }
+
+    void LoaderGLTF::decodeImages()
+    {
+        std::vector<int> pendingImages;
+        for (size_t i = 0; i < _modelDef.images.size(); ++i)
+        {
+            tinygltf::Image& imageSrc = _modelDef.images[i];
+            if (imageSrc.width < 0 && !imageSrc.image.empty()) pendingImages.push_back((int)i);
+        }
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < (int)pendingImages.size(); ++i)
+        {
+            tinygltf::LoadImageDataOption imageOption; imageOption.preserve_channels = true;
+            tinygltf::Image& imageSrc = _modelDef.images[pendingImages[i]];
+            std::vector<unsigned char> encoded; encoded.swap(imageSrc.image);
+            imageSrc.width = imageSrc.height = 0;
+
+            std::string err, warn;
+            if (!LoadImageDataEx(&imageSrc, pendingImages[i], &err, &warn, 0, 0,
+                                 &encoded[0], (int)encoded.size(), &imageOption))
+                OSG_WARN << "[LoaderGLTF] Failed to decode image: " << err << std::endl;
+        }
+    }
+
+    void LoaderGLTF::decodeMeshoptBuffers()
+    {
+        struct CompressedView
+        {
+            unsigned char* dst; const unsigned char* src; size_t srcSize, count, stride;
+            std::string mode, filter;
+        };
+
+        // EXT_meshopt_compression: views point to fallback buffers that have no data yet
+        std::vector<bool> fallbacks(_modelDef.buffers.size());
+        for (size_t i = 0; i < _modelDef.buffers.size(); ++i)
+            fallbacks[i] = _modelDef.buffers[i].data.empty();
+
+        std::vector<std::pair<tinygltf::BufferView*, const tinygltf::Value*>> pendingViews;
+        for (size_t i = 0; i < _modelDef.bufferViews.size(); ++i)
+        {
+            tinygltf::BufferView& view = _modelDef.bufferViews[i];
+            tinygltf::ExtensionMap::const_iterator itr = view.extensions.find("EXT_meshopt_compression");
+            if (itr == view.extensions.end() || view.buffer < 0 ||
+                view.buffer >= (int)fallbacks.size() || !fallbacks[view.buffer]) continue;
+
+            std::vector<unsigned char>& data = _modelDef.buffers[view.buffer].data;
+            if (data.size() < view.byteOffset + view.byteLength)
+                data.resize(view.byteOffset + view.byteLength);
+            pendingViews.push_back(std::pair<tinygltf::BufferView*, const tinygltf::Value*>(
+                &view, &(itr->second)));
+        }
+
+        // Fallback buffers are allocated, so compressed views can be decoded independently
+        std::vector<CompressedView> compressedViews;
+        for (size_t i = 0; i < pendingViews.size(); ++i)
+        {
+            tinygltf::BufferView& view = *pendingViews[i].first;
+            const tinygltf::Value& ext = *pendingViews[i].second;
+            int srcIndex = ext.Has("buffer") ? ext.Get("buffer").GetNumberAsInt() : -1;
+            if (srcIndex < 0 || srcIndex >= (int)_modelDef.buffers.size()) continue;
+
+            const std::vector<unsigned char>& srcData = _modelDef.buffers[srcIndex].data;
+            size_t srcOffset = ext.Has("byteOffset") ? ext.Get("byteOffset").GetNumberAsInt() : 0;
+            size_t srcSize = ext.Has("byteLength") ? ext.Get("byteLength").GetNumberAsInt() : 0;
+            CompressedView cv; cv.dst = &_modelDef.buffers[view.buffer].data[view.byteOffset];
+            cv.count = ext.Has("count") ? ext.Get("count").GetNumberAsInt() : 0;
+            cv.stride = ext.Has("byteStride") ? ext.Get("byteStride").GetNumberAsInt() : 0;
+            cv.mode = ext.Has("mode") ? ext.Get("mode").Get<std::string>() : "ATTRIBUTES";
+            cv.filter = ext.Has("filter") ? ext.Get("filter").Get<std::string>() : "NONE";
+            if (srcOffset + srcSize > srcData.size() || cv.count * cv.stride > view.byteLength ||
+                !srcSize || !cv.count || !cv.stride)
+            { OSG_WARN << "[LoaderGLTF] Invalid meshopt compressed view: " << view.name << std::endl; continue; }
+
+            cv.src = &srcData[srcOffset]; cv.srcSize = srcSize;
+            compressedViews.push_back(cv);
+        }
+
+        int numFailed = 0;
+#pragma omp parallel for schedule(dynamic, 1) reduction(+:numFailed)
+        for (int i = 0; i < (int)compressedViews.size(); ++i)
+        {
+            const CompressedView& cv = compressedViews[i];
+            if (!decodeMeshoptBufferView(cv.dst, cv.src, cv.srcSize, cv.count,
+                                         cv.stride, cv.mode, cv.filter)) numFailed++;
+        }
+
+        if (numFailed > 0)
+            OSG_WARN << "[LoaderGLTF] Failed to decode " << numFailed << " meshopt compressed views\n";
+    }
+
+    osg::Array* LoaderGLTF::createQuantizedArray(const tinygltf::Accessor& accessor,
+                                                 const unsigned char* src, size_t stride, bool compact)
+    {
+        int compNum = (accessor.type != TINYGLTF_TYPE_SCALAR) ? accessor.type : 1;
+        osg::Array* arr = NULL;
+#if OSG_VERSION_GREATER_THAN(3, 1, 8)
+#   define QUANTIZED_ARRAY_CASE(type, a2, a3, a4) case type: \
+        if (compNum == 2) arr = createBufferArray<osg::a2>(src, stride, accessor.count); \
+        else if (compNum == 3) arr = createBufferArray<osg::a3>(src, stride, accessor.count); \
+        else if (compNum == 4) arr = createBufferArray<osg::a4>(src, stride, accessor.count); \
+        break;
+
+        if (compact) switch (accessor.componentType)
+        {
+        QUANTIZED_ARRAY_CASE(TINYGLTF_COMPONENT_TYPE_BYTE, Vec2bArray, Vec3bArray, Vec4bArray)
+        QUANTIZED_ARRAY_CASE(TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE, Vec2ubArray, Vec3ubArray, Vec4ubArray)
+        QUANTIZED_ARRAY_CASE(TINYGLTF_COMPONENT_TYPE_SHORT, Vec2sArray, Vec3sArray, Vec4sArray)
+        QUANTIZED_ARRAY_CASE(TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, Vec2usArray, Vec3usArray, Vec4usArray)
+        default: break;
+        }
+#   undef QUANTIZED_ARRAY_CASE
+        if (arr) { arr->setNormalize(accessor.normalized); return arr; }
+#endif
+
+        if (compNum == 2) arr = createFloatArray<osg::Vec2Array>(accessor, src, stride, compNum);
+        else if (compNum == 3) arr = createFloatArray<osg::Vec3Array>(accessor, src, stride, compNum);
+        else if (compNum == 4) arr = createFloatArray<osg::Vec4Array>(accessor, src, stride, compNum);
+        return arr;
+    }
+
+    osg::StateSet* LoaderGLTF::getOrCreateMaterial(int id)
+    {
+        // Primitives with the same material share one state set
+        std::unique_lock<std::mutex> lock(_materialMutex);
+        osg::ref_ptr<osg::StateSet>& ss = _materialMap[id];
+        if (!ss) { ss = new osg::StateSet; createMaterial(ss.get(), _modelDef.materials[id]); }
+        return ss.get();
+    }
+
     void LoaderGLTF::createMaterial(osg::StateSet* ss, tinygltf::Material material)
     {
         // Shininess(RGB) = Occlusion/Roughness/Metallic, Ambient = Occlusion
@@ -1088,7 +1376,8 @@ namespace osgVerse
         }
     }
 
-    osg::ref_ptr<osg::Group> loadGltf(const std::string& file, bool isBinary)
+    osg::ref_ptr<osg::Group> loadGltf(const std::string& file, bool isBinary, bool parallel,
+                                      bool keepQuantized)
     {
         std::string workDir = osgDB::getFilePath(file), http = osgDB::getServerProtocol(file);
         if (!http.empty() && http.find("file") == std::string::npos) return NULL;
@@ -1100,14 +1389,15 @@ namespace osgVerse
             return NULL;
         }
 
-        osg::ref_ptr<LoaderGLTF> loader = new LoaderGLTF(in, workDir, isBinary);
+        osg::ref_ptr<LoaderGLTF> loader = new LoaderGLTF(in, workDir, isBinary, parallel, keepQuantized);
         if (loader->getRoot()) loader->getRoot()->setName(file);
         return loader->getRoot();
     }
 
-    osg::ref_ptr<osg::Group> loadGltf2(std::istream& in, const std::string& dir, bool isBinary)
+    osg::ref_ptr<osg::Group> loadGltf2(std::istream& in, const std::string& dir, bool isBinary,
+                                       bool parallel, bool keepQuantized)
     {
-        osg::ref_ptr<LoaderGLTF> loader = new LoaderGLTF(in, dir, isBinary);
+        osg::ref_ptr<LoaderGLTF> loader = new LoaderGLTF(in, dir, isBinary, parallel, keepQuantized);
         return loader->getRoot();
     }
 }
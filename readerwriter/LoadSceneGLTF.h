@@ -4,6 +4,7 @@
 #include <iterator>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 
 #define TINYGLTF_USE_RAPIDJSON 1
 #include "3rdparty/tiny_gltf.h"
@@ -15,7 +16,12 @@ namespace osgVerse
     class LoaderGLTF : public osg::Referenced
     {
     public:
-        LoaderGLTF(std::istream& in, const std::string& d, bool isBinary);
+        /** If parallel is set, images and static meshes are decoded with multiple threads,
+            and nodes referring to the same static mesh share its drawables. If keepQuantized is
+            set, KHR_mesh_quantization data of static meshes is kept in integer arrays, which only
+            shader-based rendering can handle; otherwise it is converted to floating arrays */
+        LoaderGLTF(std::istream& in, const std::string& d, bool isBinary, bool parallel = true,
+                   bool keepQuantized = false);
 
         osg::Group* getRoot() { return _root.get(); }
         tinygltf::Model& getModelData() { return _modelDef; }
@@ -24,10 +30,10 @@ namespace osgVerse
         struct DeferredMeshData
         {
             osg::ref_ptr<osg::Geode> meshRoot;
-            tinygltf::Mesh mesh; int skinIndex;
-            DeferredMeshData() : skinIndex(-1) {}
-            DeferredMeshData(osg::Geode* g, tinygltf::Mesh& m, int i)
-                : meshRoot(g), mesh(m), skinIndex(i) {}
+            int meshIndex, skinIndex;
+            DeferredMeshData() : meshIndex(-1), skinIndex(-1) {}
+            DeferredMeshData(osg::Geode* g, int m, int i)
+                : meshRoot(g), meshIndex(m), skinIndex(i) {}
         };
 
         struct SkinningData
@@ -44,6 +50,18 @@ namespace osgVerse
         virtual ~LoaderGLTF() {}
         osg::Node* createNode(int id, tinygltf::Node& node);
         bool createMesh(osg::Geode* geode, tinygltf::Mesh& mesh, int skinIndex);
+        bool isStaticMesh(const DeferredMeshData& mData) const;
+        void decodeImages();
+        void decodeMeshoptBuffers();
+
+        /** Create array of KHR_mesh_quantization attribute. If compact is set, integer data is
+            kept as it is and normalized by the GPU, otherwise it is converted to floating type */
+        osg::Array* createQuantizedArray(const tinygltf::Accessor& accessor, const unsigned char* src,
+                                         size_t stride, bool compact);
+
+        /** Get the state set of material, shared by all geometries using it. Don't modify the
+            result per geometry; clone it first (as done for skinned and morphed meshes) */
+        osg::StateSet* getOrCreateMaterial(int id);
         void createMaterial(osg::StateSet* ss, tinygltf::Material mat);
         void createTexture(osg::StateSet* ss, int u, const std::string& name, tinygltf::Texture& tex);
         void createInvBindMatrices(SkinningData& sd, const std::vector<osg::Transform*>& bones,
@@ -54,20 +72,53 @@ namespace osgVerse
         void applyBlendshapeWeights(osg::Geode* geode, const std::vector<double>& weights,
                                     const tinygltf::Value& targetNames);
 
+        template<size_t N>
+        static void copyStridedData(char* dst, const char* src, size_t stride, size_t count)
+        { for (size_t i = 0; i < count; ++i) memcpy(dst + i * N, src + i * stride, N); }
+
         inline void copyBufferData(void* dst, const void* src, size_t size,
                                    size_t stride, size_t count)
         {
             if (stride > 0 && count > 0)
             {
+                // Fixed-size copies of common elements are inlined by compilers
                 size_t elemSize = size / count;
-                for (size_t i = 0; i < count; ++i)
-                    memcpy((char*)dst + i * elemSize, (const char*)src + i * stride, elemSize);
+                char* d = (char*)dst; const char* s = (const char*)src;
+                switch (elemSize)
+                {
+                case 4: copyStridedData<4>(d, s, stride, count); break;
+                case 8: copyStridedData<8>(d, s, stride, count); break;
+                case 12: copyStridedData<12>(d, s, stride, count); break;
+                case 16: copyStridedData<16>(d, s, stride, count); break;
+                default:
+                    for (size_t i = 0; i < count; ++i)
+                        memcpy(d + i * elemSize, s + i * stride, elemSize);
+                    break;
+                }
             }
             else
                 memcpy(dst, src, size);
         }
 
+        /// Tightly packed data is constructed into the array directly, without zero-filling first
+        template<typename ArrayType>
+        ArrayType* createBufferArray(const void* src, size_t stride, size_t count)
+        {
+            typedef typename ArrayType::ElementDataType ElementType;
+            if (stride == 0)
+            {
+                const ElementType* ptr = (const ElementType*)src;
+                return new ArrayType(ptr, ptr + count);
+            }
+
+            ArrayType* arr = new ArrayType(count);
+            copyBufferData(&(*arr)[0], src, count * sizeof(ElementType), stride, count);
+            return arr;
+        }
+
         std::map<int, osg::observer_ptr<osg::Image>> _imageMap;
+        std::map<int, osg::ref_ptr<osg::StateSet>> _materialMap;
+        std::mutex _materialMutex;
         std::map<int, osg::Node*> _nodeCreationMap;
         std::vector<DeferredMeshData> _deferredMeshList;
         std::vector<SkinningData> _skinningDataList;
@@ -75,8 +126,12 @@ namespace osgVerse
         osg::ref_ptr<osg::NodeCallback> _rtcCenterCallback;
         tinygltf::Model _modelDef;
         std::string _workingDir;
+        bool _parallel, _keepQuantized;
     };
 
-    OSGVERSE_RW_EXPORT osg::ref_ptr<osg::Group> loadGltf(const std::string& file, bool isBinary);
-    OSGVERSE_RW_EXPORT osg::ref_ptr<osg::Group> loadGltf2(std::istream& in, const std::string& dir, bool isBinary);
+    OSGVERSE_RW_EXPORT osg::ref_ptr<osg::Group> loadGltf(const std::string& file, bool isBinary,
+                                                         bool parallel = true, bool keepQuantized = false);
+    OSGVERSE_RW_EXPORT osg::ref_ptr<osg::Group> loadGltf2(std::istream& in, const std::string& dir,
+                                                          bool isBinary, bool parallel = true,
+                                                          bool keepQuantized = false);
 }
@@ -10,9 +10,16 @@
 #include "pipeline/Utilities.h"
 #include "Utilities.h"
 
+#include <osgUtil/CullVisitor>
 #include <mutex>
+#include <thread>
+#include <deque>
+#include <condition_variable>
 #include <ktx/texture.h>
 #include <ktx/gl_format.h>
+#include <ktx/basisu/transcoder/basisu_transcoder.h>
+#define XXH_INLINE_ALL
+#include <xxhash.h>
 #include "LoadTextureKTX.h"
 
 static inline VkFormat glGetVkFormatFromInternalFormat(GLint glFormat)
@@ -214,6 +221,25 @@ static std::mutex g_readKtxMutex;
 
 namespace osgVerse
 {
+    static void getTranscodingFlags(const osgDB::Options* opt, bool& noCompress,
+                                    bool& supportsDXT, bool& supportsETC)
+    {
+        g_readKtxMutex.lock();
+        noCompress = (g_readKtxFlags[ReadKtx_ToRGBA] > 0);
+        supportsDXT = (g_readKtxFlags[ReadKtx_NoDXT] == 0);
+        g_readKtxMutex.unlock();
+
+        if (opt != NULL)
+        {
+            if (!opt->getPluginStringData("UseDXT").empty())
+                supportsDXT = atoi(opt->getPluginStringData("UseDXT").c_str()) > 0;
+            if (!opt->getPluginStringData("UseETC").empty())
+                supportsETC = atoi(opt->getPluginStringData("UseETC").c_str()) > 0;
+            if (!opt->getPluginStringData("UseRGBA").empty())
+                noCompress = atoi(opt->getPluginStringData("UseRGBA").c_str()) > 0;
+        }
+    }
+
     static osg::ref_ptr<osg::Image> loadImageFromKtx(ktxTexture* texture, const osgDB::Options* opt,
                                                      int layer, int face, ktx_size_t imgDataSize)
     {
@@ -224,20 +250,7 @@ namespace osgVerse
         if (ktxTexture_NeedsTranscoding(texture))
         {
             bool noCompress = false, supportsDXT = false, supportsETC = false;
-            g_readKtxMutex.lock();
-            noCompress = (g_readKtxFlags[ReadKtx_ToRGBA] > 0);
-            supportsDXT = (g_readKtxFlags[ReadKtx_NoDXT] == 0);
-            g_readKtxMutex.unlock();
-
-            if (opt != NULL)
-            {
-                if (!opt->getPluginStringData("UseDXT").empty())
-                    supportsDXT = atoi(opt->getPluginStringData("UseDXT").c_str()) > 0;
-                if (!opt->getPluginStringData("UseETC").empty())
-                    supportsETC = atoi(opt->getPluginStringData("UseETC").c_str()) > 0;
-                if (!opt->getPluginStringData("UseRGBA").empty())
-                    noCompress = atoi(opt->getPluginStringData("UseRGBA").c_str()) > 0;
-            }
+            getTranscodingFlags(opt, noCompress, supportsDXT, supportsETC);
 
             ktx_transcode_fmt_e fmt = ktx_transcode_fmt_e::KTX_TTF_RGBA32;
             if (w2 != w || h2 != h)
@@ -370,8 +383,24 @@ namespace osgVerse
         return resultArray;
     }
 
+    static osg::ref_ptr<osg::Image> loadStreamingKtx(const std::string& data, const osgDB::Options* opt)
+    {
+        std::string baseSize = opt ? opt->getPluginStringData("StreamingBaseSize") : "";
+        if (baseSize.empty() || atoi(baseSize.c_str()) <= 0) return NULL;
+
+        osg::ref_ptr<KtxStreamingImage> image = new KtxStreamingImage;
+        if (!image->open(data, opt, atoi(baseSize.c_str()))) return NULL;
+        return image.get();
+    }
+
     std::vector<osg::ref_ptr<osg::Image>> loadKtx(const std::string& file, const osgDB::Options* opt)
     {
+        if (opt && !opt->getPluginStringData("StreamingBaseSize").empty())
+        {
+            std::ifstream in(file.c_str(), std::ios::in | std::ios::binary);
+            if (in) return loadKtx2(in, opt);
+        }
+
         ktxTexture* texture = NULL;
         ktx_error_code_e result = ktxTexture_CreateFromNamedFile(
             file.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture);
@@ -389,6 +418,10 @@ namespace osgVerse
                          std::istreambuf_iterator<char>());
         if (data.empty()) return std::vector<osg::ref_ptr<osg::Image>>();
 
+        osg::ref_ptr<osg::Image> streamingImage = loadStreamingKtx(data, opt);
+        if (streamingImage.valid())
+            return std::vector<osg::ref_ptr<osg::Image>>(1, streamingImage);
+
         ktxTexture* texture = NULL;
         ktx_error_code_e result = ktxTexture_CreateFromMemory(
             (const ktx_uint8_t*)data.data(), data.size(),
@@ -541,3 +574,358 @@ namespace osgVerse
     void setReadingKtxFlag(ReadingKtxFlag flag, int value)
     { g_readKtxMutex.lock(); g_readKtxFlags[flag] = value; g_readKtxMutex.unlock(); }
 }
+
+namespace osgVerse
+{
+    struct KtxStreamingData
+    {
+        typedef std::shared_ptr<std::vector<unsigned char>> LevelData;
+        std::string data; basist::ktx2_transcoder transcoder;
+        basist::transcoder_texture_format format;
+        GLenum internalFormat, pixelFormat, dataType;
+        std::vector<LevelData> levels; XXH64_hash_t hash;
+        std::vector<osg::observer_ptr<osg::Node>> streamingNodes;  // nodes requesting levels
+        int residentLevel, requestedLevel, pendingLevel;
+        bool taskQueued; std::mutex mutex, transcoderMutex;
+
+        KtxStreamingData() : format(basist::transcoder_texture_format::cTFRGBA32),
+            internalFormat(GL_RGBA8), pixelFormat(GL_RGBA), dataType(GL_UNSIGNED_BYTE), hash(0),
+            residentLevel(0), requestedLevel(0), pendingLevel(0), taskQueued(false) {}
+
+        int getLevelWidth(int level) const { return osg::maximum((int)transcoder.get_width() >> level, 1); }
+        int getLevelHeight(int level) const { return osg::maximum((int)transcoder.get_height() >> level, 1); }
+
+        LevelData transcodeLevel(int level);
+
+        /// Share data and transcoded levels of another image, but stream independently of it
+        void copyFrom(KtxStreamingData& src)
+        {
+            std::lock_guard<std::mutex> lock(src.mutex);
+            data = src.data; format = src.format; hash = src.hash; levels = src.levels;
+            internalFormat = src.internalFormat; pixelFormat = src.pixelFormat; dataType = src.dataType;
+            if (!data.empty() && transcoder.init(data.data(), data.size())) transcoder.start_transcoding();
+            residentLevel = requestedLevel = pendingLevel = src.residentLevel;  // as copied pixels
+        }
+    };
+
+    class KtxStreamingCallback : public osg::NodeCallback
+    {
+    public:
+        KtxStreamingCallback(KtxStreamingImage* img) : image(img) {}
+        osg::observer_ptr<KtxStreamingImage> image;
+
+        virtual void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+            osg::ref_ptr<KtxStreamingImage> img;
+            if (cv != NULL && image.lock(img)) img->requestSize(cv->clampedPixelSize(node->getBound()));
+            traverse(node, nv);
+        }
+    };
+
+    /** Transcoded levels shared by all streaming images, with least recently used ones
+        removed when exceeding the size limit */
+    class KtxLevelCache
+    {
+    public:
+        static KtxLevelCache* instance() { static KtxLevelCache s_cache; return &s_cache; }
+        KtxLevelCache() : _totalSize(0), _maxSize(256 * 1024 * 1024), _accessCount(0) {}
+
+        KtxStreamingData::LevelData get(const std::string& key)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::map<std::string, CacheItem>::iterator itr = _items.find(key);
+            if (itr == _items.end()) return KtxStreamingData::LevelData();
+            itr->second.second = ++_accessCount; return itr->second.first;
+        }
+
+        void add(const std::string& key, KtxStreamingData::LevelData levelData)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            CacheItem& item = _items[key]; if (item.first) _totalSize -= item.first->size();
+            item.first = levelData; item.second = ++_accessCount;
+            _totalSize += levelData->size();
+            while (_totalSize > _maxSize && _items.size() > 1)
+            {
+                std::map<std::string, CacheItem>::iterator oldest = _items.begin();
+                for (std::map<std::string, CacheItem>::iterator it = _items.begin();
+                     it != _items.end(); ++it) { if (it->second.second < oldest->second.second) oldest = it; }
+                _totalSize -= oldest->second.first->size(); _items.erase(oldest);
+            }
+        }
+
+    protected:
+        typedef std::pair<KtxStreamingData::LevelData, uint64_t> CacheItem;  // data, last access
+        std::map<std::string, CacheItem> _items;
+        std::mutex _mutex;
+        size_t _totalSize, _maxSize; uint64_t _accessCount;
+    };
+
+    /** Background thread transcoding requested levels one image after another */
+    class KtxTranscodingQueue
+    {
+    public:
+        static KtxTranscodingQueue* instance() { static KtxTranscodingQueue s_queue; return &s_queue; }
+
+        void add(KtxStreamingImage* image)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _images.push_back(osg::observer_ptr<KtxStreamingImage>(image));
+            }
+            _condition.notify_one();
+        }
+
+    protected:
+        KtxTranscodingQueue() : _done(false) { _thread = std::thread(&KtxTranscodingQueue::run, this); }
+        ~KtxTranscodingQueue()
+        {
+            { std::lock_guard<std::mutex> lock(_mutex); _done = true; }
+            _condition.notify_one(); _thread.join();
+        }
+
+        void run()
+        {
+            while (true)
+            {
+                osg::ref_ptr<KtxStreamingImage> image;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _condition.wait(lock, [this]() { return _done || !_images.empty(); });
+                    if (_done) break;
+                    _images.front().lock(image); _images.pop_front();
+                }
+                if (image.valid()) image->transcodeRequestedLevels();
+            }
+        }
+
+        std::deque<osg::observer_ptr<KtxStreamingImage>> _images;
+        std::condition_variable _condition;
+        std::mutex _mutex;
+        std::thread _thread;
+        bool _done;
+    };
+
+    KtxStreamingData::LevelData KtxStreamingData::transcodeLevel(int level)
+    {
+        std::string key = std::to_string(hash) + "_" + std::to_string(level)
+                         + "_" + std::to_string((int)format);
+        LevelData levelData = KtxLevelCache::instance()->get(key);
+        if (levelData) return levelData;
+
+        int w = getLevelWidth(level), h = getLevelHeight(level);
+        unsigned int bytesPerUnit = basist::basis_get_bytes_per_block_or_pixel(format);
+        unsigned int numUnits = basist::basis_transcoder_format_is_uncompressed(format) ?
+                                (w * h) : (((w + 3) / 4) * ((h + 3) / 4));
+        levelData = LevelData(new std::vector<unsigned char>(numUnits * bytesPerUnit));
+        {
+            std::lock_guard<std::mutex> lock(transcoderMutex);
+            if (!transcoder.transcode_image_level(level, 0, 0, levelData->data(), numUnits, format))
+            {
+                OSG_WARN << "[LoaderKTX] Failed to transcode level " << level << std::endl;
+                return LevelData();
+            }
+        }
+        KtxLevelCache::instance()->add(key, levelData);
+        return levelData;
+    }
+
+    KtxStreamingImage::KtxStreamingImage()
+    :   _streamingData(new KtxStreamingData) {}
+
+    KtxStreamingImage::KtxStreamingImage(const KtxStreamingImage& copy, const osg::CopyOp& op)
+    :   osg::Image(copy, op), _streamingData(new KtxStreamingData)
+    { _streamingData->copyFrom(*copy._streamingData); }
+
+    bool KtxStreamingImage::open(const std::string& data, const osgDB::Options* opt, int baseSize)
+    {
+        static std::once_flag s_initFlag;
+        std::call_once(s_initFlag, []() { basist::basisu_transcoder_init(); });
+
+        KtxStreamingData& sd = *_streamingData; sd.data = data;
+        if (!sd.transcoder.init(sd.data.data(), sd.data.size())) return false;
+        if (sd.transcoder.get_layers() > 1 || sd.transcoder.get_faces() > 1 ||
+            sd.transcoder.get_levels() < 2) return false;  // arrays/cubemaps are loaded as usual
+        if (!sd.transcoder.start_transcoding()) return false;
+
+        // Select transcoding format like loadImageFromKtx()
+        bool noCompress = false, supportsDXT = false, supportsETC = false;
+        getTranscodingFlags(opt, noCompress, supportsDXT, supportsETC);
+        int w = sd.transcoder.get_width(), h = sd.transcoder.get_height();
+        bool hasAlpha = sd.transcoder.get_has_alpha() != 0;
+        bool isPOT = (w == osg::Image::computeNearestPowerOfTwo(w)) &&
+                     (h == osg::Image::computeNearestPowerOfTwo(h));
+        if (!noCompress && isPOT && supportsETC)
+        {
+            sd.format = hasAlpha ? basist::transcoder_texture_format::cTFETC2_RGBA
+                                 : basist::transcoder_texture_format::cTFETC1_RGB;
+            sd.internalFormat = hasAlpha ? GL_COMPRESSED_RGBA8_ETC2_EAC : GL_ETC1_RGB8_OES;
+            sd.pixelFormat = sd.internalFormat;
+        }
+        else if (!noCompress && isPOT && supportsDXT)
+        {
+            sd.format = hasAlpha ? basist::transcoder_texture_format::cTFBC3_RGBA
+                                 : basist::transcoder_texture_format::cTFBC1_RGB;
+            sd.internalFormat = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                         : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            sd.pixelFormat = sd.internalFormat;
+        }
+
+        // Transcode small levels at once, from smallest to largest
+        int numLevels = sd.transcoder.get_levels(), baseLevel = numLevels - 1;
+        while (baseLevel > 0 && osg::maximum(sd.getLevelWidth(baseLevel - 1),
+                                             sd.getLevelHeight(baseLevel - 1)) <= baseSize) baseLevel--;
+        sd.hash = XXH64(sd.data.data(), sd.data.size(), 0);
+        sd.levels.resize(numLevels);
+        for (int i = numLevels - 1; i >= baseLevel; --i)
+        {
+            sd.levels[i] = sd.transcodeLevel(i);
+            if (!sd.levels[i]) return false;
+        }
+
+        sd.residentLevel = sd.pendingLevel = numLevels;
+        applyLevels(baseLevel); sd.requestedLevel = baseLevel;
+        return true;
+    }
+
+    int KtxStreamingImage::getNumLevels() const
+    { return (int)_streamingData->levels.size(); }
+
+    int KtxStreamingImage::getResidentLevel() const
+    { std::lock_guard<std::mutex> lock(_streamingData->mutex); return _streamingData->residentLevel; }
+
+    void KtxStreamingImage::requestSize(float pixelSize)
+    {
+        int w = _streamingData->transcoder.get_width();
+        float ratio = (float)w / osg::maximum(pixelSize, 1.0f);
+        requestLevel(ratio > 1.0f ? (int)floor(log(ratio) / log(2.0f)) : 0);
+    }
+
+    void KtxStreamingImage::requestLevel(int level)
+    {
+        KtxStreamingData& sd = *_streamingData; bool toQueue = false;
+        {
+            std::lock_guard<std::mutex> lock(sd.mutex);
+            level = osg::clampBetween(level, 0, (int)sd.levels.size() - 1);
+            if (level >= sd.requestedLevel) return;
+            sd.requestedLevel = level;
+            if (!sd.taskQueued) { sd.taskQueued = true; toQueue = true; }
+        }
+        if (toQueue) KtxTranscodingQueue::instance()->add(this);
+    }
+
+    void KtxStreamingImage::transcodeRequestedLevels()
+    {
+        KtxStreamingData& sd = *_streamingData;
+        while (true)
+        {
+            int level = 0;
+            {
+                std::lock_guard<std::mutex> lock(sd.mutex);
+                if (sd.pendingLevel <= sd.requestedLevel) { sd.taskQueued = false; return; }
+                level = sd.pendingLevel - 1;
+            }
+
+            // One level each time, so that update() may apply smaller ones earlier
+            KtxStreamingData::LevelData levelData = sd.transcodeLevel(level);
+            std::lock_guard<std::mutex> lock(sd.mutex);
+            if (!levelData) { sd.requestedLevel = sd.pendingLevel; sd.taskQueued = false; return; }
+            sd.levels[level] = levelData; sd.pendingLevel = level;
+        }
+    }
+
+    void KtxStreamingImage::addStreamingNode(osg::Node* node)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_streamingData->mutex);
+            std::vector<osg::observer_ptr<osg::Node>>& nodes = _streamingData->streamingNodes;
+            for (size_t i = 0; i < nodes.size();)
+            {
+                if (nodes[i] == node) return;
+                else if (!nodes[i].valid()) nodes.erase(nodes.begin() + i); else ++i;
+            }
+            nodes.push_back(node);
+        }
+        node->addCullCallback(new KtxStreamingCallback(this));
+    }
+
+    void KtxStreamingImage::update(osg::NodeVisitor* nv)
+    {
+        // Nodes using this image start streaming here, no matter how they were loaded or paged
+        if (nv != NULL && !nv->getNodePath().empty()) addStreamingNode(nv->getNodePath().back());
+
+        int level = 0;
+        {
+            std::lock_guard<std::mutex> lock(_streamingData->mutex);
+            if (_streamingData->pendingLevel >= _streamingData->residentLevel) return;
+            level = _streamingData->pendingLevel;
+        }
+        applyLevels(level);
+    }
+
+    void KtxStreamingImage::applyLevels(int level)
+    {
+        KtxStreamingData& sd = *_streamingData;
+        std::vector<KtxStreamingData::LevelData> levels;
+        {
+            std::lock_guard<std::mutex> lock(sd.mutex);
+            levels.assign(sd.levels.begin() + level, sd.levels.end());
+            sd.residentLevel = level; sd.pendingLevel = osg::minimum(sd.pendingLevel, level);
+        }
+
+        size_t totalSize = 0; osg::Image::MipmapDataType mipmapData;
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            if (i > 0) mipmapData.push_back(totalSize);
+            totalSize += levels[i]->size();
+        }
+
+        unsigned char* buffer = new unsigned char[totalSize], *ptr = buffer;
+        for (size_t i = 0; i < levels.size(); ++i)
+        { memcpy(ptr, levels[i]->data(), levels[i]->size()); ptr += levels[i]->size(); }
+
+        setImage(sd.getLevelWidth(level), sd.getLevelHeight(level), 1, sd.internalFormat,
+                 sd.pixelFormat, sd.dataType, buffer, osg::Image::USE_NEW_DELETE, 4);
+        setMipmapLevels(mipmapData);  // setImage() also calls dirty() to upload again
+    }
+
+    class KtxStreamingVisitor : public osg::NodeVisitor
+    {
+    public:
+        KtxStreamingVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        virtual void apply(osg::Geode& geode)
+        {
+            collect(geode, geode.getStateSet());
+            for (unsigned int i = 0; i < geode.getNumDrawables(); ++i)
+                collect(geode, geode.getDrawable(i)->getStateSet());
+            traverse(geode);
+        }
+
+        virtual void apply(osg::Node& node)
+        { collect(node, node.getStateSet()); traverse(node); }
+
+    protected:
+        void collect(osg::Node& node, osg::StateSet* ss)
+        {
+            if (!ss) return;
+            const osg::StateSet::TextureAttributeList& texAttrs = ss->getTextureAttributeList();
+            for (size_t i = 0; i < texAttrs.size(); ++i)
+            {
+                osg::Texture* tex = static_cast<osg::Texture*>(
+                    ss->getTextureAttribute(i, osg::StateAttribute::TEXTURE));
+                for (unsigned int j = 0; tex && j < tex->getNumImages(); ++j)
+                {
+                    KtxStreamingImage* image = dynamic_cast<KtxStreamingImage*>(tex->getImage(j));
+                    if (image) image->addStreamingNode(&node);
+                }
+            }
+        }
+    };
+
+    void setupKtxStreaming(osg::Node* root)
+    {
+        if (!root) return;
+        KtxStreamingVisitor ksv; root->accept(ksv);
+    }
+}
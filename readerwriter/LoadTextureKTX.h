@@ -1,6 +1,7 @@
 #include <osg/Texture2D>
 #include <osg/Geode>
 #include <osg/MatrixTransform>
+#include <memory>
 #include <iterator>
 #include <fstream>
 #include <iostream>
@@ -9,6 +10,53 @@
 
 namespace osgVerse
 {
+    struct KtxStreamingData;
+
+    /** Image of a Basis-supercompressed KTX2 texture, which only transcodes small mipmaps at first.
+        Larger levels are transcoded from small to large in a background thread when requested
+        by cull callbacks of nodes using the image, and applied at next update traversal.
+        The image adds these callbacks itself at update traversal, so it streams in any scene.
+        Transcoded levels are kept in a shared cache, so identical textures are transcoded once.
+        Read a KTX2 file with option "StreamingBaseSize=<n>" to create such images */
+    class OSGVERSE_RW_EXPORT KtxStreamingImage : public osg::Image
+    {
+    public:
+        KtxStreamingImage();
+        KtxStreamingImage(const KtxStreamingImage& copy, const osg::CopyOp& op = osg::CopyOp::SHALLOW_COPY);
+        META_Object(osgVerse, KtxStreamingImage)
+
+        /// Initialize from KTX2 data and transcode levels not larger than baseSize
+        bool open(const std::string& data, const osgDB::Options* opt, int baseSize);
+
+        /// Request a level to be resident (0 = full resolution)
+        void requestLevel(int level);
+
+        /// Request a level by pixel size of the texture on screen
+        void requestSize(float pixelSize);
+
+        /// Add a cull callback requesting levels by size of the node on screen, once for each node
+        void addStreamingNode(osg::Node* node);
+
+        int getNumLevels() const;
+        int getResidentLevel() const;
+
+        /// Transcode requested levels, called by the background thread
+        void transcodeRequestedLevels();
+
+        virtual bool requiresUpdateCall() const { return true; }
+        virtual void update(osg::NodeVisitor* nv);
+
+    protected:
+        virtual ~KtxStreamingImage() {}
+        void applyLevels(int level);
+
+        std::shared_ptr<KtxStreamingData> _streamingData;
+    };
+
+    /** Add cull callbacks to nodes with KtxStreamingImage textures, to request levels by their
+        pixel sizes on screen before the first update traversal. Nodes already added are skipped */
+    OSGVERSE_RW_EXPORT void setupKtxStreaming(osg::Node* root);
+
     OSGVERSE_RW_EXPORT std::vector<osg::ref_ptr<osg::Image>> loadKtx(const std::string& file, const osgDB::Options* opt);
     OSGVERSE_RW_EXPORT std::vector<osg::ref_ptr<osg::Image>> loadKtx2(std::istream& in, const osgDB::Options* opt);
 
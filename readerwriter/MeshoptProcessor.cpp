@@ -0,0 +1,416 @@
+#include <osg/Version>
+#include <osgDB/ObjectWrapper>
+#include <osgDB/InputStream>
+#include <osgDB/OutputStream>
+#include <meshoptimizer/meshoptimizer.h>
+#include "MeshoptProcessor.h"
+#include <algorithm>
+#include <sstream>
+using namespace osgVerse;
+
+#define MESHOPT_DATA_VERSION 1
+enum ArraySlot { VERTEX_SLOT = 0, NORMAL_SLOT, COLOR_SLOT, SECONDARY_COLOR_SLOT, FOG_COORD_SLOT,
+                 TEXCOORD_SLOT = 16, VERTEX_ATTRIB_SLOT = 32 };
+enum IndexCodec { RAW_INDICES = 0, TRIANGLE_CODEC = 1, SEQUENCE_CODEC = 2 };
+
+template<typename T> static void writeValue(std::ostream& out, T v)
+{ out.write((const char*)&v, sizeof(T)); }
+
+template<typename T> static T readValue(std::istream& in)
+{ T v = T(); in.read((char*)&v, sizeof(T)); return v; }
+
+static void writeBlock(std::ostream& out, const void* data, unsigned int size)
+{ writeValue<unsigned int>(out, size); if (size > 0) out.write((const char*)data, size); }
+
+static bool readBlock(std::istream& in, std::vector<unsigned char>& data)
+{
+    unsigned int size = readValue<unsigned int>(in); data.resize(size);
+    if (size > 0) in.read((char*)&data[0], size);
+    return !in.fail();
+}
+
+#if OSG_VERSION_GREATER_THAN(3, 1, 8)
+static osg::Array* createArrayOfType(int type, unsigned int size)
+{
+#define ARRAY_TYPE_CASE(t) case osg::Array::t##Type: return new osg::t(size);
+    switch (type)
+    {
+    ARRAY_TYPE_CASE(ByteArray) ARRAY_TYPE_CASE(ShortArray) ARRAY_TYPE_CASE(IntArray)
+    ARRAY_TYPE_CASE(UByteArray) ARRAY_TYPE_CASE(UShortArray) ARRAY_TYPE_CASE(UIntArray)
+    ARRAY_TYPE_CASE(FloatArray) ARRAY_TYPE_CASE(DoubleArray)
+    ARRAY_TYPE_CASE(Vec2bArray) ARRAY_TYPE_CASE(Vec3bArray) ARRAY_TYPE_CASE(Vec4bArray)
+    ARRAY_TYPE_CASE(Vec2sArray) ARRAY_TYPE_CASE(Vec3sArray) ARRAY_TYPE_CASE(Vec4sArray)
+    ARRAY_TYPE_CASE(Vec2iArray) ARRAY_TYPE_CASE(Vec3iArray) ARRAY_TYPE_CASE(Vec4iArray)
+    ARRAY_TYPE_CASE(Vec2ubArray) ARRAY_TYPE_CASE(Vec3ubArray) ARRAY_TYPE_CASE(Vec4ubArray)
+    ARRAY_TYPE_CASE(Vec2usArray) ARRAY_TYPE_CASE(Vec3usArray) ARRAY_TYPE_CASE(Vec4usArray)
+    ARRAY_TYPE_CASE(Vec2uiArray) ARRAY_TYPE_CASE(Vec3uiArray) ARRAY_TYPE_CASE(Vec4uiArray)
+    ARRAY_TYPE_CASE(Vec2Array) ARRAY_TYPE_CASE(Vec3Array) ARRAY_TYPE_CASE(Vec4Array)
+    ARRAY_TYPE_CASE(Vec2dArray) ARRAY_TYPE_CASE(Vec3dArray) ARRAY_TYPE_CASE(Vec4dArray)
+    default: break;
+    }
+#undef ARRAY_TYPE_CASE
+    return NULL;
+}
+
+static void encodeArray(std::ostream& out, int slot, const osg::Array* arr)
+{
+    unsigned int numElements = arr->getNumElements(), elemSize = arr->getElementSize();
+    writeValue<int>(out, slot); writeValue<int>(out, (int)arr->getType());
+    writeValue<int>(out, (int)arr->getBinding());
+    writeValue<unsigned char>(out, arr->getNormalize() ? 1 : 0);
+    writeValue<unsigned int>(out, numElements); writeValue<unsigned int>(out, elemSize);
+
+    // Vertex codec requires element size to be a multiple of 4, others are saved as they are
+    const unsigned char* src = (const unsigned char*)arr->getDataPointer();
+    bool encodable = numElements > 0 && (elemSize % 4) == 0 && elemSize <= 256;
+    writeValue<unsigned char>(out, encodable ? 1 : 0);
+    if (encodable)
+    {
+        std::vector<unsigned char> buffer(meshopt_encodeVertexBufferBound(numElements, elemSize));
+        buffer.resize(meshopt_encodeVertexBuffer(&buffer[0], buffer.size(), src, numElements, elemSize));
+        writeBlock(out, &buffer[0], buffer.size());
+    }
+    else
+        writeBlock(out, src, numElements * elemSize);
+}
+
+static bool decodeArray(std::istream& in, osg::Geometry* geom)
+{
+    int slot = readValue<int>(in), type = readValue<int>(in), binding = readValue<int>(in);
+    unsigned char normalized = readValue<unsigned char>(in);
+    unsigned int numElements = readValue<unsigned int>(in), elemSize = readValue<unsigned int>(in);
+    unsigned char encoded = readValue<unsigned char>(in);
+
+    std::vector<unsigned char> buffer;
+    if (!readBlock(in, buffer)) return false;
+
+    osg::ref_ptr<osg::Array> arr = createArrayOfType(type, numElements);
+    if (!arr || arr->getElementSize() != elemSize)
+    { OSG_WARN << "[MeshoptProcessor] Unsupported array type " << type << std::endl; return false; }
+
+    unsigned char* dst = (unsigned char*)(arr->getDataPointer());
+    if (numElements > 0)
+    {
+        if (encoded)
+        {
+            if (meshopt_decodeVertexBuffer(dst, numElements, elemSize,
+                                           &buffer[0], buffer.size()) != 0) return false;
+        }
+        else if (buffer.size() == (size_t)numElements * elemSize)
+            memcpy(dst, &buffer[0], buffer.size());
+        else return false;
+    }
+
+    arr->setBinding((osg::Array::Binding)binding); arr->setNormalize(normalized > 0);
+    if (slot == VERTEX_SLOT) geom->setVertexArray(arr.get());
+    else if (slot == NORMAL_SLOT) geom->setNormalArray(arr.get(), arr->getBinding());
+    else if (slot == COLOR_SLOT) geom->setColorArray(arr.get(), arr->getBinding());
+    else if (slot == SECONDARY_COLOR_SLOT) geom->setSecondaryColorArray(arr.get(), arr->getBinding());
+    else if (slot == FOG_COORD_SLOT) geom->setFogCoordArray(arr.get(), arr->getBinding());
+    else if (slot >= VERTEX_ATTRIB_SLOT)
+        geom->setVertexAttribArray(slot - VERTEX_ATTRIB_SLOT, arr.get(), arr->getBinding());
+    else if (slot >= TEXCOORD_SLOT)
+        geom->setTexCoordArray(slot - TEXCOORD_SLOT, arr.get(), arr->getBinding());
+    return true;
+}
+
+static void encodeElements(std::ostream& out, const osg::DrawElements* de,
+                           unsigned int numVertices, bool optimizeVertexCache)
+{
+    unsigned int numIndices = de->getNumIndices(), maxIndex = 0;
+    std::vector<unsigned int> indices(numIndices);
+    for (unsigned int i = 0; i < numIndices; ++i)
+    { indices[i] = de->index(i); maxIndex = osg::maximum(maxIndex, indices[i]); }
+    writeValue<unsigned int>(out, numIndices);
+    if (numIndices == 0) { writeValue<unsigned char>(out, RAW_INDICES); return; }
+
+    bool asTriangles = de->getMode() == GL_TRIANGLES && (numIndices % 3) == 0;
+    size_t vertexCount = osg::maximum(numVertices, maxIndex + 1);
+    if (asTriangles && optimizeVertexCache)
+        meshopt_optimizeVertexCache(&indices[0], &indices[0], numIndices, vertexCount);
+
+    std::vector<unsigned char> buffer;
+    if (asTriangles)
+    {
+        buffer.resize(meshopt_encodeIndexBufferBound(numIndices, vertexCount));
+        buffer.resize(meshopt_encodeIndexBuffer(&buffer[0], buffer.size(), &indices[0], numIndices));
+    }
+    else
+    {
+        buffer.resize(meshopt_encodeIndexSequenceBound(numIndices, vertexCount));
+        buffer.resize(meshopt_encodeIndexSequence(&buffer[0], buffer.size(), &indices[0], numIndices));
+    }
+    writeValue<unsigned char>(out, asTriangles ? TRIANGLE_CODEC : SEQUENCE_CODEC);
+    writeBlock(out, &buffer[0], buffer.size());
+}
+
+template<typename DrawElementsType>
+static DrawElementsType* decodeElements(std::istream& in, GLenum mode)
+{
+    typedef typename DrawElementsType::value_type IndexType;
+    unsigned int numIndices = readValue<unsigned int>(in);
+    unsigned char codec = readValue<unsigned char>(in);
+    osg::ref_ptr<DrawElementsType> de = new DrawElementsType(mode, numIndices);
+    if (numIndices == 0 || codec == RAW_INDICES) return de.release();
+
+    std::vector<unsigned char> buffer;
+    if (!readBlock(in, buffer) || buffer.empty()) return NULL;
+
+    // Index codecs only output 16/32bit values, so 8bit indices need a temporary copy
+    std::vector<unsigned int> indices32;
+    void* dst = &(*de)[0]; size_t indexSize = sizeof(IndexType);
+    if (indexSize < 2) { indices32.resize(numIndices); dst = &indices32[0]; indexSize = 4; }
+
+    int result = (codec == TRIANGLE_CODEC)
+               ? meshopt_decodeIndexBuffer(dst, numIndices, indexSize, &buffer[0], buffer.size())
+               : meshopt_decodeIndexSequence(dst, numIndices, indexSize, &buffer[0], buffer.size());
+    if (result != 0) return NULL;
+
+    for (size_t i = 0; i < indices32.size(); ++i) (*de)[i] = (IndexType)indices32[i];
+    return de.release();
+}
+#endif
+
+osg::Geometry* MeshoptProcessor::decodeMeshoptData(std::istream& in)
+{
+    osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
+    geom->setUseDisplayList(false);
+    geom->setUseVertexBufferObjects(true);
+    if (decodeMeshoptData(in, geom.get()))
+        return geom.release();
+    return NULL;
+}
+
+bool MeshoptProcessor::decodeMeshoptData(std::istream& in, osg::Geometry* geom)
+{
+#if OSG_VERSION_GREATER_THAN(3, 1, 8)
+    int version = readValue<int>(in);
+    if (version != MESHOPT_DATA_VERSION)
+    { OSG_WARN << "[MeshoptProcessor] Unsupported data version " << version << std::endl; return false; }
+
+    unsigned int numArrays = readValue<unsigned int>(in);
+    for (unsigned int i = 0; i < numArrays; ++i)
+    {
+        if (!decodeArray(in, geom))
+        { OSG_WARN << "[MeshoptProcessor] Error decoding vertex data" << std::endl; return false; }
+    }
+
+    unsigned int numPrimitives = readValue<unsigned int>(in);
+    for (unsigned int i = 0; i < numPrimitives; ++i)
+    {
+        int type = readValue<int>(in), numInstances = readValue<int>(in);
+        GLenum mode = readValue<GLenum>(in); osg::ref_ptr<osg::PrimitiveSet> p;
+        switch (type)
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+            {
+                GLint first = readValue<GLint>(in); GLsizei count = readValue<GLsizei>(in);
+                p = new osg::DrawArrays(mode, first, count);
+            }
+            break;
+        case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+            {
+                GLint first = readValue<GLint>(in); std::vector<unsigned char> buffer;
+                osg::DrawArrayLengths* dal = new osg::DrawArrayLengths(mode, first); p = dal;
+                if (readBlock(in, buffer) && !buffer.empty())
+                {
+                    const GLsizei* ptr = (const GLsizei*)&buffer[0];
+                    for (size_t n = 0; n < buffer.size() / sizeof(GLsizei); ++n)
+                        dal->push_back(ptr[n]);
+                }
+            }
+            break;
+        case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+            p = decodeElements<osg::DrawElementsUByte>(in, mode); break;
+        case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+            p = decodeElements<osg::DrawElementsUShort>(in, mode); break;
+        case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+            p = decodeElements<osg::DrawElementsUInt>(in, mode); break;
+        default: break;
+        }
+
+        if (!p)
+        { OSG_WARN << "[MeshoptProcessor] Error decoding primitive data" << std::endl; return false; }
+        p->setNumInstances(numInstances); geom->addPrimitiveSet(p.get());
+    }
+    return true;
+#else
+    OSG_WARN << "[MeshoptProcessor] OSG version not supported" << std::endl;
+    return false;
+#endif
+}
+
+bool MeshoptProcessor::encodeMeshoptData(std::ostream& out, osg::Geometry* geom)
+{
+#if OSG_VERSION_GREATER_THAN(3, 1, 8)
+    const osg::Array* va = geom ? geom->getVertexArray() : NULL;
+    if (!va) { OSG_WARN << "[MeshoptProcessor] No vertex array to encode\n"; return false; }
+
+    std::vector<std::pair<int, const osg::Array*>> arrays;
+    arrays.push_back(std::pair<int, const osg::Array*>(VERTEX_SLOT, va));
+    if (geom->getNormalArray())
+        arrays.push_back(std::pair<int, const osg::Array*>(NORMAL_SLOT, geom->getNormalArray()));
+    if (geom->getColorArray())
+        arrays.push_back(std::pair<int, const osg::Array*>(COLOR_SLOT, geom->getColorArray()));
+    if (geom->getSecondaryColorArray())
+        arrays.push_back(std::pair<int, const osg::Array*>(
+            SECONDARY_COLOR_SLOT, geom->getSecondaryColorArray()));
+    if (geom->getFogCoordArray())
+        arrays.push_back(std::pair<int, const osg::Array*>(FOG_COORD_SLOT, geom->getFogCoordArray()));
+    for (unsigned int i = 0; i < geom->getNumTexCoordArrays(); ++i)
+    {
+        if (geom->getTexCoordArray(i)) arrays.push_back(
+            std::pair<int, const osg::Array*>(TEXCOORD_SLOT + i, geom->getTexCoordArray(i)));
+    }
+    for (unsigned int i = 0; i < geom->getNumVertexAttribArrays(); ++i)
+    {
+        if (geom->getVertexAttribArray(i)) arrays.push_back(
+            std::pair<int, const osg::Array*>(VERTEX_ATTRIB_SLOT + i, geom->getVertexAttribArray(i)));
+    }
+
+    writeValue<int>(out, MESHOPT_DATA_VERSION);
+    writeValue<unsigned int>(out, arrays.size());
+    for (size_t i = 0; i < arrays.size(); ++i)
+        encodeArray(out, arrays[i].first, arrays[i].second);
+
+    std::vector<const osg::PrimitiveSet*> primitives;
+    for (unsigned int i = 0; i < geom->getNumPrimitiveSets(); ++i)
+    {
+        const osg::PrimitiveSet* p = geom->getPrimitiveSet(i);
+        switch (p->getType())
+        {
+        case osg::PrimitiveSet::DrawArraysPrimitiveType:
+        case osg::PrimitiveSet::DrawArrayLengthsPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+        case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+            primitives.push_back(p); break;
+        default:
+            OSG_WARN << "[MeshoptProcessor] Unsupported primitive set " << p->className() << std::endl;
+            return false;
+        }
+    }
+
+    writeValue<unsigned int>(out, primitives.size());
+    for (size_t i = 0; i < primitives.size(); ++i)
+    {
+        const osg::PrimitiveSet* p = primitives[i];
+        writeValue<int>(out, (int)p->getType()); writeValue<int>(out, p->getNumInstances());
+        writeValue<GLenum>(out, p->getMode());
+        if (p->getType() == osg::PrimitiveSet::DrawArraysPrimitiveType)
+        {
+            const osg::DrawArrays* da = static_cast<const osg::DrawArrays*>(p);
+            writeValue<GLint>(out, da->getFirst()); writeValue<GLsizei>(out, da->getCount());
+        }
+        else if (p->getType() == osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
+        {
+            const osg::DrawArrayLengths* dal = static_cast<const osg::DrawArrayLengths*>(p);
+            writeValue<GLint>(out, dal->getFirst());
+            writeBlock(out, dal->empty() ? NULL : &(*dal)[0], dal->size() * sizeof(GLsizei));
+        }
+        else
+            encodeElements(out, p->getDrawElements(), va->getNumElements(), _optimizeVertexCache);
+    }
+    return true;
+#else
+    OSG_WARN << "[MeshoptProcessor] OSG version not supported" << std::endl;
+    return false;
+#endif
+}
+
+namespace osgVerse
+{
+    bool decodeMeshoptBufferView(unsigned char* dst, const unsigned char* src, size_t srcSize,
+                                 size_t count, size_t stride, const std::string& mode,
+                                 const std::string& filter)
+    {
+        int result = -1;
+        if (mode == "ATTRIBUTES")
+            result = meshopt_decodeVertexBuffer(dst, count, stride, src, srcSize);
+        else if (mode == "TRIANGLES")
+            result = meshopt_decodeIndexBuffer(dst, count, stride, src, srcSize);
+        else if (mode == "INDICES")
+            result = meshopt_decodeIndexSequence(dst, count, stride, src, srcSize);
+        if (result != 0) return false;
+
+        if (filter == "OCTAHEDRAL") meshopt_decodeFilterOct(dst, count, stride);
+        else if (filter == "QUATERNION") meshopt_decodeFilterQuat(dst, count, stride);
+        else if (filter == "EXPONENTIAL") meshopt_decodeFilterExp(dst, count, stride);
+        return true;
+    }
+}
+
+MeshoptGeometry::MeshoptGeometry() : osg::Geometry() {}
+MeshoptGeometry::MeshoptGeometry(const MeshoptGeometry& copy, const osg::CopyOp& op)
+    : osg::Geometry(copy, op) {}
+MeshoptGeometry::MeshoptGeometry(const osg::Geometry& copy, const osg::CopyOp& op)
+    : osg::Geometry(copy, op) {}
+
+// MeshoptGeometry Wrappers
+struct MeshoptGeometryReadCallback : public osgDB::FinishedObjectReadCallback
+{
+    virtual void objectRead(osgDB::InputStream&, osg::Object& obj)
+    {
+        osg::Geometry& geometry = static_cast<osg::Geometry&>(obj);
+        if (!geometry.getUseVertexBufferObjects())
+        {
+            geometry.setUseDisplayList(false);
+            geometry.setUseVertexBufferObjects(true);
+        }
+    }
+};
+
+static bool checkCompressedData(const osgVerse::MeshoptGeometry& geom)
+{ return true; }
+
+static bool readCompressedData(osgDB::InputStream& is, osgVerse::MeshoptGeometry& geom)
+{
+    unsigned int dataSize = 0; is >> dataSize;
+    if (dataSize == 0) return true;
+
+    std::vector<char> data(dataSize);
+    is.readCharArray(&data[0], dataSize);
+
+    MeshoptProcessor mp;
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    ss.write(&data[0], dataSize);
+    return mp.decodeMeshoptData(ss, &geom);
+}
+
+static bool writeCompressedData(osgDB::OutputStream& os, const osgVerse::MeshoptGeometry& geom)
+{
+    MeshoptProcessor mp;
+    std::stringstream ss(std::ios::in | std::ios::out | std::ios::binary);
+    if (mp.encodeMeshoptData(ss, (osg::Geometry*)&geom))
+    {
+        std::string data = ss.str();
+        unsigned int dataSize = data.size();
+        os << dataSize; if (dataSize == 0) return true;
+        os.writeCharArray(&data[0], dataSize); return true;
+    }
+    return false;
+}
+
+#if OSG_VERSION_GREATER_THAN(3, 4, 1)
+REGISTER_OBJECT_WRAPPER(MeshoptGeometry,
+    new osgVerse::MeshoptGeometry,
+    osgVerse::MeshoptGeometry,  // ignore osg::Geometry to NOT serialize vertices and primitives
+    "osg::Object osg::Node osg::Drawable osgVerse::MeshoptGeometry")
+{
+    {
+        UPDATE_TO_VERSION_SCOPED(154)
+        ADDED_ASSOCIATE("osg::Node")
+    }
+    ADD_USER_SERIALIZER(CompressedData);
+    wrapper->addFinishedObjectReadCallback(new MeshoptGeometryReadCallback());
+}
+#else
+REGISTER_OBJECT_WRAPPER(MeshoptGeometry,
+    new osgVerse::MeshoptGeometry,
+    osgVerse::MeshoptGeometry,  // ignore osg::Geometry to NOT serialize vertices and primitives
+    "osg::Object osg::Drawable osgVerse::MeshoptGeometry")
+{
+    ADD_USER_SERIALIZER(CompressedData);
+    wrapper->addFinishedObjectReadCallback(new MeshoptGeometryReadCallback());
+}
+#endif
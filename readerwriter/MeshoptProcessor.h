@@ -0,0 +1,48 @@
+#ifndef MANA_READERWRITER_MESHOPTPROCESSOR_HPP
+#define MANA_READERWRITER_MESHOPTPROCESSOR_HPP
+
+#include <osg/Geometry>
+#include <osgDB/ReaderWriter>
+#include "Export.h"
+
+namespace osgVerse
+{
+    /** Lossless geometry compression with meshoptimizer codecs. Compared with DracoProcessor
+        it keeps all vertex arrays in their original types (e.g., quantized ones) and decodes
+        much faster, which is preferred for paging and web clients */
+    class OSGVERSE_RW_EXPORT MeshoptProcessor : public osg::Referenced
+    {
+    public:
+        MeshoptProcessor() : _optimizeVertexCache(true) {}
+
+        /// Reorder triangle indices for vertex cache before encoding, which also compresses better
+        void setOptimizeVertexCache(bool b) { _optimizeVertexCache = b; }
+        bool getOptimizeVertexCache() const { return _optimizeVertexCache; }
+
+        osg::Geometry* decodeMeshoptData(std::istream& in);
+        bool decodeMeshoptData(std::istream& in, osg::Geometry* geom);
+        bool encodeMeshoptData(std::ostream& out, osg::Geometry* geom);
+
+    protected:
+        bool _optimizeVertexCache;
+    };
+
+    class OSGVERSE_RW_EXPORT MeshoptGeometry : public osg::Geometry
+    {
+    public:
+        MeshoptGeometry();
+        MeshoptGeometry(const MeshoptGeometry& copy,
+                        const osg::CopyOp& op = osg::CopyOp::SHALLOW_COPY);
+        MeshoptGeometry(const osg::Geometry& copy,
+                        const osg::CopyOp& op = osg::CopyOp::SHALLOW_COPY);
+        META_Object(osgVerse, MeshoptGeometry)
+    };
+
+    /** Decode a buffer view of glTF extension EXT_meshopt_compression to 'dst'
+        mode: ATTRIBUTES / TRIANGLES / INDICES, filter: NONE / OCTAHEDRAL / QUATERNION / EXPONENTIAL */
+    OSGVERSE_RW_EXPORT bool decodeMeshoptBufferView(
+            unsigned char* dst, const unsigned char* src, size_t srcSize, size_t count,
+            size_t stride, const std::string& mode, const std::string& filter);
+}
+
+#endif
@@ -3,8 +3,11 @@
 #include "Utilities.h"
 #include "LoadTextureKTX.h"
 #include "modeling/GeometryMerger.h"
+#include "modeling/MeshLodGenerator.h"
 #include "modeling/Utilities.h"
 #include "nanoid/nanoid.h"
+#define XXH_INLINE_ALL
+#include "xxhash.h"
 
 #include <osg/io_utils>
 #include <osg/PagedLOD>
@@ -13,48 +16,40 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
-#include <osgUtil/Simplifier>
+#include <marl/scheduler.h>
+#include <marl/waitgroup.h>
 #include <vector>
 #include <regex>
 #include <limits>
+#include <atomic>
+#include <memory>
 #include <iomanip>
 using namespace osgVerse;
 
-class ProcessThread : public OpenThreads::Thread
+/// Run func(0..count-1) as tasks of the bound scheduler and wait for all of them, or run them
+/// serially if no scheduler is bound to current thread. Idle workers steal pending tasks.
+/// Only as many tasks as workers are started, each taking the next index when one is done, so
+/// jobs in flight (with their fiber stacks and loaded tiles) don't grow with the dataset size
+template<typename Func> static void runTileTasks(size_t count, const Func& func)
 {
-public:
-    ProcessThread(size_t id, TileOptimizer* opt) : _optimizer(opt), _id(id), _done(false) {}
-    bool done() const { return _done; }
-
-    void add(const std::string& name, const TileOptimizer::TileNameList& src)
-    { _sourceTiles.push_back(TileNamePair(name, src)); }
-
-    virtual void run()
+    marl::Scheduler* scheduler = marl::Scheduler::get();
+    if (count < 2 || scheduler == NULL)
+    { for (size_t i = 0; i < count; ++i) func(i); return; }
+
+    size_t numWorkers = (size_t)osg::maximum(scheduler->config().workerThread.count, 1);
+    size_t numTasks = osg::minimum(count, numWorkers);
+    std::atomic<size_t> nextIndex(0); std::atomic<size_t>* next = &nextIndex;
+    marl::WaitGroup waitGroup((unsigned int)numTasks);
+    for (size_t t = 0; t < numTasks; ++t)
     {
-        while (!_done)
+        marl::schedule([=]()
         {
-            if (_sourceTiles.empty()) { _done = true; break; }
-            std::string outTileFolder = _sourceTiles[0].first;
-            TileOptimizer::TileNameList srcTiles = _sourceTiles[0].second;
-            _sourceTiles.erase(_sourceTiles.begin());
-
-            std::cout << outTileFolder << " is being processed at " << "Thread-" << _id
-                      << "... " << _sourceTiles.size() << " remains." << std::endl;
-            _optimizer->processTileFiles(outTileFolder, srcTiles);
-            OpenThreads::Thread::microSleep(50);
-        }
-        _done = true;
+            for (size_t i = (*next)++; i < count; i = (*next)++) func(i);
+            waitGroup.done();
+        });
     }
-
-    virtual int cancel()
-    { _done = true; return OpenThreads::Thread::cancel(); }
-
-protected:
-    typedef std::pair<std::string, TileOptimizer::TileNameList> TileNamePair;
-    std::vector<TileNamePair> _sourceTiles;
-    TileOptimizer* _optimizer;
-    size_t _id;  bool _done;
-};
+    waitGroup.wait();
+}
 
 class FindPlodVisitor : public osg::NodeVisitor
 {
@@ -115,7 +110,7 @@ TileOptimizer::TileOptimizer(const std::string& outFolder, const std::string& ou
         if (endChar != '/' && endChar != '\\') _outFolder += '/';
     }
     _lodScaleAdjacency = 1.0f; _lodScaleTopLevels = 1.0f; _mulForDistanceMode = 2.0f;
-    _simplifyRatio = 0.4f; _numThreads = 10; _withThreads = true;
+    _simplifyRatio = 0.4f; _numThreads = 10; _withThreads = true; _atlasPageSize = 0;
 }
 
 TileOptimizer::~TileOptimizer()
@@ -171,6 +166,7 @@ bool TileOptimizer::processGroundLevel(int combinedX0, int combinedY0, const std
 {
     std::vector<std::string> rootFileNames;
     osgDB::makeDirectory(_outFolder); osgDB::makeDirectory(_outFolder + subDir);
+    if (!_journalFile.empty()) { openJournal(); osgDB::makeDirectory(_outFolder + subDir + "_rough"); }
     for (std::map<std::string, NumberMap>::iterator itr = _srcNumberMap.begin();
          itr != _srcNumberMap.end(); ++itr)
     {
@@ -216,7 +212,7 @@ bool TileOptimizer::processGroundLevel(int combinedX0, int combinedY0, const std
                 srcTiles2.push_back(NameAndRoughLevel(srcTiles[n], NULL));
 
             std::string outFileName = subDir + "/" + outSubName + ".osgb";
-            osg::ref_ptr<osg::Node> rough = processTopTileFiles(outFileName, false, srcTiles2);
+            osg::ref_ptr<osg::Node> rough = processTopTileFilesStreamed(outFileName, false, srcTiles2);
             combination[itr2->first] = NameAndRoughLevel(outFileName, rough);
         }
 
@@ -256,7 +252,7 @@ bool TileOptimizer::processGroundLevel(int combinedX0, int combinedY0, const std
                 //std::string outFileName = isRootNode ? (tilePrefix + "root.osgb")
                 //                        : (subDir + "/" + outSubName + ".osgb");
                 std::string outFileName = subDir + "/" + outSubName + ".osgb";
-                osg::ref_ptr<osg::Node> rough = processTopTileFiles(outFileName, isRootNode, srcTiles);
+                osg::ref_ptr<osg::Node> rough = processTopTileFilesStreamed(outFileName, isRootNode, srcTiles);
                 combination[itr2->first] = NameAndRoughLevel(outFileName, rough);
                 if (isRootNode) rootFileNames.push_back(outFileName);
             }
@@ -276,7 +272,8 @@ bool TileOptimizer::processAdjacency(int adjacentX, int adjacentY)
     if (adjacentX < 1 || adjacentY < 1) return false;
 
     char outSubFolder[1024] = ""; osgDB::makeDirectory(_outFolder);
-    std::vector<ProcessThread*> threads(_numThreads); size_t ptr = 0;
+    if (!_journalFile.empty()) openJournal();
+    std::vector<std::pair<std::string, TileNameList>> tileJobs;
     for (std::map<std::string, NumberMap>::iterator itr = _srcNumberMap.begin();
         itr != _srcNumberMap.end(); ++itr)
     {
@@ -319,34 +316,34 @@ bool TileOptimizer::processAdjacency(int adjacentX, int adjacentY)
             std::string outTileFolder = std::string(outSubFolder) + '/';
             osgDB::makeDirectory(_outFolder + outTileFolder);
 
-            if (_numThreads > 0)
-            {
-                size_t index = (ptr++) % _numThreads; ProcessThread* th = threads[index];
-                if (!th) { th = new ProcessThread(index, this); threads[index] = th; }
-                th->add(outTileFolder, srcTiles);
-            }
-            else
-                processTileFiles(outTileFolder, srcTiles);
+            if (_numThreads > 0) tileJobs.push_back(std::make_pair(outTileFolder, srcTiles));
+            else processTileFiles(outTileFolder, srcTiles);
         }
     }
+    if (tileJobs.empty()) return true;
 
-    int numCPUs = OpenThreads::GetNumberOfProcessors(); if (numCPUs < 1) numCPUs = 1;
-    for (size_t i = 0; i < _numThreads; ++i)
+    // All tiles go to one work-stealing scheduler, and every tile also splits its loading, merging
+    // and encoding stages into sub-tasks, so a slow tile never stalls a whole thread queue
+    marl::Scheduler* scheduler = marl::Scheduler::get();
+    std::unique_ptr<marl::Scheduler> localScheduler;
+    if (scheduler == NULL)
     {
-        ProcessThread* th = threads[i]; if (th == NULL) continue;
-        th->setProcessorAffinity(i % numCPUs); th->start();
+        marl::Scheduler::Config config;
+        config.setWorkerThreadCount(_numThreads);
+        config.setFiberStackSize(4 * 1024 * 1024);
+        localScheduler.reset(new marl::Scheduler(config));
+        localScheduler->bind();
     }
 
-    bool allThreadDone = false;
-    while (!allThreadDone)
+    std::atomic<size_t> numRemained(tileJobs.size());
+    runTileTasks(tileJobs.size(), [&](size_t i)
     {
-        allThreadDone = true;
-        for (size_t i = 0; i < _numThreads; ++i)
-        {
-            ProcessThread* th = threads[i]; if (!th) continue; else allThreadDone = false;
-            if (th->done()) { th->join(); delete th; threads[i] = NULL; }
-        }
-    }
+        const std::string& outTileFolder = tileJobs[i].first;
+        processTileFiles(outTileFolder, tileJobs[i].second);
+        OSG_NOTICE << "[TileOptimizer] " << outTileFolder << " is processed, "
+                   << (--numRemained) << " remains" << std::endl;
+    });
+    if (localScheduler) marl::Scheduler::unbind();
     return true;
 }
 
@@ -378,14 +375,15 @@ void TileOptimizer::processTileFiles(const std::string& outTileFolder, const Til
         }
     }
 
-    // Merge every level-set, starting from the highest one
+    // Map source tiles to output tile names of every level-set first, so that level-sets
+    // can then be loaded, merged and encoded independently from each other
     std::map<std::string, std::string> plodNameMap;
+    std::vector<std::pair<std::string, TileNameList*>> levelJobs;
     for (std::map<std::string, TileNameList>::reverse_iterator itr = levelToFileMap.rbegin();
          itr != levelToFileMap.rend(); ++itr)
     {
         TileNameList& tileFiles = itr->second;
         if (tileFiles.empty()) continue;
-        if (_withThreads) OpenThreads::Thread::YieldCurrentThread();
 
         // Get output tile name
         std::string outTileName = outTileFolder, postfix = itr->first;
@@ -393,25 +391,34 @@ void TileOptimizer::processTileFiles(const std::string& outTileFolder, const Til
             outTileName = outTileFolder.substr(0, outTileFolder.size() - 1);
         outTileName += ((postfix == "L0") ? ".osgb" : ("_" + postfix));
 
-        // Map source tiles to output tile name
         std::string outFileName = outTileFolder + outTileName;
-        std::vector<osg::ref_ptr<osg::Node>> loadedNodes;
-        for (size_t i = 0; i < tileFiles.size(); ++i)
+        for (size_t i = 0; i < tileFiles.size(); ++i) plodNameMap[tileFiles[i]] = outFileName;
+        levelJobs.push_back(std::pair<std::string, TileNameList*>(outFileName, &tileFiles));
+    }
+
+    // Merge every level-set, starting from the highest one
+    runTileTasks(levelJobs.size(), [&](size_t j)
+    {
+        const std::string& outFileName = levelJobs[j].first;
+        const TileNameList& tileFiles = *(levelJobs[j].second);
+        if (isJournaled("adjacency", outFileName)) return;
+        std::vector<osg::ref_ptr<osg::Node>> loadedNodes(tileFiles.size());
+        runTileTasks(tileFiles.size(), [&](size_t i)
         {
             osg::ref_ptr<osg::Node> tile = osgDB::readNodeFile(tileFiles[i]);
-            plodNameMap[tileFiles[i]] = outFileName;
-            if (tile.valid())
-            {
-                if (_filterNodeCallback.valid())
-                    _filterNodeCallback->prefilter(tileFiles[i], *tile);
-                loadedNodes.push_back(tile);
-            }
-        }
+            if (tile.valid() && _filterNodeCallback.valid())
+                _filterNodeCallback->prefilter(tileFiles[i], *tile);
+            loadedNodes[i] = tile;
+        });
+
+        std::vector<osg::ref_ptr<osg::Node>> validNodes;
+        for (size_t i = 0; i < loadedNodes.size(); ++i)
+        { if (loadedNodes[i].valid()) validNodes.push_back(loadedNodes[i]); }
         if (_withThreads) OpenThreads::Thread::YieldCurrentThread();
 
         // Merge and generate new tile node
 #if true
-        osg::ref_ptr<osg::Node> newTile = mergeNodes(loadedNodes, plodNameMap);
+        osg::ref_ptr<osg::Node> newTile = mergeNodes(validNodes, plodNameMap);
         if (newTile.valid())
         {
             osg::ref_ptr<TextureOptimizer> opt;
@@ -425,11 +432,12 @@ void TileOptimizer::processTileFiles(const std::string& outTileFolder, const Til
 
             osg::ref_ptr<osgDB::Options> options = new osgDB::Options("WriteImageHint=IncludeFile");
             options->setPluginStringData("UseBASISU", "1");
-            osgDB::writeNodeFile(*newTile, _outFolder + outFileName, options.get());
+            if (osgDB::writeNodeFile(*newTile, _outFolder + outFileName, options.get()))
+                writeJournal("adjacency", outFileName);
             if (_withBasisu) opt->deleteSavedTextures();
         }
 #endif
-    }
+    });
 }
 
 osg::Node* TileOptimizer::processTopTileFiles(const std::string& outTileFileName, bool isRootNode,
@@ -524,6 +532,119 @@ osg::Node* TileOptimizer::processTopTileFiles(const std::string& outTileFileName
     return mergedNode.release();  // return merged rough level node
 }
 
+osg::Node* TileOptimizer::processTopTileFilesStreamed(const std::string& outTileFileName, bool isRootNode,
+                                                      TileNameAndRoughList& srcTiles)
+{
+    if (_journalFile.empty()) return processTopTileFiles(outTileFileName, isRootNode, srcTiles);
+    std::string roughFileName = getRoughFileName(outTileFileName);
+    if (isJournaled("ground", outTileFileName) && osgDB::fileExists(roughFileName))
+        return NULL;  // finished in a previous run, rough level will be reloaded from disk
+
+    // Reload rough levels of source tiles saved in previous combinations
+    for (size_t i = 0; i < srcTiles.size(); ++i)
+    {
+        std::pair<std::string, osg::ref_ptr<osg::Node>>& nameAndRough = srcTiles[i];
+        if (nameAndRough.second.valid()) continue;
+
+        std::string srcRoughFileName = getRoughFileName(nameAndRough.first);
+        if (osgDB::fileExists(srcRoughFileName))
+            nameAndRough.second = osgDB::readNodeFile(srcRoughFileName);
+    }
+
+    osg::ref_ptr<osg::Node> rough = processTopTileFiles(outTileFileName, isRootNode, srcTiles);
+    for (size_t i = 0; i < srcTiles.size(); ++i) srcTiles[i].second = NULL;
+    if (rough.valid())
+    {
+        osg::ref_ptr<osgDB::Options> options = new osgDB::Options("WriteImageHint=IncludeFile");
+        if (osgDB::writeNodeFile(*rough, roughFileName, options.get()))
+            writeJournal("ground", outTileFileName);
+    }
+    return NULL;  // the rough node is released to keep memory bounded
+}
+
+std::string TileOptimizer::getRoughFileName(const std::string& outTileFileName) const
+{
+    std::string path = osgDB::getFilePath(outTileFileName);
+    if (path.empty()) return "";  // not a combined tile
+    return _outFolder + path + "_rough/" + osgDB::getSimpleFileName(outTileFileName);
+}
+
+static std::string computeFileHash(const std::string& fileName)
+{
+    std::ifstream in(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!in) return "";
+
+    XXH64_state_t* state = XXH64_createState(); XXH64_reset(state, 0);
+    std::vector<char> buffer(1024 * 1024);
+    while (in)
+    {
+        in.read(&buffer[0], buffer.size());
+        if (in.gcount() > 0) XXH64_update(state, &buffer[0], (size_t)in.gcount());
+    }
+
+    std::stringstream ss; ss << std::hex << std::setw(16) << std::setfill('0')
+                             << (unsigned long long)XXH64_digest(state);
+    XXH64_freeState(state); return ss.str();
+}
+
+bool TileOptimizer::openJournal()
+{
+    std::lock_guard<std::mutex> lock(_journalMutex);
+    if (_journal.is_open()) return true;
+
+    std::string journalFile = osgDB::isAbsolutePath(_journalFile)
+                            ? _journalFile : (_outFolder + _journalFile);
+    std::ifstream in(journalFile.c_str(), std::ios::in);
+    if (in)
+    {
+        std::string line;
+        while (std::getline(in, line))
+        {
+            // Each line: stage <TAB> output file name <TAB> output hash
+            size_t p0 = line.find('\t'), p1 = line.rfind('\t');
+            if (p0 == std::string::npos || p1 == p0) continue;
+            _journalRecords[line.substr(0, p1)] = line.substr(p1 + 1);
+        }
+        OSG_NOTICE << "[TileOptimizer] Resuming from journal " << journalFile << " with "
+                   << _journalRecords.size() << " finished tiles" << std::endl;
+    }
+
+    _journal.open(journalFile.c_str(), std::ios::out | std::ios::app);
+    if (!_journal)
+    {
+        OSG_WARN << "[TileOptimizer] Failed to open journal " << journalFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TileOptimizer::isJournaled(const std::string& stage, const std::string& outFileName)
+{
+    std::string hashValue;
+    {
+        std::lock_guard<std::mutex> lock(_journalMutex);
+        std::map<std::string, std::string>::iterator itr =
+            _journalRecords.find(stage + '\t' + outFileName);
+        if (itr == _journalRecords.end()) return false; else hashValue = itr->second;
+    }
+
+    // Make sure the output file still exists and is complete
+    if (hashValue.empty()) return false;
+    return computeFileHash(_outFolder + outFileName) == hashValue;
+}
+
+void TileOptimizer::writeJournal(const std::string& stage, const std::string& outFileName)
+{
+    if (_journalFile.empty()) return;
+    std::string key = stage + '\t' + outFileName;
+    std::string hashValue = computeFileHash(_outFolder + outFileName);
+    if (hashValue.empty()) return;  // output not written, so it should be processed again
+
+    std::lock_guard<std::mutex> lock(_journalMutex);
+    _journalRecords[key] = hashValue;
+    if (_journal.is_open()) _journal << key << '\t' << hashValue << std::endl;
+}
+
 osg::Vec3s TileOptimizer::getNumberFromTileName(const std::string& name, const std::string& inRegex,
                                                 std::string* textPrefix)
 {
@@ -586,12 +707,15 @@ osg::Node* TileOptimizer::mergeNodes(const std::vector<osg::ref_ptr<osg::Node>>&
                    << loadedNodes.size() << " tile nodes" << std::endl;
     }
 
+    std::vector<std::vector<osg::PagedLOD*>*> plodGroups;
     for (std::map<std::string, std::vector<osg::PagedLOD*>>::iterator itr = plodGroupMap.begin();
-         itr != plodGroupMap.end(); ++itr)
+         itr != plodGroupMap.end(); ++itr) plodGroups.push_back(&(itr->second));
+
+    std::vector<osg::ref_ptr<osg::PagedLOD>> mergedPlodList(plodGroups.size());
+    runTileTasks(plodGroups.size(), [&](size_t g)
     {
-        std::vector<osg::PagedLOD*> plodList = itr->second;
+        const std::vector<osg::PagedLOD*>& plodList = *plodGroups[g];
         osg::PagedLOD* ref = plodList[0];
-        if (_withThreads) OpenThreads::Thread::YieldCurrentThread();
 
         osg::BoundingSphere bs; std::vector<std::pair<osg::Geometry*, osg::Matrix>> geomList;
         for (size_t i = 0; i < plodList.size(); ++i)
@@ -632,8 +756,9 @@ osg::Node* TileOptimizer::mergeNodes(const std::vector<osg::ref_ptr<osg::Node>>&
             fileName = plodNameMap.find(fileName)->second;  // this should be valid
             plod->setFileName(i, osgDB::getSimpleFileName(fileName));
         }
-        root->addChild(plod.get());
-    }
+        mergedPlodList[g] = plod;
+    });
+    for (size_t i = 0; i < mergedPlodList.size(); ++i) root->addChild(mergedPlodList[i].get());
 
     // If no paged LOD nodes found, this may be a leaf tile with only geometries
     if (plodGroupMap.empty())
@@ -647,23 +772,29 @@ osg::Node* TileOptimizer::mergeNodes(const std::vector<osg::ref_ptr<osg::Node>>&
 
         OSG_NOTICE << "[TileOptimizer] Merging " << geomList.size() << " geometries from "
                    << loadedNodes.size() << " leaf nodes" << std::endl;
-        if (!geomList.empty()) root->addChild(mergeGeometries(geomList, 4096, false));
+        if (!geomList.empty())
+            root->addChild(mergeGeometries(geomList, 4096, false, _atlasPageSize > 0));
         if (_withThreads) OpenThreads::Thread::YieldCurrentThread();
     }
     return (root->getNumChildren() > 0) ? root.release() : NULL;
 }
 
 osg::Node* TileOptimizer::mergeGeometries(const std::vector<std::pair<osg::Geometry*, osg::Matrix>>& geomList,
-                                          int highestRes, bool simplify)
+                                          int highestRes, bool simplify, bool asPages)
 {
     osg::ref_ptr<osg::Geode> geode = new osg::Geode;
 #if true
-    for (size_t i = 0; i < geomList.size(); i += 16)
+    // Every 16 geometries are merged, simplified and compressed as an independent task
+    std::vector<std::vector<osg::ref_ptr<osg::Geometry>>> mergedList((geomList.size() + 15) / 16);
+    runTileTasks(mergedList.size(), [&](size_t c)
     {
-        GeometryMerger merger;
-        osg::ref_ptr<osg::Geometry> result = merger.process(geomList, i, 16, highestRes);
-        if (result.valid())
+        GeometryMerger merger; std::vector<osg::ref_ptr<osg::Geometry>> results;
+        if (asPages) results = merger.processAsPages(geomList, c * 16, 16, _atlasPageSize);
+        else results.push_back(merger.process(geomList, c * 16, 16, highestRes));
+        for (size_t r = 0; r < results.size(); ++r)
         {
+            osg::ref_ptr<osg::Geometry> result = results[r];
+            if (!result.valid()) continue;
             if (simplify && _simplifyRatio > 0.0f)
             {
                 // FIXME: not good to weld vertices, it makes wrong texture mapping
@@ -706,17 +837,20 @@ osg::Node* TileOptimizer::mergeGeometries(const std::vector<std::pair<osg::Geome
                 result->removePrimitiveSet(0, result->getNumPrimitiveSets());
                 result->addPrimitiveSet(de);
 
-                osgUtil::Simplifier simplifier(_simplifyRatio);
-                simplifier.simplify(*result);
+                osg::ref_ptr<MeshLodGenerator> simplifier = new MeshLodGenerator;
+                simplifier->setMaxRelativeError(1.0f);  // only limited by the ratio
+                simplifier->simplify(*result, _simplifyRatio);
             }
 
-            if (_withDraco)
-            {
-                osg::ref_ptr<osgVerse::DracoGeometry> geom2 = new osgVerse::DracoGeometry(*result);
-                geode->addDrawable(geom2.get());
-            }
-            else geode->addDrawable(result.get());
+            if (_withDraco) mergedList[c].push_back(new osgVerse::DracoGeometry(*result));
+            else mergedList[c].push_back(result);
         }
+    });
+
+    for (size_t i = 0; i < mergedList.size(); ++i)
+    {
+        for (size_t r = 0; r < mergedList[i].size(); ++r)
+            geode->addDrawable(mergedList[i][r].get());
     }
 #else
     for (size_t i = 0; i < geomList.size(); ++i)
@@ -4,6 +4,8 @@
 #include <osg/Transform>
 #include <osg/Geometry>
 #include <osgDB/ReaderWriter>
+#include <fstream>
+#include <mutex>
 #include "Export.h"
 
 namespace osgVerse
@@ -13,14 +15,28 @@ namespace osgVerse
     public:
         TileOptimizer(const std::string& outFolder, const std::string& outFormat = "%s_%s");
 
+        /// Set worker count of the work-stealing scheduler used by processAdjacency(), or 0 to
+        /// process tiles serially. An already bound marl scheduler of caller thread is reused
         void setUseThreads(int num) { _numThreads = num; _withThreads = (num > 0); }
         void setMergingSimplifyRatio(float r) { _simplifyRatio = r; }
+
+        /// Merge leaf tiles into atlas pages not larger than this size, keeping native resolution of
+        /// their textures, instead of one atlas scaled down to 4096. Default is 0 (disabled)
+        void setMergingAtlasPageSize(int size) { _atlasPageSize = size; }
+
         void setLodScale(float adjacency, float groundLv, float mulForDistanceMode)
         {
             _lodScaleAdjacency = adjacency; _lodScaleTopLevels = groundLv;
             _mulForDistanceMode = mulForDistanceMode;
         }
 
+        /// Set a journal file (relative to output folder) to enable streaming and resumable mode.
+        /// Every successfully written tile is recorded as (stage, tile name, output hash) and skipped
+        /// when processing again, and rough levels of top tiles are saved to disk and reloaded
+        /// only when combining, instead of being kept in memory until the root is written
+        void setJournalFile(const std::string& file) { _journalFile = file; }
+        const std::string& getJournalFile() const { return _journalFile; }
+
         bool prepare(const std::string& inputFolder, const std::string& inRegex = "([+-]?\\d+)",
                      bool withDraco = true, bool withBasisuTex = true);
         bool processAdjacency(int adjacentX = 2, int adjacentY = 2);
@@ -32,6 +48,8 @@ namespace osgVerse
         osg::Node* processTopTileFiles(const std::string& outTileFileName, bool isRootNode,
                                        const TileNameAndRoughList& srcTiles);
 
+        /** Tiles are processed concurrently on marl worker threads, so prefilter() and postfilter()
+            may be called at the same time for different tiles and must be thread-safe */
         struct FilterNodeCallback : public osg::Referenced
         {
             virtual void prefilter(const std::string& name, osg::Node& node) {}
@@ -42,20 +60,29 @@ namespace osgVerse
 
     protected:
         virtual ~TileOptimizer();
+        osg::Node* processTopTileFilesStreamed(const std::string& outTileFileName, bool isRootNode,
+                                               TileNameAndRoughList& srcTiles);
+        std::string getRoughFileName(const std::string& outTileFileName) const;
+        bool openJournal();
+        bool isJournaled(const std::string& stage, const std::string& outFileName);
+        void writeJournal(const std::string& stage, const std::string& outFileName);
+
         osg::Vec3s getNumberFromTileName(const std::string& name, const std::string& inRegex,
                                          std::string* textPrefix = NULL);
         osg::Node* mergeNodes(const std::vector<osg::ref_ptr<osg::Node>>& loadedNodes,
                               const std::map<std::string, std::string>& plodNameMap);
         osg::Node* mergeGeometries(const std::vector<std::pair<osg::Geometry*, osg::Matrix>>& geomList,
-                                   int highestRes, bool simplify);
+                                   int highestRes, bool simplify, bool asPages = false);
 
         typedef std::map<osg::Vec2s, std::string> NumberMap;
         std::map<std::string, NumberMap> _srcNumberMap;
         std::map<std::string, std::pair<osg::Vec2s, osg::Vec2s>> _minMaxMap;
+        std::map<std::string, std::string> _journalRecords;
+        std::ofstream _journal; std::mutex _journalMutex;
         osg::ref_ptr<FilterNodeCallback> _filterNodeCallback;
-        std::string _inFolder, _outFolder, _inFormat, _outFormat;
+        std::string _inFolder, _outFolder, _inFormat, _outFormat, _journalFile;
         float _lodScaleAdjacency, _lodScaleTopLevels, _mulForDistanceMode, _simplifyRatio;
-        int _numThreads; bool _withDraco, _withBasisu, _withThreads;
+        int _numThreads, _atlasPageSize; bool _withDraco, _withBasisu, _withThreads;
     };
 
 }
@@ -5,12 +5,18 @@
 #include <osg/Multisample>
 #include <osg/Material>
 #include <osg/PolygonOffset>
+#include <osg/ValueObject>
 #include <osgDB/Registry>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <ghc/filesystem.hpp>
 #include <nanoid/nanoid.h>
 #include <libhv/all/base64.h>
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#if defined(__SSE__)
+#   include <xmmintrin.h>
+#endif
 
 #include "modeling/Utilities.h"
 #include "LoadTextureKTX.h"
@@ -241,6 +247,7 @@ TextureOptimizer::TextureOptimizer(bool inlineFile, const std::string& newTexFol
     _textureFolder = newTexFolder;
     _saveAsInlineFile = inlineFile;
     _generateMipmaps = false;
+    _batchProcessing = false;
     _ktxOptions = new osgDB::Options("UseBASISU=1");
 }
 
@@ -312,16 +319,100 @@ void TextureOptimizer::applyTexture(osg::Texture* tex, unsigned int unit)
     osg::Texture2D* tex2D = dynamic_cast<osg::Texture2D*>(tex);
     if (tex2D && tex2D->getImage())
     {
+        if (_batchProcessing) { _batchTextures.push_back(tex2D); return; }
+
         // Copy to original image as it may be shared by other textures
         osg::ref_ptr<osg::Image> image0 = tex2D->getImage();
         osg::ref_ptr<osg::Image> image1 = compressImage(tex, image0.get(), !_saveAsInlineFile);
-        if (!image1 || (image1.valid() && !image1->valid())) return;
-        image0->allocateImage(image1->s(), image1->t(), image1->r(),
-                              image1->getPixelFormat(), image1->getDataType(),
-                              image1->getPacking());
-        image0->setInternalTextureFormat(image1->getInternalTextureFormat());
-        memcpy(image0->data(), image1->data(), image1->getTotalSizeInBytes());
+        applyCompressedImage(image0.get(), image1.get());
+    }
+}
+
+void TextureOptimizer::applyCompressedImage(osg::Image* image0, osg::Image* image1)
+{
+    if (!image1 || !image1->valid()) return;
+    image0->allocateImage(image1->s(), image1->t(), image1->r(),
+                          image1->getPixelFormat(), image1->getDataType(),
+                          image1->getPacking());
+    image0->setInternalTextureFormat(image1->getInternalTextureFormat());
+    memcpy(image0->data(), image1->data(), image1->getTotalSizeInBytes());
+}
+
+unsigned int TextureOptimizer::flush()
+{
+    // Collect images which may be shared by textures
+    std::map<osg::Image*, std::vector<osg::Texture2D*>> imageUsers;
+    std::vector<osg::ref_ptr<osg::Image>> images;
+    for (size_t i = 0; i < _batchTextures.size(); ++i)
+    {
+        osg::Image* img = _batchTextures[i]->getImage();
+        if (!img || !img->valid()) continue;
+        std::vector<osg::Texture2D*>& users = imageUsers[img];
+        if (users.empty()) images.push_back(img); users.push_back(_batchTextures[i].get());
+    }
+
+    // Hash image contents in parallel
+    int numImages = (int)images.size();
+    std::vector<XXH64_hash_t> hashes(numImages);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < numImages; ++i)
+    {
+        osg::Image* img = images[i].get();
+        unsigned int header[6] = { (unsigned int)img->s(), (unsigned int)img->t(), (unsigned int)img->r(),
+                                   (unsigned int)img->getInternalTextureFormat(),
+                                   img->getPixelFormat(), img->getDataType() };
+        XXH64_hash_t seed = XXH64(header, sizeof(header), 0);
+        hashes[i] = XXH64(img->data(), img->getTotalSizeInBytesIncludingMipmaps(), seed);
+    }
+
+    // Find byte-identical images, the first one of each group is the representative
+    std::map<XXH64_hash_t, std::vector<int>> hashToUniques;
+    std::vector<int> representatives(numImages), uniques;
+    for (int i = 0; i < numImages; ++i)
+    {
+        osg::Image* img = images[i].get(); representatives[i] = i;
+        std::vector<int>& candidates = hashToUniques[hashes[i]];
+        for (size_t j = 0; j < candidates.size(); ++j)
+        {
+            osg::Image* rep = images[candidates[j]].get();
+            if (rep->s() == img->s() && rep->t() == img->t() && rep->r() == img->r() &&
+                rep->getInternalTextureFormat() == img->getInternalTextureFormat() &&
+                rep->getPixelFormat() == img->getPixelFormat() &&
+                rep->getDataType() == img->getDataType() &&
+                rep->getTotalSizeInBytesIncludingMipmaps() == img->getTotalSizeInBytesIncludingMipmaps() &&
+                !memcmp(rep->data(), img->data(), img->getTotalSizeInBytesIncludingMipmaps()))
+            { representatives[i] = candidates[j]; break; }
+        }
+        if (representatives[i] == i) { candidates.push_back(i); uniques.push_back(i); }
     }
+
+    // Generate mipmaps and compress unique images in parallel
+    int numUniques = (int)uniques.size();
+    std::vector<osg::Texture2D*> uniqueTextures(numUniques);
+    for (int i = 0; i < numUniques; ++i)
+        uniqueTextures[i] = imageUsers[images[uniques[i]].get()].front();
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < numUniques; ++i)
+    {
+        osg::Image* image0 = images[uniques[i]].get();
+        osg::ref_ptr<osg::Image> image1 = compressImage(uniqueTextures[i], image0, !_saveAsInlineFile);
+        applyCompressedImage(image0, image1.get());
+    }
+
+    // Share representatives with textures of duplicated images
+    for (int i = 0; i < numImages; ++i)
+    {
+        if (representatives[i] == i) continue;
+        osg::Image* rep = images[representatives[i]].get();
+        std::vector<osg::Texture2D*>& users = imageUsers[images[i].get()];
+        for (size_t j = 0; j < users.size(); ++j) users[j]->setImage(rep);
+    }
+
+    OSG_NOTICE << "[TextureOptimizer] Batch processed " << _batchTextures.size() << " textures, "
+               << numImages << " images, " << numUniques << " unique ones" << std::endl;
+    _batchTextures.clear();
+    return numUniques;
 }
 
 osg::Image* TextureOptimizer::compressImage(osg::Texture* tex, osg::Image* img, bool toLoad)
@@ -357,6 +448,7 @@ osg::Image* TextureOptimizer::compressImage(osg::Texture* tex, osg::Image* img,
 
     if (!toLoad)
     {
+        std::lock_guard<std::mutex> lock(_saveMutex);  // may be called by flush() in parallel
         std::string fileName = img->getFileName(), id = "__" + nanoid::generate(8);
         if (fileName.empty()) fileName = "temp" + id + ".ktx";
         else fileName = osgDB::getStrippedName(fileName) + id + ".ktx";
@@ -431,6 +523,36 @@ struct MipmapHelpers
         return sum * SAMPLE_COUNT_INV;
     }
 
+    /// 2x2 box filter for exact halving, averaging two contiguous float rows at a time.
+    /// With SSE, each RGBA pixel is one 4-float vector
+    static void halve(const std::vector<osg::Vec4>& source, int w0, int h0, std::vector<osg::Vec4>& target)
+    {
+        int w1 = w0 / 2, h1 = h0 / 2, rowSize0 = w0 * 4, rowSize1 = w1 * 4;
+        const float* src = source[0].ptr(); float* dst = target[0].ptr();
+#pragma omp parallel for schedule(dynamic, 1) if (w1 * h1 > 4096)
+        for (int y = 0; y < h1; ++y)
+        {
+            const float *row0 = src + (2 * y) * rowSize0, *row1 = row0 + rowSize0;
+            float* out = dst + y * rowSize1;
+#if defined(__SSE__)
+            const __m128 quarter = _mm_set1_ps(0.25f);
+            for (int x = 0; x < rowSize1; x += 4)
+            {
+                const float *p0 = row0 + x * 2, *p1 = row1 + x * 2;
+                __m128 sum = _mm_add_ps(_mm_loadu_ps(p0), _mm_loadu_ps(p0 + 4));
+                sum = _mm_add_ps(_mm_add_ps(sum, _mm_loadu_ps(p1)), _mm_loadu_ps(p1 + 4));
+                _mm_storeu_ps(out + x, _mm_mul_ps(sum, quarter));
+            }
+#else
+            for (int x = 0; x < rowSize1; ++x)
+            {
+                int c = (x >> 2) * 8 + (x & 3);
+                out[x] = (row0[c] + row0[c + 4] + row1[c] + row1[c + 4]) * 0.25f;
+            }
+#endif
+        }
+    }
+
     template<typename Filter>
     static void downsample(const std::vector<osg::Vec4>& source, int w0, int h0,
                            std::vector<osg::Vec4>& target, int w1, int h1, std::vector<osg::Vec4>& temp)
@@ -466,8 +588,16 @@ struct MipmapHelpers
                 float center = (float(x) + 0.5f) * inv_scale_x;
                 int ll = int(floorf(center - filter_width_x));
                 osg::Vec4 sum(0.0f, 0.0f, 0.0f, 0.0f);
-                for (int i = 0; i < window_size_x; i++)
-                    sum += source[osg::clampBetween(ll + i, 0, w0 - 1) + y * w0] * kernel_x[i];
+                if (ll >= 0 && ll + window_size_x <= w0)
+                {
+                    const osg::Vec4* row = &source[ll + y * w0];  // no clamping inside
+                    for (int i = 0; i < window_size_x; i++) sum += row[i] * kernel_x[i];
+                }
+                else
+                {
+                    for (int i = 0; i < window_size_x; i++)
+                        sum += source[osg::clampBetween(ll + i, 0, w0 - 1) + y * w0] * kernel_x[i];
+                }
                 temp[x * h0 + y] = sum;
             }
         }
@@ -480,8 +610,16 @@ struct MipmapHelpers
                 float center = (float(y) + 0.5f) * inv_scale_y;
                 int tt = int(floorf(center - filter_width_y));
                 osg::Vec4 sum(0.0f, 0.0f, 0.0f, 0.0f);
-                for (int i = 0; i < window_size_y; i++)
-                    sum += temp[x * h0 + osg::clampBetween(tt + i, 0, h0 - 1)] * kernel_y[i];
+                if (tt >= 0 && tt + window_size_y <= h0)
+                {
+                    const osg::Vec4* column = &temp[x * h0 + tt];
+                    for (int i = 0; i < window_size_y; i++) sum += column[i] * kernel_y[i];
+                }
+                else
+                {
+                    for (int i = 0; i < window_size_y; i++)
+                        sum += temp[x * h0 + osg::clampBetween(tt + i, 0, h0 - 1)] * kernel_y[i];
+                }
                 target[x + y * w1] = sum;
             }
         }
@@ -520,7 +658,6 @@ namespace osgVerse
         }
         else level0 = source;
 
-        std::vector<osg::Vec4>& data0 = level0;
         int numLevels = MipmapHelpers::log2Int(w > h ? w : h) + 1; mipmapDataList.resize(numLevels);
         mipmapDataList[0] = MipmapData(osg::Vec2(w, h), level0);
         for (int i = 1; i < numLevels; ++i)
@@ -531,12 +668,14 @@ namespace osgVerse
             int hh = (h >> i); hh = hh > 1 ? hh : 1;
             mipmapDataList[i] = MipmapData(osg::Vec2(ww, hh), std::vector<osg::Vec4>(ww * hh));
 
+            const std::vector<osg::Vec4>& data0 = mipmapDataList[i - 1].second;
             std::vector<osg::Vec4>& data = mipmapDataList[i].second;
             if (useKaiser)
                 MipmapHelpers::downsample<MipmapHelpers::Kaiser>(data0, prevW, prevH, data, ww, hh, temp);
+            else if (prevW == ww * 2 && prevH == hh * 2)
+                MipmapHelpers::halve(data0, prevW, prevH, data);
             else
                 MipmapHelpers::downsample<MipmapHelpers::Box>(data0, prevW, prevH, data, ww, hh, temp);
-            data0 = mipmapDataList[i].second;
         }
 
         std::vector<unsigned char> totalData;
@@ -590,4 +729,42 @@ namespace osgVerse
         std::vector<unsigned char> out(result.size()); if (result.empty()) return out;
         memcpy(&out[0], result.data(), result.size()); return out;
     }
+
+    float sampleBrickVolume(const osg::Image& atlas, const osg::Vec3& uvw)
+    {
+        const osg::UserDataContainer* udc = atlas.getUserDataContainer();
+        const osg::Image* indirection = udc ?
+            dynamic_cast<const osg::Image*>(udc->getUserObject("BrickIndirection")) : NULL;
+        int brickSize = 0; atlas.getUserValue("BrickSize", brickSize);
+        if (!indirection || brickSize < 1 || !atlas.valid()) return 0.0f;
+
+        // Find the brick containing the voxel-space position
+        int numBricks[3] = { indirection->s(), indirection->t(), indirection->r() }, brick[3];
+        float local[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            float q = osg::clampBetween(uvw[i], 0.0f, 1.0f) * numBricks[i] * brickSize;
+            brick[i] = osg::clampBetween((int)floor(q / brickSize), 0, numBricks[i] - 1);
+            local[i] = q - brick[i] * brickSize;
+        }
+
+        const unsigned char* entry = indirection->data(brick[0], brick[1], brick[2]);
+        if (entry[3] == 0) return 0.0f;
+
+        // Trilinear filtering between voxel centers; 1-voxel apron makes neighbors always valid
+        int padded = brickSize + 2, v0[3]; float f[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            float p = entry[i] * padded + 1.0f + local[i] - 0.5f;
+            v0[i] = (int)floor(p); f[i] = p - v0[i];
+        }
+
+        float result = 0.0f;
+        for (int k = 0; k < 2; ++k) for (int j = 0; j < 2; ++j) for (int i = 0; i < 2; ++i)
+        {
+            float w = (i ? f[0] : 1.0f - f[0]) * (j ? f[1] : 1.0f - f[1]) * (k ? f[2] : 1.0f - f[2]);
+            result += w * (*atlas.data(v0[0] + i, v0[1] + j, v0[2] + k)) / 255.0f;
+        }
+        return result;
+    }
 }
@@ -4,7 +4,9 @@
 #include <osg/Transform>
 #include <osg/Geometry>
 #include <osg/Camera>
+#include <osg/Texture2D>
 #include <osgDB/ReaderWriter>
+#include <mutex>
 #ifdef __EMSCRIPTEN__
 #   include <emscripten/fetch.h>
 #   include <emscripten.h>
@@ -54,6 +56,15 @@ namespace osgVerse
 
         void setGeneratingMipmaps(bool b) { _generateMipmaps = b; }
 
+        /** Only collect textures while traversing, and process them together in flush().
+            Byte-identical images are compressed once and shared by all their textures,
+            and different images are compressed in parallel */
+        void setBatchProcessing(bool b) { _batchProcessing = b; }
+        bool getBatchProcessing() const { return _batchProcessing; }
+
+        /// Process collected textures in batch mode, returning number of unique images
+        unsigned int flush();
+
         virtual void apply(osg::Drawable& drawable);
         virtual void apply(osg::Geode& geode);
         virtual void apply(osg::Node& node);
@@ -62,11 +73,14 @@ namespace osgVerse
     protected:
         virtual void applyTexture(osg::Texture* tex, unsigned int unit);
         osg::Image* compressImage(osg::Texture* tex, osg::Image* img, bool toLoad);
+        void applyCompressedImage(osg::Image* image0, osg::Image* image1);
 
         osg::ref_ptr<osgDB::Options> _ktxOptions;
+        std::vector<osg::ref_ptr<osg::Texture2D>> _batchTextures;
         std::vector<std::string> _savedTextures;
         std::string _textureFolder;
-        bool _saveAsInlineFile, _generateMipmaps;
+        std::mutex _saveMutex;
+        bool _saveAsInlineFile, _generateMipmaps, _batchProcessing;
     };
 
 #ifdef __EMSCRIPTEN__
@@ -147,6 +161,11 @@ namespace osgVerse
     /** Generate mipmaps of given image */
     OSGVERSE_RW_EXPORT bool generateMipmaps(osg::Image& image, bool useKaiser);
 
+    /** Sample a sparse brick volume (read by VDB plugin with BrickSize option) at normalized
+        coordinates. It works like the GPU: look up the indirection image for the brick, and then
+        apply trilinear filtering in the padded brick of the atlas. Empty bricks return 0 */
+    OSGVERSE_RW_EXPORT float sampleBrickVolume(const osg::Image& atlas, const osg::Vec3& uvw);
+
     /** Add necessary methods to OSG class wrappers */
     OSGVERSE_RW_EXPORT bool updateOsgBinaryWrappers(const std::string& libName = "osg");
 
@@ -14,8 +14,10 @@
 #include <pipeline/Global.h>
 #include <readerwriter/Utilities.h>
 #include <readerwriter/DracoProcessor.h>
+#include <readerwriter/MeshoptProcessor.h>
 #ifdef OSG_LIBRARY_STATIC
 USE_SERIALIZER_WRAPPER(DracoGeometry)
+USE_SERIALIZER_WRAPPER(MeshoptGeometry)
 #endif
 
 #include <backward.hpp>  // for better debug info
@@ -43,6 +45,23 @@ protected:
     }
 };
 
+class MeshoptGeometryVisitor : public osg::NodeVisitor
+{
+public:
+    MeshoptGeometryVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+    virtual void apply(osg::Geode& node)
+    {
+        for (unsigned int i = 0; i < node.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geom = node.getDrawable(i)->asGeometry();
+            if (geom && !dynamic_cast<osgVerse::MeshoptGeometry*>(geom))
+                node.setDrawable(i, new osgVerse::MeshoptGeometry(*geom));
+        }
+        traverse(node);
+    }
+};
+
 int main(int argc, char** argv)
 {
     osg::ArgumentParser arguments = osgVerse::globalInitialize(argc, argv);
@@ -52,11 +71,13 @@ int main(int argc, char** argv)
     osg::ref_ptr<osg::MatrixTransform> root = new osg::MatrixTransform;
     if (arguments.read("--out"))
     {
+        bool withMeshopt = arguments.read("--meshopt");
         osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles(arguments);
         if (node)
         {
             SceneDataOptimizer sdo; node->accept(sdo);
             sdo.deleteSavedTextures();
+            if (withMeshopt) { MeshoptGeometryVisitor mgv; node->accept(mgv); }
 
             osg::ref_ptr<osgDB::Options> options = new osgDB::Options("WriteImageHint=IncludeFile");
             options->setPluginStringData("UseBASISU", "1");
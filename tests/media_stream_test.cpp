@@ -12,6 +12,7 @@
 #include <pipeline/Pipeline.h>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 #include <libhv/all/server/WebSocketServer.h>
 #include <backward.hpp>  // for better debug info
@@ -98,12 +99,70 @@ protected:
     osg::ref_ptr<osgDB::Archive> _msServer;
 };
 
+static int runLoopbackBenchmark(int numFrames, int width, int height)
+{
+    // Start a local RTMP server, push synthetic frames to it and pull them back
+    osg::ref_ptr<osgDB::ReaderWriter> rw =
+        osgDB::Registry::instance()->getReaderWriterForExtension("verse_ms");
+    if (!rw) { OSG_WARN << "Invalid readerwriter verse_ms?\n"; return 1; }
+
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options;
+    options->setPluginStringData("rtmp", "19350");
+    osg::ref_ptr<osgDB::Archive> server = rw->openArchive(
+        "BenchmarkServer", osgDB::ReaderWriter::CREATE, 4096, options.get()).getArchive();
+
+    const std::string url = "rtmp://127.0.0.1:19350/live/bench";
+    osg::ref_ptr<osg::Image> image = new osg::Image;
+    image->allocateImage(width, height, 1, GL_RGB, GL_UNSIGNED_BYTE);
+
+    osg::ref_ptr<osg::ImageStream> is;
+    const unsigned char* lastFrame = NULL; int receivedFrames = 0;
+    double pushTime = 0.0; osg::Timer_t start = osg::Timer::instance()->tick();
+    for (int f = 0; f < numFrames; ++f)
+    {
+        unsigned char* ptr = image->data();
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x, ptr += 3)
+            { ptr[0] = (x + f) % 256; ptr[1] = (y + f) % 256; ptr[2] = (x + y) % 256; }
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        rw->writeImage(*image, url);
+        pushTime += osg::Timer::instance()->delta_m(t0, osg::Timer::instance()->tick());
+
+        if (!is && f == 25)
+        {
+            is = dynamic_cast<osg::ImageStream*>(rw->readImage(url).getImage());
+            if (is.valid()) is->play();
+        }
+        else if (is.valid() && is->data() != lastFrame)
+        { lastFrame = is->data(); receivedFrames++; }  // pooled frames rotate their buffers
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    }
+
+    double totalTime = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+    std::cout << "Pushed " << numFrames << " frames of " << width << "x" << height
+              << " in " << totalTime << "s, average conversion and pushing time = "
+              << (pushTime / numFrames) << "ms, pulled " << receivedFrames << " frames\n";
+    if (is.valid()) is->quit();
+    if (server.valid()) server->close();
+    return 0;
+}
+
 int main(int argc, char** argv)
 {
     osgDB::Registry::instance()->loadLibrary(
         osgDB::Registry::instance()->createLibraryNameForExtension("verse_ms"));
     osg::setNotifyLevel(osg::NOTICE);
 
+    osg::ArgumentParser arguments(&argc, argv);
+    if (arguments.read("--benchmark"))
+    {
+        int numFrames = 500, w = 1920, h = 1080;
+        arguments.read("--frames", numFrames);
+        arguments.read("--size", w, h);
+        return runLoopbackBenchmark(numFrames, w, h);
+    }
+
     osg::ref_ptr<osg::Node> scene =
         (argc < 2) ? osgDB::readNodeFile("cessna.osg") : osgDB::readNodeFile(argv[1]);
     if (!scene) { OSG_WARN << "Failed to load " << (argc < 2) ? "" : argv[1]; return 1; }
@@ -9,114 +9,53 @@
 #include <osgViewer/ViewerEventHandlers>
 #include <iostream>
 #include <sstream>
-#include <pipeline/Utilities.h>
-#include <pipeline/IntersectionManager.h>
 #include <modeling/Utilities.h>
-#include <modeling/Math.h>
+#include <modeling/MeshBoolean.h>
 
 #include <backward.hpp>  // for better debug info
 namespace backward { backward::SignalHandling sh; }
 
-int main(int argc, char** argv)
+static osg::Geometry* createBox(const osg::BoundingBox& bb)
 {
-    osg::ref_ptr<osg::Node> nodeA = (argc < 2)
-                                  ? osgDB::readNodeFile("cow.osg") : osgDB::readNodeFile(argv[1]);
-    osg::Polytope polytope;
-    {
-        osg::ComputeBoundsVisitor cbv;
-        nodeA->accept(cbv);
-
-        osg::BoundingBox bb = cbv.getBoundingBox();
-        osg::Vec3 minPt(bb._min.x() * 0.8f + bb._max.x() * 0.2f, bb._min.y(), bb._min.z());
-        osg::Vec3 maxPt(bb._min.x() * 0.5f + bb._max.x() * 0.5f, bb._max.y(), bb._max.z());
-        polytope.setToBoundingBox(osg::BoundingBox(minPt, maxPt));
-    }
-
-    std::vector<osgVerse::IntersectionResult> results =
-        osgVerse::findAllIntersections(nodeA.get(), polytope);
     osg::Vec3Array* va = new osg::Vec3Array;
-    osg::DrawElementsUInt* de = new osg::DrawElementsUInt(GL_TRIANGLES);
-
-    std::map<int, std::vector<std::pair<osg::Vec3, osg::Vec3>>> edgeOnPlaneMap;
-    const osg::Polytope::PlaneList& planes = polytope.getPlaneList();
-    for (size_t k = 0; k < results.size(); ++k)
-    {
-        osgVerse::IntersectionResult& ir = results[k];
-        std::vector<osg::Vec3d> origPt = ir.intersectPoints;
-        if (origPt.size() < 3) continue;
-
-        // Find and reorder vertices on a intersected face (with 3-5 points)
-        std::vector<osg::Vec3d> ptIn, ptOut, edge;
-        for (size_t i = 0; i < origPt.size(); ++i) ptIn.push_back(origPt[i] * ir.matrix);
-
-        osgVerse::PointList2D projected; ptOut.resize(ptIn.size());
-        osgVerse::GeometryAlgorithm::project(ptIn, osg::Vec3d(), osg::Vec3d(), projected);
-        osgVerse::GeometryAlgorithm::reorderPointsInPlane(projected);
-        for (size_t i = 0; i < ptIn.size(); ++i) ptOut[i] = ptIn[projected[i].second];
+    for (int i = 0; i < 8; ++i) va->push_back(bb.corner(i));
 
-        // Find which plane this face is intersected and record a co-plane edge if exists
-        for (size_t j = 0; j < planes.size(); ++j)
-        {
-            const osg::Plane& plane = planes[j]; edge.clear();
-            for (size_t i = 0; i < ptOut.size(); ++i)
-            { if (osg::equivalent(plane.distance(ptOut[i]), 0.0)) edge.push_back(ptOut[i]); }
-            if (edge.size() > 1)
-                edgeOnPlaneMap[j].push_back(std::pair<osg::Vec3, osg::Vec3>(edge[0], edge[1]));
-        }
+    const unsigned int faces[36] = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                     2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+    osg::DrawElementsUInt* de = new osg::DrawElementsUInt(GL_TRIANGLES, 36, faces);
+    return osgVerse::createGeometry(va, NULL, osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f), de);
+}
 
-        // Triangulate the face in a simple way
-        size_t numPt = ptOut.size(), i0 = va->size();
-        for (size_t p = 0; p < numPt; ++p) va->push_back(ptOut[p]);
-        switch (numPt)
-        {
-        case 3: de->push_back(i0); de->push_back(i0 + 1); de->push_back(i0 + 2); break;
-        case 4: de->push_back(i0); de->push_back(i0 + 1); de->push_back(i0 + 2);
-                de->push_back(i0); de->push_back(i0 + 2); de->push_back(i0 + 3); break;
-        case 5: de->push_back(i0); de->push_back(i0 + 1); de->push_back(i0 + 2);
-                de->push_back(i0); de->push_back(i0 + 2); de->push_back(i0 + 3);
-                de->push_back(i0); de->push_back(i0 + 3); de->push_back(i0 + 4); break;
-        }
-    }
+int main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc, argv);
+    osgVerse::MeshBoolean::Operation op = osgVerse::MeshBoolean::DIFFERENCE;
+    if (arguments.read("--union")) op = osgVerse::MeshBoolean::UNION;
+    if (arguments.read("--intersection")) op = osgVerse::MeshBoolean::INTERSECTION;
 
-    // Find each cap and do Delaunay
-    osg::ref_ptr<osg::Geode> root = new osg::Geode;
-    for (std::map<int, std::vector<std::pair<osg::Vec3, osg::Vec3>>>::iterator
-         itr = edgeOnPlaneMap.begin(); itr != edgeOnPlaneMap.end(); ++itr)
-    {
-        std::vector<osgVerse::LineType3D> edges(itr->second.size());
-        for (size_t k = 0; k < edges.size(); ++k) edges[k] = itr->second[k];
-        if (edges.size() < 3) continue;
+    osg::ref_ptr<osg::Node> nodeA = (argc < 2)
+                                  ? osgDB::readNodeFile("cow.osg") : osgDB::readNodeFile(argv[1]);
+    if (!nodeA) { OSG_WARN << "Failed to load model" << std::endl; return 1; }
 
-        osg::Vec3Array* va2 = new osg::Vec3Array;
-#if 0
-        osg::DrawElementsUInt* de2 = new osg::DrawElementsUInt(GL_LINES);
-#else
-        osg::DrawElementsUInt* de2 = new osg::DrawElementsUInt(GL_TRIANGLES);
-#endif
-        osgVerse::PointList3D points; osgVerse::PointList2D points2D;
-        osgVerse::EdgeList edgeIndices = osgVerse::GeometryAlgorithm::project(
-            edges, -planes[itr->first].getNormal(), points, points2D);
-        va2->assign(points.begin(), points.end());
+    osg::ComputeBoundsVisitor cbv; nodeA->accept(cbv);
+    osg::BoundingBox bb = cbv.getBoundingBox();
+    osg::Vec3 minPt(bb._min.x() * 0.8f + bb._max.x() * 0.2f, bb._min.y() - 1.0f, bb._min.z() - 1.0f);
+    osg::Vec3 maxPt(bb._min.x() * 0.5f + bb._max.x() * 0.5f, bb._max.y() + 1.0f, bb._max.z() + 1.0f);
+    osg::ref_ptr<osg::Geode> nodeB = new osg::Geode;
+    nodeB->addDrawable(createBox(osg::BoundingBox(minPt, maxPt)));
 
-#if 0
-        for (size_t i = 0; i < edgeIndices.size(); ++i)
-        {
-            de2->push_back(edgeIndices[i].first);
-            de2->push_back(edgeIndices[i].second);
-        }
-#else
-        std::vector<size_t> indices =
-            osgVerse::GeometryAlgorithm::delaunayTriangulation(points2D, edgeIndices);
-        de2->assign(indices.begin(), indices.end());
-#endif
+    osg::ref_ptr<osgVerse::MeshBoolean> meshBoolean = new osgVerse::MeshBoolean;
+    meshBoolean->setMesh(osgVerse::MeshBoolean::MESH_A, nodeA.get());
+    meshBoolean->setMesh(osgVerse::MeshBoolean::MESH_B, nodeB.get());
 
-        osg::Geometry* geom2 = osgVerse::createGeometry(
-            va2, NULL, osg::Vec4(1.0f, 1.0f, 0.0f, 1.0f), de2);
-        root->addDrawable(geom2);
-    }
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    osg::ref_ptr<osg::Geometry> result = meshBoolean->process(op);
+    std::cout << "Boolean operation finished in " << osg::Timer::instance()->delta_m(
+              t0, osg::Timer::instance()->tick()) << "ms, with "
+              << meshBoolean->getNumIntersectedPairs() << " intersecting pairs" << std::endl;
 
-    osg::Geometry* geom = osgVerse::createGeometry(va, NULL, NULL, de);
-    root->addDrawable(geom); //osgDB::writeNodeFile(*root, "test.osg");
+    osg::ref_ptr<osg::Geode> root = new osg::Geode;
+    if (result.valid()) root->addDrawable(result.get()); //osgDB::writeNodeFile(*root, "test.osg");
 
     osgViewer::Viewer viewer;
     viewer.addEventHandler(new osgViewer::StatsHandler);
@@ -12,17 +12,67 @@
 #include <modeling/DynamicGeometry.h>
 #include <modeling/MeshTopology.h>
 #include <modeling/GeometryMapper.h>
+#include <modeling/FFDModeler.h>
 #include <modeling/Utilities.h>
 #include <pipeline/Utilities.h>
 #include <iostream>
 #include <sstream>
+#include "self_check.h"
 
 #define TEST_MAPPING_TO_VHACD 1
 #include <backward.hpp>  // for better debug info
 namespace backward { backward::SignalHandling sh; }
 
+static void checkFFDWeights(SelfCheck& checker)
+{
+    // Deform the same random points with and without cached weights, which must agree with
+    // BSplineVolume::getPosition() after every edit of control points
+    osg::ref_ptr<osg::Vec3Array> va = new osg::Vec3Array(10000);
+    for (size_t i = 0; i < va->size(); ++i)
+        (*va)[i].set(rand() * 10.0f / RAND_MAX, rand() * 5.0f / RAND_MAX, rand() * 2.0f / RAND_MAX);
+
+    osg::ref_ptr<osgVerse::FFDModeler> modelers[2];
+    osg::ref_ptr<osg::MatrixTransform> parents[2];
+    osg::ref_ptr<osg::Geometry> geometries[2];
+    for (int m = 0; m < 2; ++m)
+    {
+        geometries[m] = new osg::Geometry;
+        geometries[m]->setVertexArray(new osg::Vec3Array(va->begin(), va->end()));
+        osg::Geode* geode = new osg::Geode; geode->addDrawable(geometries[m].get());
+        parents[m] = new osg::MatrixTransform; parents[m]->addChild(geode);
+        parents[m]->setMatrix(osg::Matrix::translate(1.0f, 2.0f, 3.0f));
+
+        modelers[m] = new osgVerse::FFDModeler;
+        modelers[m]->setUseCachedWeights(m == 1);
+        modelers[m]->setQuantity(5, 4, 3); modelers[m]->setNode(geode);
+    }
+
+    float maxError = 0.0f, maxMoved = 0.0f;
+    for (int n = 0; n < 20; ++n)
+    {
+        int u = rand() % 5, v = rand() % 4, w = rand() % 3;
+        osg::Vec3 offset(rand() * 1.0f / RAND_MAX, rand() * 1.0f / RAND_MAX, rand() * 1.0f / RAND_MAX);
+        osg::Vec3 pt = modelers[0]->getCtrlPoint(u, v, w) + offset;
+        for (int m = 0; m < 2; ++m) modelers[m]->setCtrlPoint(u, v, w, pt);
+
+        const osg::Vec3Array* va0 = static_cast<osg::Vec3Array*>(geometries[0]->getVertexArray());
+        const osg::Vec3Array* va1 = static_cast<osg::Vec3Array*>(geometries[1]->getVertexArray());
+        for (size_t i = 0; i < va0->size(); ++i)
+        {
+            maxError = osg::maximum(maxError, ((*va0)[i] - (*va1)[i]).length());
+            maxMoved = osg::maximum(maxMoved, ((*va0)[i] - (*va)[i]).length());
+        }
+    }
+    checker.check("Vertices are deformed", maxMoved > 0.01f);
+    checker.checkError("Cached weights against BSplineVolume::getPosition()", maxError, 1e-4);
+}
+
 int main(int argc, char** argv)
 {
+    osg::ArgumentParser arguments(&argc, argv);
+    int checked = SelfCheck::run(arguments, "--check-ffd", checkFFDWeights);
+    if (checked >= 0) return checked;
+
     osg::ref_ptr<osg::Node> scene =
         (argc < 2) ? osgDB::readNodeFile("cessna.osg") : osgDB::readNodeFile(argv[1]);
     if (!scene) { OSG_WARN << "Failed to load " << (argc < 2) ? "" : argv[1]; return 1; }
@@ -25,6 +25,7 @@
 #include <readerwriter/Utilities.h>
 #include <readerwriter/OsgbTileOptimizer.h>
 #include <readerwriter/DracoProcessor.h>
+#include "self_check.h"
 
 #ifdef OSG_LIBRARY_STATIC
 USE_OSG_PLUGINS()
@@ -145,23 +146,75 @@ void processFile(const std::string& prefix, const std::string& dirName,
 
         osgVerse::TextureOptimizer opt(true, "optimize_tex_" + nanoid::generate(8));
         opt.setGeneratingMipmaps(true);
-        node->accept(opt);
+        opt.setBatchProcessing(true);
+        node->accept(opt); opt.flush();
 
         std::string dbFileName = dbBase + dirName + "/" + fileName;
         if (!savingToDB) osgDB::makeDirectoryForFile(dbFileName);
 
         osg::ref_ptr<osgDB::Options> options = new osgDB::Options("WriteImageHint=IncludeFile");
         options->setPluginStringData("UseBASISU", "1");
+        if (savingToDB) options->setPluginStringData("WriteBatchSize", "64");
         osgDB::writeNodeFile(*node, dbFileName, options.get());
         opt.deleteSavedTextures();
         std::cout << "Re-saving " << fileName << "\n";
     }
 }
 
+static void checkLevelDB(SelfCheck& checker)
+{
+    // Write tiles in batches to a new database, then read them back with read-ahead,
+    // after overwriting a prefetched one, and all at once with multi-get
+    std::string dbUrl = "leveldb://leveldb_check_" + nanoid::generate(8) + ".db/";
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options;
+    options->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+    options->setPluginStringData("WriteBatchSize", "8");
+
+    const int numTiles = 20; bool written = true;
+    for (int i = 0; i < numTiles; ++i)
+    {
+        osg::ref_ptr<osg::Group> tile = new osg::Group; tile->setName("tile" + std::to_string(i));
+        written &= osgDB::writeNodeFile(
+            *tile, dbUrl + "tiles/" + std::to_string(100 + i) + ".osgt.verse_leveldb", options.get());
+    }
+    checker.check("Write " + std::to_string(numTiles) + " tiles in batches of 8", written);
+
+    options->setPluginStringData("WriteBatchSize", "1");
+    options->setPluginStringData("ReadAhead", "4");
+    int numMatched = 0;
+    for (int i = 0; i < numTiles; ++i)
+    {
+        osg::ref_ptr<osg::Node> tile = osgDB::readNodeFile(
+            dbUrl + "tiles/" + std::to_string(100 + i) + ".osgt.verse_leveldb", options.get());
+        if (tile.valid() && tile->getName() == "tile" + std::to_string(i)) numMatched++;
+    }
+    checker.check("Read tiles with read-ahead of 4", numMatched == numTiles,
+                  std::to_string(numMatched) + " matched");
+
+    std::string key0 = dbUrl + "tiles/100.osgt.verse_leveldb", key1 = dbUrl + "tiles/101.osgt.verse_leveldb";
+    osg::ref_ptr<osg::Group> changed = new osg::Group; changed->setName("tile1_changed");
+    osg::ref_ptr<osg::Node> tile0 = osgDB::readNodeFile(key0, options.get());  // prefetch 101-104
+    osgDB::writeNodeFile(*changed, key1, options.get());
+    osg::ref_ptr<osg::Node> tile1 = osgDB::readNodeFile(key1, options.get());
+    checker.check("Overwritten tile is not read from prefetched values",
+                  tile0.valid() && tile1.valid() && tile1->getName() == "tile1_changed");
+
+    osg::ref_ptr<osgDB::Options> multiOptions = new osgDB::Options;
+    multiOptions->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+    multiOptions->setPluginStringData("MultiGet", "tiles/103.osgt;tiles/missing.osgt;tiles/101.osgt");
+    osg::ref_ptr<osg::Node> multi = osgDB::readNodeFile(dbUrl + "multi.verse_leveldb", multiOptions.get());
+    osg::Group* group = multi.valid() ? multi->asGroup() : NULL;
+    checker.check("Multi-get keeps order of keys and leaves missing ones empty",
+                  group && group->getNumChildren() == 3 && group->getChild(0)->getName() == "tile3" &&
+                  group->getChild(1)->getName().empty() && group->getChild(2)->getName() == "tile1_changed");
+}
+
 int main(int argc, char** argv)
 {
     osg::ArgumentParser arguments(&argc, argv);
     std::string output; arguments.read("--output", output);
+    std::string journal; arguments.read("--journal", journal);
+    int atlasPageSize = 0; arguments.read("--atlas-page-size", atlasPageSize);
 
     osgVerse::fixOsgBinaryWrappers();
     if (argc > 3 && std::string(argv[1]) == "adj")
@@ -169,14 +222,15 @@ int main(int argc, char** argv)
         std::string srcDir = std::string(argv[2]), dstDir = std::string(argv[3]);
         osg::ref_ptr<osgVerse::TileOptimizer> opt = new osgVerse::TileOptimizer(dstDir);
         if (!opt->prepare(srcDir)) { printf("Can't prepare for tiles\n"); return 1; }
-        opt->setUseThreads(10); opt->processAdjacency(2, 2); return 0;
+        opt->setMergingAtlasPageSize(atlasPageSize);
+        opt->setJournalFile(journal); opt->setUseThreads(10); opt->processAdjacency(2, 2); return 0;
     }
     else if (argc > 3 && std::string(argv[1]) == "top")
     {
         std::string srcDir = std::string(argv[2]), dstDir = std::string(argv[3]);
         osg::ref_ptr<osgVerse::TileOptimizer> opt = new osgVerse::TileOptimizer(dstDir);
         if (!opt->prepare(srcDir)) { printf("Can't prepare for tiles\n"); return 1; }
-        opt->setUseThreads(10); opt->processGroundLevel(2, 2); return 0;
+        opt->setJournalFile(journal); opt->setUseThreads(10); opt->processGroundLevel(2, 2); return 0;
     }
 
 #ifndef OSG_LIBRARY_STATIC
@@ -185,6 +239,9 @@ int main(int argc, char** argv)
     osgDB::Registry::instance()->loadLibrary(
         osgDB::Registry::instance()->createLibraryNameForExtension("verse_leveldb"));
 #endif
+    int checked = SelfCheck::run(arguments, "--check-leveldb", checkLevelDB);
+    if (checked >= 0) return checked;
+
     osg::ref_ptr<osg::MatrixTransform> root = new osg::MatrixTransform;
     root->setName("PlodGridRoot");
 
@@ -250,7 +307,8 @@ int main(int argc, char** argv)
             node->accept(rdp);
 
             osgVerse::TextureOptimizer opt(true, "optimize_tex_" + nanoid::generate(8));
-            node->accept(opt);
+            opt.setBatchProcessing(true);
+            node->accept(opt); opt.flush();
 
             osg::ref_ptr<osgDB::Options> options = new osgDB::Options("WriteImageHint=IncludeFile");
             options->setPluginStringData("UseBASISU", "1");
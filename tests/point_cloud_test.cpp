@@ -9,8 +9,10 @@
 #include <osgText/Text>
 #include <osgViewer/Viewer>
 #include <osgViewer/ViewerEventHandlers>
+#include <modeling/Math.h>
 #include <iostream>
 #include <sstream>
+#include "self_check.h"
 
 #include <backward.hpp>  // for better debug info
 namespace backward { backward::SignalHandling sh; }
@@ -102,8 +104,82 @@ osg::Camera* createHUD(osgText::Text* text, unsigned int w, unsigned int h)
     return camera;
 }
 
+static void checkCoordinateConversions(SelfCheck& checker, size_t numPoints)
+{
+    // Compare batch conversions with scalar ones on random points around the world
+    osgVerse::Coordinate::UTM utm(32650);
+    std::vector<osg::Vec3d> lla(numPoints), utmCoords(numPoints);
+    std::vector<double> x(numPoints), y(numPoints), z(numPoints);
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        lla[i] = osg::Vec3d(((double)rand() / RAND_MAX - 0.5) * osg::PI * 0.999,
+                            ((double)rand() / RAND_MAX - 0.5) * osg::PI * 2.0,
+                            (double)(rand() % 10000) - 500.0);
+        utmCoords[i] = osg::Vec3d(osg::DegreesToRadians(117.0) + ((double)rand() / RAND_MAX - 0.5) * 0.1,
+                                  osg::DegreesToRadians(40.0) + ((double)rand() / RAND_MAX - 0.5) * 0.1,
+                                  lla[i][2]);
+        x[i] = lla[i][0]; y[i] = lla[i][1]; z[i] = lla[i][2];
+    }
+
+    // AoS and SoA round trips of LLA -> ECEF -> LLA
+    std::vector<osg::Vec3d> ecef = lla, lla2;
+    osg::Timer_t t0 = osg::Timer::instance()->tick();
+    osgVerse::Coordinate::convertLLAtoECEF(&ecef[0], numPoints); lla2 = ecef;
+    osgVerse::Coordinate::convertECEFtoLLA(&lla2[0], numPoints);
+
+    osg::Timer_t t1 = osg::Timer::instance()->tick();
+    osgVerse::Coordinate::convertLLAtoECEF(&x[0], &y[0], &z[0], numPoints);
+    std::vector<double> x2 = x, y2 = y, z2 = z;
+    osgVerse::Coordinate::convertECEFtoLLA(&x2[0], &y2[0], &z2[0], numPoints);
+
+    // LLA -> UTM -> LLA in one zone
+    osg::Timer_t t2 = osg::Timer::instance()->tick();
+    std::vector<osg::Vec3d> utm2 = utmCoords, utmLLA;
+    osgVerse::Coordinate::convertLLAtoUTM(&utm2[0], numPoints, utm); utmLLA = utm2;
+    osgVerse::Coordinate::convertUTMtoLLA(&utmLLA[0], numPoints, utm);
+    osg::Timer_t t3 = osg::Timer::instance()->tick();
+
+    double errECEF = 0.0, errLLA = 0.0, errHeight = 0.0, errSoA = 0.0, errLLASoA = 0.0,
+           errHeightSoA = 0.0, errUTM = 0.0, errUTMLLA = 0.0, errUTMHeight = 0.0;
+    for (size_t i = 0; i < numPoints; ++i)
+    {
+        osg::Vec3d e = osgVerse::Coordinate::convertLLAtoECEF(lla[i]);
+        osg::Vec3d l = osgVerse::Coordinate::convertECEFtoLLA(e);
+        osg::Vec3d u = osgVerse::Coordinate::convertLLAtoUTM(utmCoords[i], utm);
+        osg::Vec3d ul = osgVerse::Coordinate::convertUTMtoLLA(utm2[i], utm);
+        errECEF = osg::maximum(errECEF, (e - ecef[i]).length());
+        errLLA = osg::maximum(errLLA, osg::Vec2d(l[0] - lla2[i][0], l[1] - lla2[i][1]).length());
+        errHeight = osg::maximum(errHeight, fabs(l[2] - lla2[i][2]));
+        errSoA = osg::maximum(errSoA, (e - osg::Vec3d(x[i], y[i], z[i])).length());
+        errLLASoA = osg::maximum(errLLASoA, osg::Vec2d(l[0] - x2[i], l[1] - y2[i]).length());
+        errHeightSoA = osg::maximum(errHeightSoA, fabs(l[2] - z2[i]));
+        errUTM = osg::maximum(errUTM, (u - utm2[i]).length());
+        errUTMLLA = osg::maximum(errUTMLLA, osg::Vec2d(ul[0] - utmLLA[i][0], ul[1] - utmLLA[i][1]).length());
+        errUTMHeight = osg::maximum(errUTMHeight, fabs(ul[2] - utmLLA[i][2]));
+    }
+
+    std::cout << "Converted " << numPoints << " points: ECEF/LLA round trip "
+              << osg::Timer::instance()->delta_m(t0, t1) << "ms, SoA "
+              << osg::Timer::instance()->delta_m(t1, t2) << "ms, UTM/LLA round trip "
+              << osg::Timer::instance()->delta_m(t2, t3) << "ms\n";
+    checker.checkError("LLA to ECEF (m)", errECEF, 1e-6);
+    checker.checkError("LLA to ECEF, SoA (m)", errSoA, 1e-6);
+    checker.checkError("ECEF to LLA (rad)", errLLA, 1e-12);
+    checker.checkError("ECEF to LLA height (m)", errHeight, 1e-6);
+    checker.checkError("ECEF to LLA, SoA (rad)", errLLASoA, 1e-12);
+    checker.checkError("ECEF to LLA height, SoA (m)", errHeightSoA, 1e-6);
+    checker.checkError("LLA to UTM (m)", errUTM, 1e-6);
+    checker.checkError("UTM to LLA (rad)", errUTMLLA, 1e-12);
+    checker.checkError("UTM to LLA height (m)", errUTMHeight, 1e-6);
+}
+
 int main(int argc, char** argv)
 {
+    osg::ArgumentParser arguments(&argc, argv);
+    int checked = SelfCheck::run(arguments, "--check-coordinates", [](SelfCheck& checker)
+        { checkCoordinateConversions(checker, 1000000); });
+    if (checked >= 0) return checked;
+
     std::string filename = argc > 1 ? argv[1] : "";
     std::string ext = osgDB::getFileExtension(filename);
     if (ext != "verse_ept") filename += ".verse_ept";
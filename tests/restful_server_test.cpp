@@ -18,9 +18,12 @@
 #include <pipeline/Utilities.h>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <ctime>
 
 #include <libhv/all/server/HttpService.h>
 #include <libhv/all/server/HttpServer.h>
+#include "self_check.h"
 #include <backward.hpp>  // for better debug info
 namespace backward { backward::SignalHandling sh; }
 
@@ -36,7 +39,9 @@ public:
 
     static int postprocessor(HttpRequest* req, HttpResponse* resp)
     {
-        OSG_NOTICE << resp->Dump(true, true) << std::endl;
+        bool staticFile = (req->Path().find("/data/") == 0);  // don't dump file contents
+        if (staticFile && resp->status_code == HTTP_STATUS_OK) numDownloads++;
+        OSG_NOTICE << resp->Dump(true, !staticFile) << std::endl;
         return resp->status_code;
     }
 
@@ -123,6 +128,7 @@ public:
 
     static osg::ref_ptr<osg::Group> root;
     static osgViewer::Viewer viewer;
+    static std::atomic<int> numDownloads;  // static files sent with status 200
 
 protected:
     static int response_status(const HttpContextPtr& ctx, int code = 200, const char* message = NULL)
@@ -156,9 +162,38 @@ protected:
 
 osg::ref_ptr<osg::Group> Handler::root;
 osgViewer::Viewer Handler::viewer;
+std::atomic<int> Handler::numDownloads(0);
+
+static void checkWebCache(SelfCheck& checker, const std::string& dataDir)
+{
+    // Read a served file twice through the web plugin with disk cache. The first read must
+    // download it, and the second one must be a fresh hit or a 304 revalidation
+    std::string fileName = "web_cache_check.osgt";
+    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+    geode->addDrawable(new osg::ShapeDrawable(new osg::Box));
+    if (!checker.check("Write " + dataDir + "/" + fileName,
+                       osgDB::writeNodeFile(*geode, dataDir + "/" + fileName))) return;
+
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options;
+    options->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+    options->setPluginStringData("CacheDirectory", "web_cache_check_" + std::to_string(time(NULL)));
+
+    std::string url = "http://127.0.0.1:2520/data/" + fileName + ".verse_web";
+    osg::ref_ptr<osg::Node> first = osgDB::readNodeFile(url, options.get());
+    int downloads = Handler::numDownloads;
+    osg::ref_ptr<osg::Node> second = osgDB::readNodeFile(url, options.get());
+
+    checker.check("First read downloads the file", first.valid() && downloads == 1);
+    checker.check("Second read uses the cache", second.valid() && Handler::numDownloads == 1,
+                  "downloads = " + std::to_string(Handler::numDownloads));
+}
 
 int main(int argc, char** argv)
 {
+    osg::ArgumentParser arguments(&argc, argv);
+    bool checkCache = arguments.read("--check-cache");
+    std::string dataDir = (argc > 1) ? argv[1] : ".";
+
     hv::HttpServer server;
     server.worker_processes = 0;
     server.worker_threads = 0;
@@ -170,8 +205,18 @@ int main(int argc, char** argv)
     service.GET("/camera/matrix", Handler::get_matrix);
     service.POST("/scene/:npath", Handler::add_child);
     service.Delete("/scene/:npath", Handler::remove_child);
+
+    // Static files with ETag / Last-Modified, for testing web plugin and its disk cache
+    // osgviewer http://127.0.0.1:2520/data/cessna.osg.verse_web -O "CacheDirectory=web_cache"
+    // Or run with --check-cache to check downloading and revalidation automatically
+    service.Static("/data", dataDir.c_str());
     server.registerHttpService(&service);
     server.start();
+    if (checkCache)
+    {
+        SelfCheck checker("check-cache"); checkWebCache(checker, dataDir);
+        server.stop(); return checker.result();
+    }
 
     // Scene root
     osg::Node* node = osgDB::readNodeFile("cessna.osg");
@@ -0,0 +1,56 @@
+#ifndef MANA_TESTS_SELF_CHECK_HPP
+#define MANA_TESTS_SELF_CHECK_HPP
+
+#include <osg/ArgumentParser>
+#include <iostream>
+#include <string>
+
+/** Non-interactive checks of test programs. A program runs its check instead of the viewer demo
+    when started with the related "--check-*" argument, prints every result and exits with 0 only
+    if all of them passed */
+class SelfCheck
+{
+public:
+    SelfCheck(const std::string& name) : _name(name), _numChecked(0), _numFailed(0) {}
+
+    /// Record a result, with optional details (e.g. measured values) to print after it
+    bool check(const std::string& item, bool passed, const std::string& details = "")
+    {
+        std::cout << "[" << _name << "] " << item << (details.empty() ? "" : " (" + details + ")")
+                  << ": " << (passed ? "OK" : "FAILED") << std::endl;
+        _numChecked++; if (!passed) _numFailed++; return passed;
+    }
+
+    /// Record a measured error, which must be less than the tolerance
+    bool checkError(const std::string& item, double error, double tolerance)
+    {
+        std::cout << "[" << _name << "] " << item << ": error = " << error << " (tolerance "
+                  << tolerance << "): " << (error < tolerance ? "OK" : "FAILED") << std::endl;
+        _numChecked++; if (!(error < tolerance)) _numFailed++; return error < tolerance;
+    }
+
+    /// Print the summary and return the exit code of the program
+    int result() const
+    {
+        bool passed = (_numChecked > 0 && _numFailed == 0);
+        std::cout << "[" << _name << "] " << (_numChecked - _numFailed) << "/" << _numChecked
+                  << " checks passed: " << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    /** Run func(SelfCheck&) if the argument is given. Returns the exit code of the check, or -1
+        if it was not requested and the program should continue as usual */
+    template<typename Func>
+    static int run(osg::ArgumentParser& arguments, const std::string& option, Func func)
+    {
+        if (!arguments.read(option)) return -1;
+        SelfCheck checker(option.substr(option.find_first_not_of('-')));
+        func(checker); return checker.result();
+    }
+
+protected:
+    std::string _name;
+    int _numChecked, _numFailed;
+};
+
+#endif
@@ -5,14 +5,19 @@
 #include <osg/ImageSequence>
 #include <osg/ImageUtils>
 #include <osg/MatrixTransform>
+#include <osg/ValueObject>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
+#include <osgDB/Registry>
 #include <osgGA/TrackballManipulator>
 #include <osgViewer/Viewer>
 #include <osgViewer/ViewerEventHandlers>
 #include <iostream>
 #include <sstream>
+#include <functional>
 #include <pipeline/Utilities.h>
+#include <readerwriter/Utilities.h>
+#include "self_check.h"
 
 #include <backward.hpp>  // for better debug info
 namespace backward { backward::SignalHandling sh; }
@@ -322,8 +327,136 @@ osg::Image* createTransferFunction(const std::vector<std::pair<float, osg::Vec4u
     return image1D.release();
 }
 
+static void checkBrickSampling(SelfCheck& checker)
+{
+    // Two 8^3 bricks along X: brick 0 is stored in the atlas, brick 1 is empty. Voxels hold a
+    // linear function of global voxel coordinates (apron included), which trilinear filtering
+    // must reproduce exactly at any position of brick 0
+    const int brickSize = 8, padded = brickSize + 2;
+    osg::ref_ptr<osg::Image> atlas = new osg::Image;
+    atlas->allocateImage(padded, padded, padded, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+    for (int k = 0; k < padded; ++k) for (int j = 0; j < padded; ++j) for (int i = 0; i < padded; ++i)
+        *atlas->data(i, j, k) = (unsigned char)(20 + 10 * (i - 1) + 3 * (j - 1) + (k - 1));
+
+    osg::ref_ptr<osg::Image> indirection = new osg::Image;
+    indirection->allocateImage(2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    memset(indirection->data(), 0, indirection->getTotalSizeInBytes());
+    indirection->data(0, 0, 0)[3] = 255; indirection->setName("BrickIndirection");
+    atlas->setUserValue("BrickSize", brickSize);
+    atlas->getOrCreateUserDataContainer()->addUserObject(indirection.get());
+
+    float maxError = 0.0f; bool emptyOk = true;
+    for (int n = 0; n < 1000; ++n)
+    {
+        osg::Vec3 uvw(0.5f * rand() / (float)RAND_MAX * 0.999f,
+                      rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+        osg::Vec3 q(uvw[0] * 2.0f * brickSize, uvw[1] * brickSize, uvw[2] * brickSize);
+        float expected = (20.0f + 10.0f * (q[0] - 0.5f) + 3.0f * (q[1] - 0.5f) + (q[2] - 0.5f)) / 255.0f;
+        maxError = osg::maximum(maxError, std::abs(osgVerse::sampleBrickVolume(*atlas, uvw) - expected));
+
+        osg::Vec3 uvwEmpty(0.5f + uvw[0], uvw[1], uvw[2]);
+        if (osgVerse::sampleBrickVolume(*atlas, uvwEmpty) != 0.0f) emptyOk = false;
+    }
+
+    checker.checkError("Trilinear sampling of a linear brick", maxError, 1e-4);
+    checker.check("Empty brick samples to zero", emptyOk);
+}
+
+static void checkVdbBricks(SelfCheck& checker)
+{
+    // Write a sparse grid with two boxes of values through the VDB plugin, read it back as a
+    // brick atlas, and compare it with the dense volume normalized the same way
+    const int w = 32, h = 24, d = 16;
+    osg::ref_ptr<osg::Image> dense = new osg::Image;
+    dense->allocateImage(w, h, d, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+    memset(dense->data(), 0, dense->getTotalSizeInBytes());
+    for (int z = 0; z < d; ++z) for (int y = 0; y < h; ++y) for (int x = 0; x < w; ++x)
+    {
+        bool inBoxA = (x >= 1 && x <= 10 && y >= 2 && y <= 9 && z >= 1 && z <= 6);
+        bool inBoxB = (x >= 20 && x <= 29 && y >= 14 && y <= 21 && z >= 9 && z <= 14);
+        if (inBoxA || inBoxB) *dense->data(x, y, z) = (unsigned char)(10 + x + 2 * y + 3 * z);
+    }
+
+    std::string fileName = "brick_check.vdb.verse_vdb";
+    if (!checker.check("Write " + fileName, osgDB::writeImageFile(*dense, fileName))) return;
+
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options;
+    options->setObjectCacheHint(osgDB::Options::CACHE_NONE);
+    options->setPluginStringData("BrickSize", "8");
+    osg::ref_ptr<osg::Image> atlas = osgDB::readImageFile(fileName, options.get());
+    osg::Image* indirection = atlas.valid() ? dynamic_cast<osg::Image*>(
+        atlas->getUserDataContainer()->getUserObject("BrickIndirection")) : NULL;
+    if (!checker.check("Read " + fileName + " as brick atlas", indirection != NULL)) return;
+
+    osg::Vec3 origin, dims; osg::Vec2 range;
+    atlas->getUserValue("BrickOrigin", origin); atlas->getUserValue("VoxelDimensions", dims);
+    atlas->getUserValue("ValueRange", range);
+    double inv = (range[1] > range[0]) ? 1.0 / (range[1] - range[0]) : 1.0;
+    std::function<float (int, int, int)> denseValue = [&](int x, int y, int z)
+    {
+        x += (int)origin[0]; y += (int)origin[1]; z += (int)origin[2];
+        if (x < 0 || y < 0 || z < 0 || x >= w || y >= h || z >= d) x = y = z = -1;
+        double v = (x < 0) ? 0.0 : ((double)*dense->data(x, y, z) - range[0]) * inv;
+        return (unsigned char)(osg::clampBetween(v, 0.0, 1.0) * 255.0) / 255.0f;
+    };
+
+    // Every brick containing a non-zero voxel must be stored, and every voxel center must match
+    int numOccupied = 0, numStored = 0; float maxError = 0.0f;
+    for (int k = 0; k < indirection->r(); ++k) for (int j = 0; j < indirection->t(); ++j)
+        for (int i = 0; i < indirection->s(); ++i)
+        {
+            bool occupied = false;
+            for (int z = k * 8; z < k * 8 + 8; ++z) for (int y = j * 8; y < j * 8 + 8; ++y)
+                for (int x = i * 8; x < i * 8 + 8; ++x)
+                {
+                    float expected = denseValue(x, y, z); if (expected > 0.0f) occupied = true;
+                    osg::Vec3 uvw((x + 0.5f) / dims[0], (y + 0.5f) / dims[1], (z + 0.5f) / dims[2]);
+                    float sampled = osgVerse::sampleBrickVolume(*atlas, uvw);
+                    maxError = osg::maximum(maxError, std::abs(sampled - expected));
+                }
+            if (occupied) numOccupied++;
+            if (indirection->data(i, j, k)[3] > 0) numStored++;
+        }
+    checker.check("Indirection stores occupied bricks", numOccupied > 0 && numStored == numOccupied,
+                  std::to_string(numStored) + " stored, " + std::to_string(numOccupied) + " occupied");
+    checker.checkError("Voxel centers against dense volume", maxError, 1e-4);
+
+    // Between voxel centers of stored bricks, aprons must make filtering match the dense volume
+    maxError = 0.0f;
+    for (int n = 0; n < 10000; ++n)
+    {
+        osg::Vec3 uvw(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+        osg::Vec3 q(uvw[0] * dims[0], uvw[1] * dims[1], uvw[2] * dims[2]);
+        int bx = osg::minimum((int)q[0] / 8, indirection->s() - 1),
+            by = osg::minimum((int)q[1] / 8, indirection->t() - 1),
+            bz = osg::minimum((int)q[2] / 8, indirection->r() - 1);
+        if (indirection->data(bx, by, bz)[3] == 0) continue;
+
+        osg::Vec3 p = q - osg::Vec3(0.5f, 0.5f, 0.5f), f;
+        int v0[3] = { (int)floor(p[0]), (int)floor(p[1]), (int)floor(p[2]) };
+        for (int i = 0; i < 3; ++i) f[i] = p[i] - v0[i];
+
+        float expected = 0.0f;
+        for (int k = 0; k < 2; ++k) for (int j = 0; j < 2; ++j) for (int i = 0; i < 2; ++i)
+        {
+            float wt = (i ? f[0] : 1.0f - f[0]) * (j ? f[1] : 1.0f - f[1]) * (k ? f[2] : 1.0f - f[2]);
+            expected += wt * denseValue(v0[0] + i, v0[1] + j, v0[2] + k);
+        }
+        maxError = osg::maximum(maxError, std::abs(osgVerse::sampleBrickVolume(*atlas, uvw) - expected));
+    }
+    checker.checkError("Trilinear sampling against dense volume", maxError, 1e-4);
+}
+
 int main(int argc, char** argv)
 {
+    osg::ArgumentParser arguments(&argc, argv);
+#ifndef OSG_LIBRARY_STATIC
+    osgDB::Registry::instance()->loadLibrary(
+        osgDB::Registry::instance()->createLibraryNameForExtension("verse_vdb"));
+#endif
+    int checked = SelfCheck::run(arguments, "--check-bricks", [](SelfCheck& checker)
+        { checkBrickSampling(checker); checkVdbBricks(checker); });
+    if (checked >= 0) return checked;
     if (argc < 2)
     {
         std::cout << "Usage: " << argv[0] << " <image/image_seq file>" << std::endl;